@@ -1,420 +1,394 @@
-#include <iostream>
-#include <iomanip>
-#include <vector>
-#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <exception>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
 #include <random>
+#include <sstream>
 #include <string>
-#include <algorithm>
+#include <vector>
 
 #include "../libraries/qe_risk_engine/includes/Portfolio.h"
+#include "../libraries/qe_risk_engine/includes/PortfolioLoader.h"
+#include "../libraries/qe_risk_engine/includes/PortfolioSnapshot.h"
 #include "../libraries/qe_risk_engine/includes/Instrument.h"
 #include "../libraries/qe_risk_engine/includes/MarketData.h"
 #include "../libraries/qe_risk_engine/includes/RiskEngine.h"
+#include "../libraries/qe_risk_engine/includes/RiskPipeline.h"
+#include "../libraries/qe_risk_engine/includes/StressEngine.h"
 
-void printSeparator(char c = '=', int width = 70) {
-    std::cout << std::string(width, c) << std::endl;
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
 }
 
-void printHeader(const std::string& title) {
-    printSeparator();
-    std::cout << "  " << title << std::endl;
-    printSeparator();
-    std::cout << std::endl;
+struct Options {
+    std::string portfolio_path;
+    std::string market_data_path;
+    std::string output_path;
+    std::string snapshot_path;
+    int synthetic_positions = 0;
+    int simulations = 10000;
+    double horizon_days = 1.0;
+    bool fixed_seed = false;
+    unsigned int seed = 0;
+    std::vector<double> spot_shocks = {-0.2, -0.1, -0.05, 0.05, 0.1, 0.2};
+    std::vector<double> vol_shocks = {0.0};
+    bool pipeline = false;
+    size_t batch_size = RiskPipelineOptions().batch_size;
+    unsigned int workers = 0;
+};
+
+void printUsage(std::ostream& out) {
+    out << "Usage: risk-engine (--portfolio FILE | --synthetic N) [options]\n"
+           "\n"
+           "Prices a book, computes its Greeks, Monte Carlo VaR/ES and a spot x vol\n"
+           "stress ladder, and writes one result row per position.\n"
+           "\n"
+           "  --portfolio FILE       positions: .csv, .json or .qesnap snapshot\n"
+           "  --market-data FILE     market data: .csv, .json or .qesnap; defaults to the\n"
+           "                         portfolio file when that is .json or .qesnap\n"
+           "  --synthetic N          deterministic N-position book on 10 assets\n"
+           "  --output FILE          per-position results as CSV\n"
+           "  --simulations N        Monte Carlo paths (default 10000)\n"
+           "  --horizon DAYS         VaR horizon in trading days (default 1)\n"
+           "  --seed N               fixed random seed, for reproducible runs\n"
+           "  --spot-shocks LIST     relative spot moves of the stress ladder\n"
+           "                         (default -0.2,-0.1,-0.05,0.05,0.1,0.2)\n"
+           "  --vol-shocks LIST      absolute vol moves of the stress ladder (default 0)\n"
+           "  --write-snapshot FILE  save the loaded book and market data as a snapshot\n"
+           "  --pipeline             stream the portfolio file through concurrent load,\n"
+           "                         build, pricing, aggregate and write stages; the\n"
+           "                         book is never held whole, and component VaR and\n"
+           "                         the stress ladder are skipped\n"
+           "  --batch-size N         positions per pipeline batch (default 4096)\n"
+           "  --workers N            pipeline pricing threads (default: one per core)\n"
+           "  --help                 show this message\n";
 }
 
-std::vector<std::string> getRandomAssets(int count) {
-    std::vector<std::string> asset_pool = {
-        "AAPL", "GOOGL", "MSFT", "AMZN", "META", 
-        "TSLA", "NVDA", "JPM", "BAC", "WMT"
-    };
-    
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::shuffle(asset_pool.begin(), asset_pool.end(), gen);
-    
-    std::vector<std::string> selected;
-    for (int i = 0; i < std::min(count, (int)asset_pool.size()); ++i) {
-        selected.push_back(asset_pool[i]);
+std::vector<double> parseList(const std::string& text) {
+    std::vector<double> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t used = 0;
+        values.push_back(std::stod(item, &used));
+        if (used != item.size()) {
+            throw std::invalid_argument("Invalid number in list: " + item);
+        }
     }
-    return selected;
+    return values;
 }
 
-double getRandomPrice(double min = 50.0, double max = 500.0) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(min, max);
-    return dis(gen);
-}
+Options parseArguments(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(std::cout);
+            std::exit(0);
+        }
+        if (arg == "--pipeline") {
+            options.pipeline = true;
+            continue;
+        }
+        static const char* const kValueOptions[] = {
+            "--portfolio", "--market-data", "--synthetic", "--output", "--simulations",
+            "--horizon", "--seed", "--spot-shocks", "--vol-shocks", "--write-snapshot",
+            "--batch-size", "--workers"};
+        if (std::find(std::begin(kValueOptions), std::end(kValueOptions), arg) ==
+            std::end(kValueOptions)) {
+            throw std::invalid_argument("Unknown option " + arg);
+        }
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        const std::string value = argv[++i];
+        if (arg == "--portfolio") {
+            options.portfolio_path = value;
+        } else if (arg == "--market-data") {
+            options.market_data_path = value;
+        } else if (arg == "--synthetic") {
+            options.synthetic_positions = std::stoi(value);
+        } else if (arg == "--output") {
+            options.output_path = value;
+        } else if (arg == "--simulations") {
+            options.simulations = std::stoi(value);
+        } else if (arg == "--horizon") {
+            options.horizon_days = std::stod(value);
+        } else if (arg == "--seed") {
+            options.fixed_seed = true;
+            options.seed = static_cast<unsigned int>(std::stoul(value));
+        } else if (arg == "--spot-shocks") {
+            options.spot_shocks = parseList(value);
+        } else if (arg == "--vol-shocks") {
+            options.vol_shocks = parseList(value);
+        } else if (arg == "--batch-size") {
+            options.batch_size = std::stoul(value);
+        } else if (arg == "--workers") {
+            options.workers = static_cast<unsigned int>(std::stoul(value));
+        } else {
+            options.snapshot_path = value;
+        }
+    }
 
-double getRandomVolatility(double min = 0.15, double max = 0.35) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(min, max);
-    return dis(gen);
+    if (options.portfolio_path.empty() == (options.synthetic_positions <= 0)) {
+        throw std::invalid_argument("Give exactly one of --portfolio and --synthetic");
+    }
+    if (options.pipeline && options.portfolio_path.empty()) {
+        throw std::invalid_argument("--pipeline needs a --portfolio file");
+    }
+    if (options.pipeline && !options.snapshot_path.empty()) {
+        throw std::invalid_argument("--pipeline does not hold the book, so cannot --write-snapshot");
+    }
+    if (options.market_data_path.empty() && !options.portfolio_path.empty()) {
+        const PortfolioLoader::Format format = PortfolioLoader::formatOf(options.portfolio_path);
+        if (format == PortfolioLoader::Format::Csv) {
+            throw std::invalid_argument("--market-data is required with a CSV portfolio");
+        }
+        options.market_data_path = options.portfolio_path;
+    }
+    return options;
 }
 
-double getRandomRate(double min = 0.03, double max = 0.06) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(min, max);
-    return dis(gen);
-}
+// Calls and puts spread over the assets and a strike ladder, the same book
+// for the same N on every run
+void buildSyntheticBook(int positions, Portfolio& portfolio,
+                        std::map<std::string, MarketData>& market_data) {
+    const int asset_count = 10;
+    for (int a = 0; a < asset_count; ++a) {
+        const std::string asset_id = "ASSET" + std::to_string(a);
+        market_data[asset_id] = MarketData(asset_id, 80.0 + 5.0 * a, 0.04, 0.18 + 0.01 * a);
+    }
 
-double getRandomMaturity(double min = 0.1, double max = 2.0) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(min, max);
-    return dis(gen);
+    PositionBuffer buffer;
+    buffer.reserve(positions);
+    PositionRecord record;
+    for (int i = 0; i < positions; ++i) {
+        const int asset = i % asset_count;
+        record.asset_id = "ASSET" + std::to_string(asset);
+        record.is_call = i % 2 == 0;
+        record.strike = (80.0 + 5.0 * asset) * (0.8 + 0.05 * (i / asset_count % 9));
+        record.expiry = 0.25 + 0.25 * (i % 4);
+        record.quantity = i % 2 == 0 ? 10 : -5;
+        buffer.add(record);
+    }
+    portfolio.addPositions(buffer.columns());
 }
 
-int getRandomQuantity(int min = -100, int max = 100) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(min, max);
-    int qty = dis(gen);
-    return (qty == 0) ? min : qty;
-}
+void writePositionResults(const std::string& path, const Portfolio& portfolio,
+                          const PortfolioRiskResult& risk, const StressResult& stress) {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Cannot create " + path);
+    }
+    out << std::setprecision(12);
 
-OptionType getRandomOptionType() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 1);
-    return dis(gen) == 0 ? OptionType::Call : OptionType::Put;
-}
+    out << "position,position_id,asset_id,instrument,quantity,pv,delta,gamma,vega,theta,"
+           "component_var_95,component_var_99,component_es_95,component_es_99";
+    for (const auto& name : stress.scenario_names) {
+        out << ",\"stress " << name << "\"";
+    }
+    out << "\n";
 
-void demonstrateBasicPortfolio() {
-    printHeader("Basic Portfolio Risk Analysis");
-    
-    try {
-        Portfolio portfolio;
-        
-        auto assets = getRandomAssets(2);
-        std::map<std::string, MarketData> market_data;
-        
-        for (const auto& asset : assets) {
-            double spot = getRandomPrice();
-            double rate = getRandomRate();
-            double vol = getRandomVolatility();
-            market_data[asset] = MarketData(asset, spot, rate, vol);
-            
-            double strike = spot * (0.9 + (std::rand() % 21) / 100.0);
-            double maturity = getRandomMaturity();
-            OptionType opt_type = getRandomOptionType();
-            int quantity = getRandomQuantity(-100, 100);
-            
-            portfolio.addInstrument(
-                std::make_unique<EuropeanOption>(opt_type, strike, maturity, asset),
-                quantity
-            );
-        }
-        
-        RiskEngine engine;
-        engine.setVaRSimulations(50000);
-        
-        PortfolioRiskResult results = engine.calculatePortfolioRisk(portfolio, market_data);
-        
-        std::cout << std::fixed << std::setprecision(4);
-        std::cout << "Portfolio Size: " << portfolio.size() << " instruments\n" << std::endl;
-        
-        std::cout << "Risk Metrics:" << std::endl;
-        std::cout << "  Total PV:           $" << std::setw(12) << results.total_pv << std::endl;
-        std::cout << "  Total Delta:         " << std::setw(12) << results.total_delta << std::endl;
-        std::cout << "  Total Gamma:         " << std::setw(12) << results.total_gamma << std::endl;
-        std::cout << "  Total Vega:          " << std::setw(12) << results.total_vega << std::endl;
-        std::cout << "  Total Theta:         " << std::setw(12) << results.total_theta << std::endl;
-        std::cout << "\nValue at Risk (1-day):" << std::endl;
-        std::cout << "  95% VaR:            $" << std::setw(12) << results.value_at_risk_95 << std::endl;
-        std::cout << "  99% VaR:            $" << std::setw(12) << results.value_at_risk_99 << std::endl;
-        std::cout << "\nExpected Shortfall (1-day):" << std::endl;
-        std::cout << "  95% ES:             $" << std::setw(12) << results.expected_shortfall_95 << std::endl;
-        std::cout << "  99% ES:             $" << std::setw(12) << results.expected_shortfall_99 << std::endl;
-        
-        std::cout << "\nNet Positions:" << std::endl;
-        for (const auto& asset : assets) {
-            std::cout << "  " << std::left << std::setw(10) << (asset + ":") 
-                      << std::right << std::setw(12) << portfolio.getTotalQuantityForAsset(asset) << std::endl;
+    const auto& instruments = portfolio.getInstruments();
+    for (size_t i = 0; i < instruments.size(); ++i) {
+        const RiskContribution& r = risk.position_risk[i];
+        out << i << ',' << portfolio.getPositionId(i) << ','
+            << portfolio.getAssetName(portfolio.getPositionAsset(i)) << ','
+            << instruments[i].first->getInstrumentType() << ',' << instruments[i].second << ','
+            << r.pv << ',' << r.delta << ',' << r.gamma << ',' << r.vega << ',' << r.theta << ','
+            << r.component_var_95 << ',' << r.component_var_99 << ','
+            << r.component_es_95 << ',' << r.component_es_99;
+        for (size_t s = 0; s < stress.scenarioCount(); ++s) {
+            out << ',' << stress.pnl(s, i);
         }
-        
-        std::cout << "\n";
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Error in basic portfolio: " << e.what() << std::endl;
+        out << '\n';
     }
-}
 
-void demonstrateMultiplePricingModels() {
-    printHeader("Multiple Pricing Models Comparison");
-    
-    try {
-        auto asset = getRandomAssets(1)[0];
-        double spot = getRandomPrice();
-        double rate = getRandomRate();
-        double vol = getRandomVolatility();
-        double strike = spot * (0.95 + (std::rand() % 11) / 100.0);
-        double maturity = getRandomMaturity(0.5, 1.5);
-        
-        MarketData md(asset, spot, rate, vol);
-        
-        EuropeanOption bs_option(OptionType::Call, strike, maturity, asset, PricingModel::BlackScholes);
-        EuropeanOption bin_option(OptionType::Call, strike, maturity, asset, PricingModel::Binomial);
-        bin_option.setBinomialSteps(200);
-        
-        EuropeanOption jd_option(OptionType::Call, strike, maturity, asset, PricingModel::MertonJumpDiffusion);
-        jd_option.setJumpParameters(2.0, -0.05, 0.15);
-        
-        std::cout << std::fixed << std::setprecision(4);
-        std::cout << "Call Option (K=" << strike << ", S=" << spot 
-                  << ", T=" << maturity << ", σ=" << vol << "):\n" << std::endl;
-        
-        std::cout << "Black-Scholes Model:" << std::endl;
-        std::cout << "  Price:  $" << bs_option.price(md) << std::endl;
-        std::cout << "  Delta:   " << bs_option.delta(md) << std::endl;
-        std::cout << "  Gamma:   " << bs_option.gamma(md) << std::endl;
-        std::cout << "  Vega:    " << bs_option.vega(md) << std::endl;
-        std::cout << "  Theta:   " << bs_option.theta(md) << std::endl;
-        
-        std::cout << "\nBinomial Tree Model (200 steps):" << std::endl;
-        std::cout << "  Price:  $" << bin_option.price(md) << std::endl;
-        std::cout << "  Delta:   " << bin_option.delta(md) << std::endl;
-        
-        std::cout << "\nMerton Jump Diffusion Model (λ=2.0, μ=-0.05, σ_j=0.15):" << std::endl;
-        std::cout << "  Price:  $" << jd_option.price(md) << std::endl;
-        std::cout << "  Delta:   " << jd_option.delta(md) << std::endl;
-        
-        std::cout << "\n";
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Error in pricing models: " << e.what() << std::endl;
+    if (!out) {
+        throw std::runtime_error("Failed writing " + path);
     }
 }
 
-void demonstrateAmericanOptions() {
-    printHeader("American Options Pricing");
-    
-    try {
-        auto asset = getRandomAssets(1)[0];
-        double spot = getRandomPrice();
-        double rate = getRandomRate();
-        double vol = getRandomVolatility(0.2, 0.35);
-        double strike = spot * (0.9 + (std::rand() % 11) / 100.0);
-        double maturity = getRandomMaturity(0.3, 0.8);
-        
-        MarketData md(asset, spot, rate, vol);
-        
-        EuropeanOption euro_put(OptionType::Put, strike, maturity, asset);
-        AmericanOption american_put(OptionType::Put, strike, maturity, asset, 200);
-        
-        std::cout << std::fixed << std::setprecision(4);
-        std::cout << "Put Option (K=" << strike << ", S=" << spot 
-                  << ", T=" << maturity << ", σ=" << vol << "):\n" << std::endl;
-        
-        std::cout << "European Put:" << std::endl;
-        std::cout << "  Price:  $" << euro_put.price(md) << std::endl;
-        std::cout << "  Delta:   " << euro_put.delta(md) << std::endl;
-        
-        std::cout << "\nAmerican Put (200 steps):" << std::endl;
-        std::cout << "  Price:  $" << american_put.price(md) << std::endl;
-        std::cout << "  Delta:   " << american_put.delta(md) << std::endl;
-        
-        double early_exercise_premium = american_put.price(md) - euro_put.price(md);
-        std::cout << "\nEarly Exercise Premium: $" << early_exercise_premium << std::endl;
-        
-        std::cout << "\n";
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Error in American options: " << e.what() << std::endl;
-    }
+void printSeparator(char c = '=', int width = 70) {
+    std::cout << std::string(width, c) << std::endl;
 }
 
-void demonstrateMarketDataManager() {
-    printHeader("Market Data Manager");
-    
-    try {
-        MarketDataManager mdm;
-        
-        auto assets = getRandomAssets(3);
-        for (const auto& asset : assets) {
-            double spot = getRandomPrice();
-            double rate = getRandomRate();
-            double vol = getRandomVolatility();
-            mdm.addMarketData(asset, MarketData(asset, spot, rate, vol));
-        }
-        
-        std::cout << "Market Data Store Size: " << mdm.size() << " assets\n" << std::endl;
-        
-        std::cout << std::fixed << std::setprecision(2);
-        auto all_data = mdm.getAllMarketData();
-        for (const auto& [asset_id, md] : all_data) {
-            std::cout << asset_id << ":" << std::endl;
-            std::cout << "  Spot:  $" << md.spot_price << std::endl;
-            std::cout << "  Rate:   " << (md.risk_free_rate * 100) << "%" << std::endl;
-            std::cout << "  Vol:    " << (md.volatility * 100) << "%" << std::endl;
-            std::cout << std::endl;
+void printHeader(const std::string& title) {
+    printSeparator();
+    std::cout << "  " << title << std::endl;
+    printSeparator();
+}
+
+void printSummary(const Options& options, size_t positions, size_t assets,
+                  const PortfolioRiskResult& risk, const StressResult& stress,
+                  const std::map<std::string, double>& timings) {
+    std::cout << std::fixed << std::setprecision(4);
+
+    printHeader("Risk Summary");
+    std::cout << "  Positions:          " << std::setw(14) << positions << "\n"
+              << "  Assets:             " << std::setw(14) << assets << "\n"
+              << "  Total PV:           " << std::setw(14) << risk.total_pv << "\n"
+              << "  Total Delta:        " << std::setw(14) << risk.total_delta << "\n"
+              << "  Total Gamma:        " << std::setw(14) << risk.total_gamma << "\n"
+              << "  Total Vega:         " << std::setw(14) << risk.total_vega << "\n"
+              << "  Total Theta:        " << std::setw(14) << risk.total_theta << "\n"
+              << "  95% VaR:            " << std::setw(14) << risk.value_at_risk_95 << "\n"
+              << "  99% VaR:            " << std::setw(14) << risk.value_at_risk_99 << "\n"
+              << "  95% ES:             " << std::setw(14) << risk.expected_shortfall_95 << "\n"
+              << "  99% ES:             " << std::setw(14) << risk.expected_shortfall_99 << "\n"
+              << "  (" << options.simulations << " paths, " << std::defaultfloat
+              << options.horizon_days << "-day horizon)\n\n" << std::fixed;
+
+    if (stress.scenarioCount() > 0) {
+        size_t worst = 0;
+        for (size_t s = 1; s < stress.scenarioCount(); ++s) {
+            if (stress.total_pnl[s] < stress.total_pnl[worst]) worst = s;
         }
-        
-        if (!assets.empty()) {
-            double new_spot = getRandomPrice();
-            mdm.updateMarketData(assets[0], MarketData(assets[0], new_spot, 
-                                mdm.getMarketData(assets[0]).risk_free_rate,
-                                mdm.getMarketData(assets[0]).volatility));
-            std::cout << "Updated " << assets[0] << " spot price to: $" 
-                      << mdm.getMarketData(assets[0]).spot_price << std::endl;
+        std::cout << "  Stress scenarios:   " << std::setw(14) << stress.scenarioCount() << "\n"
+                  << "  Worst scenario:     " << std::setw(14) << stress.total_pnl[worst]
+                  << "  (" << stress.scenario_names[worst] << ")\n\n";
+    }
+
+    printHeader("Timing (seconds)");
+    for (const auto& [stage, seconds] : timings) {
+        std::cout << "  " << std::left << std::setw(20) << stage << std::right
+                  << std::setw(14) << seconds << "\n";
+    }
+    const Profiling::Report& profile = risk.profile;
+    if (profile.enabled) {
+        std::cout << "\n  Risk run phases (summed over threads):\n";
+        for (size_t p = 0; p < Profiling::kPhaseCount; ++p) {
+            std::cout << "    " << std::left << std::setw(18)
+                      << Profiling::phaseName(static_cast<Profiling::Phase>(p)) << std::right
+                      << std::setw(14) << profile.phase_seconds[p] << "\n";
         }
-        
-        std::cout << "\n";
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Error in market data manager: " << e.what() << std::endl;
+        std::cout << "    pricings: " << profile.count(Profiling::Counter::Pricings)
+                  << ", paths: " << profile.count(Profiling::Counter::Paths) << "\n";
     }
+    printSeparator();
 }
 
-void demonstrateComplexPortfolio() {
-    printHeader("Complex Multi-Asset Portfolio");
-    
-    try {
-        Portfolio portfolio;
-        portfolio.reserve(10);
-        
-        auto assets = getRandomAssets(2);
-        std::map<std::string, MarketData> market_data;
-        
-        for (const auto& asset : assets) {
-            double spot = getRandomPrice(100.0, 300.0);
-            double rate = getRandomRate();
-            double vol = getRandomVolatility();
-            market_data[asset] = MarketData(asset, spot, rate, vol);
-            
-            int num_options = 2 + std::rand() % 3;
-            for (int i = 0; i < num_options; ++i) {
-                double strike_mult = 0.85 + (std::rand() % 31) / 100.0;
-                double strike = spot * strike_mult;
-                double maturity = getRandomMaturity(0.2, 0.8);
-                OptionType opt_type = getRandomOptionType();
-                int quantity = getRandomQuantity(-50, 50);
-                
-                portfolio.addInstrument(
-                    std::make_unique<EuropeanOption>(opt_type, strike, maturity, asset),
-                    quantity
-                );
-            }
-        }
-        
-        RiskEngine engine;
-        engine.setVaRSimulations(100000);
-        engine.setVaRTimeHorizonDays(1.0);
-        
-        PortfolioRiskResult results = engine.calculatePortfolioRisk(portfolio, market_data);
-        
-        std::cout << std::fixed << std::setprecision(4);
-        std::cout << "Portfolio Composition:" << std::endl;
-        std::cout << "  Total Instruments:  " << portfolio.size() << std::endl;
-        for (const auto& asset : assets) {
-            std::cout << "  " << asset << " Net Position:  " 
-                      << portfolio.getTotalQuantityForAsset(asset) << std::endl;
-        }
-        std::cout << std::endl;
-        
-        std::cout << "Risk Metrics:" << std::endl;
-        std::cout << "  Total PV:           $" << std::setw(12) << results.total_pv << std::endl;
-        std::cout << "  Total Delta:         " << std::setw(12) << results.total_delta << std::endl;
-        std::cout << "  Total Gamma:         " << std::setw(12) << results.total_gamma << std::endl;
-        std::cout << "  Total Vega:          " << std::setw(12) << results.total_vega << std::endl;
-        std::cout << "  Total Theta:         " << std::setw(12) << results.total_theta << std::endl;
-        
-        std::cout << "\nValue at Risk (1-day):" << std::endl;
-        std::cout << "  95% VaR:            $" << std::setw(12) << results.value_at_risk_95 << std::endl;
-        std::cout << "  99% VaR:            $" << std::setw(12) << results.value_at_risk_99 << std::endl;
-        
-        std::cout << "\nExpected Shortfall (1-day):" << std::endl;
-        std::cout << "  95% ES:             $" << std::setw(12) << results.expected_shortfall_95 << std::endl;
-        std::cout << "  99% ES:             $" << std::setw(12) << results.expected_shortfall_99 << std::endl;
-        
-        std::cout << "\n  Simulations:        " << engine.getVaRSimulations() << std::endl;
-        std::cout << std::endl;
-        
-        std::string delta_status = "NEUTRAL";
-        if (std::abs(results.total_delta) > 10.0) {
-            delta_status = results.total_delta > 0 ? "LONG" : "SHORT";
-        }
-        
-        std::string gamma_status = results.total_gamma > 0.1 ? "LONG GAMMA" : "SHORT GAMMA";
-        
-        std::cout << "Portfolio Positioning:" << std::endl;
-        std::cout << "  Delta:  " << delta_status << std::endl;
-        std::cout << "  Gamma:  " << gamma_status << std::endl;
-        
-        std::cout << "\n";
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Error in complex portfolio: " << e.what() << std::endl;
+int runPipeline(const Options& options) {
+    const Clock::time_point start = Clock::now();
+    const std::map<std::string, MarketData> market_data_map =
+        PortfolioLoader::loadMarketData(options.market_data_path);
+
+    RiskPipelineOptions pipeline_options;
+    pipeline_options.batch_size = options.batch_size;
+    pipeline_options.pricing_workers = options.workers;
+    pipeline_options.var_simulations = options.simulations;
+    pipeline_options.time_horizon_days = options.horizon_days;
+    if (options.fixed_seed) {
+        pipeline_options.seed = options.seed;
+    } else {
+        pipeline_options.seed = std::random_device()();
+    }
+    const RiskPipeline pipeline(market_data_map, pipeline_options);
+    const RiskPipelineResult result = pipeline.run(options.portfolio_path, options.output_path);
+    if (result.positions == 0) {
+        throw std::invalid_argument("Portfolio is empty");
     }
+
+    // Stages overlap, so their busy times add up to more than the wall time
+    std::map<std::string, double> timings;
+    timings["1 load"] = result.load_seconds;
+    timings["2 build"] = result.build_seconds;
+    timings["3 pricing (workers)"] = result.pricing_seconds;
+    timings["4 aggregate"] = result.aggregate_seconds;
+    if (!options.output_path.empty()) {
+        timings["5 write results"] = result.write_seconds;
+    }
+    timings["6 total"] = secondsSince(start);
+
+    printSummary(options, result.positions, result.asset_names.size(), result.risk,
+                 StressResult(), timings);
+    return 0;
 }
 
-void demonstrateErrorHandling() {
-    printHeader("Error Handling and Validation");
-    
-    std::cout << "Testing input validation:\n" << std::endl;
-    
-    try {
-        MarketData invalid_md("TEST", -100.0, 0.05, 0.2);
-    } catch (const std::exception& e) {
-        std::cout << "✓ Caught invalid spot price: " << e.what() << std::endl;
+int run(const Options& options) {
+    if (options.pipeline) {
+        return runPipeline(options);
     }
-    
-    try {
-        EuropeanOption invalid_option(OptionType::Call, -100.0, 1.0, "TEST");
-    } catch (const std::exception& e) {
-        std::cout << "✓ Caught invalid strike: " << e.what() << std::endl;
+
+    std::map<std::string, double> timings;
+    const Clock::time_point start = Clock::now();
+
+    Portfolio portfolio;
+    std::map<std::string, MarketData> market_data_map;
+    if (options.synthetic_positions > 0) {
+        buildSyntheticBook(options.synthetic_positions, portfolio, market_data_map);
+    } else {
+        PortfolioLoader::loadPositions(options.portfolio_path, portfolio);
+        market_data_map = PortfolioLoader::loadMarketData(options.market_data_path);
     }
-    
-    try {
-        Portfolio portfolio;
-        portfolio.addInstrument(nullptr, 10);
-    } catch (const std::exception& e) {
-        std::cout << "✓ Caught null instrument: " << e.what() << std::endl;
+    timings["1 load"] = secondsSince(start);
+    if (portfolio.empty()) {
+        throw std::invalid_argument("Portfolio is empty");
     }
-    
-    try {
-        RiskEngine engine;
-        engine.setVaRSimulations(-1000);
-    } catch (const std::exception& e) {
-        std::cout << "✓ Caught invalid VaR simulations: " << e.what() << std::endl;
+
+    if (!options.snapshot_path.empty()) {
+        const Clock::time_point snapshot_start = Clock::now();
+        PortfolioSnapshot::write(options.snapshot_path, portfolio, market_data_map);
+        timings["2 write snapshot"] = secondsSince(snapshot_start);
+    }
+
+    const MarketDataTable market_data(market_data_map);
+    RiskEngine engine(options.simulations);
+    engine.setVaRTimeHorizonDays(options.horizon_days);
+    if (options.fixed_seed) {
+        engine.setRandomSeed(options.seed);
+    }
+    StressEngine stress_engine;
+    const std::vector<StressScenario> scenarios =
+        StressEngine::ladder(options.spot_shocks, options.vol_shocks);
+
+    // Both are internally parallel and only read the book, so they share it
+    const Clock::time_point risk_start = Clock::now();
+    auto stress_future = std::async(std::launch::async, [&]() {
+        const Clock::time_point stress_start = Clock::now();
+        StressResult result = stress_engine.run(portfolio, market_data, scenarios);
+        return std::make_pair(std::move(result), secondsSince(stress_start));
+    });
+    const PortfolioRiskResult risk = engine.calculatePortfolioRisk(portfolio, market_data);
+    timings["3 greeks and VaR"] = secondsSince(risk_start);
+    auto [stress, stress_seconds] = stress_future.get();
+    timings["4 stress"] = stress_seconds;
+
+    if (!options.output_path.empty()) {
+        const Clock::time_point write_start = Clock::now();
+        writePositionResults(options.output_path, portfolio, risk, stress);
+        timings["5 write results"] = secondsSince(write_start);
     }
-    
+    timings["6 total"] = secondsSince(start);
+
+    printSummary(options, portfolio.size(), portfolio.getAssetCount(), risk, stress, timings);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
     try {
-        Portfolio portfolio;
-        portfolio.getTotalQuantityForAsset("");
+        options = parseArguments(argc, argv);
     } catch (const std::exception& e) {
-        std::cout << "✓ Caught empty asset ID: " << e.what() << std::endl;
+        std::cerr << "Error: " << e.what() << "\n\n";
+        printUsage(std::cerr);
+        return 2;
     }
-    
-    std::cout << "\nAll validation tests passed!" << std::endl;
-    std::cout << "\n";
-}
 
-int main() {
-    std::cout << "\n";
-    printSeparator('=', 70);
-    std::cout << "  QUANTITATIVE RISK ENGINE - DEMONSTRATION" << std::endl;
-    printSeparator('=', 70);
-    std::cout << "\n";
-    
     try {
-        demonstrateBasicPortfolio();
-        demonstrateMultiplePricingModels();
-        demonstrateAmericanOptions();
-        demonstrateMarketDataManager();
-        demonstrateComplexPortfolio();
-        demonstrateErrorHandling();
-        
-        printSeparator('=', 70);
-        std::cout << "  All demonstrations completed successfully!" << std::endl;
-        printSeparator('=', 70);
-        std::cout << "\n";
-        
-        return 0;
-        
+        return run(options);
     } catch (const std::exception& e) {
         std::cerr << "\nFATAL ERROR: " << e.what() << std::endl;
         return 1;
@@ -0,0 +1,83 @@
+#include "Instrument.h"
+#include "MarketData.h"
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+
+namespace {
+
+const MarketData kMarketData("AAPL", 100.0, 0.05, 0.22);
+
+enum class Metric { Price, Delta, Gamma, Vega, Theta };
+
+const char *metricName(Metric metric) {
+  switch (metric) {
+  case Metric::Price: return "price";
+  case Metric::Delta: return "delta";
+  case Metric::Gamma: return "gamma";
+  case Metric::Vega: return "vega";
+  case Metric::Theta: return "theta";
+  }
+  return "";
+}
+
+double evaluate(const Instrument &instrument, Metric metric, const MarketData &md) {
+  switch (metric) {
+  case Metric::Price: return instrument.price(md);
+  case Metric::Delta: return instrument.delta(md);
+  case Metric::Gamma: return instrument.gamma(md);
+  case Metric::Vega: return instrument.vega(md);
+  case Metric::Theta: return instrument.theta(md);
+  }
+  return 0.0;
+}
+
+std::unique_ptr<Instrument> europeanOption(PricingModel model) {
+  auto option = std::make_unique<EuropeanOption>(OptionType::Call, 105.0, 0.75, "AAPL", model);
+  if (model == PricingModel::MertonJumpDiffusion) {
+    option->setJumpParameters(0.5, -0.1, 0.15);
+  } else if (model == PricingModel::Heston) {
+    option->setHestonParameters(0.05, 2.0, 0.06, 0.6, -0.65);
+  }
+  return option;
+}
+
+void BM_InstrumentMetric(benchmark::State &state, std::shared_ptr<const Instrument> instrument,
+                         Metric metric) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(evaluate(*instrument, metric, kMarketData));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Every Greek of every model, named Instrument/<type>/<model>/<metric>
+int registerInstrumentBenchmarks() {
+  const std::pair<const char *, PricingModel> models[] = {
+      {"BlackScholes", PricingModel::BlackScholes},
+      {"Binomial", PricingModel::Binomial},
+      {"MertonJumpDiffusion", PricingModel::MertonJumpDiffusion},
+      {"Heston", PricingModel::Heston}};
+  const Metric metrics[] = {Metric::Price, Metric::Delta, Metric::Gamma, Metric::Vega,
+                            Metric::Theta};
+
+  for (const auto &[model_name, model] : models) {
+    std::shared_ptr<const Instrument> option = europeanOption(model);
+    for (Metric metric : metrics) {
+      const std::string name = std::string("Instrument/EuropeanOption/") + model_name + "/" +
+                               metricName(metric);
+      benchmark::RegisterBenchmark(name.c_str(), BM_InstrumentMetric, option, metric);
+    }
+  }
+
+  std::shared_ptr<const Instrument> american =
+      std::make_shared<AmericanOption>(OptionType::Put, 105.0, 0.75, "AAPL");
+  for (Metric metric : metrics) {
+    const std::string name = std::string("Instrument/AmericanOption/Binomial/") + metricName(metric);
+    benchmark::RegisterBenchmark(name.c_str(), BM_InstrumentMetric, american, metric);
+  }
+  return 0;
+}
+
+const int registered = registerInstrumentBenchmarks();
+
+} // namespace
@@ -0,0 +1,153 @@
+#include "BinomialTree.h"
+#include "BlackScholes.h"
+#include "Heston.h"
+#include "ImpliedVolatilitySurface.h"
+#include "JumpDiffusion.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+const double S = 100.0, K = 105.0, r = 0.05, T = 0.75, sigma = 0.22;
+
+using BlackScholesFunction = double (*)(double, double, double, double, double);
+
+void BM_BlackScholes(benchmark::State &state, BlackScholesFunction function) {
+  // Strike walks across the chain so branches and caches see varied inputs
+  double strike = 80.0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(function(S, strike, r, T, sigma));
+    strike = strike < 120.0 ? strike + 0.5 : 80.0;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CAPTURE(BM_BlackScholes, callPrice, &BlackScholes::callPrice);
+BENCHMARK_CAPTURE(BM_BlackScholes, putPrice, &BlackScholes::putPrice);
+BENCHMARK_CAPTURE(BM_BlackScholes, callDelta, &BlackScholes::callDelta);
+BENCHMARK_CAPTURE(BM_BlackScholes, putDelta, &BlackScholes::putDelta);
+BENCHMARK_CAPTURE(BM_BlackScholes, gamma, &BlackScholes::gamma);
+BENCHMARK_CAPTURE(BM_BlackScholes, vega, &BlackScholes::vega);
+BENCHMARK_CAPTURE(BM_BlackScholes, callTheta, &BlackScholes::callTheta);
+BENCHMARK_CAPTURE(BM_BlackScholes, putTheta, &BlackScholes::putTheta);
+BENCHMARK_CAPTURE(BM_BlackScholes, callRho, &BlackScholes::callRho);
+BENCHMARK_CAPTURE(BM_BlackScholes, putRho, &BlackScholes::putRho);
+
+void BM_BlackScholesImpliedVol(benchmark::State &state) {
+  const double price = BlackScholes::callPrice(S, K, r, T, sigma);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(BlackScholes::impliedVolatility(price, S, K, r, T, true));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BlackScholesImpliedVol);
+
+void BM_BlackScholesImpliedVolBatch(benchmark::State &state) {
+  const size_t count = static_cast<size_t>(state.range(0));
+  std::vector<BlackScholes::ImpliedVolQuote> quotes(count);
+  for (size_t i = 0; i < count; ++i) {
+    const double strike = 60.0 + 80.0 * static_cast<double>(i) / count;
+    const double expiry = 0.1 + 1.9 * static_cast<double>(i % 16) / 16.0;
+    const bool is_call = strike >= S;
+    quotes[i] = {is_call ? BlackScholes::callPrice(S, strike, r, expiry, sigma)
+                         : BlackScholes::putPrice(S, strike, r, expiry, sigma),
+                 strike, expiry, is_call};
+  }
+  std::vector<double> vols(count);
+  for (auto _ : state) {
+    BlackScholes::impliedVolatility(quotes.data(), count, S, r, vols.data());
+    benchmark::DoNotOptimize(vols.data());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_BlackScholesImpliedVolBatch)->RangeMultiplier(10)->Range(100, 100000);
+
+void BM_BinomialEuropean(benchmark::State &state) {
+  const int steps = static_cast<int>(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        BinomialTree::europeanOptionPrice(S, K, r, T, sigma, OptionType::Call, steps));
+  }
+  state.SetComplexityN(steps);
+}
+BENCHMARK(BM_BinomialEuropean)->RangeMultiplier(2)->Range(32, 2048)->Complexity();
+
+void BM_BinomialAmerican(benchmark::State &state) {
+  const int steps = static_cast<int>(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        BinomialTree::americanOptionPrice(S, K, r, T, sigma, OptionType::Put, steps));
+  }
+  state.SetComplexityN(steps);
+}
+BENCHMARK(BM_BinomialAmerican)->RangeMultiplier(2)->Range(32, 2048)->Complexity();
+
+void BM_MertonJumpDiffusion(benchmark::State &state) {
+  const int max_jumps = static_cast<int>(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(JumpDiffusion::mertonOptionPrice(
+        S, K, r, T, sigma, OptionType::Call, 0.5, -0.1, 0.15, max_jumps));
+  }
+}
+BENCHMARK(BM_MertonJumpDiffusion)->Arg(10)->Arg(50)->Arg(200);
+
+void BM_HestonPrice(benchmark::State &state) {
+  Heston::Parameters params;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Heston::optionPrice(S, K, r, T, OptionType::Call, params));
+  }
+}
+BENCHMARK(BM_HestonPrice);
+
+void BM_HestonPriceWithGradient(benchmark::State &state) {
+  Heston::Parameters params;
+  Heston::Gradient gradient;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Heston::callPriceWithGradient(S, K, r, T, params, gradient));
+  }
+}
+BENCHMARK(BM_HestonPriceWithGradient);
+
+VolatilitySurface::ImpliedVolSurface sampleSurface(int strikes, int expiries) {
+  VolatilitySurface::ImpliedVolSurface surface;
+  for (int e = 0; e < expiries; ++e) {
+    const double expiry = 0.1 + 2.0 * e / expiries;
+    for (int k = 0; k < strikes; ++k) {
+      const double strike = 60.0 + 80.0 * k / strikes;
+      const double skew = 0.25 - 0.1 * (strike - S) / S;
+      surface.addPoint(strike, expiry, skew + 0.02 * std::sqrt(expiry));
+    }
+  }
+  return surface;
+}
+
+void BM_SurfaceInterpolate(benchmark::State &state) {
+  const VolatilitySurface::ImpliedVolSurface surface =
+      sampleSurface(static_cast<int>(state.range(0)), 12);
+  double strike = 65.0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(surface.interpolate(strike, 0.8));
+    strike = strike < 135.0 ? strike + 0.7 : 65.0;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SurfaceInterpolate)->Arg(10)->Arg(50)->Arg(200);
+
+void BM_SurfaceInterpolateBatch(benchmark::State &state) {
+  const VolatilitySurface::ImpliedVolSurface surface = sampleSurface(50, 12);
+  const size_t count = static_cast<size_t>(state.range(0));
+  std::vector<double> strikes(count), expiries(count), vols(count);
+  for (size_t i = 0; i < count; ++i) {
+    strikes[i] = 65.0 + 70.0 * static_cast<double>(i) / count;
+    expiries[i] = 0.1 + 2.0 * static_cast<double>(i % 24) / 24.0;
+  }
+  for (auto _ : state) {
+    surface.interpolate(strikes.data(), expiries.data(), vols.data(), count);
+    benchmark::DoNotOptimize(vols.data());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_SurfaceInterpolateBatch)->RangeMultiplier(10)->Range(100, 100000);
+
+} // namespace
@@ -0,0 +1,75 @@
+#include "Instrument.h"
+#include "MarketData.h"
+#include "Portfolio.h"
+#include "RiskEngine.h"
+#include <benchmark/benchmark.h>
+#include <map>
+#include <string>
+
+namespace {
+
+const int kAssetCount = 10;
+
+std::map<std::string, MarketData> benchmarkMarketData() {
+  std::map<std::string, MarketData> market_data;
+  for (int a = 0; a < kAssetCount; ++a) {
+    const std::string asset_id = "ASSET" + std::to_string(a);
+    market_data[asset_id] = MarketData(asset_id, 80.0 + 5.0 * a, 0.04, 0.18 + 0.01 * a);
+  }
+  return market_data;
+}
+
+// Black-Scholes calls and puts spread over the assets and a strike ladder
+void buildPortfolio(Portfolio &portfolio, int positions) {
+  portfolio.reserveInstruments<EuropeanOption>(positions);
+  for (int i = 0; i < positions; ++i) {
+    const int asset = i % kAssetCount;
+    const double spot = 80.0 + 5.0 * asset;
+    const double strike = spot * (0.8 + 0.05 * (i / kAssetCount % 9));
+    portfolio.emplaceInstrument<EuropeanOption>(
+        i % 2 == 0 ? 10 : -5, i % 2 == 0 ? OptionType::Call : OptionType::Put, strike,
+        0.25 + 0.25 * (i % 4), "ASSET" + std::to_string(asset));
+  }
+}
+
+// Args: portfolio size, simulation count
+void BM_CalculatePortfolioRisk(benchmark::State &state) {
+  Portfolio portfolio;
+  buildPortfolio(portfolio, static_cast<int>(state.range(0)));
+  const MarketDataTable market_data(benchmarkMarketData());
+  RiskEngine engine(static_cast<int>(state.range(1)));
+  engine.setRandomSeed(42);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(engine.calculatePortfolioRisk(portfolio, market_data));
+  }
+  // One item per position revalued on one path
+  state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+}
+BENCHMARK(BM_CalculatePortfolioRisk)
+    ->ArgNames({"positions", "paths"})
+    ->ArgsProduct({{1, 10, 100}, {1000, 10000, 100000}})
+    ->Args({1000, 10000})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+void BM_CalculateHorizonRisk(benchmark::State &state) {
+  Portfolio portfolio;
+  buildPortfolio(portfolio, static_cast<int>(state.range(0)));
+  const MarketDataTable market_data(benchmarkMarketData());
+  RiskEngine engine(10000);
+  engine.setRandomSeed(42);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        engine.calculateHorizonRisk(portfolio, market_data, {1.0, 10.0, 20.0}));
+  }
+}
+BENCHMARK(BM_CalculateHorizonRisk)
+    ->ArgName("positions")
+    ->Arg(10)
+    ->Arg(100)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
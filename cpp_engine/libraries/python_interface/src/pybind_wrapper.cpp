@@ -1,16 +1,125 @@
 #include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 #include <pybind11/stl_bind.h>
 
+#include "BlackScholes.h"
 #include "Instrument.h"
 #include "Portfolio.h"
+#include "PortfolioLoader.h"
+#include "PortfolioSnapshot.h"
+#include "ReturnHistory.h"
 #include "RiskEngine.h"
+#include "RiskSession.h"
+#include "StressEngine.h"
 #include "MarketData.h"
+#include "ImpliedVolatilitySurface.h"
+#include "SVISurface.h"
 
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace py = pybind11;
 
+namespace
+{
+    template <typename T>
+    using InputColumn = py::array_t<T, py::array::c_style | py::array::forcecast>;
+
+    template <typename T>
+    const T *optionalColumn(const std::optional<InputColumn<T>> &column, size_t count,
+                            const char *name)
+    {
+        if (!column)
+            return nullptr;
+        if (static_cast<size_t>(column->size()) != count)
+            throw py::value_error(std::string(name) + " must have one entry per position");
+        return column->data();
+    }
+
+    // Factorises the asset ids into codes and hands the columns to
+    // Portfolio::addPositions, which copies everything it keeps
+    void addPositionArrays(Portfolio &portfolio, const InputColumn<uint8_t> &is_call,
+                           const InputColumn<double> &strike, const InputColumn<double> &expiry,
+                           const std::vector<std::string> &asset_id,
+                           const InputColumn<int32_t> &quantity,
+                           const std::optional<InputColumn<uint8_t>> &american,
+                           const std::optional<InputColumn<uint8_t>> &model,
+                           const std::optional<InputColumn<int32_t>> &binomial_steps,
+                           const std::optional<InputColumn<double>> &jump_intensity,
+                           const std::optional<InputColumn<double>> &jump_mean,
+                           const std::optional<InputColumn<double>> &jump_vol)
+    {
+        const size_t count = static_cast<size_t>(is_call.size());
+        for (const size_t size : {static_cast<size_t>(strike.size()),
+                                  static_cast<size_t>(expiry.size()), asset_id.size(),
+                                  static_cast<size_t>(quantity.size())})
+        {
+            if (size != count)
+                throw py::value_error("All position columns must have the same length");
+        }
+
+        std::vector<std::string> asset_names;
+        std::vector<int32_t> asset_codes(count);
+        std::unordered_map<std::string, int32_t> codes;
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto [it, inserted] = codes.emplace(asset_id[i], static_cast<int32_t>(asset_names.size()));
+            if (inserted)
+                asset_names.push_back(asset_id[i]);
+            asset_codes[i] = it->second;
+        }
+
+        PositionColumns columns;
+        columns.count = count;
+        columns.is_call = is_call.data();
+        columns.strike = strike.data();
+        columns.expiry = expiry.data();
+        columns.quantity = quantity.data();
+        columns.asset = asset_codes.data();
+        columns.asset_names = asset_names.data();
+        columns.asset_name_count = asset_names.size();
+        columns.american = optionalColumn(american, count, "american");
+        columns.model = optionalColumn(model, count, "model");
+        columns.binomial_steps = optionalColumn(binomial_steps, count, "binomial_steps");
+        columns.jump_intensity = optionalColumn(jump_intensity, count, "jump_intensity");
+        columns.jump_mean = optionalColumn(jump_mean, count, "jump_mean");
+        columns.jump_vol = optionalColumn(jump_vol, count, "jump_vol");
+        portfolio.addPositions(columns);
+    }
+
+    // Python's Portfolio. Calculations read it with the GIL released, so they
+    // hold `access` shared for the call and mutators hold it exclusively.
+    // Methods that only read run under the GIL without the lock, which is
+    // safe because mutators also hold the GIL while they change anything.
+    struct PyPortfolio : Portfolio
+    {
+        mutable std::shared_mutex access;
+    };
+
+    // Called with the GIL released
+    std::shared_lock<std::shared_mutex> readLock(const PyPortfolio &portfolio)
+    {
+        return std::shared_lock<std::shared_mutex>(portfolio.access);
+    }
+
+    // Waits for running calculations without the GIL, so they can finish,
+    // and returns with both the GIL and the exclusive lock held. Neither lock
+    // is ever waited for while holding the other.
+    std::unique_lock<std::shared_mutex> writeLock(PyPortfolio &portfolio)
+    {
+        std::unique_lock<std::shared_mutex> lock(portfolio.access, std::defer_lock);
+        py::gil_scoped_release release;
+        lock.lock();
+        return lock;
+    }
+}
+
 PYBIND11_MODULE(quant_risk_engine, m)
 {
     m.doc() = "Python bindings for the Quant Enthusiasts Risk Engine";
@@ -24,6 +133,7 @@ PYBIND11_MODULE(quant_risk_engine, m)
         .value("BlackScholes", PricingModel::BlackScholes)
         .value("Binomial", PricingModel::Binomial)
         .value("MertonJumpDiffusion", PricingModel::MertonJumpDiffusion)
+        .value("Heston", PricingModel::Heston)
         .export_values();
 
     py::class_<MarketData>(m, "MarketData")
@@ -40,6 +150,127 @@ PYBIND11_MODULE(quant_risk_engine, m)
         .def("validate", &MarketData::validate)
         .def("is_valid", &MarketData::isValid);
 
+    py::class_<VolatilitySurface::ImpliedVolSurface,
+               std::shared_ptr<VolatilitySurface::ImpliedVolSurface>>(m, "ImpliedVolSurface")
+        .def(py::init<>())
+        .def("add_point", &VolatilitySurface::ImpliedVolSurface::addPoint,
+             py::arg("strike"), py::arg("expiry"), py::arg("implied_vol"))
+        .def("interpolate",
+             py::overload_cast<double, double>(&VolatilitySurface::ImpliedVolSurface::interpolate, py::const_),
+             py::arg("strike"), py::arg("expiry"))
+        .def("interpolate",
+             py::overload_cast<const std::vector<double>&, const std::vector<double>&>(
+                 &VolatilitySurface::ImpliedVolSurface::interpolate, py::const_),
+             py::arg("strikes"), py::arg("expiries"))
+        .def("set_forward_rate", &VolatilitySurface::ImpliedVolSurface::setForwardRate)
+        .def("get_forward_rate", &VolatilitySurface::ImpliedVolSurface::getForwardRate)
+        .def("has_data", &VolatilitySurface::ImpliedVolSurface::hasData)
+        .def("size", &VolatilitySurface::ImpliedVolSurface::size)
+        .def("clear", &VolatilitySurface::ImpliedVolSurface::clear)
+        .def("__len__", &VolatilitySurface::ImpliedVolSurface::size);
+
+    py::class_<VolatilitySurface::SVIParameters>(m, "SVIParameters")
+        .def(py::init<>())
+        .def_readwrite("a", &VolatilitySurface::SVIParameters::a)
+        .def_readwrite("b", &VolatilitySurface::SVIParameters::b)
+        .def_readwrite("rho", &VolatilitySurface::SVIParameters::rho)
+        .def_readwrite("m", &VolatilitySurface::SVIParameters::m)
+        .def_readwrite("sigma", &VolatilitySurface::SVIParameters::sigma)
+        .def("total_variance", &VolatilitySurface::SVIParameters::totalVariance, py::arg("k"))
+        .def("is_valid", &VolatilitySurface::SVIParameters::isValid);
+
+    py::class_<VolatilitySurface::SVISlice>(m, "SVISlice")
+        .def_readonly("expiry", &VolatilitySurface::SVISlice::expiry)
+        .def_readonly("params", &VolatilitySurface::SVISlice::params)
+        .def_readonly("rmse", &VolatilitySurface::SVISlice::rmse)
+        .def_readonly("quotes", &VolatilitySurface::SVISlice::quotes);
+
+    py::class_<VolatilitySurface::ArbitrageReport>(m, "ArbitrageReport")
+        .def_readonly("butterfly_violations", &VolatilitySurface::ArbitrageReport::butterfly_violations)
+        .def_readonly("calendar_violations", &VolatilitySurface::ArbitrageReport::calendar_violations)
+        .def("is_butterfly_free", &VolatilitySurface::ArbitrageReport::isButterflyFree)
+        .def("is_calendar_free", &VolatilitySurface::ArbitrageReport::isCalendarFree)
+        .def("is_arbitrage_free", &VolatilitySurface::ArbitrageReport::isArbitrageFree);
+
+    py::class_<VolatilitySurface::ParametricSurface>(m, "ParametricSurface")
+        .def("total_variance", &VolatilitySurface::ParametricSurface::totalVariance,
+             py::arg("k"), py::arg("expiry"))
+        .def("implied_vol", &VolatilitySurface::ParametricSurface::impliedVol,
+             py::arg("strike"), py::arg("expiry"))
+        .def("skew", &VolatilitySurface::ParametricSurface::skew, py::arg("expiry"))
+        .def("term_structure", &VolatilitySurface::ParametricSurface::termStructure,
+             py::arg("strike"), py::arg("expiry"))
+        .def("check_arbitrage", &VolatilitySurface::ParametricSurface::checkArbitrage);
+
+    py::class_<VolatilitySurface::SVISurface, VolatilitySurface::ParametricSurface>(m, "SVISurface")
+        .def(py::init<double, double>(), py::arg("spot"), py::arg("rate"))
+        .def("fit", &VolatilitySurface::SVISurface::fit,
+             py::arg("surface"), py::arg("num_threads") = 0)
+        .def("get_slices", &VolatilitySurface::SVISurface::getSlices);
+
+    py::class_<VolatilitySurface::SSVISurface, VolatilitySurface::ParametricSurface>(m, "SSVISurface")
+        .def(py::init<double, double>(), py::arg("spot"), py::arg("rate"))
+        .def("fit", &VolatilitySurface::SSVISurface::fit, py::arg("surface"))
+        .def("atm_total_variance", &VolatilitySurface::SSVISurface::atmTotalVariance, py::arg("expiry"))
+        .def_property_readonly("rho", &VolatilitySurface::SSVISurface::getRho)
+        .def_property_readonly("eta", &VolatilitySurface::SSVISurface::getEta)
+        .def_property_readonly("gamma", &VolatilitySurface::SSVISurface::getGamma)
+        .def_property_readonly("rmse", &VolatilitySurface::SSVISurface::getRmse);
+
+    py::class_<RateCurve, std::shared_ptr<RateCurve>>(m, "RateCurve")
+        .def(py::init<>())
+        .def(py::init<double>(), py::arg("flat_rate"))
+        .def("add_point", &RateCurve::addPoint, py::arg("time"), py::arg("zero_rate"))
+        .def("rate", &RateCurve::rate, py::arg("time"))
+        .def("size", &RateCurve::size)
+        .def("__len__", &RateCurve::size);
+
+    py::class_<SurfaceMarketData>(m, "SurfaceMarketData")
+        .def(py::init<>())
+        .def(py::init<const MarketData &>(), py::arg("base"))
+        .def_readwrite("base", &SurfaceMarketData::base)
+        .def_property("vol_surface",
+            [](const SurfaceMarketData &smd) { return std::const_pointer_cast<VolatilitySurface::ImpliedVolSurface>(smd.vol_surface); },
+            [](SurfaceMarketData &smd, std::shared_ptr<VolatilitySurface::ImpliedVolSurface> surface) { smd.vol_surface = surface; })
+        .def_property("rate_curve",
+            [](const SurfaceMarketData &smd) { return std::const_pointer_cast<RateCurve>(smd.rate_curve); },
+            [](SurfaceMarketData &smd, std::shared_ptr<RateCurve> curve) { smd.rate_curve = curve; })
+        .def("resolve", &SurfaceMarketData::resolve, py::arg("strike"), py::arg("time_to_expiry"));
+
+    py::class_<MarketState>(m, "MarketState")
+        .def(py::init<>())
+        .def(py::init<const MarketData &>(), py::arg("market_data"))
+        .def_readwrite("spot_price", &MarketState::spot_price)
+        .def_readwrite("risk_free_rate", &MarketState::risk_free_rate)
+        .def_readwrite("volatility", &MarketState::volatility)
+        .def_readwrite("dividend_yield", &MarketState::dividend_yield);
+
+    py::class_<AssetSymbolTable>(m, "AssetSymbolTable")
+        .def(py::init<>())
+        .def_readonly_static("npos", &AssetSymbolTable::npos)
+        .def("intern", &AssetSymbolTable::intern, py::arg("asset_id"))
+        .def("find", &AssetSymbolTable::find, py::arg("asset_id"))
+        .def("name", &AssetSymbolTable::name, py::arg("id"))
+        .def("size", &AssetSymbolTable::size)
+        .def("clear", &AssetSymbolTable::clear)
+        .def("__len__", &AssetSymbolTable::size);
+
+    py::class_<MarketDataTable>(m, "MarketDataTable")
+        .def(py::init<>())
+        .def(py::init<const std::map<std::string, MarketData> &>(), py::arg("market_data"))
+        .def("set", py::overload_cast<const std::string &, const MarketData &>(&MarketDataTable::set),
+             py::arg("asset_id"), py::arg("market_data"))
+        .def("set", py::overload_cast<AssetId, const MarketState &>(&MarketDataTable::set),
+             py::arg("id"), py::arg("state"))
+        .def("find", &MarketDataTable::find, py::arg("asset_id"))
+        .def("get_state", &MarketDataTable::getState, py::arg("id"))
+        .def("get_market_data", &MarketDataTable::getMarketData, py::arg("id"))
+        .def("get_symbols", &MarketDataTable::getSymbols, py::return_value_policy::reference_internal)
+        .def("size", &MarketDataTable::size)
+        .def("clear", &MarketDataTable::clear)
+        .def("to_map", &MarketDataTable::toMap)
+        .def("__len__", &MarketDataTable::size);
+
     py::class_<MarketDataManager>(m, "MarketDataManager")
         .def(py::init<>())
         .def("add_market_data", &MarketDataManager::addMarketData,
@@ -55,6 +286,9 @@ PYBIND11_MODULE(quant_risk_engine, m)
         .def("clear", &MarketDataManager::clear)
         .def("size", &MarketDataManager::size)
         .def("get_all_market_data", &MarketDataManager::getAllMarketData)
+        .def("get_market_data_table", &MarketDataManager::getMarketDataTable)
+        .def("get_version", &MarketDataManager::getVersion, py::arg("asset_id"))
+        .def("get_latest_version", &MarketDataManager::getLatestVersion)
         .def("__len__", &MarketDataManager::size);
 
     py::class_<Instrument, std::shared_ptr<Instrument>>(m, "Instrument")
@@ -64,6 +298,8 @@ PYBIND11_MODULE(quant_risk_engine, m)
         .def("vega", &Instrument::vega)
         .def("theta", &Instrument::theta)
         .def("get_asset_id", &Instrument::getAssetId)
+        .def("get_strike", &Instrument::getStrike)
+        .def("get_time_to_expiry", &Instrument::getTimeToExpiry)
         .def("get_instrument_type", &Instrument::getInstrumentType)
         .def("is_valid", &Instrument::isValid);
 
@@ -80,9 +316,9 @@ PYBIND11_MODULE(quant_risk_engine, m)
         .def("set_jump_parameters", &EuropeanOption::setJumpParameters,
              py::arg("lambda"), py::arg("jump_mean"), py::arg("jump_vol"))
         .def("get_jump_intensity", &EuropeanOption::getJumpIntensity)
-        .def("get_option_type", &EuropeanOption::getOptionType)
-        .def("get_strike", &EuropeanOption::getStrike)
-        .def("get_time_to_expiry", &EuropeanOption::getTimeToExpiry);
+        .def("set_heston_parameters", &EuropeanOption::setHestonParameters,
+             py::arg("v0"), py::arg("kappa"), py::arg("theta"), py::arg("sigma"), py::arg("rho"))
+        .def("get_option_type", &EuropeanOption::getOptionType);
 
     py::class_<AmericanOption, Instrument, std::shared_ptr<AmericanOption>>(m, "AmericanOption")
         .def(py::init<OptionType, double, double, std::string>(),
@@ -93,27 +329,130 @@ PYBIND11_MODULE(quant_risk_engine, m)
         .def("set_binomial_steps", &AmericanOption::setBinomialSteps)
         .def("get_binomial_steps", &AmericanOption::getBinomialSteps);
 
-    py::class_<Portfolio>(m, "Portfolio")
+    py::class_<PyPortfolio>(m, "Portfolio")
         .def(py::init<>())
-        .def("add_instrument", [](Portfolio &p, EuropeanOption &instr, int quantity)
+        .def("add_instrument", [](PyPortfolio &p, EuropeanOption &instr, int quantity)
+             {
+            auto lock = writeLock(p);
+            p.emplaceInstrument<EuropeanOption>(quantity, instr); },
+             py::arg("instrument"), py::arg("quantity"))
+        .def("add_instrument", [](PyPortfolio &p, AmericanOption &instr, int quantity)
+             {
+            auto lock = writeLock(p);
+            p.emplaceInstrument<AmericanOption>(quantity, instr); },
+             py::arg("instrument"), py::arg("quantity"))
+        // Columnar bulk construction: one row per position, NumPy arrays or
+        // sequences. `model` holds PricingModel values as integers and applies
+        // to European rows; Heston is rejected, as its parameters have no
+        // column. The jump columns are given together or not at all.
+        .def("add_positions",
+             [](PyPortfolio &p, const InputColumn<uint8_t> &is_call, const InputColumn<double> &strike,
+                const InputColumn<double> &expiry, const std::vector<std::string> &asset_id,
+                const InputColumn<int32_t> &quantity,
+                const std::optional<InputColumn<uint8_t>> &american,
+                const std::optional<InputColumn<uint8_t>> &model,
+                const std::optional<InputColumn<int32_t>> &binomial_steps,
+                const std::optional<InputColumn<double>> &jump_intensity,
+                const std::optional<InputColumn<double>> &jump_mean,
+                const std::optional<InputColumn<double>> &jump_vol)
              {
-            auto owned_instr = std::make_unique<EuropeanOption>(instr);
-            p.addInstrument(std::move(owned_instr), quantity); }, py::arg("instrument"), py::arg("quantity"))
-        .def("add_instrument", [](Portfolio &p, AmericanOption &instr, int quantity)
+            auto lock = writeLock(p);
+            addPositionArrays(p, is_call, strike, expiry, asset_id, quantity, american, model,
+                              binomial_steps, jump_intensity, jump_mean, jump_vol); },
+             py::arg("is_call"), py::arg("strike"), py::arg("expiry"), py::arg("asset_id"),
+             py::arg("quantity"), py::arg("american") = py::none(), py::arg("model") = py::none(),
+             py::arg("binomial_steps") = py::none(), py::arg("jump_intensity") = py::none(),
+             py::arg("jump_mean") = py::none(), py::arg("jump_vol") = py::none())
+        .def_static("from_arrays",
+                    [](const InputColumn<uint8_t> &is_call, const InputColumn<double> &strike,
+                       const InputColumn<double> &expiry, const std::vector<std::string> &asset_id,
+                       const InputColumn<int32_t> &quantity,
+                       const std::optional<InputColumn<uint8_t>> &american,
+                       const std::optional<InputColumn<uint8_t>> &model,
+                       const std::optional<InputColumn<int32_t>> &binomial_steps,
+                       const std::optional<InputColumn<double>> &jump_intensity,
+                       const std::optional<InputColumn<double>> &jump_mean,
+                       const std::optional<InputColumn<double>> &jump_vol)
+                    {
+                        auto portfolio = std::make_unique<PyPortfolio>();
+                        addPositionArrays(*portfolio, is_call, strike, expiry, asset_id, quantity,
+                                          american, model, binomial_steps, jump_intensity,
+                                          jump_mean, jump_vol);
+                        return portfolio; },
+                    py::arg("is_call"), py::arg("strike"), py::arg("expiry"), py::arg("asset_id"),
+                    py::arg("quantity"), py::arg("american") = py::none(),
+                    py::arg("model") = py::none(), py::arg("binomial_steps") = py::none(),
+                    py::arg("jump_intensity") = py::none(), py::arg("jump_mean") = py::none(),
+                    py::arg("jump_vol") = py::none())
+        .def("reserve_european", [](PyPortfolio &p, size_t count)
              {
-            auto owned_instr = std::make_unique<AmericanOption>(instr);
-            p.addInstrument(std::move(owned_instr), quantity); }, py::arg("instrument"), py::arg("quantity"))
+            auto lock = writeLock(p);
+            p.reserveInstruments<EuropeanOption>(count); },
+             py::arg("count"))
+        .def("reserve_american", [](PyPortfolio &p, size_t count)
+             {
+            auto lock = writeLock(p);
+            p.reserveInstruments<AmericanOption>(count); },
+             py::arg("count"))
         .def("size", &Portfolio::size)
         .def("empty", &Portfolio::empty)
-        .def("clear", &Portfolio::clear)
-        .def("reserve", &Portfolio::reserve)
+        .def("clear", [](PyPortfolio &p)
+             {
+            auto lock = writeLock(p);
+            p.clear(); })
+        .def("reserve", [](PyPortfolio &p, size_t capacity)
+             {
+            auto lock = writeLock(p);
+            p.reserve(capacity); })
         .def("get_total_quantity", &Portfolio::getTotalQuantityForAsset)
-        .def("remove_instrument", &Portfolio::removeInstrument)
-        .def("update_quantity", &Portfolio::updateQuantity)
+        .def("remove_instrument", [](PyPortfolio &p, size_t index)
+             {
+            auto lock = writeLock(p);
+            p.removeInstrument(index); })
+        .def("update_quantity", [](PyPortfolio &p, size_t index, int new_quantity)
+             {
+            auto lock = writeLock(p);
+            p.updateQuantity(index, new_quantity); })
+        .def("get_position_id", &Portfolio::getPositionId)
+        .def("get_asset_count", &Portfolio::getAssetCount)
+        .def("find_asset", &Portfolio::findAsset)
+        .def("get_asset_name", &Portfolio::getAssetName)
+        .def("get_position_asset", &Portfolio::getPositionAsset)
+        .def("get_positions_for_asset", &Portfolio::getPositionsForAsset)
         .def("__len__", &Portfolio::size)
-        .def("__bool__", [](const Portfolio &p)
+        .def("__bool__", [](const PyPortfolio &p)
              { return !p.empty(); });
 
+    py::class_<RiskContribution>(m, "RiskContribution")
+        .def(py::init<>())
+        .def_readwrite("pv", &RiskContribution::pv)
+        .def_readwrite("delta", &RiskContribution::delta)
+        .def_readwrite("gamma", &RiskContribution::gamma)
+        .def_readwrite("vega", &RiskContribution::vega)
+        .def_readwrite("theta", &RiskContribution::theta)
+        .def_readwrite("component_var_95", &RiskContribution::component_var_95)
+        .def_readwrite("component_var_99", &RiskContribution::component_var_99)
+        .def_readwrite("component_es_95", &RiskContribution::component_es_95)
+        .def_readwrite("component_es_99", &RiskContribution::component_es_99)
+        .def_readwrite("marginal_var_95", &RiskContribution::marginal_var_95)
+        .def_readwrite("marginal_var_99", &RiskContribution::marginal_var_99);
+
+    py::class_<Profiling::Report>(m, "ProfileReport")
+        .def_readonly("enabled", &Profiling::Report::enabled)
+        .def_readonly("wall_seconds", &Profiling::Report::wall_seconds)
+        .def_property_readonly("phase_seconds", [](const Profiling::Report &r)
+             {
+            std::map<std::string, double> phases;
+            for (size_t i = 0; i < Profiling::kPhaseCount; ++i)
+                phases[Profiling::phaseName(static_cast<Profiling::Phase>(i))] = r.phase_seconds[i];
+            return phases; })
+        .def_property_readonly("counters", [](const Profiling::Report &r)
+             {
+            std::map<std::string, uint64_t> counters;
+            for (size_t i = 0; i < Profiling::kCounterCount; ++i)
+                counters[Profiling::counterName(static_cast<Profiling::Counter>(i))] = r.counters[i];
+            return counters; });
+
     py::class_<PortfolioRiskResult>(m, "PortfolioRiskResult")
         .def(py::init<>())
         .def_readwrite("total_pv", &PortfolioRiskResult::total_pv)
@@ -125,17 +464,317 @@ PYBIND11_MODULE(quant_risk_engine, m)
         .def_readwrite("value_at_risk_99", &PortfolioRiskResult::value_at_risk_99)
         .def_readwrite("expected_shortfall_95", &PortfolioRiskResult::expected_shortfall_95)
         .def_readwrite("expected_shortfall_99", &PortfolioRiskResult::expected_shortfall_99)
+        .def_readwrite("position_risk", &PortfolioRiskResult::position_risk)
+        .def_readwrite("asset_risk", &PortfolioRiskResult::asset_risk)
+        .def_readonly("profile", &PortfolioRiskResult::profile)
         .def("is_valid", &PortfolioRiskResult::isValid)
         .def("reset", &PortfolioRiskResult::reset);
 
+    py::class_<RiskCacheStats>(m, "RiskCacheStats")
+        .def_readonly("repriced_positions", &RiskCacheStats::repriced_positions)
+        .def_readonly("revalued_assets", &RiskCacheStats::revalued_assets)
+        .def_readonly("cached_positions", &RiskCacheStats::cached_positions)
+        .def_readonly("cached_assets", &RiskCacheStats::cached_assets);
+
+    py::class_<ReturnHistory>(m, "ReturnHistory")
+        .def(py::init<const std::string &>(), py::arg("path"))
+        .def("asset_count", &ReturnHistory::assetCount)
+        .def("day_count", &ReturnHistory::dayCount)
+        .def("find_asset", &ReturnHistory::findAsset, py::arg("asset_id"))
+        .def("asset_name", &ReturnHistory::assetName, py::arg("asset"))
+        .def("get_dates", [](const ReturnHistory &h)
+             { return std::vector<int32_t>(h.dates(), h.dates() + h.dayCount()); })
+        .def("get_returns", [](const ReturnHistory &h, int asset)
+             {
+            const double *r = h.returns(asset);
+            return std::vector<double>(r, r + h.dayCount()); }, py::arg("asset"))
+        .def_static("write", &ReturnHistory::write,
+                    py::arg("path"), py::arg("dates"), py::arg("names"), py::arg("columns"));
+
+    py::class_<PortfolioSnapshot>(m, "PortfolioSnapshot")
+        .def(py::init<const std::string &>(), py::arg("path"))
+        .def("position_count", &PortfolioSnapshot::positionCount)
+        .def("asset_count", &PortfolioSnapshot::assetCount)
+        .def("asset_names", &PortfolioSnapshot::assetNames)
+        .def("market_data", &PortfolioSnapshot::marketData)
+        .def("load_into", [](const PortfolioSnapshot &snapshot, PyPortfolio &portfolio)
+             {
+            auto lock = writeLock(portfolio);
+            snapshot.loadInto(portfolio); },
+             py::arg("portfolio"))
+        .def("load", [](const PortfolioSnapshot &snapshot)
+             {
+            auto portfolio = std::make_unique<PyPortfolio>();
+            snapshot.loadInto(*portfolio);
+            return portfolio; })
+        .def_static("write", [](const std::string &path, const PyPortfolio &portfolio,
+                                const std::map<std::string, MarketData> &market_data)
+                    { PortfolioSnapshot::write(path, portfolio, market_data); },
+                    py::arg("path"), py::arg("portfolio"), py::arg("market_data"));
+
+    // .csv and .json files are parsed on a background thread and added in
+    // batches; .qesnap files load through PortfolioSnapshot
+    m.def("load_portfolio", [](const std::string &path)
+          {
+        auto portfolio = std::make_unique<PyPortfolio>();
+        PortfolioLoader::loadPositions(path, *portfolio);
+        return portfolio; },
+          py::arg("path"), py::call_guard<py::gil_scoped_release>());
+    m.def("load_market_data", &PortfolioLoader::loadMarketData, py::arg("path"),
+          py::call_guard<py::gil_scoped_release>());
+
+    py::class_<HistoricalSimulationOptions>(m, "HistoricalSimulationOptions")
+        .def(py::init<>())
+        .def_readwrite("window_days", &HistoricalSimulationOptions::window_days)
+        .def_readwrite("ewma_lambda", &HistoricalSimulationOptions::ewma_lambda)
+        .def_readwrite("filtered", &HistoricalSimulationOptions::filtered)
+        .def_readwrite("volatility_lambda", &HistoricalSimulationOptions::volatility_lambda);
+
+    py::class_<HorizonRiskResult>(m, "HorizonRiskResult")
+        .def_readonly("horizon_days", &HorizonRiskResult::horizon_days)
+        .def_readonly("value_at_risk_95", &HorizonRiskResult::value_at_risk_95)
+        .def_readonly("value_at_risk_99", &HorizonRiskResult::value_at_risk_99)
+        .def_readonly("expected_shortfall_95", &HorizonRiskResult::expected_shortfall_95)
+        .def_readonly("expected_shortfall_99", &HorizonRiskResult::expected_shortfall_99)
+        .def_readonly("profile", &HorizonRiskResult::profile);
+
+    // Calculations release the GIL, so Python threads can run them in
+    // parallel. Portfolio mutators wait for them to finish; bound market data
+    // objects must not be modified meanwhile.
     py::class_<RiskEngine>(m, "RiskEngine")
         .def(py::init<>())
         .def(py::init<int>())
-        .def("calculate_portfolio_risk", &RiskEngine::calculatePortfolioRisk)
-        .def("set_var_simulations", &RiskEngine::setVaRSimulations)
-        .def("get_var_simulations", &RiskEngine::getVaRSimulations)
-        .def("set_var_time_horizon_days", &RiskEngine::setVaRTimeHorizonDays)
-        .def("get_var_time_horizon_days", &RiskEngine::getVaRTimeHorizonDays)
-        .def("set_random_seed", &RiskEngine::setRandomSeed)
-        .def("set_use_fixed_seed", &RiskEngine::setUseFixedSeed);
+        .def("calculate_portfolio_risk",
+             [](const RiskEngine &e, const PyPortfolio &p,
+                const std::map<std::string, MarketData> &market_data)
+             {
+            auto lock = readLock(p);
+            return e.calculatePortfolioRisk(p, market_data); },
+             py::call_guard<py::gil_scoped_release>())
+        .def("calculate_portfolio_risk",
+             [](const RiskEngine &e, const PyPortfolio &p,
+                const std::map<std::string, SurfaceMarketData> &market_data)
+             {
+            auto lock = readLock(p);
+            return e.calculatePortfolioRisk(p, market_data); },
+             py::call_guard<py::gil_scoped_release>())
+        .def("calculate_portfolio_risk",
+             [](const RiskEngine &e, const PyPortfolio &p, const MarketDataTable &market_data)
+             {
+            auto lock = readLock(p);
+            return e.calculatePortfolioRisk(p, market_data); },
+             py::call_guard<py::gil_scoped_release>())
+        .def("calculate_portfolio_risk",
+             [](const RiskEngine &e, const PyPortfolio &p, const MarketDataManager &market_data)
+             {
+            auto lock = readLock(p);
+            return e.calculatePortfolioRisk(p, market_data); },
+             py::call_guard<py::gil_scoped_release>())
+        .def("calculate_historical_risk",
+             [](const RiskEngine &e, const PyPortfolio &p,
+                const std::map<std::string, MarketData> &market_data, const ReturnHistory &history,
+                const HistoricalSimulationOptions &options)
+             {
+            auto lock = readLock(p);
+            return e.calculateHistoricalRisk(p, market_data, history, options); },
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("portfolio"), py::arg("market_data"), py::arg("history"),
+             py::arg("options") = HistoricalSimulationOptions())
+        .def("calculate_historical_risk",
+             [](const RiskEngine &e, const PyPortfolio &p, const MarketDataTable &market_data,
+                const ReturnHistory &history, const HistoricalSimulationOptions &options)
+             {
+            auto lock = readLock(p);
+            return e.calculateHistoricalRisk(p, market_data, history, options); },
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("portfolio"), py::arg("market_data"), py::arg("history"),
+             py::arg("options") = HistoricalSimulationOptions())
+        .def("calculate_horizon_risk",
+             [](const RiskEngine &e, const PyPortfolio &p,
+                const std::map<std::string, MarketData> &market_data,
+                const std::vector<double> &horizon_days)
+             {
+            auto lock = readLock(p);
+            return e.calculateHorizonRisk(p, market_data, horizon_days); },
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("portfolio"), py::arg("market_data"), py::arg("horizon_days"))
+        .def("calculate_horizon_risk",
+             [](const RiskEngine &e, const PyPortfolio &p, const MarketDataTable &market_data,
+                const std::vector<double> &horizon_days)
+             {
+            auto lock = readLock(p);
+            return e.calculateHorizonRisk(p, market_data, horizon_days); },
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("portfolio"), py::arg("market_data"), py::arg("horizon_days"))
+        // These wait for running calculations; the GIL is released so other
+        // Python threads are not held up meanwhile
+        .def("clear_cache", &RiskEngine::clearCache,
+             py::call_guard<py::gil_scoped_release>())
+        .def("get_last_cache_stats", &RiskEngine::getLastCacheStats,
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_var_simulations", &RiskEngine::setVaRSimulations,
+             py::call_guard<py::gil_scoped_release>())
+        .def("get_var_simulations", &RiskEngine::getVaRSimulations,
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_var_time_horizon_days", &RiskEngine::setVaRTimeHorizonDays,
+             py::call_guard<py::gil_scoped_release>())
+        .def("get_var_time_horizon_days", &RiskEngine::getVaRTimeHorizonDays,
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_random_seed", &RiskEngine::setRandomSeed,
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_use_fixed_seed", &RiskEngine::setUseFixedSeed,
+             py::call_guard<py::gil_scoped_release>());
+
+    py::class_<StressShock>(m, "StressShock")
+        .def(py::init<>())
+        .def(py::init([](const std::string &asset_id, double spot_shift, double vol_shift, double rate_shift)
+                      { return StressShock{asset_id, spot_shift, vol_shift, rate_shift}; }),
+             py::arg("asset_id") = "", py::arg("spot_shift") = 0.0,
+             py::arg("vol_shift") = 0.0, py::arg("rate_shift") = 0.0)
+        .def_readwrite("asset_id", &StressShock::asset_id)
+        .def_readwrite("spot_shift", &StressShock::spot_shift)
+        .def_readwrite("vol_shift", &StressShock::vol_shift)
+        .def_readwrite("rate_shift", &StressShock::rate_shift);
+
+    py::class_<StressScenario>(m, "StressScenario")
+        .def(py::init<>())
+        .def(py::init([](const std::string &name, const std::vector<StressShock> &shocks)
+                      { return StressScenario{name, shocks}; }),
+             py::arg("name"), py::arg("shocks"))
+        .def_readwrite("name", &StressScenario::name)
+        .def_readwrite("shocks", &StressScenario::shocks);
+
+    py::class_<StressResult>(m, "StressResult")
+        .def_readonly("scenario_names", &StressResult::scenario_names)
+        .def_readonly("position_count", &StressResult::position_count)
+        .def_readonly("base_value", &StressResult::base_value)
+        .def_readonly("position_pnl", &StressResult::position_pnl)
+        .def_readonly("total_pnl", &StressResult::total_pnl)
+        .def("scenario_count", &StressResult::scenarioCount)
+        .def("pnl", &StressResult::pnl, py::arg("scenario"), py::arg("position"));
+
+    py::class_<StressEngine>(m, "StressEngine")
+        .def(py::init<>())
+        .def("run",
+             [](const StressEngine &e, const PyPortfolio &p,
+                const std::map<std::string, MarketData> &market_data,
+                const std::vector<StressScenario> &scenarios)
+             {
+            auto lock = readLock(p);
+            return e.run(p, market_data, scenarios); },
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("portfolio"), py::arg("market_data"), py::arg("scenarios"))
+        .def("run",
+             [](const StressEngine &e, const PyPortfolio &p, const MarketDataTable &market_data,
+                const std::vector<StressScenario> &scenarios)
+             {
+            auto lock = readLock(p);
+            return e.run(p, market_data, scenarios); },
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("portfolio"), py::arg("market_data"), py::arg("scenarios"))
+        .def_static("ladder", &StressEngine::ladder,
+                    py::arg("spot_shifts"), py::arg("vol_shifts"), py::arg("asset_id") = "");
+
+    // Vectorised Black-Scholes over NumPy columns. Contiguous float64 inputs
+    // and bool/uint8 flags are read in place; outputs must be preallocated
+    // C-contiguous float64 arrays and are written in place. With no outputs
+    // given, all six are allocated. Returns the columns written, by name.
+    m.def("black_scholes_batch",
+          [](py::array_t<double, py::array::c_style | py::array::forcecast> spot,
+             py::array_t<double, py::array::c_style | py::array::forcecast> strike,
+             py::array_t<double, py::array::c_style | py::array::forcecast> rate,
+             py::array_t<double, py::array::c_style | py::array::forcecast> expiry,
+             py::array_t<double, py::array::c_style | py::array::forcecast> vol,
+             py::object is_call, py::object price, py::object delta, py::object gamma,
+             py::object vega, py::object theta, py::object rho, unsigned int num_threads)
+          {
+            using Column = py::array_t<double, py::array::c_style>;
+            using Flags = py::array_t<uint8_t, py::array::c_style | py::array::forcecast>;
+
+            py::array flags = py::array::ensure(is_call);
+            if (!flags)
+                throw py::type_error("is_call must be array-like");
+            const char kind = flags.dtype().kind();
+            if (flags.itemsize() != 1 || (kind != 'b' && kind != 'u' && kind != 'i') ||
+                !(flags.flags() & py::array::c_style))
+            {
+                flags = Flags::ensure(flags);
+                if (!flags)
+                    throw py::type_error("is_call must be convertible to a bool array");
+            }
+
+            const size_t count = static_cast<size_t>(spot.size());
+            for (const py::ssize_t size : {strike.size(), rate.size(), expiry.size(), vol.size(),
+                                           flags.size()})
+            {
+                if (static_cast<size_t>(size) != count)
+                    throw py::value_error("All input columns must have the same length");
+            }
+
+            const bool allocate = price.is_none() && delta.is_none() && gamma.is_none() &&
+                                  vega.is_none() && theta.is_none() && rho.is_none();
+            py::dict written;
+            auto output = [&](const char *name, py::object &target) -> double *
+            {
+                if (target.is_none())
+                {
+                    if (!allocate)
+                        return nullptr;
+                    target = Column(static_cast<py::ssize_t>(count));
+                }
+                else if (!py::isinstance<Column>(target))
+                {
+                    throw py::type_error(std::string(name) + " must be a C-contiguous float64 array");
+                }
+                Column column = py::reinterpret_borrow<Column>(target);
+                if (static_cast<size_t>(column.size()) != count)
+                    throw py::value_error(std::string(name) + " must have one entry per option");
+                written[name] = column;
+                return column.mutable_data();
+            };
+
+            BlackScholes::BatchOutputs outputs;
+            outputs.price = output("price", price);
+            outputs.delta = output("delta", delta);
+            outputs.gamma = output("gamma", gamma);
+            outputs.vega = output("vega", vega);
+            outputs.theta = output("theta", theta);
+            outputs.rho = output("rho", rho);
+
+            const BlackScholes::BatchInputs inputs{
+                spot.data(), strike.data(), rate.data(), expiry.data(), vol.data(),
+                static_cast<const uint8_t *>(flags.data()), count};
+            {
+                // The arrays stay referenced by this frame while the kernel runs
+                py::gil_scoped_release release;
+                BlackScholes::priceBatch(inputs, outputs, num_threads);
+            }
+            return written; },
+          py::arg("spot"), py::arg("strike"), py::arg("rate"), py::arg("expiry"), py::arg("vol"),
+          py::arg("is_call"), py::arg("price") = py::none(), py::arg("delta") = py::none(),
+          py::arg("gamma") = py::none(), py::arg("vega") = py::none(),
+          py::arg("theta") = py::none(), py::arg("rho") = py::none(),
+          py::arg("num_threads") = 0);
+
+    py::class_<RiskSession>(m, "RiskSession")
+        .def(py::init<const std::map<std::string, MarketData> &, int, double, unsigned int>(),
+             py::arg("market_data"), py::arg("var_simulations") = 10000,
+             py::arg("time_horizon_days") = 1.0, py::arg("seed") = 0)
+        .def("add_instrument", [](RiskSession &s, EuropeanOption &instr, int quantity)
+             { return s.addInstrument(std::make_unique<EuropeanOption>(instr), quantity); },
+             py::arg("instrument"), py::arg("quantity"))
+        .def("add_instrument", [](RiskSession &s, AmericanOption &instr, int quantity)
+             { return s.addInstrument(std::make_unique<AmericanOption>(instr), quantity); },
+             py::arg("instrument"), py::arg("quantity"))
+        .def("remove_instrument", &RiskSession::removeInstrument)
+        .def("update_quantity", &RiskSession::updateQuantity)
+        .def("update_market_data", &RiskSession::updateMarketData, py::arg("market_data"))
+        .def("get_position_id", &RiskSession::getPositionId, py::arg("index"))
+        .def("find_position", &RiskSession::findPosition, py::arg("position_id"))
+        .def("get_risk", &RiskSession::getRisk)
+        .def("size", &RiskSession::size)
+        .def("empty", &RiskSession::empty)
+        .def("get_var_simulations", &RiskSession::getVaRSimulations)
+        .def("get_var_time_horizon_days", &RiskSession::getVaRTimeHorizonDays)
+        .def("__len__", &RiskSession::size);
 }
@@ -1,7 +1,10 @@
 #ifndef BLACKSCHOLES_H
 #define BLACKSCHOLES_H
 
+#include <cstddef>
+#include <cstdint>
 #include <stdexcept>
+#include <vector>
 
 #ifdef USE_QUANTLIB
 #include "QuantLibPricingEngine.h"
@@ -32,6 +35,73 @@ namespace BlackScholes {
         int max_iterations = 100
     );
     
+    struct ImpliedVolQuote {
+        double market_price;
+        double strike;
+        double expiry;
+        bool is_call;
+    };
+    
+    struct BatchImpliedVolOptions {
+        double tolerance = 1e-12;      // relative change in sigma * sqrt(T)
+        int max_iterations = 32;
+        unsigned int num_threads = 0;  // 0 = hardware concurrency
+    };
+    
+    /**
+     * @brief Implied volatilities for a whole chain on one underlying
+     *
+     * Quotes are normalised to out-of-the-money forward prices, seeded with a
+     * rational (Corrado-Miller) or low-price asymptotic guess, and refined with
+     * bracketed third-order Householder steps. Quotes are solved in blocks of
+     * eight lanes with a convergence mask; the lanes run as scalar code, not
+     * SIMD. The chain is split across threads. Quotes outside the
+     * no-arbitrage bounds give NaN instead of throwing; prices at intrinsic
+     * give zero.
+     */
+    void impliedVolatility(
+        const ImpliedVolQuote* quotes, size_t count, double S, double r,
+        double* vols, const BatchImpliedVolOptions& options = BatchImpliedVolOptions()
+    );
+    std::vector<double> impliedVolatility(
+        const std::vector<ImpliedVolQuote>& quotes, double S, double r,
+        const BatchImpliedVolOptions& options = BatchImpliedVolOptions()
+    );
+    
+    // Columns of `count` options; is_call is one byte per option (nonzero
+    // for calls) so NumPy bool arrays can be used without conversion
+    struct BatchInputs {
+        const double* spot = nullptr;
+        const double* strike = nullptr;
+        const double* rate = nullptr;
+        const double* expiry = nullptr;
+        const double* vol = nullptr;
+        const uint8_t* is_call = nullptr;
+        size_t count = 0;
+    };
+    
+    // Columns to fill, `count` entries each; null columns are skipped
+    struct BatchOutputs {
+        double* price = nullptr;
+        double* delta = nullptr;
+        double* gamma = nullptr;
+        double* vega = nullptr;
+        double* theta = nullptr;
+        double* rho = nullptr;
+    };
+    
+    /**
+     * @brief Prices and Greeks for a batch of options in one pass
+     *
+     * Same conventions as the scalar functions (theta per calendar day, rho
+     * per 1% rate move), with d1, d2 and the discount factor computed once
+     * per option. Options whose inputs the scalar functions would reject give
+     * NaN in every requested column instead of throwing. The batch is split
+     * across threads; num_threads = 0 uses hardware concurrency.
+     */
+    void priceBatch(const BatchInputs& inputs, const BatchOutputs& outputs,
+                    unsigned int num_threads = 0);
+    
     void validateInputs(double S, double K, double r, double T, double sigma);
     
 #ifdef USE_QUANTLIB
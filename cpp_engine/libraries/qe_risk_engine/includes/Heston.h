@@ -0,0 +1,65 @@
+#ifndef HESTON_H
+#define HESTON_H
+
+#include "Instrument.h"
+#include "ImpliedVolatilitySurface.h"
+#include <array>
+
+namespace Heston {
+    /**
+     * @brief Heston stochastic volatility parameters
+     *
+     * dS = r S dt + sqrt(v) S dW1
+     * dv = kappa (theta - v) dt + sigma sqrt(v) dW2,  dW1 dW2 = rho dt
+     */
+    struct Parameters {
+        double initial_variance = 0.04;   // v0
+        double mean_reversion = 1.5;      // kappa
+        double long_run_variance = 0.04;  // theta
+        double vol_of_vol = 0.5;          // sigma
+        double correlation = -0.5;        // rho
+
+        void validate() const;
+    };
+
+    // Gradient ordering follows Parameters: v0, kappa, theta, sigma, rho
+    using Gradient = std::array<double, 5>;
+
+    double callPrice(double S, double K, double r, double T, const Parameters& params);
+    double putPrice(double S, double K, double r, double T, const Parameters& params);
+
+    double optionPrice(double S, double K, double r, double T,
+                       OptionType type, const Parameters& params);
+
+    // Call price together with its analytic gradient w.r.t. the model parameters
+    double callPriceWithGradient(double S, double K, double r, double T,
+                                 const Parameters& params, Gradient& gradient);
+
+    struct CalibrationOptions {
+        int max_iterations = 100;
+        double tolerance = 1e-10;      // relative change in the objective
+        unsigned int num_threads = 0;  // 0 = hardware concurrency
+    };
+
+    struct CalibrationResult {
+        Parameters parameters;
+        double rmse = 0.0;             // vega-weighted, approximately in vol units
+        int iterations = 0;
+        bool converged = false;
+    };
+
+    /**
+     * @brief Levenberg-Marquardt fit of the Heston parameters to surface quotes
+     *
+     * Residuals are vega-weighted price differences so the objective is close
+     * to a least-squares fit in implied volatility.
+     */
+    CalibrationResult calibrate(
+        const VolatilitySurface::ImpliedVolSurface& surface,
+        double S, double r,
+        const Parameters& initial_guess = Parameters(),
+        const CalibrationOptions& options = CalibrationOptions()
+    );
+}
+
+#endif
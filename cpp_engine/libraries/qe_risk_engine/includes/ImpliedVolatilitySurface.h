@@ -4,6 +4,7 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <cstddef>
 
 namespace VolatilitySurface {
     struct VolPoint {
@@ -12,28 +13,55 @@ namespace VolatilitySurface {
         double implied_vol;
     };
     
+    /**
+     * @brief Implied volatility surface indexed as a sorted expiry x strike grid
+     *
+     * Quotes are kept in expiry slices sorted by log-strike, so a lookup is two
+     * binary searches. Interpolation is linear in total variance (sigma^2 * T)
+     * along log-moneyness within a slice and along expiry between slices, with
+     * flat-vol extrapolation outside the quoted range.
+     */
     class ImpliedVolSurface {
     public:
         void addPoint(double strike, double expiry, double implied_vol);
         double interpolate(double strike, double expiry) const;
+        
+        // Batch lookup: vols[i] = interpolate(strikes[i], expiries[i])
+        void interpolate(const double* strikes, const double* expiries,
+                         double* vols, size_t count) const;
+        std::vector<double> interpolate(const std::vector<double>& strikes,
+                                        const std::vector<double>& expiries) const;
+        
+        // Carry rate defining the forward, F(T) = S * exp(rate * T), used for
+        // moneyness between expiries. Zero interpolates at constant strike.
+        void setForwardRate(double rate);
+        double getForwardRate() const;
+        
         bool hasData() const;
         size_t size() const;
+        size_t expiryCount() const;
         void clear();
         
         std::vector<VolPoint> getPoints() const;
         
     private:
+        struct ExpirySlice {
+            double expiry;
+            std::vector<double> log_strikes;
+            std::vector<double> total_variance;
+        };
+        
         std::vector<VolPoint> points_;
+        std::vector<ExpirySlice> slices_;
+        double forward_rate_ = 0.0;
         
-        double bilinearInterpolation(
-            double strike, double expiry,
-            const VolPoint& p1, const VolPoint& p2,
-            const VolPoint& p3, const VolPoint& p4
-        ) const;
+        double sliceTotalVariance(const ExpirySlice& slice, double log_strike) const;
     };
     
+    // Finite-difference estimates from raw quotes; SVISurface / SSVISurface
+    // give the analytic skew and term structure of a fitted surface
     double calculateSkew(const std::vector<VolPoint>& points, double expiry);
     double calculateTermStructure(const std::vector<VolPoint>& points, double strike);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -11,7 +11,8 @@ enum class OptionType { Call, Put };
 enum class PricingModel { 
     BlackScholes, 
     Binomial, 
-    MertonJumpDiffusion 
+    MertonJumpDiffusion,
+    Heston
 };
 
 class Instrument {
@@ -24,9 +25,21 @@ public:
     virtual double vega(const MarketData& md) const = 0;
     virtual double theta(const MarketData& md) const = 0;
     virtual std::string getAssetId() const = 0;
+    virtual double getStrike() const = 0;
+    virtual double getTimeToExpiry() const = 0;
+    
+    // Copy of this instrument `years` closer to expiry, for revaluation at a
+    // future horizon; time to expiry floors at zero, where options are worth
+    // their intrinsic value
+    virtual std::unique_ptr<Instrument> aged(double years) const = 0;
     
     virtual std::string getInstrumentType() const = 0;
     virtual bool isValid() const = 0;
+    
+    // Flat market data for this instrument's strike and expiry
+    MarketData resolveMarketData(const SurfaceMarketData& smd) const {
+        return smd.resolve(getStrike(), getTimeToExpiry());
+    }
 };
 
 class EuropeanOption : public Instrument {
@@ -51,6 +64,7 @@ public:
     double gamma(const MarketData& md) const override;
     double vega(const MarketData& md) const override;
     double theta(const MarketData& md) const override;
+    std::unique_ptr<Instrument> aged(double years) const override;
     std::string getAssetId() const override;
     std::string getInstrumentType() const override;
     bool isValid() const override;
@@ -63,10 +77,15 @@ public:
     
     void setJumpParameters(double lambda, double jump_mean, double jump_vol);
     double getJumpIntensity() const;
+    double getJumpMean() const;
+    double getJumpVolatility() const;
+    
+    void setHestonParameters(double v0, double kappa, double theta,
+                             double sigma, double rho);
     
     OptionType getOptionType() const;
-    double getStrike() const;
-    double getTimeToExpiry() const;
+    double getStrike() const override;
+    double getTimeToExpiry() const override;
 
 private:
     OptionType option_type_;
@@ -80,12 +99,23 @@ private:
     double jump_mean_;
     double jump_volatility_;
     
+    double heston_v0_;
+    double heston_kappa_;
+    double heston_theta_;
+    double heston_sigma_;
+    double heston_rho_;
+    
     void validateParameters() const;
     void validateMarketData(const MarketData& md) const;
     
-    double priceBlackScholes(const MarketData& md) const;
-    double priceBinomial(const MarketData& md) const;
-    double priceJumpDiffusion(const MarketData& md) const;
+    // Price with time_to_expiry left; intrinsic once expired
+    double priceAt(const MarketData& md, double time_to_expiry) const;
+    
+    double priceBlackScholes(const MarketData& md, double time_to_expiry) const;
+    double priceBinomial(const MarketData& md, double time_to_expiry) const;
+    double priceJumpDiffusion(const MarketData& md, double time_to_expiry) const;
+    double priceHeston(const MarketData& md, double time_to_expiry) const;
+    double vegaHeston(const MarketData& md) const;
     
     double deltaBlackScholes(const MarketData& md) const;
     double deltaNumerical(const MarketData& md) const;
@@ -106,10 +136,15 @@ public:
     double gamma(const MarketData& md) const override;
     double vega(const MarketData& md) const override;
     double theta(const MarketData& md) const override;
+    std::unique_ptr<Instrument> aged(double years) const override;
     std::string getAssetId() const override;
     std::string getInstrumentType() const override;
     bool isValid() const override;
     
+    OptionType getOptionType() const;
+    double getStrike() const override;
+    double getTimeToExpiry() const override;
+    
     void setBinomialSteps(int steps);
     int getBinomialSteps() const;
 
@@ -123,6 +158,7 @@ private:
     void validateParameters() const;
     void validateMarketData(const MarketData& md) const;
     double calculateIntrinsicValue(double spot_price) const;
+    double priceAt(const MarketData& md, double time_to_expiry) const;
 };
 
 // Forward declarations for exotic option types
@@ -157,10 +193,13 @@ public:
     double gamma(const MarketData& md) const override;
     double vega(const MarketData& md) const override;
     double theta(const MarketData& md) const override;
+    std::unique_ptr<Instrument> aged(double years) const override;
     std::string getAssetId() const override;
     std::string getInstrumentType() const override;
     bool isValid() const override;
     
+    double getStrike() const override { return strike_price_; }
+    double getTimeToExpiry() const override { return time_to_expiry_years_; }
     double getBarrier() const { return barrier_level_; }
     BarrierType getBarrierType() const { return barrier_type_; }
     double getRebate() const { return rebate_; }
@@ -175,10 +214,15 @@ private:
     double rebate_;
     
     void validateParameters() const;
+    // Expired barriers settle on the final spot alone
+    double priceAt(const MarketData& md, double time_to_expiry) const;
 };
 
 /**
  * @brief Asian Option - option with payoff based on average price
+ *
+ * `running_accumulator` follows QuantLib: the sum of the past fixings for an
+ * arithmetic average, their product for a geometric one.
  */
 class AsianOption : public Instrument {
 public:
@@ -194,7 +238,7 @@ public:
         std::string asset_id,
         AverageType average_type,
         int num_fixings,
-        double running_sum = 0.0,
+        double running_accumulator = 0.0,
         int past_fixings = 0
     );
     
@@ -203,10 +247,13 @@ public:
     double gamma(const MarketData& md) const override;
     double vega(const MarketData& md) const override;
     double theta(const MarketData& md) const override;
+    std::unique_ptr<Instrument> aged(double years) const override;
     std::string getAssetId() const override;
     std::string getInstrumentType() const override;
     bool isValid() const override;
     
+    double getStrike() const override { return strike_price_; }
+    double getTimeToExpiry() const override { return time_to_expiry_years_; }
     AverageType getAverageType() const { return average_type_; }
     int getNumFixings() const { return num_fixings_; }
 
@@ -217,10 +264,11 @@ private:
     std::string underlying_asset_id_;
     AverageType average_type_;
     int num_fixings_;
-    double running_sum_;
+    double running_accumulator_;
     int past_fixings_;
     
     void validateParameters() const;
+    double priceAt(const MarketData& md, double time_to_expiry) const;
 };
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,95 @@
+#ifndef INSTRUMENTARENA_H
+#define INSTRUMENTARENA_H
+
+#include "Instrument.h"
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Pooled storage for instruments, one block chain per concrete type
+ *
+ * Instruments are bump-allocated, so instruments of the same type sit
+ * contiguously and a book of N positions costs a handful of block
+ * allocations rather than N. Slots handed back through recycle() go on a
+ * per-type free list and are reused by the next create() of that type, so a
+ * long-lived book that churns positions stays at its peak size. Block memory
+ * is only freed by release(), one free per block; objects must have been
+ * destroyed before that.
+ */
+class InstrumentArena {
+public:
+    InstrumentArena() = default;
+    InstrumentArena(const InstrumentArena&) = delete;
+    InstrumentArena& operator=(const InstrumentArena&) = delete;
+    InstrumentArena(InstrumentArena&& other) = default;
+    // Swaps, so the blocks previously owned here outlive the objects the
+    // caller still has to destroy in them
+    InstrumentArena& operator=(InstrumentArena&& other);
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(std::is_base_of<Instrument, T>::value,
+                      "Arena only stores instruments");
+        void* memory = allocate(typeid(T), sizeof(T), alignof(T));
+        return ::new (memory) T(std::forward<Args>(args)...);
+    }
+
+    // Destroys an instrument created here and keeps its slot for reuse
+    void recycle(Instrument* instrument) noexcept;
+
+    // Makes room for `count` more T without further block allocations
+    template <typename T>
+    void reserve(size_t count) {
+        if (count > 0) {
+            reserveBytes(typeid(T), sizeof(T) * count, alignof(T));
+        }
+    }
+
+    void release();
+
+    size_t blockCount() const;
+    size_t bytesUsed() const;      // bump-allocated, recycled slots included
+    size_t freeSlotCount() const;
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t capacity = 0;
+        size_t used = 0;
+    };
+
+    struct Pool {
+        std::vector<Block> blocks;
+        std::vector<void*> free_slots;
+    };
+
+    static constexpr size_t kBlockSize = 64 * 1024;
+
+    std::unordered_map<std::type_index, Pool> pools_;
+
+    void* allocate(std::type_index type, size_t size, size_t align);
+    void reserveBytes(std::type_index type, size_t bytes, size_t align);
+};
+
+// Destroys in place for arena-owned instruments, deletes otherwise
+struct InstrumentDeleter {
+    bool arena_owned = false;
+
+    void operator()(Instrument* instrument) const {
+        if (arena_owned) {
+            instrument->~Instrument();
+        } else {
+            delete instrument;
+        }
+    }
+};
+
+using InstrumentPtr = std::unique_ptr<Instrument, InstrumentDeleter>;
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Read-only memory mapping of a whole file
+ *
+ * Pages are faulted in as they are read and shared with the page cache, so
+ * mapping a large file costs nothing until its contents are touched. Errors
+ * name the file as `description`, e.g. "Cannot open return history: <path>".
+ */
+class MappedFile {
+public:
+    MappedFile(const std::string& path, const std::string& description);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* view_ = nullptr;
+#endif
+};
+
+#endif
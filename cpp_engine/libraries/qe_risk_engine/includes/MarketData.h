@@ -4,7 +4,12 @@
 #include <string>
 #include <stdexcept>
 #include <cmath>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "ImpliedVolatilitySurface.h"
 
 struct MarketData {
     std::string asset_id;
@@ -75,19 +80,159 @@ struct MarketData {
     }
 };
 
+/**
+ * @brief Numeric part of MarketData
+ *
+ * Trivially copyable, so scenario code can copy and shock it per path
+ * without touching the heap.
+ */
+struct MarketState {
+    double spot_price = 0.0;
+    double risk_free_rate = 0.0;
+    double volatility = 0.0;
+    double dividend_yield = 0.0;
+    
+    MarketState() = default;
+    explicit MarketState(const MarketData& md)
+        : spot_price(md.spot_price),
+          risk_free_rate(md.risk_free_rate),
+          volatility(md.volatility),
+          dividend_yield(md.dividend_yield) {}
+};
+
+using AssetId = uint32_t;
+
+/**
+ * @brief Interns tickers as dense integer ids in first-seen order
+ */
+class AssetSymbolTable {
+public:
+    static constexpr AssetId npos = static_cast<AssetId>(-1);
+    
+    AssetId intern(const std::string& asset_id);
+    // npos when the ticker has not been interned
+    AssetId find(const std::string& asset_id) const;
+    const std::string& name(AssetId id) const;
+    size_t size() const;
+    bool empty() const;
+    void clear();
+    
+private:
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, AssetId> ids_;
+};
+
+/**
+ * @brief Contiguous market data indexed by AssetId
+ *
+ * Replaces string-keyed maps on hot paths: tickers are resolved to ids once,
+ * after which every lookup is an array index. Values are stored as given;
+ * consumers validate the assets they actually use.
+ */
+class MarketDataTable {
+public:
+    MarketDataTable() = default;
+    explicit MarketDataTable(const std::map<std::string, MarketData>& market_data_map);
+    
+    // Inserts or overwrites; returns the asset's id
+    AssetId set(const std::string& asset_id, const MarketData& md);
+    void set(AssetId id, const MarketState& state);
+    
+    AssetId find(const std::string& asset_id) const;
+    const MarketState& getState(AssetId id) const;
+    // Rebuilds the string-carrying form, for pricing APIs that take MarketData
+    MarketData getMarketData(AssetId id) const;
+    
+    const AssetSymbolTable& getSymbols() const { return symbols_; }
+    const std::vector<MarketState>& getStates() const { return states_; }
+    size_t size() const;
+    bool empty() const;
+    void clear();
+    
+    std::map<std::string, MarketData> toMap() const;
+    
+private:
+    AssetSymbolTable symbols_;
+    std::vector<MarketState> states_;
+    
+    void checkId(AssetId id) const;
+};
+
+/**
+ * @brief Continuously-compounded zero-rate term structure
+ *
+ * Linear interpolation in time with flat extrapolation at both ends.
+ */
+class RateCurve {
+public:
+    RateCurve() = default;
+    explicit RateCurve(double flat_rate);
+    
+    void addPoint(double time, double zero_rate);
+    double rate(double time) const;
+    bool empty() const;
+    size_t size() const;
+    
+private:
+    std::vector<double> times_;
+    std::vector<double> rates_;
+};
+
+/**
+ * @brief Market data that references a per-asset smile and rate curve
+ *
+ * The scalar fields of `base` are the fallbacks when a surface or curve is
+ * not set. resolve() collapses everything to the flat MarketData an
+ * instrument with the given strike and expiry should be priced with; it is
+ * meant to be called once per instrument, not per scenario. There is no
+ * dividend curve: no pricer reads MarketData::dividend_yield yet.
+ */
+struct SurfaceMarketData {
+    MarketData base;
+    std::shared_ptr<const VolatilitySurface::ImpliedVolSurface> vol_surface;
+    std::shared_ptr<const RateCurve> rate_curve;
+    
+    SurfaceMarketData() = default;
+    explicit SurfaceMarketData(const MarketData& md) : base(md) {}
+    
+    MarketData resolve(double strike, double time_to_expiry) const;
+};
+
+/**
+ * @brief Market data store with a version stamp per asset
+ *
+ * Every add, or update that changes a value, stamps the asset with the next
+ * value of a process-wide counter, so a consumer that remembers the version
+ * it last saw can tell exactly which assets have ticked since, even when it
+ * is handed a different manager.
+ */
 class MarketDataManager {
 public:
     void addMarketData(const std::string& asset_id, const MarketData& md);
     void updateMarketData(const std::string& asset_id, const MarketData& md);
     MarketData getMarketData(const std::string& asset_id) const;
+    const MarketData& getMarketDataRef(const std::string& asset_id) const;
     bool hasMarketData(const std::string& asset_id) const;
     void removeMarketData(const std::string& asset_id);
     void clear();
     size_t size() const;
     std::map<std::string, MarketData> getAllMarketData() const;
+    MarketDataTable getMarketDataTable() const;
+    
+    uint64_t getVersion(const std::string& asset_id) const;
+    // Latest stamp this manager handed out; changes whenever any asset changes
+    uint64_t getLatestVersion() const;
     
 private:
-    std::map<std::string, MarketData> market_data_map_;
+    struct Entry {
+        MarketData data;
+        uint64_t version;
+    };
+    
+    std::map<std::string, Entry> market_data_map_;
+    uint64_t latest_version_ = 0;
+    
+    const Entry& findEntry(const std::string& asset_id) const;
 };
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+namespace Parallel {
+    /**
+     * @brief Data-parallel loop on a shared worker pool
+     *
+     * Splits [0, count) into contiguous chunks of at least min_per_thread
+     * items, one per thread, and calls worker(start, end) on each. At most
+     * max_threads chunks are made (0 = hardware concurrency). Chunks run on a
+     * process-wide pool started on first use, and the calling thread takes
+     * chunks as well, so nested and concurrent calls always make progress.
+     * The first worker exception is rethrown on the calling thread once every
+     * chunk has finished. Workers report to the caller's profiling collector.
+     */
+    void parallelFor(int count, int min_per_thread, const std::function<void(int, int)>& worker,
+                     unsigned int max_threads = 0);
+    
+    // Threads parallelFor uses by default, the caller included
+    unsigned int concurrency();
+}
+
+#endif
@@ -2,16 +2,55 @@
 #define PORTFOLIO_H
 
 #include "Instrument.h"
+#include "InstrumentArena.h"
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
+
+// A book of vanilla options as columns of `count` entries; position i is
+// built from entry i of each column. Optional columns may be left null.
+struct PositionColumns {
+    size_t count = 0;
+    const uint8_t* is_call = nullptr;           // nonzero for calls
+    const double* strike = nullptr;
+    const double* expiry = nullptr;             // years
+    const int32_t* quantity = nullptr;
+    // Asset of each position, as an index into asset_names
+    const int32_t* asset = nullptr;
+    const std::string* asset_names = nullptr;
+    size_t asset_name_count = 0;
+    
+    const uint8_t* american = nullptr;          // nonzero: AmericanOption; null: all European
+    const uint8_t* model = nullptr;             // PricingModel of European rows, not Heston; null: Black-Scholes
+    const int32_t* binomial_steps = nullptr;    // null: the instruments' default
+    // Merton parameters, applied to MertonJumpDiffusion rows; all or none
+    const double* jump_intensity = nullptr;
+    const double* jump_mean = nullptr;
+    const double* jump_vol = nullptr;
+};
 
 class Portfolio {
 public:
     void addInstrument(std::unique_ptr<Instrument> instrument, int quantity);
     
-    const std::vector<std::pair<std::unique_ptr<Instrument>, int>>& getInstruments() const;
+    // Appends every position of `columns`, constructed in the arena in one
+    // pass. The whole batch is validated first, so a bad row throws
+    // std::invalid_argument naming it and adds nothing.
+    void addPositions(const PositionColumns& columns);
+    
+    // Constructs the instrument in the portfolio's arena instead of its own
+    // heap allocation; the reference stays valid until it is removed
+    template <typename T, typename... Args>
+    T& emplaceInstrument(int quantity, Args&&... args);
+    
+    // Pre-sizes the arena pool for `count` more instruments of type T
+    template <typename T>
+    void reserveInstruments(size_t count);
+    
+    const std::vector<std::pair<InstrumentPtr, int>>& getInstruments() const;
     
     size_t size() const;
     bool empty() const;
@@ -21,13 +60,58 @@ public:
     int getTotalQuantityForAsset(const std::string& asset_id) const;
     
     void removeInstrument(size_t index);
+    // Removes every position from index new_size on, in one pass
+    void truncate(size_t new_size);
     
     void updateQuantity(size_t index, int new_quantity);
     
+    // Process-wide unique ID assigned when a position is added; stays with
+    // the position as others are removed, so caches can key on it
+    uint64_t getPositionId(size_t index) const;
+    
+    // Interned asset table: each distinct asset ID gets a dense integer in
+    // first-seen order, and keeps the ascending indices of its positions,
+    // maintained on add and remove. Assets stay interned once seen.
+    size_t getAssetCount() const;
+    int findAsset(const std::string& asset_id) const;   // -1 if never held
+    const std::string& getAssetName(int asset) const;
+    int getPositionAsset(size_t index) const;
+    const std::vector<size_t>& getPositionsForAsset(int asset) const;
+    
+    const InstrumentArena& getArena() const { return arena; }
+    
 private:
-    std::vector<std::pair<std::unique_ptr<Instrument>, int>> instruments;
+    // Declared first so it is destroyed after the instruments living in it
+    InstrumentArena arena;
+    std::vector<std::pair<InstrumentPtr, int>> instruments;
+    std::vector<uint64_t> position_ids;
+    std::vector<int> position_assets;
     
+    std::vector<std::string> asset_names;
+    std::unordered_map<std::string, int> asset_lookup;
+    std::vector<std::vector<size_t>> asset_positions;
+    
+    void insertInstrument(InstrumentPtr instrument, int quantity);
+    // Destroys a removed instrument, returning arena slots for reuse
+    void disposeInstrument(InstrumentPtr& instrument);
+    int internAsset(const std::string& asset_id);
     void validateIndex(size_t index) const;
+    void validateAsset(int asset) const;
 };
 
+template <typename T, typename... Args>
+T& Portfolio::emplaceInstrument(int quantity, Args&&... args) {
+    InstrumentPtr instrument(arena.create<T>(std::forward<Args>(args)...),
+                             InstrumentDeleter{true});
+    T& created = static_cast<T&>(*instrument);
+    insertInstrument(std::move(instrument), quantity);
+    return created;
+}
+
+template <typename T>
+void Portfolio::reserveInstruments(size_t count) {
+    reserve(instruments.size() + count);
+    arena.reserve<T>(count);
+}
+
 #endif
\ No newline at end of file
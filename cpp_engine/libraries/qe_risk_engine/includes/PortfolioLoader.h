@@ -0,0 +1,159 @@
+#ifndef PORTFOLIOLOADER_H
+#define PORTFOLIOLOADER_H
+
+#include "Instrument.h"
+#include "MarketData.h"
+#include "Portfolio.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// One position as read from a file
+struct PositionRecord {
+    std::string asset_id;
+    bool is_call = true;
+    bool american = false;
+    PricingModel model = PricingModel::BlackScholes;   // European rows only
+    double strike = 0.0;
+    double expiry = 0.0;
+    int32_t quantity = 0;
+    int32_t binomial_steps = 100;
+    double jump_intensity = 0.0;
+    double jump_mean = 0.0;
+    double jump_vol = 0.0;
+};
+
+/**
+ * @brief Growable position columns in the layout Portfolio::addPositions reads
+ *
+ * Assets are interned as records are added, so a buffer of any size carries
+ * one string per distinct asset.
+ */
+class PositionBuffer {
+public:
+    void add(const PositionRecord& record);
+    void reserve(size_t count);
+    // Drops the positions; capacity and interned assets are kept for reuse
+    void clear();
+    size_t size() const { return strike_.size(); }
+    bool empty() const { return strike_.empty(); }
+
+    // Views into the buffer, valid until it is next modified
+    PositionColumns columns() const;
+
+private:
+    std::vector<uint8_t> is_call_;
+    std::vector<uint8_t> american_;
+    std::vector<uint8_t> model_;
+    std::vector<int32_t> quantity_;
+    std::vector<int32_t> asset_;
+    std::vector<int32_t> binomial_steps_;
+    std::vector<double> strike_;
+    std::vector<double> expiry_;
+    std::vector<double> jump_intensity_;
+    std::vector<double> jump_mean_;
+    std::vector<double> jump_vol_;
+
+    std::vector<std::string> asset_names_;
+    std::unordered_map<std::string, int32_t> asset_lookup_;
+};
+
+/**
+ * @brief Portfolios and market data from CSV, JSON and snapshot files
+ *
+ * Field names and defaults follow the Flask API.
+ *   Positions CSV   header row naming type, strike, expiry, asset_id,
+ *                   quantity and optionally style, pricing_model,
+ *                   binomial_steps, jump_lambda, jump_mean, jump_vol
+ *   Positions JSON  array of position objects, or an object holding one
+ *                   under "portfolio"
+ *   Market CSV      asset_id, spot, rate, vol and optionally dividend
+ *   Market JSON     object keyed by asset, at the top level or under
+ *                   "market_data"
+ * so a saved /calculate_risk request body serves as both files. The format
+ * is picked by extension: .csv, .json, or .qesnap for a PortfolioSnapshot.
+ */
+namespace PortfolioLoader {
+
+enum class Format { Csv, Json, Snapshot };
+
+// Throws std::invalid_argument for an unknown extension
+Format formatOf(const std::string& path);
+
+// Calls on_position for each position in file order. Rows are validated as
+// they are read, against the same rules as Portfolio::addPositions; a bad one
+// throws std::invalid_argument naming its line (CSV) or index (JSON). CSV is
+// read in large blocks and split in place, so fields are never copied into
+// strings of their own.
+void readPositions(std::istream& in, Format format,
+                   const std::function<void(const PositionRecord&)>& on_position);
+
+// Text files are streamed in batches through a PositionStream. A bad row adds
+// nothing: batches already appended are removed again before it throws.
+void loadPositions(const std::string& path, Portfolio& portfolio);
+
+std::map<std::string, MarketData> readMarketData(std::istream& in, Format format);
+std::map<std::string, MarketData> loadMarketData(const std::string& path);
+
+} // namespace PortfolioLoader
+
+/**
+ * @brief Positions of a CSV or JSON file, parsed on a background thread
+ *
+ * The reader thread fills batches of up to batch_size positions and runs at
+ * most max_pending batches ahead of the consumer, so memory stays bounded
+ * however large the file is. A consumer that builds or prices each batch as
+ * it arrives overlaps that work with parsing the rest of the file.
+ */
+class PositionStream {
+public:
+    // Opens the file here, so a missing file or an unsupported format throws
+    // from the constructor
+    explicit PositionStream(const std::string& path,
+                            size_t batch_size = 65536,
+                            size_t max_pending = 4);
+    // Stops the reader if the file has not been consumed
+    ~PositionStream();
+
+    PositionStream(const PositionStream&) = delete;
+    PositionStream& operator=(const PositionStream&) = delete;
+
+    // Waits for the next batch and moves it into `batch`, whose previous
+    // contents are recycled. Returns false once the file is exhausted. A parse
+    // error is rethrown here, after every batch read before it.
+    bool next(PositionBuffer& batch);
+
+    // Appends the next batch through Portfolio::addPositions; returns how many
+    // positions were added, 0 at the end of the file
+    size_t appendTo(Portfolio& portfolio);
+
+private:
+    size_t batch_size_;
+    size_t max_pending_;
+
+    std::mutex mutex_;
+    std::condition_variable batch_ready_;
+    std::condition_variable space_ready_;
+    std::deque<PositionBuffer> pending_;
+    std::vector<PositionBuffer> spare_;   // consumed buffers, kept for their capacity
+    bool finished_ = false;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+
+    PositionBuffer batch_;   // consumer side of appendTo
+    std::thread reader_;
+
+    void readFile(std::istream& in, PortfolioLoader::Format format);
+    void publish(PositionBuffer& batch);
+};
+
+#endif
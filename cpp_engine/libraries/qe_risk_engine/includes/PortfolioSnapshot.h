@@ -0,0 +1,71 @@
+#ifndef PORTFOLIOSNAPSHOT_H
+#define PORTFOLIOSNAPSHOT_H
+
+#include "MarketData.h"
+#include "Portfolio.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+/**
+ * @brief Versioned binary snapshot of a portfolio and its market data
+ *
+ * File layout (little-endian):
+ *   header     magic "QESNAP\0\0", version, asset count, position count,
+ *              directory offset
+ *   sections   offset (u64) of each column below, in this order
+ *   columns    per position: is_call u8, american u8, model u8, quantity
+ *              i32, asset i32, binomial steps i32, strike f64, expiry f64,
+ *              jump intensity, mean and vol f64; per asset: has market
+ *              data u8, MarketState. Each column is 8-byte aligned.
+ *   directory  per asset: name length (u32), name
+ *
+ * Opening maps the file and parses the header and the asset directory only.
+ * columns() points straight into the mapped pages, so position data is not
+ * parsed or copied until loadInto() builds instruments from it, and it is
+ * validated there.
+ */
+class PortfolioSnapshot {
+public:
+    explicit PortfolioSnapshot(const std::string& path);
+    ~PortfolioSnapshot();
+
+    PortfolioSnapshot(const PortfolioSnapshot&) = delete;
+    PortfolioSnapshot& operator=(const PortfolioSnapshot&) = delete;
+
+    size_t positionCount() const { return columns_.count; }
+    size_t assetCount() const { return asset_names_.size(); }
+    const std::vector<std::string>& assetNames() const { return asset_names_; }
+
+    // Views into the mapping, valid for the snapshot's lifetime
+    const PositionColumns& columns() const { return columns_; }
+
+    bool hasMarketData(int asset) const;
+    const MarketState& marketState(int asset) const;
+    // Every asset stored with market data, keyed by name
+    std::map<std::string, MarketData> marketData() const;
+
+    // Appends the stored positions through Portfolio::addPositions
+    void loadInto(Portfolio& portfolio) const;
+
+    // Stores European and American options with their market data. Heston
+    // and exotic instruments are rejected, as the columns cannot carry them.
+    static void write(const std::string& path,
+                      const Portfolio& portfolio,
+                      const std::map<std::string, MarketData>& market_data);
+
+private:
+    std::unique_ptr<MappedFile> mapping_;
+    std::vector<std::string> asset_names_;
+    PositionColumns columns_;
+    const uint8_t* has_market_data_ = nullptr;
+    const MarketState* market_states_ = nullptr;
+
+    void validateAsset(int asset) const;
+};
+
+#endif
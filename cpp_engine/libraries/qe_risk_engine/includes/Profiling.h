@@ -0,0 +1,134 @@
+#ifndef PROFILING_H
+#define PROFILING_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * @brief Hot-path timers and counters for risk runs
+ *
+ * Compiled in when QE_ENABLE_PROFILING is defined; otherwise the
+ * QE_PROFILE_* macros expand to nothing and reports come back disabled and
+ * empty. A profiled run owns a Collector. Every thread taking part attaches
+ * to it with a ThreadScope and accumulates into its own thread-local Report,
+ * which is merged under the collector's lock once, when the thread detaches.
+ * Timers and counters on the hot path therefore touch only thread-local
+ * memory, and do nothing at all on threads that are not attached.
+ */
+namespace Profiling {
+
+enum class Phase {
+    Greeks,           // base prices and sensitivities
+    PathGeneration,   // drawing shocks and simulated spots
+    Revaluation,      // repricing positions on every scenario
+    TailSort,         // ranking the P&L distribution
+    Attribution       // repricing the tail for component VaR/ES
+};
+
+enum class Counter {
+    Pricings,         // Instrument price evaluations
+    TreeNodes,        // binomial lattice nodes rolled back
+    Paths             // scenarios simulated or replayed
+};
+
+constexpr size_t kPhaseCount = 5;
+constexpr size_t kCounterCount = 3;
+
+const char* phaseName(Phase phase);
+const char* counterName(Counter counter);
+
+struct Report {
+    bool enabled = false;
+    double wall_seconds = 0.0;
+    // Summed over threads, so parallel phases can exceed wall_seconds
+    std::array<double, kPhaseCount> phase_seconds{};
+    std::array<uint64_t, kCounterCount> counters{};
+
+    double seconds(Phase phase) const { return phase_seconds[static_cast<size_t>(phase)]; }
+    uint64_t count(Counter counter) const { return counters[static_cast<size_t>(counter)]; }
+    void merge(const Report& other);
+};
+
+class Collector {
+public:
+    Collector();
+
+    void merge(const Report& thread_report);
+    // Totals merged so far, with the wall time since construction
+    Report report() const;
+
+private:
+    mutable std::mutex mutex_;
+    Report totals_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+namespace detail {
+    inline thread_local Report* thread_report = nullptr;
+    inline thread_local Collector* thread_collector = nullptr;
+}
+
+// Collector the current thread reports to; null when not profiled
+inline Collector* threadCollector() { return detail::thread_collector; }
+
+// Attaches the current thread to `collector` until detach() or destruction.
+// A null collector, or a thread that is already attached, makes it a no-op,
+// so worker code can attach unconditionally.
+class ThreadScope {
+public:
+    explicit ThreadScope(Collector* collector);
+    ~ThreadScope();
+    ThreadScope(const ThreadScope&) = delete;
+    ThreadScope& operator=(const ThreadScope&) = delete;
+
+    void detach();
+
+private:
+    Collector* collector_ = nullptr;
+    Report local_;
+};
+
+inline void count(Counter counter, uint64_t n) {
+    if (Report* report = detail::thread_report) {
+        report->counters[static_cast<size_t>(counter)] += n;
+    }
+}
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Phase phase) : report_(detail::thread_report), phase_(phase) {
+        if (report_) start_ = std::chrono::steady_clock::now();
+    }
+    ~ScopedTimer() {
+        if (report_) {
+            report_->phase_seconds[static_cast<size_t>(phase_)] +=
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        }
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Report* report_;
+    Phase phase_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace Profiling
+
+#ifdef QE_ENABLE_PROFILING
+#define QE_PROFILE_CONCAT_INNER(a, b) a##b
+#define QE_PROFILE_CONCAT(a, b) QE_PROFILE_CONCAT_INNER(a, b)
+// Times the rest of the enclosing scope
+#define QE_PROFILE_PHASE(phase) \
+    ::Profiling::ScopedTimer QE_PROFILE_CONCAT(qe_profile_timer_, __LINE__)(phase)
+#define QE_PROFILE_COUNT(counter, n) ::Profiling::count(counter, n)
+#else
+#define QE_PROFILE_PHASE(phase) ((void)0)
+#define QE_PROFILE_COUNT(counter, n) ((void)0)
+#endif
+
+#endif
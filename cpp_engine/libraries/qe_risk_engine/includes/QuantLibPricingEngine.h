@@ -128,7 +128,8 @@ enum class AverageType {
 /**
  * @brief Price Asian option using QuantLib
  * @param past_fixings Historical price fixings (if any)
- * @param running_sum Running sum of past fixings for arithmetic average
+ * @param running_sum Running sum of past fixings for arithmetic average,
+ *                    running product for geometric
  */
 double asianOptionPrice(
     double S, double K, double r, double T, double sigma,
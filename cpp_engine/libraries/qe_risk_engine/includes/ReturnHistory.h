@@ -0,0 +1,70 @@
+#ifndef RETURNHISTORY_H
+#define RETURNHISTORY_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class MappedFile;
+
+/**
+ * @brief Read-only, memory-mapped daily log-return history
+ *
+ * File layout (little-endian):
+ *   header     magic "QERHIST\0", version, asset count, day count,
+ *              directory offset
+ *   dates      int32[day count], yyyymmdd, oldest first
+ *   columns    double[day count] per asset, 8-byte aligned
+ *   directory  per asset: column offset (u64), name length (u32), name
+ *
+ * Opening maps the file and reads the fixed-size header only. The ticker
+ * directory is parsed on the first lookup and column pages are faulted in
+ * as they are read, so opening a history of thousands of assets costs the
+ * same as opening one. A NaN return means no observation and is applied as
+ * an unchanged price.
+ */
+class ReturnHistory {
+public:
+    explicit ReturnHistory(const std::string& path);
+    ~ReturnHistory();
+
+    ReturnHistory(const ReturnHistory&) = delete;
+    ReturnHistory& operator=(const ReturnHistory&) = delete;
+
+    size_t assetCount() const { return asset_count_; }
+    size_t dayCount() const { return day_count_; }
+
+    const int32_t* dates() const;
+
+    // -1 if the ticker has no column; thread-safe
+    int findAsset(const std::string& asset_id) const;
+    const std::string& assetName(int asset) const;
+    // day count returns, oldest first
+    const double* returns(int asset) const;
+
+    // Writes a history file; columns[a] holds dates.size() returns of names[a]
+    static void write(const std::string& path,
+                      const std::vector<int32_t>& dates,
+                      const std::vector<std::string>& names,
+                      const std::vector<std::vector<double>>& columns);
+
+private:
+    std::unique_ptr<MappedFile> mapping_;
+
+    size_t asset_count_ = 0;
+    size_t day_count_ = 0;
+    uint64_t directory_offset_ = 0;
+
+    mutable std::once_flag directory_once_;
+    mutable std::vector<std::string> names_;
+    mutable std::vector<const double*> columns_;
+    mutable std::unordered_map<std::string, int> lookup_;
+
+    void loadDirectory() const;
+    void validateAsset(int asset) const;
+};
+
+#endif
@@ -3,11 +3,41 @@
 
 #include "Portfolio.h"
 #include "MarketData.h"
+#include "Profiling.h"
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
+#include <shared_mutex>
 #include <vector>
 #include <string>
 #include <stdexcept>
 
+class ReturnHistory;
+
+/**
+ * @brief Risk of one position or one underlying
+ *
+ * Component VaR/ES are Euler allocations: over all positions (or assets)
+ * they add up to the portfolio figure. Component ES averages each position's
+ * P&L over the tail scenarios; component VaR averages it over the scenarios
+ * ranked next to the VaR scenario and is rescaled to sum exactly.
+ */
+struct RiskContribution {
+    double pv = 0.0;
+    double delta = 0.0;
+    double gamma = 0.0;
+    double vega = 0.0;
+    double theta = 0.0;
+    double component_var_95 = 0.0;
+    double component_var_99 = 0.0;
+    double component_es_95 = 0.0;
+    double component_es_99 = 0.0;
+    // Change in VaR per extra unit of the position (positions only)
+    double marginal_var_95 = 0.0;
+    double marginal_var_99 = 0.0;
+};
+
 struct PortfolioRiskResult {
     double total_pv = 0.0;
     double total_delta = 0.0;
@@ -19,6 +49,15 @@ struct PortfolioRiskResult {
     double expected_shortfall_95 = 0.0;
     double expected_shortfall_99 = 0.0;
     
+    // Indexed like Portfolio::getInstruments()
+    std::vector<RiskContribution> position_risk;
+    // Indexed by the portfolio's interned asset index (Portfolio::getAssetName)
+    std::vector<RiskContribution> asset_risk;
+    
+    // Where the run spent its time; disabled unless built with
+    // QE_ENABLE_PROFILING
+    Profiling::Report profile;
+    
     void reset() {
         total_pv = 0.0;
         total_delta = 0.0;
@@ -29,6 +68,9 @@ struct PortfolioRiskResult {
         value_at_risk_99 = 0.0;
         expected_shortfall_95 = 0.0;
         expected_shortfall_99 = 0.0;
+        position_risk.clear();
+        asset_risk.clear();
+        profile = Profiling::Report();
     }
     
     bool isValid() const {
@@ -52,15 +94,130 @@ struct RiskMetrics {
     double es_99 = 0.0;
 };
 
+// VaR and expected shortfall of a simulated P&L distribution in O(paths);
+// the distribution is partially reordered in place
+RiskMetrics riskMetricsFromDistribution(std::vector<double>& pnl_distribution);
+
+// Same for scenarios of unequal probability: VaR is the loss at which the
+// weight of worse scenarios reaches the tail probability, and ES the
+// weighted mean loss over exactly that much weight. Weights need not be
+// normalised.
+RiskMetrics riskMetricsFromWeightedDistribution(
+    const std::vector<double>& pnl_distribution,
+    const std::vector<double>& weights
+);
+
+struct HistoricalSimulationOptions {
+    size_t window_days = 0;            // most recent days used; 0 = all
+    // Weight of a scenario `age` days old is ewma_lambda^age (Boudoukh-
+    // Richardson-Whitelaw); 1 gives every day the same weight
+    double ewma_lambda = 1.0;
+    // Filtered HS: rescale each day's returns from the EWMA volatility of
+    // that day to today's
+    bool filtered = false;
+    double volatility_lambda = 0.94;
+};
+
+// VaR/ES at one checkpoint of a multi-horizon run
+struct HorizonRiskResult {
+    double horizon_days = 0.0;
+    double value_at_risk_95 = 0.0;
+    double value_at_risk_99 = 0.0;
+    double expected_shortfall_95 = 0.0;
+    double expected_shortfall_99 = 0.0;
+    
+    // Timings of the whole call, so every horizon of one run shares them
+    Profiling::Report profile;
+};
+
+// What the last version-aware run had to recompute
+struct RiskCacheStats {
+    size_t repriced_positions = 0;   // price/Greeks recomputed
+    size_t revalued_assets = 0;      // per-path P&L rebuilt
+    size_t cached_positions = 0;
+    size_t cached_assets = 0;
+};
+
+// Calculations are const and may run concurrently on one engine, provided
+// the portfolio and market data they read are not modified meanwhile. A
+// setter waits for running calculations and holds new ones back until it
+// returns. Version-aware runs share the engine's cache, so they run one at a
+// time.
 class RiskEngine {
 public:
     RiskEngine();
     explicit RiskEngine(int var_simulations);
+    ~RiskEngine();
     
+    // Adapter over the MarketDataTable overload
     PortfolioRiskResult calculatePortfolioRisk(
         const Portfolio& portfolio, 
         const std::map<std::string, MarketData>& market_data_map
-    );
+    ) const;
+    
+    // Tickers are resolved once per asset held; scenarios run on flat,
+    // string-free market state
+    PortfolioRiskResult calculatePortfolioRisk(
+        const Portfolio& portfolio, 
+        const MarketDataTable& market_data
+    ) const;
+    
+    // Smile-aware variant: each instrument is priced with the vol, rate and
+    // dividend read off its asset's surface/curves at its strike and expiry
+    PortfolioRiskResult calculatePortfolioRisk(
+        const Portfolio& portfolio, 
+        const std::map<std::string, SurfaceMarketData>& market_data_map
+    ) const;
+    
+    // Version-aware variant: per-position prices/Greeks and per-asset P&L
+    // vectors are cached against the manager's version stamps, so only
+    // positions on assets that ticked are repriced, and only assets that
+    // ticked or whose positions changed are re-simulated. The scenario set is
+    // kept between calls until the seed, simulation count or horizon changes.
+    // Component VaR/ES are filled per asset only; position components stay 0.
+    PortfolioRiskResult calculatePortfolioRisk(
+        const Portfolio& portfolio, 
+        const MarketDataManager& market_data
+    ) const;
+    
+    // Historical simulation: each day of the history is one scenario in which
+    // every held asset moves by that day's log return, scaled by
+    // sqrt(horizon days). With equal weights, component VaR/ES are
+    // allocated as in the Monte Carlo run; with EWMA weights only the
+    // Greeks are attributed.
+    PortfolioRiskResult calculateHistoricalRisk(
+        const Portfolio& portfolio,
+        const MarketDataTable& market_data,
+        const ReturnHistory& history,
+        const HistoricalSimulationOptions& options = HistoricalSimulationOptions()
+    ) const;
+    
+    PortfolioRiskResult calculateHistoricalRisk(
+        const Portfolio& portfolio,
+        const std::map<std::string, MarketData>& market_data_map,
+        const ReturnHistory& history,
+        const HistoricalSimulationOptions& options = HistoricalSimulationOptions()
+    ) const;
+    
+    // One Monte Carlo pass for several horizons: each path is stepped from
+    // checkpoint to checkpoint, and at each one positions are revalued with
+    // instruments aged by that horizon. Horizons are trading days, returned
+    // ascending without duplicates; the first matches a single-horizon run
+    // with the same seed. The horizon set by setVaRTimeHorizonDays is unused.
+    std::vector<HorizonRiskResult> calculateHorizonRisk(
+        const Portfolio& portfolio,
+        const MarketDataTable& market_data,
+        const std::vector<double>& horizon_days
+    ) const;
+    
+    std::vector<HorizonRiskResult> calculateHorizonRisk(
+        const Portfolio& portfolio,
+        const std::map<std::string, MarketData>& market_data_map,
+        const std::vector<double>& horizon_days
+    ) const;
+    
+    void clearCache();
+    RiskCacheStats getLastCacheStats() const;
     
     void setVaRSimulations(int simulations);
     int getVaRSimulations() const;
@@ -77,20 +234,84 @@ private:
     unsigned int random_seed_;
     bool use_fixed_seed_;
     
+    // Held shared by calculations and exclusively by the setters, so a run
+    // sees one consistent set of parameters
+    mutable std::shared_mutex settings_mutex_;
+    
+    struct VersionedCache;
+    std::unique_ptr<VersionedCache> cache_;
+    
+    // Market data resolved once per position, before any scenario is run
+    struct PositionMarketData {
+        MarketState asset;    // drives the simulated underlying
+        MarketData pricing;   // instrument-specific vol, rate and dividend
+    };
+    
+    std::vector<PositionMarketData> resolvePositions(
+        const Portfolio& portfolio,
+        const MarketDataTable& market_data
+    ) const;
+    
+    PortfolioRiskResult calculateRisk(
+        const Portfolio& portfolio,
+        const std::vector<PositionMarketData>& position_market_data
+    ) const;
+    
+    // Prices and Greeks per position, and their totals
+    PortfolioRiskResult valuePositions(
+        const Portfolio& portfolio,
+        const std::vector<PositionMarketData>& position_market_data
+    ) const;
+    
     RiskMetrics calculateRiskMetrics(
         const Portfolio& portfolio, 
-        const std::map<std::string, MarketData>& market_data_map
-    );
+        const std::vector<PositionMarketData>& position_market_data,
+        std::vector<RiskContribution>& position_risk
+    ) const;
     
-    void validateMarketData(
+    // Ranks the scenarios of pnl_distribution, then revalues every position
+    // (as aged to the horizon in at_horizon) on the tail scenarios only,
+    // regenerated from the seed, to fill the component and marginal VaR/ES of
+    // position_risk. Returns the portfolio VaR/ES, as
+    // riskMetricsFromDistribution would.
+    RiskMetrics allocateTailRisk(
         const Portfolio& portfolio,
-        const std::map<std::string, MarketData>& market_data_map
+        const std::vector<std::unique_ptr<Instrument>>& at_horizon,
+        const std::vector<PositionMarketData>& position_market_data,
+        const std::vector<double>& base_prices,
+        uint64_t seed,
+        const std::vector<double>& pnl_distribution,
+        std::vector<RiskContribution>& position_risk
     ) const;
     
+    // P&L distribution at each horizon, horizons[h] filling pnl_distributions[h]
+    void simulateHorizons(
+        const Portfolio& portfolio,
+        const std::vector<PositionMarketData>& position_market_data,
+        const std::vector<double>& horizons,
+        std::vector<std::vector<double>>& pnl_distributions
+    ) const;
+    
+    // Sums position contributions per underlying into result.asset_risk
+    static void aggregateByAsset(const Portfolio& portfolio, PortfolioRiskResult& result);
+    
+    // Table id of every asset the portfolio holds, indexed by the portfolio's
+    // interned asset index; the referenced market data is validated
+    std::vector<AssetId> joinMarketData(
+        const Portfolio& portfolio,
+        const MarketDataTable& market_data
+    ) const;
+    
+    void validateAssetMarketData(const std::string& asset_id, const MarketState& state) const;
+    
     void validateParameters() const;
     
+    // Splits [0, var_simulations_) across threads; worker exceptions are
+    // rethrown on the calling thread
+    void runPaths(const std::function<void(int, int)>& worker) const;
+    
     double calculateSingleInstrumentMetric(
-        const std::unique_ptr<Instrument>& instrument,
+        const InstrumentPtr& instrument,
         int quantity,
         const MarketData& md,
         const std::string& metric_name
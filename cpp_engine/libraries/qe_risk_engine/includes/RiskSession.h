@@ -0,0 +1,92 @@
+#ifndef RISKSESSION_H
+#define RISKSESSION_H
+
+#include "Portfolio.h"
+#include "MarketData.h"
+#include "RiskEngine.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Portfolio risk kept current as positions change
+ *
+ * Each position's unit price and Greeks are cached when it is added. Path P&L
+ * is cached per asset, summed over that asset's positions, so memory grows
+ * with assets x paths rather than positions x paths. Adding, removing or
+ * resizing a position reprices only that position on the session's fixed
+ * Monte Carlo paths and adjusts its asset's and the portfolio's P&L vectors;
+ * getRisk() reads VaR/ES off the portfolio vector by selection.
+ *
+ * Scenarios come from the same generator as RiskEngine, so a session and an
+ * engine seeded alike agree on the same book. Shocks are drawn per asset, so a
+ * market-data update reprices only the positions on that asset.
+ */
+class RiskSession {
+public:
+    explicit RiskSession(
+        const std::map<std::string, MarketData>& market_data_map,
+        int var_simulations = 10000,
+        double time_horizon_days = 1.0,
+        unsigned int seed = 0
+    );
+    
+    // Returns the index of the new position
+    size_t addInstrument(std::unique_ptr<Instrument> instrument, int quantity);
+    void removeInstrument(size_t index);
+    void updateQuantity(size_t index, int new_quantity);
+    
+    // Replaces the market data of one asset and revalues the positions on it;
+    // returns how many were revalued. A failed revaluation leaves the session
+    // unchanged.
+    size_t updateMarketData(const MarketData& market_data);
+    
+    // Stable handles for positions, since indices shift on removal
+    uint64_t getPositionId(size_t index) const;
+    size_t findPosition(uint64_t position_id) const;   // throws std::out_of_range
+    
+    PortfolioRiskResult getRisk() const;
+    
+    const Portfolio& getPortfolio() const;
+    size_t size() const;
+    bool empty() const;
+    int getVaRSimulations() const;
+    double getVaRTimeHorizonDays() const;
+    
+private:
+    struct PositionCache {
+        double price = 0.0;
+        double delta = 0.0;
+        double gamma = 0.0;
+        double vega = 0.0;
+        double theta = 0.0;
+    };
+    
+    struct AssetPnl {
+        size_t positions = 0;
+        std::vector<double> pnl;   // per path, summed over the asset's positions
+    };
+    
+    std::map<std::string, MarketData> market_data_map_;
+    int var_simulations_;
+    double time_horizon_days_;
+    unsigned int seed_;
+    
+    Portfolio portfolio_;
+    std::vector<PositionCache> positions_;
+    std::map<std::string, AssetPnl> assets_;
+    PortfolioRiskResult totals_;           // Greeks and PV; VaR/ES are derived
+    std::vector<double> pnl_distribution_; // portfolio P&L per path
+    
+    const MarketData& marketDataFor(const std::string& asset_id) const;
+    PositionCache valuePosition(const Instrument& instrument) const;
+    // Adds quantity times the position's P&L on every path to pnl
+    void addPathPnl(const Instrument& instrument, const PositionCache& position,
+                    double quantity, std::vector<double>& pnl) const;
+    int positionQuantity(size_t index) const;
+    void accumulate(const PositionCache& position, double quantity_change);
+    void applyPathPnl(const std::string& asset_id, const std::vector<double>& pnl_change);
+};
+
+#endif
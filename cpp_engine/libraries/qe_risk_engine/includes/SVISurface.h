@@ -0,0 +1,150 @@
+#ifndef SVISURFACE_H
+#define SVISURFACE_H
+
+#include "ImpliedVolatilitySurface.h"
+#include <utility>
+#include <vector>
+
+namespace VolatilitySurface {
+    /**
+     * @brief Raw SVI slice: w(k) = a + b (rho (k - m) + sqrt((k - m)^2 + sigma^2))
+     *
+     * w is total implied variance and k = log(K / F) the log-moneyness.
+     */
+    struct SVIParameters {
+        double a = 0.0;
+        double b = 0.0;
+        double rho = 0.0;
+        double m = 0.0;
+        double sigma = 0.1;
+
+        double totalVariance(double k) const;
+        double firstDerivative(double k) const;
+        double secondDerivative(double k) const;
+        bool isValid() const;
+    };
+
+    struct SVISlice {
+        double expiry = 0.0;
+        SVIParameters params;
+        double rmse = 0.0;      // in total variance
+        size_t quotes = 0;
+    };
+
+    struct ArbitrageReport {
+        // Expiries whose slice has negative risk-neutral density somewhere
+        std::vector<double> butterfly_violations;
+        // Consecutive expiry pairs whose total variance crosses
+        std::vector<std::pair<double, double>> calendar_violations;
+
+        bool isButterflyFree() const { return butterfly_violations.empty(); }
+        bool isCalendarFree() const { return calendar_violations.empty(); }
+        bool isArbitrageFree() const { return isButterflyFree() && isCalendarFree(); }
+    };
+
+    /**
+     * @brief Closed-form surface in log-moneyness k = log(K / F(T)),
+     * F(T) = spot * exp(rate * T)
+     *
+     * Derived classes provide total variance and its partial derivatives;
+     * vols, skew and term structure follow analytically from those.
+     */
+    class ParametricSurface {
+    public:
+        ParametricSurface(double spot, double rate);
+        virtual ~ParametricSurface() = default;
+
+        virtual double totalVariance(double k, double expiry) const = 0;
+
+        double impliedVol(double strike, double expiry) const;
+
+        // d(sigma)/dK at the forward: replaces the point rescans of calculateSkew
+        double skew(double expiry) const;
+
+        // d(sigma)/dT at a fixed strike: replaces calculateTermStructure
+        double termStructure(double strike, double expiry) const;
+
+        virtual ArbitrageReport checkArbitrage() const = 0;
+
+        double getSpot() const { return spot_; }
+        double getRate() const { return rate_; }
+
+    protected:
+        double spot_;
+        double rate_;
+
+        double logMoneyness(double strike, double expiry) const;
+
+        // w, dw/dk (fixed T) and dw/dT (fixed k)
+        virtual void derivatives(double k, double expiry,
+                                 double& w, double& dw_dk, double& dw_dT) const = 0;
+    };
+
+    /**
+     * @brief Independent SVI fit per expiry slice
+     *
+     * Slices are linked linearly in total variance at constant moneyness.
+     */
+    class SVISurface : public ParametricSurface {
+    public:
+        SVISurface(double spot, double rate);
+
+        // Fits every expiry of the surface; slices run in parallel
+        void fit(const ImpliedVolSurface& surface, unsigned int num_threads = 0);
+
+        double totalVariance(double k, double expiry) const override;
+        ArbitrageReport checkArbitrage() const override;
+
+        const std::vector<SVISlice>& getSlices() const { return slices_; }
+
+    protected:
+        void derivatives(double k, double expiry,
+                         double& w, double& dw_dk, double& dw_dT) const override;
+
+    private:
+        std::vector<SVISlice> slices_;
+    };
+
+    /**
+     * @brief Surface SVI (Gatheral-Jacquier) with power-law phi:
+     * w(k, T) = theta/2 (1 + rho phi k + sqrt((phi k + rho)^2 + 1 - rho^2)),
+     * phi(theta) = eta / (theta^gamma (1 + theta)^(1 - gamma))
+     *
+     * The fit keeps eta (1 + |rho|) <= 2 and the ATM variance curve
+     * non-decreasing, which makes the surface free of static arbitrage.
+     */
+    class SSVISurface : public ParametricSurface {
+    public:
+        SSVISurface(double spot, double rate);
+
+        void fit(const ImpliedVolSurface& surface);
+
+        double totalVariance(double k, double expiry) const override;
+        ArbitrageReport checkArbitrage() const override;
+
+        double getRho() const { return rho_; }
+        double getEta() const { return eta_; }
+        double getGamma() const { return gamma_; }
+        double getRmse() const { return rmse_; }
+
+        // ATM total variance theta(T)
+        double atmTotalVariance(double expiry) const;
+
+    protected:
+        void derivatives(double k, double expiry,
+                         double& w, double& dw_dk, double& dw_dT) const override;
+
+    private:
+        std::vector<double> expiries_;
+        std::vector<double> atm_variance_;
+        double rho_ = 0.0;
+        double eta_ = 1.0;
+        double gamma_ = 0.5;
+        double rmse_ = 0.0;
+
+        double phi(double theta) const;
+        void atmVariance(double expiry, double& theta, double& dtheta_dT) const;
+    };
+}
+
+#endif
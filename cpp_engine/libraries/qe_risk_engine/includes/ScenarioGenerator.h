@@ -0,0 +1,33 @@
+#ifndef SCENARIOGENERATOR_H
+#define SCENARIOGENERATOR_H
+
+#include "MarketData.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Scenario {
+    /**
+     * @brief Counter-based Monte Carlo shocks
+     *
+     * The standard normal shock for (seed, asset stream, path) is a pure
+     * function of those three values, so any subset of paths or assets can be
+     * regenerated in any order, on any thread, and later runs see exactly the
+     * same scenarios. Positions on the same asset share a stream and move
+     * together.
+     */
+    uint64_t assetStream(const std::string& asset_id);
+    
+    double standardNormal(uint64_t seed, uint64_t stream, uint64_t path);
+    
+    // Stream for the step into checkpoint k of a multi-horizon path. Step 0
+    // is the asset stream itself, so the first checkpoint sees the same
+    // shocks as a single-horizon run.
+    uint64_t checkpointStream(uint64_t asset_stream, size_t checkpoint);
+    
+    // GBM spot after dt years under the asset's rate and volatility
+    double simulatedSpot(const MarketData& md, double dt, double shock);
+    double simulatedSpot(const MarketState& state, double dt, double shock);
+}
+
+#endif
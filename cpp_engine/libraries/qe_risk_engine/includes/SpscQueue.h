@@ -0,0 +1,136 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Bounded lock-free queue between one producer and one consumer
+ *
+ * A ring of slots with one atomic index per side: only the producer moves
+ * tail_ and only the consumer moves head_, so neither takes a lock. The two
+ * indices sit on separate cache lines, and each side caches the other's
+ * index, rereading it only when the ring looks full or empty.
+ *
+ * push() blocks while the ring is full, which is the backpressure between
+ * pipeline stages: a fast producer waits for its consumer rather than
+ * buffering without bound. Waiting spins briefly, then yields, then sleeps,
+ * so an idle stage does not hold a core. close() ends the stream; pop()
+ * drains what is left and then returns false. cancel() abandons the queue
+ * from either side and wakes both.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("Queue capacity must be positive");
+        }
+        size_t slots = 1;
+        while (slots < capacity) slots <<= 1;
+        slots_.resize(slots);
+        mask_ = slots - 1;
+        capacity_ = capacity;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    // Producer side. Moves from value on success; false if the ring is full.
+    bool tryPush(T& value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == capacity_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == capacity_) {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. False if the ring is empty.
+    bool tryPop(T& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return false;
+            }
+        }
+        value = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Waits for room; false if the queue was cancelled, with value untouched
+    bool push(T value) {
+        Backoff backoff;
+        while (!tryPush(value)) {
+            if (cancelled()) return false;
+            backoff.wait();
+        }
+        return true;
+    }
+
+    // Waits for an item; false once the queue is closed and drained, or
+    // cancelled
+    bool pop(T& value) {
+        Backoff backoff;
+        for (;;) {
+            if (cancelled()) return false;
+            if (tryPop(value)) return true;
+            // Closed is published after the last push, so one more look
+            // after seeing it catches an item that raced with it
+            if (closed_.load(std::memory_order_acquire)) {
+                return tryPop(value);
+            }
+            backoff.wait();
+        }
+    }
+
+    void close() { closed_.store(true, std::memory_order_release); }
+    void cancel() { cancelled_.store(true, std::memory_order_release); }
+    bool cancelled() const { return cancelled_.load(std::memory_order_acquire); }
+
+private:
+    static constexpr size_t kCacheLine = 64;
+
+    // Spins, then yields, then sleeps in short steps
+    class Backoff {
+    public:
+        void wait() {
+            ++rounds_;
+            if (rounds_ <= 64) return;
+            if (rounds_ <= 1024) {
+                std::this_thread::yield();
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+
+    private:
+        int rounds_ = 0;
+    };
+
+    std::vector<T> slots_;
+    size_t mask_ = 0;
+    size_t capacity_ = 0;
+
+    alignas(kCacheLine) std::atomic<size_t> head_{0};
+    size_t tail_cache_ = 0;   // consumer's last view of tail_
+    alignas(kCacheLine) std::atomic<size_t> tail_{0};
+    size_t head_cache_ = 0;   // producer's last view of head_
+    alignas(kCacheLine) std::atomic<bool> closed_{false};
+    std::atomic<bool> cancelled_{false};
+};
+
+#endif
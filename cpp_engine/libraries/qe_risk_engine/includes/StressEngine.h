@@ -0,0 +1,72 @@
+#ifndef STRESSENGINE_H
+#define STRESSENGINE_H
+
+#include "Portfolio.h"
+#include "MarketData.h"
+#include <map>
+#include <string>
+#include <vector>
+
+// One market move. Spot shifts are relative (-0.1 = down 10%); vol and rate
+// shifts are absolute (0.05 = +5 vol points / +500bp).
+struct StressShock {
+    std::string asset_id;   // empty: every asset
+    double spot_shift = 0.0;
+    double vol_shift = 0.0;
+    double rate_shift = 0.0;
+};
+
+// Shocks compound: spot shifts multiply, vol and rate shifts add
+struct StressScenario {
+    std::string name;
+    std::vector<StressShock> shocks;
+};
+
+struct StressResult {
+    std::vector<std::string> scenario_names;
+    size_t position_count = 0;
+    double base_value = 0.0;
+    // Row-major [scenario][position], indexed like Portfolio::getInstruments()
+    std::vector<double> position_pnl;
+    std::vector<double> total_pnl;   // per scenario
+
+    size_t scenarioCount() const { return scenario_names.size(); }
+    double pnl(size_t scenario, size_t position) const {
+        return position_pnl[scenario * position_count + position];
+    }
+};
+
+/**
+ * @brief Deterministic full-revaluation stress testing
+ *
+ * The book is flattened once into per-position columns (asset, quantity,
+ * base market data and price), and every scenario is turned into shocked
+ * spot/vol/rate columns per held asset up front. The scenario batch is then
+ * split across threads, each revaluing whole scenarios against those columns,
+ * so a pack of thousands of scenarios costs one call and one thread spawn.
+ */
+class StressEngine {
+public:
+    StressResult run(
+        const Portfolio& portfolio,
+        const MarketDataTable& market_data,
+        const std::vector<StressScenario>& scenarios
+    ) const;
+
+    StressResult run(
+        const Portfolio& portfolio,
+        const std::map<std::string, MarketData>& market_data_map,
+        const std::vector<StressScenario>& scenarios
+    ) const;
+
+    // Spot x vol ladder, spot-major: scenario i * vol_shifts.size() + j moves
+    // spot by spot_shifts[i] and vol by vol_shifts[j]. An empty asset_id
+    // moves every asset together.
+    static std::vector<StressScenario> ladder(
+        const std::vector<double>& spot_shifts,
+        const std::vector<double>& vol_shifts,
+        const std::string& asset_id = ""
+    );
+};
+
+#endif
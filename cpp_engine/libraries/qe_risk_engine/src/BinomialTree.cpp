@@ -1,4 +1,5 @@
 #include "BinomialTree.h"
+#include "Profiling.h"
 #include <cmath>
 #include <algorithm>
 #include <stdexcept>
@@ -40,6 +41,8 @@ double europeanOptionPrice(
         throw std::runtime_error("Invalid probability in binomial tree");
     }
     
+    QE_PROFILE_COUNT(Profiling::Counter::TreeNodes,
+                     static_cast<uint64_t>(steps + 1) * (steps + 2) / 2);
     std::vector<double> prices(steps + 1);
     
     for (int i = 0; i <= steps; ++i) {
@@ -96,6 +99,8 @@ double americanOptionPrice(
         throw std::runtime_error("Invalid probability in binomial tree");
     }
     
+    QE_PROFILE_COUNT(Profiling::Counter::TreeNodes,
+                     static_cast<uint64_t>(steps + 1) * (steps + 2) / 2);
     std::vector<double> prices(steps + 1);
     std::vector<double> spots(steps + 1);
     
@@ -1,7 +1,11 @@
 #include "BlackScholes.h"
+#include "Parallel.h"
 #include <cmath>
 #include <algorithm>
+#include <array>
+#include <functional>
 #include <limits>
+#include <vector>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -230,6 +234,289 @@ double impliedVolatility(
     throw std::runtime_error("Implied volatility did not converge");
 }
 
+namespace {
+
+// Quotes per solver block. Each lane calls exp/erfc and branches on its
+// objective, so the lane loop is scalar; blocking only shares the loop
+// and convergence bookkeeping
+constexpr size_t kLanes = 8;
+// Below this many quotes per thread the hand-off cost dominates
+constexpr size_t kMinQuotesPerThread = 1024;
+
+const double kInvSqrt2Pi = 1.0 / std::sqrt(2.0 * M_PI);
+
+// Normalised Black call b(x, s) = e^{x/2} N(x/s + s/2) - e^{-x/2} N(x/s - s/2)
+// for x = log(F/K) <= 0, s = sigma sqrt(T)
+double normalisedCall(double x, double s) {
+    const double d1 = x / s + 0.5 * s;
+    const double d2 = x / s - 0.5 * s;
+    return 0.5 * (std::exp(0.5 * x) * std::erfc(-d1 / std::sqrt(2.0)) -
+                  std::exp(-0.5 * x) * std::erfc(-d2 / std::sqrt(2.0)));
+}
+
+// Initial guess: Corrado-Miller's rational approximation above the
+// inflection point s = sqrt(2|x|), the small-price asymptote below it
+double initialGuess(double x, double beta) {
+    const double s_c = std::sqrt(2.0 * std::abs(x));
+    const double b_c = s_c > 0.0 ? normalisedCall(x, s_c) : 0.0;
+
+    const double forward = std::exp(0.5 * x), strike = std::exp(-0.5 * x);
+    const double half_gap = 0.5 * (forward - strike);
+    const double excess = beta - half_gap;
+    const double discriminant = std::max(excess * excess - 4.0 * half_gap * half_gap / M_PI, 0.0);
+    const double corrado_miller = std::sqrt(2.0 * M_PI) / (forward + strike) *
+                                  (excess + std::sqrt(discriminant));
+
+    if (beta >= b_c || x == 0.0) {
+        return std::max(corrado_miller, 1e-8);
+    }
+    const double asymptotic = std::abs(x) / std::sqrt(-2.0 * std::log(beta));
+    return std::max(std::max(corrado_miller, asymptotic), 1e-8);
+}
+
+struct Lanes {
+    std::array<double, kLanes> x, beta, s, lo, hi, scale;
+    std::array<bool, kLanes> active, use_log;
+};
+
+void solveLanes(Lanes& lanes, const BatchImpliedVolOptions& options) {
+    for (int iteration = 0; iteration < options.max_iterations; ++iteration) {
+        bool any_active = false;
+        for (size_t l = 0; l < kLanes; ++l) {
+            const double x = lanes.x[l], s = lanes.s[l];
+            const double b = normalisedCall(x, s);
+
+            // Vega and its log-derivatives in s are closed form
+            const double db = kInvSqrt2Pi * std::exp(-0.5 * (x * x / (s * s) + 0.25 * s * s));
+            const double h2 = x * x / (s * s * s) - 0.25 * s;
+            const double h3 = h2 * h2 - 3.0 * x * x / (s * s * s * s) - 0.25;
+
+            // Objective b - beta, or log(b / beta) deep out of the money where
+            // b is exponentially small
+            double f, d1f, q2, q3;
+            if (lanes.use_log[l]) {
+                const double ratio = db / b;
+                f = std::log(b / lanes.beta[l]);
+                d1f = ratio;
+                q2 = h2 - ratio;
+                q3 = h3 - 3.0 * h2 * ratio + 2.0 * ratio * ratio;
+            } else {
+                f = b - lanes.beta[l];
+                d1f = db;
+                q2 = h2;
+                q3 = h3;
+            }
+
+            // The objective increases in s, so its sign shrinks the bracket
+            const bool below = f < 0.0;
+            const double lo = below ? s : lanes.lo[l];
+            const double hi = below ? lanes.hi[l] : s;
+
+            // Householder(3): s + nu (1 + q2 nu / 2) / (1 + nu (q2 + q3 nu / 6))
+            const double nu = -f / d1f;
+            const double step = nu * (1.0 + 0.5 * q2 * nu) / (1.0 + nu * (q2 + q3 * nu / 6.0));
+            const bool done = std::abs(step) <= options.tolerance * s;
+            double next = s + step;
+            if (!done && !(next > lo && next < hi)) {
+                next = std::isfinite(hi) ? 0.5 * (lo + hi) : 2.0 * s;
+            }
+            const bool active = lanes.active[l];
+            lanes.s[l] = active ? next : s;
+            lanes.lo[l] = active ? lo : lanes.lo[l];
+            lanes.hi[l] = active ? hi : lanes.hi[l];
+            lanes.active[l] = active && !done;
+            any_active = any_active || lanes.active[l];
+        }
+        if (!any_active) return;
+    }
+}
+
+void solveRange(const ImpliedVolQuote* quotes, size_t begin, size_t end,
+                double S, double r, double* vols, const BatchImpliedVolOptions& options) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    for (size_t block = begin; block < end; block += kLanes) {
+        Lanes lanes;
+        std::array<size_t, kLanes> index;
+        size_t used = 0;
+
+        for (size_t i = block; i < std::min(block + kLanes, end); ++i) {
+            const ImpliedVolQuote& q = quotes[i];
+            vols[i] = nan;
+            if (!(q.strike > 0.0) || !(q.expiry > 0.0) || !(q.market_price >= 0.0) ||
+                !std::isfinite(q.market_price)) {
+                continue;
+            }
+
+            // Undiscounted price normalised by sqrt(F K); a put is a call at
+            // mirrored moneyness, p(x, s) = b(-x, s)
+            const double forward = S * std::exp(r * q.expiry);
+            const double norm = std::sqrt(forward * q.strike);
+            double x = std::log(forward / q.strike);
+            double beta = q.market_price * std::exp(r * q.expiry) / norm;
+            if (!q.is_call) {
+                x = -x;
+            }
+
+            // In-the-money maps to out-of-the-money: b(x) = b(-x) + intrinsic
+            if (x > 0.0) {
+                beta -= std::exp(0.5 * x) - std::exp(-0.5 * x);
+                x = -x;
+            }
+
+            if (beta <= 0.0) {
+                if (beta > -1e-10 * (1.0 + q.market_price) / norm) vols[i] = 0.0;
+                continue;
+            }
+            if (beta >= std::exp(0.5 * x)) {
+                continue;
+            }
+
+            lanes.x[used] = x;
+            lanes.beta[used] = beta;
+            lanes.s[used] = initialGuess(x, beta);
+            lanes.lo[used] = 0.0;
+            lanes.hi[used] = std::numeric_limits<double>::infinity();
+            lanes.scale[used] = 1.0 / std::sqrt(q.expiry);
+            lanes.active[used] = true;
+            lanes.use_log[used] = x < 0.0 &&
+                beta < normalisedCall(x, std::sqrt(2.0 * std::abs(x)));
+            index[used++] = i;
+        }
+
+        if (used == 0) continue;
+
+        // Pad unused lanes with a converged dummy quote
+        for (size_t l = used; l < kLanes; ++l) {
+            lanes.x[l] = 0.0;
+            lanes.beta[l] = normalisedCall(0.0, 0.2);
+            lanes.s[l] = 0.2;
+            lanes.lo[l] = 0.0;
+            lanes.hi[l] = std::numeric_limits<double>::infinity();
+            lanes.scale[l] = 1.0;
+            lanes.active[l] = false;
+            lanes.use_log[l] = false;
+        }
+
+        solveLanes(lanes, options);
+
+        for (size_t l = 0; l < used; ++l) {
+            if (!lanes.active[l]) vols[index[l]] = lanes.s[l] * lanes.scale[l];
+        }
+    }
+}
+
+} // namespace
+
+void impliedVolatility(
+    const ImpliedVolQuote* quotes, size_t count, double S, double r,
+    double* vols, const BatchImpliedVolOptions& options
+) {
+    if (S <= 0.0 || std::isnan(S) || std::isinf(S)) {
+        throw std::invalid_argument("Spot price must be positive");
+    }
+    if (std::isnan(r) || std::isinf(r)) {
+        throw std::invalid_argument("Invalid risk-free rate");
+    }
+    if (count == 0) return;
+
+    // Chunks are whole lane blocks so no block straddles two threads
+    const int blocks = static_cast<int>((count + kLanes - 1) / kLanes);
+    Parallel::parallelFor(blocks, static_cast<int>(kMinQuotesPerThread / kLanes), [&](int start, int end) {
+        solveRange(quotes, start * kLanes, std::min(count, end * kLanes), S, r, vols, options);
+    }, options.num_threads);
+}
+
+std::vector<double> impliedVolatility(
+    const std::vector<ImpliedVolQuote>& quotes, double S, double r,
+    const BatchImpliedVolOptions& options
+) {
+    std::vector<double> vols(quotes.size());
+    impliedVolatility(quotes.data(), quotes.size(), S, r, vols.data(), options);
+    return vols;
+}
+
+namespace {
+
+bool validInputs(double S, double K, double r, double T, double sigma) {
+    return std::isfinite(S) && std::isfinite(K) && std::isfinite(r) &&
+           std::isfinite(T) && std::isfinite(sigma) &&
+           S > 0.0 && K > 0.0 && T >= 0.0 && sigma >= 0.0;
+}
+
+void priceRange(const BatchInputs& in, const BatchOutputs& out, size_t begin, size_t end) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    
+    for (size_t i = begin; i < end; ++i) {
+        const double S = in.spot[i];
+        const double K = in.strike[i];
+        const double r = in.rate[i];
+        const double T = in.expiry[i];
+        const double sigma = in.vol[i];
+        const bool is_call = in.is_call[i] != 0;
+        
+        double price = nan, delta = nan, gamma = nan, vega = nan, theta = nan, rho = nan;
+        
+        if (validInputs(S, K, r, T, sigma)) {
+            if (T <= 0.0 || sigma <= 0.0) {
+                price = is_call ? std::max(0.0, S - K) : std::max(0.0, K - S);
+                delta = is_call ? (S > K ? 1.0 : 0.0) : (S < K ? -1.0 : 0.0);
+                gamma = 0.0;
+                vega = 0.0;
+                theta = 0.0;
+            }
+            if (T <= 0.0) {
+                rho = 0.0;
+            } else {
+                const double sqrt_t = std::sqrt(T);
+                const double vol_sqrt_t = sigma * sqrt_t;
+                const double d1 = (std::log(S / K) + (r + 0.5 * sigma * sigma) * T) / vol_sqrt_t;
+                const double d2 = d1 - vol_sqrt_t;
+                const double discounted_strike = K * std::exp(-r * T);
+                // N(-x) = 1 - N(x) would lose the deep tails, so puts use N(-d) directly
+                const double n_d2 = N(is_call ? d2 : -d2);
+                
+                rho = (is_call ? 1.0 : -1.0) * discounted_strike * T * n_d2 / 100.0;
+                
+                if (sigma > 0.0) {
+                    const double n_d1 = N(is_call ? d1 : -d1);
+                    const double pdf_d1 = nPrime(d1);
+                    price = is_call ? S * n_d1 - discounted_strike * n_d2
+                                    : discounted_strike * n_d2 - S * n_d1;
+                    delta = is_call ? n_d1 : -n_d1;
+                    gamma = pdf_d1 / (S * vol_sqrt_t);
+                    vega = S * pdf_d1 * sqrt_t;
+                    const double decay = -(S * pdf_d1 * sigma) / (2.0 * sqrt_t);
+                    theta = (is_call ? decay - r * discounted_strike * n_d2
+                                     : decay + r * discounted_strike * n_d2) / 365.0;
+                }
+            }
+        }
+        
+        if (out.price) out.price[i] = price;
+        if (out.delta) out.delta[i] = delta;
+        if (out.gamma) out.gamma[i] = gamma;
+        if (out.vega) out.vega[i] = vega;
+        if (out.theta) out.theta[i] = theta;
+        if (out.rho) out.rho[i] = rho;
+    }
+}
+
+} // namespace
+
+void priceBatch(const BatchInputs& inputs, const BatchOutputs& outputs,
+                unsigned int num_threads) {
+    if (inputs.count == 0) return;
+    if (!inputs.spot || !inputs.strike || !inputs.rate || !inputs.expiry || !inputs.vol ||
+        !inputs.is_call) {
+        throw std::invalid_argument("Batch pricing needs every input column");
+    }
+    
+    Parallel::parallelFor(static_cast<int>(inputs.count), static_cast<int>(kMinQuotesPerThread),
+                          [&](int start, int end) { priceRange(inputs, outputs, start, end); },
+                          num_threads);
+}
+
 #ifdef USE_QUANTLIB
 QuantLibPricer::ValidationResult validateCallPrice(
     double S, double K, double r, double T, double sigma,
@@ -0,0 +1,615 @@
+#include "Heston.h"
+#include "BlackScholes.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace Heston {
+
+namespace {
+
+using Complex = std::complex<double>;
+using ComplexGradient = std::array<Complex, 5>;
+
+// The integral runs over [0, limit], split into Gauss-Legendre panels. The
+// limit is set per expiry, where the characteristic function has fallen
+// below kTailTolerance, and there are enough panels that neither its decay
+// nor the strike phase u log(F/K) turns too fast for one panel's nodes.
+constexpr int kPanelNodes = 64;
+constexpr int kMaxPanels = 64;
+constexpr double kTailTolerance = 1e-12;
+constexpr double kMaxIntegrationLimit = 1e4;
+// Radians of strike phase one panel resolves comfortably
+constexpr double kPanelPhase = 20.0;
+
+struct Quadrature {
+    std::vector<double> nodes;
+    std::vector<double> weights;
+};
+
+struct StandardRule {
+    std::array<double, kPanelNodes> nodes;
+    std::array<double, kPanelNodes> weights;
+};
+
+// Gauss-Legendre on [-1, 1]
+StandardRule buildGaussLegendre() {
+    StandardRule q;
+    const int n = kPanelNodes;
+
+    for (int i = 0; i < (n + 1) / 2; ++i) {
+        double x = std::cos(M_PI * (i + 0.75) / (n + 0.5));
+        double dp = 0.0;
+
+        for (int iter = 0; iter < 100; ++iter) {
+            double p0 = 1.0;
+            double p1 = x;
+            for (int k = 2; k <= n; ++k) {
+                const double p2 = ((2.0 * k - 1.0) * x * p1 - (k - 1.0) * p0) / k;
+                p0 = p1;
+                p1 = p2;
+            }
+            dp = n * (x * p1 - p0) / (x * x - 1.0);
+            const double dx = p1 / dp;
+            x -= dx;
+            if (std::abs(dx) < 1e-15) {
+                break;
+            }
+        }
+
+        const double w = 2.0 / ((1.0 - x * x) * dp * dp);
+        q.nodes[i] = -x;
+        q.nodes[n - 1 - i] = x;
+        q.weights[i] = w;
+        q.weights[n - 1 - i] = w;
+    }
+
+    return q;
+}
+
+// Computed once per process and shared by every pricing call
+const StandardRule& gaussLegendre() {
+    static const StandardRule q = buildGaussLegendre();
+    return q;
+}
+
+/**
+ * Log of the forward-normalised characteristic function, i.e. log(phi(u))
+ * without the iu*log(F) term, in the Cui et al. (2017) formulation that is
+ * continuous in u and admits closed-form parameter derivatives.
+ * Hyperbolic functions are scaled by exp(-d*tau/2) to avoid overflow; every
+ * place they enter is a ratio, so the scaling cancels.
+ */
+Complex logCharacteristic(Complex u, double tau, const Parameters& p,
+                          ComplexGradient* gradient) {
+    const Complex i(0.0, 1.0);
+    const double v0 = p.initial_variance;
+    const double kappa = p.mean_reversion;
+    const double theta = p.long_run_variance;
+    const double sigma = p.vol_of_vol;
+    const double rho = p.correlation;
+
+    const Complex iu = i * u;
+    const Complex uu = u * u + iu;
+    const Complex xi = kappa - sigma * rho * iu;
+    const Complex d = std::sqrt(xi * xi + sigma * sigma * uu);
+    const Complex e = std::exp(-d * tau);
+    const Complex ch = 0.5 * (1.0 + e);
+    const Complex sh = 0.5 * (1.0 - e);
+
+    const Complex A1 = uu * sh;
+    const Complex A2 = (d * ch + xi * sh) / v0;
+    const Complex A = A1 / A2;
+    const Complex D = std::log(d / v0) + 0.5 * (kappa - d) * tau -
+                      std::log((d + xi) / (2.0 * v0) + (d - xi) / (2.0 * v0) * e);
+
+    const double sigma2 = sigma * sigma;
+    const Complex log_phi = -kappa * theta * rho * tau * iu / sigma - A +
+                            (2.0 * kappa * theta / sigma2) * D;
+
+    if (gradient) {
+        // Chain rule through xi and d for kappa, sigma and rho
+        auto partials = [&](Complex xi_x, Complex d2_x, double kappa_x,
+                            Complex& A_x, Complex& D_x) {
+            const Complex d_x = d2_x / (2.0 * d);
+            const Complex A1_x = uu * ch * (0.5 * tau) * d_x;
+            const Complex A2_x = (d_x * ch + d * sh * (0.5 * tau) * d_x +
+                                  xi_x * sh + xi * ch * (0.5 * tau) * d_x) / v0;
+            A_x = A1_x / A2 - A * A2_x / A2;
+            D_x = d_x / d - A2_x / A2 + 0.5 * kappa_x * tau;
+        };
+
+        Complex A_kappa, D_kappa, A_sigma, D_sigma, A_rho, D_rho;
+
+        partials(1.0, 2.0 * xi, 1.0, A_kappa, D_kappa);
+
+        const Complex xi_sigma = -rho * iu;
+        partials(xi_sigma, 2.0 * xi * xi_sigma + 2.0 * sigma * uu, 0.0, A_sigma, D_sigma);
+
+        const Complex xi_rho = -sigma * iu;
+        partials(xi_rho, 2.0 * xi * xi_rho, 0.0, A_rho, D_rho);
+
+        ComplexGradient& h = *gradient;
+        h[0] = -A / v0;
+        h[1] = -A_kappa + (2.0 * theta / sigma2) * D +
+               (2.0 * kappa * theta / sigma2) * D_kappa -
+               theta * rho * tau * iu / sigma;
+        h[2] = (2.0 * kappa / sigma2) * D - kappa * rho * tau * iu / sigma;
+        h[3] = -A_sigma - (4.0 * kappa * theta / (sigma2 * sigma)) * D +
+               (2.0 * kappa * theta / sigma2) * D_sigma +
+               kappa * theta * rho * tau * iu / sigma2;
+        h[4] = -A_rho + (2.0 * kappa * theta / sigma2) * D_rho -
+               kappa * theta * tau * iu / sigma;
+    }
+
+    return log_phi;
+}
+
+double characteristicModulus(double u, double tau, const Parameters& p) {
+    return std::max(std::abs(std::exp(logCharacteristic(Complex(u, -1.0), tau, p, nullptr))),
+                    std::abs(std::exp(logCharacteristic(Complex(u, 0.0), tau, p, nullptr))));
+}
+
+// Rule for one expiry; log_moneyness is the largest |log(F/K)| it must price
+void buildQuadrature(double tau, const Parameters& p, double log_moneyness, Quadrature& q) {
+    // Near zero the characteristic function is close to a Gaussian in the
+    // mean variance over the option's life
+    const double kt = p.mean_reversion * tau;
+    const double mean_variance = p.long_run_variance +
+        (p.initial_variance - p.long_run_variance) * (kt > 1e-8 ? (1.0 - std::exp(-kt)) / kt : 1.0);
+    const double gaussian_limit = std::min(
+        std::sqrt(-2.0 * std::log(kTailTolerance) / std::max(mean_variance * tau, 1e-12)),
+        kMaxIntegrationLimit);
+
+    // Further out it decays only exponentially, so widen until it has died out
+    double limit = gaussian_limit;
+    while (limit < kMaxIntegrationLimit && characteristicModulus(limit, tau, p) > kTailTolerance) {
+        limit = std::min(1.5 * limit, kMaxIntegrationLimit);
+    }
+
+    const double needed = std::max(limit / gaussian_limit, limit * log_moneyness / kPanelPhase);
+    const int panels = std::clamp(static_cast<int>(std::ceil(needed)), 1, kMaxPanels);
+
+    const StandardRule& rule = gaussLegendre();
+    const double half_width = 0.5 * limit / panels;
+    q.nodes.resize(static_cast<size_t>(panels) * kPanelNodes);
+    q.weights.resize(q.nodes.size());
+    for (int panel = 0; panel < panels; ++panel) {
+        const double centre = (2 * panel + 1) * half_width;
+        for (int j = 0; j < kPanelNodes; ++j) {
+            q.nodes[panel * kPanelNodes + j] = centre + half_width * rule.nodes[j];
+            q.weights[panel * kPanelNodes + j] = half_width * rule.weights[j];
+        }
+    }
+}
+
+/**
+ * Strike-independent integrand terms for one expiry. Every strike on the
+ * same expiry reuses them, which is what makes calibration cheap.
+ */
+struct SliceTerms {
+    double forward = 0.0;
+    double discount = 0.0;
+    Quadrature quadrature;
+    // w_j * F * phi0(u_j - i) / (i u_j) and w_j * phi0(u_j) / (i u_j)
+    std::vector<Complex> shifted;
+    std::vector<Complex> plain;
+    std::vector<ComplexGradient> shifted_gradient;
+    std::vector<ComplexGradient> plain_gradient;
+};
+
+void evaluateSlice(double S, double r, double tau, const Parameters& p, double log_moneyness,
+                   bool with_gradient, SliceTerms& out) {
+    const Complex i(0.0, 1.0);
+
+    out.forward = S * std::exp(r * tau);
+    out.discount = std::exp(-r * tau);
+    buildQuadrature(tau, p, log_moneyness, out.quadrature);
+    const Quadrature& q = out.quadrature;
+    const size_t nodes = q.nodes.size();
+    out.shifted.resize(nodes);
+    out.plain.resize(nodes);
+    if (with_gradient) {
+        out.shifted_gradient.resize(nodes);
+        out.plain_gradient.resize(nodes);
+    }
+
+    ComplexGradient h_shifted;
+    ComplexGradient h_plain;
+
+    for (size_t j = 0; j < nodes; ++j) {
+        const double u = q.nodes[j];
+        const Complex scale = q.weights[j] / (i * u);
+
+        const Complex phi_shifted = std::exp(logCharacteristic(
+            Complex(u, -1.0), tau, p, with_gradient ? &h_shifted : nullptr));
+        const Complex phi_plain = std::exp(logCharacteristic(
+            Complex(u, 0.0), tau, p, with_gradient ? &h_plain : nullptr));
+
+        out.shifted[j] = scale * out.forward * phi_shifted;
+        out.plain[j] = scale * phi_plain;
+
+        if (with_gradient) {
+            for (int k = 0; k < 5; ++k) {
+                out.shifted_gradient[j][k] = out.shifted[j] * h_shifted[k];
+                out.plain_gradient[j][k] = out.plain[j] * h_plain[k];
+            }
+        }
+    }
+}
+
+double sliceCallPrice(const SliceTerms& slice, double S, double K, Gradient* gradient) {
+    const std::vector<double>& nodes = slice.quadrature.nodes;
+    const double x = std::log(slice.forward / K);
+    double integral = 0.0;
+    Gradient grad_integral{};
+
+    for (size_t j = 0; j < nodes.size(); ++j) {
+        const Complex phase = std::polar(1.0, nodes[j] * x);
+        integral += std::real(phase * (slice.shifted[j] - K * slice.plain[j]));
+        if (gradient) {
+            for (int k = 0; k < 5; ++k) {
+                grad_integral[k] += std::real(
+                    phase * (slice.shifted_gradient[j][k] - K * slice.plain_gradient[j][k]));
+            }
+        }
+    }
+
+    const double factor = slice.discount / M_PI;
+    if (gradient) {
+        for (int k = 0; k < 5; ++k) {
+            (*gradient)[k] = factor * grad_integral[k];
+        }
+    }
+
+    return 0.5 * (S - K * slice.discount) + factor * integral;
+}
+
+void validateInputs(double S, double K, double r, double T) {
+    if (S <= 0.0 || K <= 0.0) {
+        throw std::invalid_argument("Stock price and strike must be positive");
+    }
+    if (T < 0.0) {
+        throw std::invalid_argument("Time to expiry cannot be negative");
+    }
+    if (std::isnan(r) || std::isinf(r)) {
+        throw std::invalid_argument("Invalid risk-free rate");
+    }
+}
+
+// Box constraints applied after every Levenberg-Marquardt step
+Parameters project(const Parameters& p) {
+    Parameters out;
+    out.initial_variance = std::clamp(p.initial_variance, 1e-4, 4.0);
+    out.mean_reversion = std::clamp(p.mean_reversion, 1e-3, 20.0);
+    out.long_run_variance = std::clamp(p.long_run_variance, 1e-4, 4.0);
+    out.vol_of_vol = std::clamp(p.vol_of_vol, 1e-3, 5.0);
+    out.correlation = std::clamp(p.correlation, -0.999, 0.999);
+    return out;
+}
+
+Parameters applyStep(const Parameters& p, const Gradient& step) {
+    Parameters out = p;
+    out.initial_variance += step[0];
+    out.mean_reversion += step[1];
+    out.long_run_variance += step[2];
+    out.vol_of_vol += step[3];
+    out.correlation += step[4];
+    return project(out);
+}
+
+// Solves the 5x5 system by Gaussian elimination with partial pivoting
+bool solveNormalEquations(std::array<std::array<double, 5>, 5> a, Gradient b, Gradient& x) {
+    for (int col = 0; col < 5; ++col) {
+        int pivot = col;
+        for (int row = col + 1; row < 5; ++row) {
+            if (std::abs(a[row][col]) > std::abs(a[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (std::abs(a[pivot][col]) < 1e-300) {
+            return false;
+        }
+        std::swap(a[col], a[pivot]);
+        std::swap(b[col], b[pivot]);
+
+        for (int row = col + 1; row < 5; ++row) {
+            const double factor = a[row][col] / a[col][col];
+            for (int k = col; k < 5; ++k) {
+                a[row][k] -= factor * a[col][k];
+            }
+            b[row] -= factor * b[col];
+        }
+    }
+
+    for (int row = 4; row >= 0; --row) {
+        double sum = b[row];
+        for (int k = row + 1; k < 5; ++k) {
+            sum -= a[row][k] * x[k];
+        }
+        x[row] = sum / a[row][row];
+    }
+    return true;
+}
+
+struct CalibrationQuote {
+    double strike;
+    double market_price;
+    double weight;
+};
+
+struct CalibrationSlice {
+    double expiry;
+    size_t first_quote;
+    size_t last_quote;
+    double log_moneyness;  // largest |log(F/K)| on the slice
+};
+
+class CalibrationProblem {
+public:
+    CalibrationProblem(const std::vector<VolatilitySurface::VolPoint>& points,
+                       double S, double r, unsigned int num_threads)
+        : spot_(S), rate_(r), num_threads_(num_threads) {
+        std::vector<VolatilitySurface::VolPoint> sorted = points;
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const VolatilitySurface::VolPoint& a, const VolatilitySurface::VolPoint& b) {
+                      return a.expiry < b.expiry;
+                  });
+
+        quotes_.reserve(sorted.size());
+        for (const auto& point : sorted) {
+            if (slices_.empty() || std::abs(point.expiry - slices_.back().expiry) > 1e-10) {
+                slices_.push_back({point.expiry, quotes_.size(), quotes_.size(), 0.0});
+            }
+
+            CalibrationQuote quote;
+            quote.strike = point.strike;
+            quote.market_price = BlackScholes::callPrice(
+                S, point.strike, r, point.expiry, point.implied_vol);
+            const double vega = BlackScholes::vega(
+                S, point.strike, r, point.expiry, point.implied_vol);
+            quote.weight = 1.0 / std::max(vega, 1e-4 * S);
+
+            quotes_.push_back(quote);
+            slices_.back().last_quote = quotes_.size();
+            slices_.back().log_moneyness = std::max(
+                slices_.back().log_moneyness,
+                std::abs(std::log(S * std::exp(r * point.expiry) / point.strike)));
+        }
+    }
+
+    size_t size() const { return quotes_.size(); }
+
+    // Fills residuals and Jacobian rows; returns half the sum of squares
+    double evaluate(const Parameters& p, std::vector<double>& residuals,
+                    std::vector<Gradient>& jacobian) const {
+        residuals.resize(quotes_.size());
+        jacobian.resize(quotes_.size());
+
+        // One LM evaluation is short, so slices go to the shared pool
+        Parallel::parallelFor(static_cast<int>(slices_.size()), 1, [&](int start, int end) {
+            SliceTerms terms;
+            for (int s = start; s < end; ++s) {
+                const CalibrationSlice& slice = slices_[s];
+                evaluateSlice(spot_, rate_, slice.expiry, p, slice.log_moneyness, true, terms);
+
+                for (size_t q = slice.first_quote; q < slice.last_quote; ++q) {
+                    const CalibrationQuote& quote = quotes_[q];
+                    Gradient gradient;
+                    const double model_price = sliceCallPrice(terms, spot_, quote.strike, &gradient);
+
+                    residuals[q] = quote.weight * (model_price - quote.market_price);
+                    for (int k = 0; k < 5; ++k) {
+                        jacobian[q][k] = quote.weight * gradient[k];
+                    }
+                }
+            }
+        }, num_threads_);
+
+        double cost = 0.0;
+        for (double res : residuals) {
+            cost += res * res;
+        }
+        return 0.5 * cost;
+    }
+
+private:
+    double spot_;
+    double rate_;
+    unsigned int num_threads_;  // 0 = hardware concurrency
+    std::vector<CalibrationQuote> quotes_;
+    std::vector<CalibrationSlice> slices_;
+};
+
+}
+
+void Parameters::validate() const {
+    if (initial_variance < 0.0 || long_run_variance < 0.0) {
+        throw std::invalid_argument("Heston variances cannot be negative");
+    }
+    if (mean_reversion <= 0.0) {
+        throw std::invalid_argument("Heston mean reversion must be positive");
+    }
+    if (vol_of_vol <= 0.0) {
+        throw std::invalid_argument("Heston vol of vol must be positive");
+    }
+    if (correlation <= -1.0 || correlation >= 1.0) {
+        throw std::invalid_argument("Heston correlation must be in (-1, 1)");
+    }
+    if (std::isnan(initial_variance) || std::isnan(mean_reversion) ||
+        std::isnan(long_run_variance) || std::isnan(vol_of_vol) ||
+        std::isnan(correlation)) {
+        throw std::invalid_argument("Invalid Heston parameters");
+    }
+}
+
+double callPriceWithGradient(double S, double K, double r, double T,
+                             const Parameters& params, Gradient& gradient) {
+    validateInputs(S, K, r, T);
+    params.validate();
+
+    if (T == 0.0) {
+        gradient.fill(0.0);
+        return std::max(0.0, S - K);
+    }
+
+    // Guard the 1/v0 terms of the characteristic function
+    Parameters p = params;
+    p.initial_variance = std::max(p.initial_variance, 1e-12);
+
+    SliceTerms terms;
+    evaluateSlice(S, r, T, p, std::abs(std::log(S * std::exp(r * T) / K)), true, terms);
+
+    const double price = sliceCallPrice(terms, S, K, &gradient);
+    const double lower_bound = std::max(0.0, S - K * terms.discount);
+    if (price < lower_bound) {
+        // The bound does not move with the parameters
+        gradient.fill(0.0);
+        return lower_bound;
+    }
+    return price;
+}
+
+double callPrice(double S, double K, double r, double T, const Parameters& params) {
+    validateInputs(S, K, r, T);
+    params.validate();
+
+    if (T == 0.0) {
+        return std::max(0.0, S - K);
+    }
+
+    Parameters p = params;
+    p.initial_variance = std::max(p.initial_variance, 1e-12);
+
+    // Reused across calls on this thread so pricing does not reallocate
+    thread_local SliceTerms terms;
+    evaluateSlice(S, r, T, p, std::abs(std::log(S * std::exp(r * T) / K)), false, terms);
+    const double price = sliceCallPrice(terms, S, K, nullptr);
+
+    if (std::isnan(price) || std::isinf(price)) {
+        throw std::runtime_error("Invalid Heston price");
+    }
+
+    return std::max(price, std::max(0.0, S - K * terms.discount));
+}
+
+double putPrice(double S, double K, double r, double T, const Parameters& params) {
+    const double call = callPrice(S, K, r, T, params);
+    const double put = call - S + K * std::exp(-r * T);
+    return std::max(put, std::max(0.0, K * std::exp(-r * T) - S));
+}
+
+double optionPrice(double S, double K, double r, double T,
+                   OptionType type, const Parameters& params) {
+    if (type == OptionType::Call) {
+        return callPrice(S, K, r, T, params);
+    } else {
+        return putPrice(S, K, r, T, params);
+    }
+}
+
+CalibrationResult calibrate(
+    const VolatilitySurface::ImpliedVolSurface& surface,
+    double S, double r,
+    const Parameters& initial_guess,
+    const CalibrationOptions& options
+) {
+    if (S <= 0.0) {
+        throw std::invalid_argument("Spot price must be positive");
+    }
+    if (surface.size() < 5) {
+        throw std::invalid_argument("Heston calibration needs at least five quotes");
+    }
+    if (options.max_iterations < 1) {
+        throw std::invalid_argument("Calibration needs at least one iteration");
+    }
+    initial_guess.validate();
+
+    const CalibrationProblem problem(surface.getPoints(), S, r, options.num_threads);
+
+    CalibrationResult result;
+    result.parameters = project(initial_guess);
+
+    std::vector<double> residuals;
+    std::vector<Gradient> jacobian;
+    double cost = problem.evaluate(result.parameters, residuals, jacobian);
+
+    std::vector<double> trial_residuals;
+    std::vector<Gradient> trial_jacobian;
+    double lambda = 1e-3;  // Marquardt damping, relative to diag(J^T J)
+
+    for (int iter = 0; iter < options.max_iterations; ++iter) {
+        result.iterations = iter + 1;
+
+        std::array<std::array<double, 5>, 5> jtj{};
+        Gradient jtr{};
+        for (size_t q = 0; q < residuals.size(); ++q) {
+            for (int a = 0; a < 5; ++a) {
+                jtr[a] += jacobian[q][a] * residuals[q];
+                for (int b = 0; b <= a; ++b) {
+                    jtj[a][b] += jacobian[q][a] * jacobian[q][b];
+                }
+            }
+        }
+        for (int a = 0; a < 5; ++a) {
+            for (int b = a + 1; b < 5; ++b) {
+                jtj[a][b] = jtj[b][a];
+            }
+        }
+
+        bool accepted = false;
+        while (!accepted && lambda < 1e12) {
+            auto damped = jtj;
+            Gradient rhs;
+            for (int a = 0; a < 5; ++a) {
+                damped[a][a] += lambda * std::max(jtj[a][a], 1e-12);
+                rhs[a] = -jtr[a];
+            }
+
+            Gradient step{};
+            if (!solveNormalEquations(damped, rhs, step)) {
+                lambda *= 4.0;
+                continue;
+            }
+
+            const Parameters trial = applyStep(result.parameters, step);
+            const double trial_cost = problem.evaluate(trial, trial_residuals, trial_jacobian);
+
+            if (trial_cost < cost) {
+                const double improvement = cost - trial_cost;
+                result.parameters = trial;
+                residuals.swap(trial_residuals);
+                jacobian.swap(trial_jacobian);
+                cost = trial_cost;
+                lambda = std::max(lambda / 3.0, 1e-12);
+                accepted = true;
+
+                if (improvement <= options.tolerance * std::max(cost, 1e-300)) {
+                    result.converged = true;
+                }
+            } else {
+                lambda *= 4.0;
+            }
+        }
+
+        if (!accepted) {
+            // No descent direction left: we are at a (possibly constrained) minimum
+            result.converged = true;
+        }
+        if (result.converged) {
+            break;
+        }
+    }
+
+    result.rmse = std::sqrt(2.0 * cost / static_cast<double>(problem.size()));
+    return result;
+}
+
+}
@@ -17,7 +17,34 @@ void ImpliedVolSurface::addPoint(double strike, double expiry, double implied_vo
         throw std::invalid_argument("Implied volatility out of reasonable range");
     }
     
-    points_.push_back({strike, expiry, implied_vol});
+    auto slice_it = std::lower_bound(
+        slices_.begin(), slices_.end(), expiry,
+        [](const ExpirySlice& slice, double t) { return slice.expiry < t; });
+    
+    if (slice_it == slices_.end() || slice_it->expiry != expiry) {
+        slice_it = slices_.insert(slice_it, ExpirySlice{expiry, {}, {}});
+    }
+    
+    const double log_strike = std::log(strike);
+    const double total_variance = implied_vol * implied_vol * expiry;
+    
+    auto& log_strikes = slice_it->log_strikes;
+    auto strike_it = std::lower_bound(log_strikes.begin(), log_strikes.end(), log_strike);
+    const size_t pos = static_cast<size_t>(strike_it - log_strikes.begin());
+    
+    if (strike_it != log_strikes.end() && *strike_it == log_strike) {
+        // Re-quoted strike: the latest quote replaces the old one, so the
+        // points handed to calibrators match the grid
+        slice_it->total_variance[pos] = total_variance;
+        auto point_it = std::find_if(points_.begin(), points_.end(), [&](const VolPoint& p) {
+            return p.expiry == expiry && std::log(p.strike) == log_strike;
+        });
+        *point_it = {strike, expiry, implied_vol};
+    } else {
+        log_strikes.insert(strike_it, log_strike);
+        slice_it->total_variance.insert(slice_it->total_variance.begin() + pos, total_variance);
+        points_.push_back({strike, expiry, implied_vol});
+    }
 }
 
 bool ImpliedVolSurface::hasData() const {
@@ -28,39 +55,114 @@ size_t ImpliedVolSurface::size() const {
     return points_.size();
 }
 
+size_t ImpliedVolSurface::expiryCount() const {
+    return slices_.size();
+}
+
 void ImpliedVolSurface::clear() {
     points_.clear();
+    slices_.clear();
 }
 
 std::vector<VolPoint> ImpliedVolSurface::getPoints() const {
     return points_;
 }
 
+void ImpliedVolSurface::setForwardRate(double rate) {
+    if (std::isnan(rate) || std::isinf(rate)) {
+        throw std::invalid_argument("Invalid forward rate");
+    }
+    forward_rate_ = rate;
+}
+
+double ImpliedVolSurface::getForwardRate() const {
+    return forward_rate_;
+}
+
+double ImpliedVolSurface::sliceTotalVariance(const ExpirySlice& slice, double log_strike) const {
+    const auto& x = slice.log_strikes;
+    const auto& w = slice.total_variance;
+    
+    if (log_strike <= x.front()) {
+        return w.front();
+    }
+    if (log_strike >= x.back()) {
+        return w.back();
+    }
+    
+    const size_t hi = static_cast<size_t>(
+        std::upper_bound(x.begin(), x.end(), log_strike) - x.begin());
+    const size_t lo = hi - 1;
+    const double weight = (log_strike - x[lo]) / (x[hi] - x[lo]);
+    
+    return w[lo] + weight * (w[hi] - w[lo]);
+}
+
 double ImpliedVolSurface::interpolate(double strike, double expiry) const {
-    if (points_.empty()) {
+    if (slices_.empty()) {
         throw std::runtime_error("No volatility data available");
     }
+    if (strike <= 0.0) {
+        throw std::invalid_argument("Strike must be positive");
+    }
+    if (expiry <= 0.0) {
+        throw std::invalid_argument("Expiry must be positive");
+    }
+    
+    // Constant log-moneyness log(K / F(T)) maps to log-strike
+    // log(K) + rate * (T_slice - T) on each slice
+    const double log_strike = std::log(strike);
+    auto slice_log_strike = [&](const ExpirySlice& slice) {
+        return log_strike + forward_rate_ * (slice.expiry - expiry);
+    };
+    
+    auto upper = std::lower_bound(
+        slices_.begin(), slices_.end(), expiry,
+        [](const ExpirySlice& slice, double t) { return slice.expiry < t; });
+    
+    if (upper == slices_.begin()) {
+        const double w = sliceTotalVariance(*upper, slice_log_strike(*upper));
+        return std::sqrt(std::max(0.0, w) / upper->expiry);
+    }
+    if (upper == slices_.end()) {
+        const ExpirySlice& last = slices_.back();
+        const double w = sliceTotalVariance(last, slice_log_strike(last));
+        return std::sqrt(std::max(0.0, w) / last.expiry);
+    }
+    
+    const ExpirySlice& hi = *upper;
+    const ExpirySlice& lo = *(upper - 1);
+    const double w_hi = sliceTotalVariance(hi, slice_log_strike(hi));
     
-    if (points_.size() == 1) {
-        return points_[0].implied_vol;
+    if (hi.expiry == expiry) {
+        return std::sqrt(std::max(0.0, w_hi) / expiry);
     }
     
-    double min_dist = std::numeric_limits<double>::max();
-    double nearest_vol = points_[0].implied_vol;
+    const double w_lo = sliceTotalVariance(lo, slice_log_strike(lo));
+    const double weight = (expiry - lo.expiry) / (hi.expiry - lo.expiry);
+    const double w = w_lo + weight * (w_hi - w_lo);
     
-    for (const auto& point : points_) {
-        const double dist = std::sqrt(
-            std::pow(strike - point.strike, 2) + 
-            std::pow(expiry - point.expiry, 2)
-        );
-        
-        if (dist < min_dist) {
-            min_dist = dist;
-            nearest_vol = point.implied_vol;
-        }
+    return std::sqrt(std::max(0.0, w) / expiry);
+}
+
+void ImpliedVolSurface::interpolate(const double* strikes, const double* expiries,
+                                    double* vols, size_t count) const {
+    for (size_t i = 0; i < count; ++i) {
+        vols[i] = interpolate(strikes[i], expiries[i]);
+    }
+}
+
+std::vector<double> ImpliedVolSurface::interpolate(
+    const std::vector<double>& strikes,
+    const std::vector<double>& expiries
+) const {
+    if (strikes.size() != expiries.size()) {
+        throw std::invalid_argument("Strike and expiry arrays must have the same length");
     }
     
-    return nearest_vol;
+    std::vector<double> vols(strikes.size());
+    interpolate(strikes.data(), expiries.data(), vols.data(), vols.size());
+    return vols;
 }
 
 double calculateSkew(const std::vector<VolPoint>& points, double expiry) {
@@ -123,4 +225,4 @@ double calculateTermStructure(const std::vector<VolPoint>& points, double strike
     return (long_term_vol - short_term_vol) / time_range;
 }
 
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include "Instrument.h"
 #include "BinomialTree.h"
 #include "BlackScholes.h"
+#include "Heston.h"
 #include "JumpDiffusion.h"
+#include "Profiling.h"
 #include <algorithm>
 #include <cmath>
 #include <limits>
@@ -12,7 +14,9 @@ EuropeanOption::EuropeanOption(OptionType type, double strike,
     : option_type_(type), strike_price_(strike),
       time_to_expiry_years_(time_to_expiry), underlying_asset_id_(asset_id),
       pricing_model_(PricingModel::BlackScholes), binomial_steps_(100),
-      jump_intensity_(0.0), jump_mean_(0.0), jump_volatility_(0.0) {
+      jump_intensity_(0.0), jump_mean_(0.0), jump_volatility_(0.0),
+      heston_v0_(0.04), heston_kappa_(1.5), heston_theta_(0.04),
+      heston_sigma_(0.5), heston_rho_(-0.5) {
   validateParameters();
 }
 
@@ -22,7 +26,9 @@ EuropeanOption::EuropeanOption(OptionType type, double strike,
     : option_type_(type), strike_price_(strike),
       time_to_expiry_years_(time_to_expiry), underlying_asset_id_(asset_id),
       pricing_model_(model), binomial_steps_(100), jump_intensity_(0.0),
-      jump_mean_(0.0), jump_volatility_(0.0) {
+      jump_mean_(0.0), jump_volatility_(0.0), heston_v0_(0.04),
+      heston_kappa_(1.5), heston_theta_(0.04), heston_sigma_(0.5),
+      heston_rho_(-0.5) {
   validateParameters();
 }
 
@@ -71,6 +77,12 @@ bool EuropeanOption::isValid() const {
   }
 }
 
+std::unique_ptr<Instrument> EuropeanOption::aged(double years) const {
+  auto copy = std::make_unique<EuropeanOption>(*this);
+  copy->time_to_expiry_years_ = std::max(0.0, time_to_expiry_years_ - years);
+  return copy;
+}
+
 std::string EuropeanOption::getInstrumentType() const {
   return "EuropeanOption";
 }
@@ -104,6 +116,19 @@ void EuropeanOption::setJumpParameters(double lambda, double jump_mean,
 }
 
 double EuropeanOption::getJumpIntensity() const { return jump_intensity_; }
+double EuropeanOption::getJumpMean() const { return jump_mean_; }
+double EuropeanOption::getJumpVolatility() const { return jump_volatility_; }
+
+void EuropeanOption::setHestonParameters(double v0, double kappa, double theta,
+                                         double sigma, double rho) {
+  Heston::Parameters params{v0, kappa, theta, sigma, rho};
+  params.validate();
+  heston_v0_ = v0;
+  heston_kappa_ = kappa;
+  heston_theta_ = theta;
+  heston_sigma_ = sigma;
+  heston_rho_ = rho;
+}
 
 OptionType EuropeanOption::getOptionType() const { return option_type_; }
 
@@ -111,45 +136,94 @@ double EuropeanOption::getStrike() const { return strike_price_; }
 
 double EuropeanOption::getTimeToExpiry() const { return time_to_expiry_years_; }
 
-double EuropeanOption::priceBlackScholes(const MarketData &md) const {
+double EuropeanOption::priceBlackScholes(const MarketData &md,
+                                         double time_to_expiry) const {
   if (option_type_ == OptionType::Call) {
     return BlackScholes::callPrice(md.spot_price, strike_price_,
-                                   md.risk_free_rate, time_to_expiry_years_,
+                                   md.risk_free_rate, time_to_expiry,
                                    md.volatility);
   } else {
     return BlackScholes::putPrice(md.spot_price, strike_price_,
-                                  md.risk_free_rate, time_to_expiry_years_,
+                                  md.risk_free_rate, time_to_expiry,
                                   md.volatility);
   }
 }
 
-double EuropeanOption::priceBinomial(const MarketData &md) const {
+double EuropeanOption::priceBinomial(const MarketData &md,
+                                     double time_to_expiry) const {
   return BinomialTree::europeanOptionPrice(
-      md.spot_price, strike_price_, md.risk_free_rate, time_to_expiry_years_,
+      md.spot_price, strike_price_, md.risk_free_rate, time_to_expiry,
       md.volatility, option_type_, binomial_steps_);
 }
 
-double EuropeanOption::priceJumpDiffusion(const MarketData &md) const {
+double EuropeanOption::priceJumpDiffusion(const MarketData &md,
+                                          double time_to_expiry) const {
   return JumpDiffusion::mertonOptionPrice(
-      md.spot_price, strike_price_, md.risk_free_rate, time_to_expiry_years_,
+      md.spot_price, strike_price_, md.risk_free_rate, time_to_expiry,
       md.volatility, option_type_, jump_intensity_, jump_mean_,
       jump_volatility_);
 }
 
+double EuropeanOption::priceHeston(const MarketData &md,
+                                   double time_to_expiry) const {
+  // Variance dynamics come from the Heston parameters; md.volatility is unused
+  Heston::Parameters params{heston_v0_, heston_kappa_, heston_theta_,
+                            heston_sigma_, heston_rho_};
+  return Heston::optionPrice(md.spot_price, strike_price_, md.risk_free_rate,
+                             time_to_expiry, option_type_, params);
+}
+
+double EuropeanOption::vegaHeston(const MarketData &md) const {
+  // md.volatility does not enter the Heston price, so the bump is applied to
+  // the initial volatility sqrt(v0) instead
+  const double bump = 0.01;
+  const double vol = std::sqrt(heston_v0_);
+  const double vol_up = vol + bump;
+  const double vol_down = std::max(0.0, vol - bump);
+
+  Heston::Parameters up{vol_up * vol_up, heston_kappa_, heston_theta_,
+                        heston_sigma_, heston_rho_};
+  Heston::Parameters down{vol_down * vol_down, heston_kappa_, heston_theta_,
+                          heston_sigma_, heston_rho_};
+  const double price_up =
+      Heston::optionPrice(md.spot_price, strike_price_, md.risk_free_rate,
+                          time_to_expiry_years_, option_type_, up);
+  const double price_down =
+      Heston::optionPrice(md.spot_price, strike_price_, md.risk_free_rate,
+                          time_to_expiry_years_, option_type_, down);
+
+  return (price_up - price_down) / (vol_up - vol_down);
+}
+
 double EuropeanOption::price(const MarketData &md) const {
   validateMarketData(md);
+  return priceAt(md, time_to_expiry_years_);
+}
+
+double EuropeanOption::priceAt(const MarketData &md,
+                               double time_to_expiry) const {
+  QE_PROFILE_COUNT(Profiling::Counter::Pricings, 1);
+  // Expired: settles at intrinsic whatever the model
+  if (time_to_expiry <= 0.0) {
+    return option_type_ == OptionType::Call
+               ? std::max(0.0, md.spot_price - strike_price_)
+               : std::max(0.0, strike_price_ - md.spot_price);
+  }
 
   double result = 0.0;
 
   switch (pricing_model_) {
   case PricingModel::BlackScholes:
-    result = priceBlackScholes(md);
+    result = priceBlackScholes(md, time_to_expiry);
     break;
   case PricingModel::Binomial:
-    result = priceBinomial(md);
+    result = priceBinomial(md, time_to_expiry);
     break;
   case PricingModel::MertonJumpDiffusion:
-    result = priceJumpDiffusion(md);
+    result = priceJumpDiffusion(md, time_to_expiry);
+    break;
+  case PricingModel::Heston:
+    result = priceHeston(md, time_to_expiry);
     break;
   default:
     throw std::runtime_error("Unknown pricing model");
@@ -244,6 +318,8 @@ double EuropeanOption::vega(const MarketData &md) const {
   if (pricing_model_ == PricingModel::BlackScholes) {
     result = BlackScholes::vega(md.spot_price, strike_price_, md.risk_free_rate,
                                 time_to_expiry_years_, md.volatility);
+  } else if (pricing_model_ == PricingModel::Heston) {
+    result = vegaHeston(md);
   } else {
     const double bump = 0.01;
 
@@ -288,11 +364,8 @@ double EuropeanOption::theta(const MarketData &md) const {
     }
 
     double current_price = price(md);
-
-    EuropeanOption temp_option = *this;
-    temp_option.time_to_expiry_years_ =
-        std::max(0.0, time_to_expiry_years_ - bump);
-    double future_price = temp_option.price(md);
+    double future_price =
+        priceAt(md, std::max(0.0, time_to_expiry_years_ - bump));
 
     result = (future_price - current_price) / bump;
   }
@@ -348,6 +421,12 @@ bool AmericanOption::isValid() const {
   }
 }
 
+std::unique_ptr<Instrument> AmericanOption::aged(double years) const {
+  auto copy = std::make_unique<AmericanOption>(*this);
+  copy->time_to_expiry_years_ = std::max(0.0, time_to_expiry_years_ - years);
+  return copy;
+}
+
 std::string AmericanOption::getInstrumentType() const {
   return "AmericanOption";
 }
@@ -361,6 +440,12 @@ void AmericanOption::setBinomialSteps(int steps) {
 
 int AmericanOption::getBinomialSteps() const { return binomial_steps_; }
 
+OptionType AmericanOption::getOptionType() const { return option_type_; }
+
+double AmericanOption::getStrike() const { return strike_price_; }
+
+double AmericanOption::getTimeToExpiry() const { return time_to_expiry_years_; }
+
 double AmericanOption::calculateIntrinsicValue(double spot_price) const {
   if (option_type_ == OptionType::Call) {
     return std::max(0.0, spot_price - strike_price_);
@@ -371,9 +456,18 @@ double AmericanOption::calculateIntrinsicValue(double spot_price) const {
 
 double AmericanOption::price(const MarketData &md) const {
   validateMarketData(md);
+  return priceAt(md, time_to_expiry_years_);
+}
+
+double AmericanOption::priceAt(const MarketData &md,
+                               double time_to_expiry) const {
+  QE_PROFILE_COUNT(Profiling::Counter::Pricings, 1);
+  if (time_to_expiry <= 0.0) {
+    return calculateIntrinsicValue(md.spot_price);
+  }
 
   double result = BinomialTree::americanOptionPrice(
-      md.spot_price, strike_price_, md.risk_free_rate, time_to_expiry_years_,
+      md.spot_price, strike_price_, md.risk_free_rate, time_to_expiry,
       md.volatility, option_type_, binomial_steps_);
 
   if (std::isnan(result) || std::isinf(result) || result < 0.0) {
@@ -459,11 +553,8 @@ double AmericanOption::theta(const MarketData &md) const {
   }
 
   double current_price = price(md);
-
-  AmericanOption temp_option = *this;
-  temp_option.time_to_expiry_years_ =
-      std::max(0.0, time_to_expiry_years_ - bump);
-  double future_price = temp_option.price(md);
+  double future_price =
+      priceAt(md, std::max(0.0, time_to_expiry_years_ - bump));
 
   double result = (future_price - current_price) / bump;
 
@@ -529,11 +620,38 @@ std::string BarrierOption::getAssetId() const {
     return underlying_asset_id_;
 }
 
+std::unique_ptr<Instrument> BarrierOption::aged(double years) const {
+    auto copy = std::make_unique<BarrierOption>(*this);
+    copy->time_to_expiry_years_ = std::max(0.0, time_to_expiry_years_ - years);
+    return copy;
+}
+
 std::string BarrierOption::getInstrumentType() const {
     return "BarrierOption";
 }
 
 double BarrierOption::price(const MarketData& md) const {
+    return priceAt(md, time_to_expiry_years_);
+}
+
+double BarrierOption::priceAt(const MarketData& md, double time_to_expiry) const {
+    QE_PROFILE_COUNT(Profiling::Counter::Pricings, 1);
+    if (time_to_expiry <= 0.0) {
+        // Only the settlement spot is known, so it decides the barrier
+        const bool breached = (barrier_type_ == BarrierType::DownIn ||
+                               barrier_type_ == BarrierType::DownOut)
+                                  ? md.spot_price <= barrier_level_
+                                  : md.spot_price >= barrier_level_;
+        const bool knock_in = barrier_type_ == BarrierType::DownIn ||
+                              barrier_type_ == BarrierType::UpIn;
+        if (breached != knock_in) {
+            return rebate_;
+        }
+        return option_type_ == OptionType::Call
+                   ? std::max(0.0, md.spot_price - strike_price_)
+                   : std::max(0.0, strike_price_ - md.spot_price);
+    }
+    
 #ifdef USE_QUANTLIB
     // Convert our barrier type to QuantLib barrier type
     QuantLibPricer::BarrierType ql_barrier_type;
@@ -557,7 +675,7 @@ double BarrierOption::price(const MarketData& md) const {
         strike_price_,
         barrier_level_,
         md.risk_free_rate,
-        time_to_expiry_years_,
+        time_to_expiry,
         md.volatility,
         option_type_,
         ql_barrier_type,
@@ -615,10 +733,7 @@ double BarrierOption::theta(const MarketData& md) const {
     }
     
     double current_price = price(md);
-    
-    BarrierOption temp_option = *this;
-    temp_option.time_to_expiry_years_ = std::max(0.0, time_to_expiry_years_ - bump);
-    double future_price = temp_option.price(md);
+    double future_price = priceAt(md, std::max(0.0, time_to_expiry_years_ - bump));
     
     return (future_price - current_price) / bump;
 }
@@ -634,7 +749,7 @@ AsianOption::AsianOption(
     std::string asset_id,
     AverageType average_type,
     int num_fixings,
-    double running_sum,
+    double running_accumulator,
     int past_fixings
 ) : option_type_(option_type),
     strike_price_(strike),
@@ -642,7 +757,7 @@ AsianOption::AsianOption(
     underlying_asset_id_(asset_id),
     average_type_(average_type),
     num_fixings_(num_fixings),
-    running_sum_(running_sum),
+    running_accumulator_(running_accumulator),
     past_fixings_(past_fixings) {
     validateParameters();
 }
@@ -663,6 +778,10 @@ void AsianOption::validateParameters() const {
     if (past_fixings_ < 0 || past_fixings_ > num_fixings_) {
         throw std::invalid_argument("Invalid number of past fixings");
     }
+    if (average_type_ == AverageType::Geometric && past_fixings_ > 0 &&
+        !(running_accumulator_ > 0.0)) {
+        throw std::invalid_argument("Geometric running product must be positive");
+    }
 }
 
 bool AsianOption::isValid() const {
@@ -678,11 +797,37 @@ std::string AsianOption::getAssetId() const {
     return underlying_asset_id_;
 }
 
+std::unique_ptr<Instrument> AsianOption::aged(double years) const {
+    auto copy = std::make_unique<AsianOption>(*this);
+    copy->time_to_expiry_years_ = std::max(0.0, time_to_expiry_years_ - years);
+    return copy;
+}
+
 std::string AsianOption::getInstrumentType() const {
     return "AsianOption";
 }
 
 double AsianOption::price(const MarketData& md) const {
+    return priceAt(md, time_to_expiry_years_);
+}
+
+double AsianOption::priceAt(const MarketData& md, double time_to_expiry) const {
+    QE_PROFILE_COUNT(Profiling::Counter::Pricings, 1);
+    if (time_to_expiry <= 0.0) {
+        // Fixings still outstanding are all taken at the settlement spot
+        const int outstanding = num_fixings_ - past_fixings_;
+        double average;
+        if (average_type_ == AverageType::Geometric) {
+            const double past_log = past_fixings_ > 0 ? std::log(running_accumulator_) : 0.0;
+            average = std::exp((past_log + outstanding * std::log(md.spot_price)) / num_fixings_);
+        } else {
+            average = (running_accumulator_ + outstanding * md.spot_price) / num_fixings_;
+        }
+        return option_type_ == OptionType::Call
+                   ? std::max(0.0, average - strike_price_)
+                   : std::max(0.0, strike_price_ - average);
+    }
+    
 #ifdef USE_QUANTLIB
     // Convert our average type to QuantLib average type
     QuantLibPricer::AverageType ql_average_type = 
@@ -694,12 +839,13 @@ double AsianOption::price(const MarketData& md) const {
         md.spot_price,
         strike_price_,
         md.risk_free_rate,
-        time_to_expiry_years_,
+        time_to_expiry,
         md.volatility,
         option_type_,
         ql_average_type,
         num_fixings_,
-        running_sum_,
+        // An empty product is one, not the zero an empty sum defaults to
+        (average_type_ == AverageType::Geometric && past_fixings_ == 0) ? 1.0 : running_accumulator_,
         past_fixings_
     );
 #else
@@ -754,10 +900,7 @@ double AsianOption::theta(const MarketData& md) const {
     }
     
     double current_price = price(md);
-    
-    AsianOption temp_option = *this;
-    temp_option.time_to_expiry_years_ = std::max(0.0, time_to_expiry_years_ - bump);
-    double future_price = temp_option.price(md);
+    double future_price = priceAt(md, std::max(0.0, time_to_expiry_years_ - bump));
     
     return (future_price - current_price) / bump;
-}
\ No newline at end of file
+}
\ No newline at end of file
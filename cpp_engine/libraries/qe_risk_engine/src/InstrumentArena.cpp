@@ -0,0 +1,104 @@
+#include "InstrumentArena.h"
+#include <algorithm>
+
+namespace {
+
+size_t alignUp(size_t offset, size_t align) {
+    return (offset + align - 1) & ~(align - 1);
+}
+
+} // namespace
+
+InstrumentArena& InstrumentArena::operator=(InstrumentArena&& other) {
+    pools_.swap(other.pools_);
+    return *this;
+}
+
+void* InstrumentArena::allocate(std::type_index type, size_t size, size_t align) {
+    Pool& pool = pools_[type];
+    if (!pool.free_slots.empty()) {
+        void* slot = pool.free_slots.back();
+        pool.free_slots.pop_back();
+        return slot;
+    }
+    std::vector<Block>& blocks = pool.blocks;
+
+    if (!blocks.empty()) {
+        Block& block = blocks.back();
+        const size_t offset = alignUp(block.used, align);
+        if (offset + size <= block.capacity) {
+            block.used = offset + size;
+            return block.data.get() + offset;
+        }
+    }
+
+    // operator new[] alignment covers every instrument type
+    if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+        throw std::bad_alloc();
+    }
+
+    Block block;
+    block.capacity = std::max(kBlockSize, size);
+    block.data.reset(new std::byte[block.capacity]);
+    block.used = size;
+    blocks.push_back(std::move(block));
+    return blocks.back().data.get();
+}
+
+void InstrumentArena::reserveBytes(std::type_index type, size_t bytes, size_t align) {
+    std::vector<Block>& blocks = pools_[type].blocks;
+
+    if (!blocks.empty()) {
+        const Block& block = blocks.back();
+        if (alignUp(block.used, align) + bytes <= block.capacity) {
+            return;
+        }
+    }
+
+    Block block;
+    block.capacity = std::max(kBlockSize, bytes);
+    block.data.reset(new std::byte[block.capacity]);
+    blocks.push_back(std::move(block));
+}
+
+void InstrumentArena::recycle(Instrument* instrument) noexcept {
+    // Every slot of a pool holds the one type it was created for
+    auto it = pools_.find(typeid(*instrument));
+    void* slot = dynamic_cast<void*>(instrument);
+    instrument->~Instrument();
+    try {
+        it->second.free_slots.push_back(slot);
+    } catch (const std::bad_alloc&) {
+        // The slot stays unused until release()
+    }
+}
+
+void InstrumentArena::release() {
+    pools_.clear();
+}
+
+size_t InstrumentArena::blockCount() const {
+    size_t count = 0;
+    for (const auto& [type, pool] : pools_) {
+        count += pool.blocks.size();
+    }
+    return count;
+}
+
+size_t InstrumentArena::bytesUsed() const {
+    size_t used = 0;
+    for (const auto& [type, pool] : pools_) {
+        for (const Block& block : pool.blocks) {
+            used += block.used;
+        }
+    }
+    return used;
+}
+
+size_t InstrumentArena::freeSlotCount() const {
+    size_t count = 0;
+    for (const auto& [type, pool] : pools_) {
+        count += pool.free_slots.size();
+    }
+    return count;
+}
@@ -1,4 +1,26 @@
 #include "MarketData.h"
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+// Shared by every manager, so a stamp identifies one asset state in one
+// manager and caches keyed on it cannot confuse two managers
+std::atomic<uint64_t> next_version{1};
+
+uint64_t nextVersion() {
+    return next_version.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool sameMarketData(const MarketData& a, const MarketData& b) {
+    return a.asset_id == b.asset_id &&
+           a.spot_price == b.spot_price &&
+           a.risk_free_rate == b.risk_free_rate &&
+           a.volatility == b.volatility &&
+           a.dividend_yield == b.dividend_yield;
+}
+
+} // namespace
 
 void MarketDataManager::addMarketData(const std::string& asset_id, const MarketData& md) {
     if (asset_id.empty()) {
@@ -11,7 +33,8 @@ void MarketDataManager::addMarketData(const std::string& asset_id, const MarketD
         throw std::runtime_error("Market data for " + asset_id + " already exists. Use updateMarketData instead.");
     }
     
-    market_data_map_[asset_id] = md;
+    latest_version_ = nextVersion();
+    market_data_map_[asset_id] = {md, latest_version_};
 }
 
 void MarketDataManager::updateMarketData(const std::string& asset_id, const MarketData& md) {
@@ -21,14 +44,21 @@ void MarketDataManager::updateMarketData(const std::string& asset_id, const Mark
     
     md.validate();
     
-    if (market_data_map_.find(asset_id) == market_data_map_.end()) {
+    auto it = market_data_map_.find(asset_id);
+    if (it == market_data_map_.end()) {
         throw std::runtime_error("Market data for " + asset_id + " does not exist. Use addMarketData instead.");
     }
     
-    market_data_map_[asset_id] = md;
+    // A repeated tick keeps its stamp so nothing downstream is revalued
+    if (sameMarketData(it->second.data, md)) {
+        return;
+    }
+    
+    latest_version_ = nextVersion();
+    it->second = {md, latest_version_};
 }
 
-MarketData MarketDataManager::getMarketData(const std::string& asset_id) const {
+const MarketDataManager::Entry& MarketDataManager::findEntry(const std::string& asset_id) const {
     if (asset_id.empty()) {
         throw std::invalid_argument("Asset ID cannot be empty");
     }
@@ -41,6 +71,22 @@ MarketData MarketDataManager::getMarketData(const std::string& asset_id) const {
     return it->second;
 }
 
+MarketData MarketDataManager::getMarketData(const std::string& asset_id) const {
+    return findEntry(asset_id).data;
+}
+
+const MarketData& MarketDataManager::getMarketDataRef(const std::string& asset_id) const {
+    return findEntry(asset_id).data;
+}
+
+uint64_t MarketDataManager::getVersion(const std::string& asset_id) const {
+    return findEntry(asset_id).version;
+}
+
+uint64_t MarketDataManager::getLatestVersion() const {
+    return latest_version_;
+}
+
 bool MarketDataManager::hasMarketData(const std::string& asset_id) const {
     return market_data_map_.find(asset_id) != market_data_map_.end();
 }
@@ -59,6 +105,7 @@ void MarketDataManager::removeMarketData(const std::string& asset_id) {
 }
 
 void MarketDataManager::clear() {
+    // Stamps keep counting so re-added assets never reuse an old version
     market_data_map_.clear();
 }
 
@@ -67,5 +114,195 @@ size_t MarketDataManager::size() const {
 }
 
 std::map<std::string, MarketData> MarketDataManager::getAllMarketData() const {
-    return market_data_map_;
-}
\ No newline at end of file
+    std::map<std::string, MarketData> all;
+    for (const auto& [asset_id, entry] : market_data_map_) {
+        all.emplace(asset_id, entry.data);
+    }
+    return all;
+}
+
+MarketDataTable MarketDataManager::getMarketDataTable() const {
+    MarketDataTable table;
+    for (const auto& [asset_id, entry] : market_data_map_) {
+        table.set(asset_id, entry.data);
+    }
+    return table;
+}
+
+AssetId AssetSymbolTable::intern(const std::string& asset_id) {
+    auto it = ids_.find(asset_id);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+    
+    const AssetId id = static_cast<AssetId>(names_.size());
+    names_.push_back(asset_id);
+    ids_.emplace(asset_id, id);
+    return id;
+}
+
+AssetId AssetSymbolTable::find(const std::string& asset_id) const {
+    auto it = ids_.find(asset_id);
+    return it == ids_.end() ? npos : it->second;
+}
+
+const std::string& AssetSymbolTable::name(AssetId id) const {
+    if (id >= names_.size()) {
+        throw std::out_of_range("Asset id out of range");
+    }
+    return names_[id];
+}
+
+size_t AssetSymbolTable::size() const {
+    return names_.size();
+}
+
+bool AssetSymbolTable::empty() const {
+    return names_.empty();
+}
+
+void AssetSymbolTable::clear() {
+    names_.clear();
+    ids_.clear();
+}
+
+MarketDataTable::MarketDataTable(const std::map<std::string, MarketData>& market_data_map) {
+    states_.reserve(market_data_map.size());
+    for (const auto& [asset_id, md] : market_data_map) {
+        set(asset_id, md);
+    }
+}
+
+AssetId MarketDataTable::set(const std::string& asset_id, const MarketData& md) {
+    if (asset_id.empty()) {
+        throw std::invalid_argument("Asset ID cannot be empty");
+    }
+    
+    const AssetId id = symbols_.intern(asset_id);
+    if (id == states_.size()) {
+        states_.emplace_back(md);
+    } else {
+        states_[id] = MarketState(md);
+    }
+    return id;
+}
+
+void MarketDataTable::set(AssetId id, const MarketState& state) {
+    checkId(id);
+    states_[id] = state;
+}
+
+AssetId MarketDataTable::find(const std::string& asset_id) const {
+    return symbols_.find(asset_id);
+}
+
+const MarketState& MarketDataTable::getState(AssetId id) const {
+    checkId(id);
+    return states_[id];
+}
+
+MarketData MarketDataTable::getMarketData(AssetId id) const {
+    const MarketState& state = getState(id);
+    MarketData md;
+    md.asset_id = symbols_.name(id);
+    md.spot_price = state.spot_price;
+    md.risk_free_rate = state.risk_free_rate;
+    md.volatility = state.volatility;
+    md.dividend_yield = state.dividend_yield;
+    return md;
+}
+
+size_t MarketDataTable::size() const {
+    return states_.size();
+}
+
+bool MarketDataTable::empty() const {
+    return states_.empty();
+}
+
+void MarketDataTable::clear() {
+    symbols_.clear();
+    states_.clear();
+}
+
+std::map<std::string, MarketData> MarketDataTable::toMap() const {
+    std::map<std::string, MarketData> all;
+    for (AssetId id = 0; id < states_.size(); ++id) {
+        all.emplace(symbols_.name(id), getMarketData(id));
+    }
+    return all;
+}
+
+void MarketDataTable::checkId(AssetId id) const {
+    if (id >= states_.size()) {
+        throw std::out_of_range("Asset id out of range");
+    }
+}
+
+RateCurve::RateCurve(double flat_rate) {
+    addPoint(0.0, flat_rate);
+}
+
+void RateCurve::addPoint(double time, double zero_rate) {
+    if (time < 0.0) {
+        throw std::invalid_argument("Curve time cannot be negative");
+    }
+    if (std::isnan(zero_rate) || std::isinf(zero_rate)) {
+        throw std::invalid_argument("Invalid zero rate");
+    }
+    
+    auto it = std::lower_bound(times_.begin(), times_.end(), time);
+    const size_t pos = static_cast<size_t>(it - times_.begin());
+    
+    if (it != times_.end() && *it == time) {
+        rates_[pos] = zero_rate;
+    } else {
+        times_.insert(it, time);
+        rates_.insert(rates_.begin() + pos, zero_rate);
+    }
+}
+
+double RateCurve::rate(double time) const {
+    if (times_.empty()) {
+        throw std::runtime_error("Rate curve has no points");
+    }
+    if (time <= times_.front()) {
+        return rates_.front();
+    }
+    if (time >= times_.back()) {
+        return rates_.back();
+    }
+    
+    const size_t hi = static_cast<size_t>(
+        std::upper_bound(times_.begin(), times_.end(), time) - times_.begin());
+    const size_t lo = hi - 1;
+    const double weight = (time - times_[lo]) / (times_[hi] - times_[lo]);
+    
+    return rates_[lo] + weight * (rates_[hi] - rates_[lo]);
+}
+
+bool RateCurve::empty() const {
+    return times_.empty();
+}
+
+size_t RateCurve::size() const {
+    return times_.size();
+}
+
+MarketData SurfaceMarketData::resolve(double strike, double time_to_expiry) const {
+    MarketData md = base;
+    
+    // Expired instruments settle on intrinsic value, the smile is irrelevant
+    if (time_to_expiry <= 0.0) {
+        return md;
+    }
+    
+    if (vol_surface && vol_surface->hasData()) {
+        md.volatility = vol_surface->interpolate(strike, time_to_expiry);
+    }
+    if (rate_curve && !rate_curve->empty()) {
+        md.risk_free_rate = rate_curve->rate(time_to_expiry);
+    }
+    
+    return md;
+}
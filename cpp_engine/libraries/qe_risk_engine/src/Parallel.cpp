@@ -0,0 +1,161 @@
+#include "Parallel.h"
+#include "Profiling.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+
+namespace {
+
+// One parallelFor call. Chunks are claimed through `next`, so pool threads
+// and the caller never run the same chunk
+struct Job {
+    const std::function<void(int, int)>* worker = nullptr;
+    Profiling::Collector* collector = nullptr;
+    int chunks = 0;
+    int chunk = 0;
+    int remainder = 0;
+    std::atomic<int> next{0};
+    
+    std::mutex mutex;
+    std::condition_variable finished;
+    int done = 0;
+    std::exception_ptr error;
+    
+    // Runs chunk c; false once every chunk has been claimed
+    bool runNext() {
+        const int c = next.fetch_add(1);
+        if (c >= chunks) return false;
+        
+        const int start = c * chunk + std::min(c, remainder);
+        const int end = start + chunk + (c < remainder ? 1 : 0);
+        std::exception_ptr failure;
+        {
+            Profiling::ThreadScope profile_scope(collector);
+            try {
+                (*worker)(start, end);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failure && !error) error = failure;
+        if (++done == chunks) finished.notify_all();
+        return true;
+    }
+};
+
+class Pool {
+public:
+    Pool() {
+        unsigned int threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 4;
+        concurrency_ = threads;
+        // The caller runs chunks too
+        for (unsigned int t = 1; t < threads; ++t) {
+            threads_.emplace_back([this]() { run(); });
+        }
+    }
+    
+    ~Pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& th : threads_) th.join();
+    }
+    
+    unsigned int concurrency() const { return concurrency_; }
+    
+    void submit(const std::shared_ptr<Job>& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(job);
+        }
+        wake_.notify_all();
+    }
+    
+    void retire(const std::shared_ptr<Job>& job) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.erase(std::remove(jobs_.begin(), jobs_.end(), job), jobs_.end());
+    }
+    
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+            if (stop_) return;
+            
+            const std::shared_ptr<Job> job = jobs_.front();
+            lock.unlock();
+            const bool ran = job->runNext();
+            lock.lock();
+            if (!ran && !jobs_.empty() && jobs_.front() == job) {
+                jobs_.pop_front();
+            }
+        }
+    }
+    
+    unsigned int concurrency_ = 1;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    bool stop_ = false;
+};
+
+Pool& pool() {
+    static Pool instance;
+    return instance;
+}
+
+} // namespace
+
+unsigned int concurrency() {
+    return pool().concurrency();
+}
+
+void parallelFor(int count, int min_per_thread, const std::function<void(int, int)>& worker,
+                 unsigned int max_threads) {
+    if (count <= 0) return;
+    
+    unsigned int num_threads = max_threads == 0 ? concurrency() : max_threads;
+    num_threads = std::max(1u, std::min<unsigned int>(
+        num_threads, static_cast<unsigned int>(count / std::max(1, min_per_thread))));
+    
+    if (num_threads == 1) {
+        worker(0, count);
+        return;
+    }
+    
+    auto job = std::make_shared<Job>();
+    job->worker = &worker;
+    job->collector = Profiling::threadCollector();
+    job->chunks = static_cast<int>(num_threads);
+    job->chunk = count / job->chunks;
+    job->remainder = count % job->chunks;
+    
+    Pool& workers = pool();
+    workers.submit(job);
+    while (job->runNext()) {
+    }
+    {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->finished.wait(lock, [&]() { return job->done == job->chunks; });
+    }
+    workers.retire(job);
+    
+    if (job->error) std::rethrow_exception(job->error);
+}
+
+} // namespace Parallel
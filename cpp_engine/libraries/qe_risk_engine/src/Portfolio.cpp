@@ -1,8 +1,15 @@
 #include "Portfolio.h"
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <sstream>
 #include <climits>
 
+namespace
+{
+    std::atomic<uint64_t> next_position_id{1};
+}
+
 void Portfolio::addInstrument(std::unique_ptr<Instrument> instrument, int quantity)
 {
     if (!instrument)
@@ -10,9 +17,15 @@ void Portfolio::addInstrument(std::unique_ptr<Instrument> instrument, int quanti
         throw std::invalid_argument("Cannot add null instrument to portfolio");
     }
 
+    insertInstrument(InstrumentPtr(instrument.release()), quantity);
+}
+
+void Portfolio::insertInstrument(InstrumentPtr instrument, int quantity)
+{
+    std::string asset_id;
     try
     {
-        std::string asset_id = instrument->getAssetId();
+        asset_id = instrument->getAssetId();
         if (asset_id.empty())
         {
             throw std::invalid_argument("Instrument must have a valid asset ID");
@@ -30,7 +43,16 @@ void Portfolio::addInstrument(std::unique_ptr<Instrument> instrument, int quanti
 
     try
     {
+        // Reserve everything first so the pushes below cannot fail halfway
+        const int asset = internAsset(asset_id);
+        position_ids.reserve(instruments.capacity());
+        position_assets.reserve(instruments.capacity());
+        asset_positions[asset].reserve(asset_positions[asset].size() + 1);
+
+        asset_positions[asset].push_back(instruments.size());
         instruments.emplace_back(std::move(instrument), quantity);
+        position_ids.push_back(next_position_id.fetch_add(1, std::memory_order_relaxed));
+        position_assets.push_back(asset);
     }
     catch (const std::bad_alloc &e)
     {
@@ -42,7 +64,164 @@ void Portfolio::addInstrument(std::unique_ptr<Instrument> instrument, int quanti
     }
 }
 
-const std::vector<std::pair<std::unique_ptr<Instrument>, int>> &Portfolio::getInstruments() const
+void Portfolio::addPositions(const PositionColumns &columns)
+{
+    const size_t count = columns.count;
+    if (count == 0)
+    {
+        return;
+    }
+    if (!columns.is_call || !columns.strike || !columns.expiry || !columns.quantity ||
+        !columns.asset || !columns.asset_names)
+    {
+        throw std::invalid_argument("Position columns need option type, strike, expiry, quantity and asset");
+    }
+    const bool has_jumps = columns.jump_intensity || columns.jump_mean || columns.jump_vol;
+    if (has_jumps && !(columns.jump_intensity && columns.jump_mean && columns.jump_vol))
+    {
+        throw std::invalid_argument("Jump parameters need all three columns");
+    }
+
+    auto modelOf = [&](size_t i)
+    {
+        return columns.model ? static_cast<PricingModel>(columns.model[i]) : PricingModel::BlackScholes;
+    };
+    auto isAmerican = [&](size_t i)
+    {
+        return columns.american && columns.american[i] != 0;
+    };
+    // Only lattice-priced rows read their step count
+    auto usesSteps = [&](size_t i)
+    {
+        return columns.binomial_steps && (isAmerican(i) || modelOf(i) == PricingModel::Binomial);
+    };
+
+    size_t american_count = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto reject = [i](const std::string &reason)
+        {
+            throw std::invalid_argument("Position " + std::to_string(i) + ": " + reason);
+        };
+
+        if (!(columns.strike[i] > 0.0) || std::isinf(columns.strike[i]))
+        {
+            reject("strike must be positive");
+        }
+        if (!(columns.expiry[i] >= 0.0) || std::isinf(columns.expiry[i]))
+        {
+            reject("time to expiry must be non-negative");
+        }
+        const int32_t asset = columns.asset[i];
+        if (asset < 0 || static_cast<size_t>(asset) >= columns.asset_name_count)
+        {
+            reject("asset index out of range");
+        }
+        if (columns.asset_names[asset].empty())
+        {
+            reject("asset ID cannot be empty");
+        }
+        if (usesSteps(i) &&
+            (columns.binomial_steps[i] < 1 || columns.binomial_steps[i] > 10000))
+        {
+            reject("binomial steps must be between 1 and 10000");
+        }
+
+        if (isAmerican(i))
+        {
+            ++american_count;
+            continue;
+        }
+        if (columns.model && columns.model[i] > static_cast<uint8_t>(PricingModel::Heston))
+        {
+            reject("unknown pricing model");
+        }
+        if (modelOf(i) == PricingModel::Heston)
+        {
+            // There are no Heston parameter columns, so the position would
+            // silently price with the default parameters
+            reject("Heston positions need parameters the columns cannot carry");
+        }
+        if (has_jumps && modelOf(i) == PricingModel::MertonJumpDiffusion &&
+            (!(columns.jump_intensity[i] >= 0.0) || !(columns.jump_vol[i] >= 0.0) ||
+             std::isnan(columns.jump_mean[i])))
+        {
+            reject("jump intensity and volatility must be non-negative");
+        }
+    }
+
+    try
+    {
+        // Each distinct name is looked up once, and every container is sized
+        // up front so nothing below can fail halfway
+        std::vector<int> interned(columns.asset_name_count, -1);
+        std::vector<size_t> added_per_asset;
+        for (size_t i = 0; i < count; ++i)
+        {
+            int &asset = interned[columns.asset[i]];
+            if (asset < 0)
+            {
+                asset = internAsset(columns.asset_names[columns.asset[i]]);
+            }
+            if (added_per_asset.size() <= static_cast<size_t>(asset))
+            {
+                added_per_asset.resize(asset + 1, 0);
+            }
+            ++added_per_asset[asset];
+        }
+        for (size_t asset = 0; asset < added_per_asset.size(); ++asset)
+        {
+            asset_positions[asset].reserve(asset_positions[asset].size() + added_per_asset[asset]);
+        }
+        reserve(instruments.size() + count);
+        arena.reserve<AmericanOption>(american_count);
+        arena.reserve<EuropeanOption>(count - american_count);
+
+        uint64_t position_id = next_position_id.fetch_add(count, std::memory_order_relaxed);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const int asset = interned[columns.asset[i]];
+            const std::string &asset_id = asset_names[asset];
+            const OptionType type = columns.is_call[i] ? OptionType::Call : OptionType::Put;
+
+            Instrument *created;
+            if (isAmerican(i))
+            {
+                created = arena.create<AmericanOption>(
+                    type, columns.strike[i], columns.expiry[i], asset_id,
+                    usesSteps(i) ? columns.binomial_steps[i] : 100);
+            }
+            else
+            {
+                const PricingModel model = modelOf(i);
+                EuropeanOption *option = arena.create<EuropeanOption>(
+                    type, columns.strike[i], columns.expiry[i], asset_id, model);
+                if (usesSteps(i))
+                {
+                    option->setBinomialSteps(columns.binomial_steps[i]);
+                }
+                if (has_jumps && model == PricingModel::MertonJumpDiffusion)
+                {
+                    option->setJumpParameters(columns.jump_intensity[i], columns.jump_mean[i],
+                                              columns.jump_vol[i]);
+                }
+                created = option;
+            }
+
+            asset_positions[asset].push_back(instruments.size());
+            instruments.emplace_back(InstrumentPtr(created, InstrumentDeleter{true}),
+                                     columns.quantity[i]);
+            position_ids.push_back(position_id++);
+            position_assets.push_back(asset);
+        }
+    }
+    catch (const std::bad_alloc &e)
+    {
+        throw std::runtime_error("Failed to allocate memory for new positions");
+    }
+}
+
+const std::vector<std::pair<InstrumentPtr, int>> &Portfolio::getInstruments() const
 {
     return instruments;
 }
@@ -61,6 +240,14 @@ void Portfolio::clear()
 {
     instruments.clear();
     instruments.shrink_to_fit();
+    arena.release();
+    position_ids.clear();
+    position_ids.shrink_to_fit();
+    position_assets.clear();
+    position_assets.shrink_to_fit();
+    asset_names.clear();
+    asset_lookup.clear();
+    asset_positions.clear();
 }
 
 void Portfolio::reserve(size_t capacity)
@@ -68,6 +255,8 @@ void Portfolio::reserve(size_t capacity)
     try
     {
         instruments.reserve(capacity);
+        position_ids.reserve(capacity);
+        position_assets.reserve(capacity);
     }
     catch (const std::bad_alloc &e)
     {
@@ -82,26 +271,75 @@ int Portfolio::getTotalQuantityForAsset(const std::string &asset_id) const
         throw std::invalid_argument("Asset ID cannot be empty");
     }
 
+    const int asset = findAsset(asset_id);
+    if (asset < 0)
+    {
+        return 0;
+    }
+
     int total = 0;
-    for (const auto &[instr, qty] : instruments)
+    for (size_t index : asset_positions[asset])
     {
-        if (instr && instr->getAssetId() == asset_id)
+        const int qty = instruments[index].second;
+        if ((qty > 0 && total > INT_MAX - qty) ||
+            (qty < 0 && total < INT_MIN - qty))
         {
-            if ((qty > 0 && total > INT_MAX - qty) ||
-                (qty < 0 && total < INT_MIN - qty))
-            {
-                throw std::overflow_error("Quantity overflow for asset " + asset_id);
-            }
-            total += qty;
+            throw std::overflow_error("Quantity overflow for asset " + asset_id);
         }
+        total += qty;
     }
     return total;
 }
 
+void Portfolio::disposeInstrument(InstrumentPtr &instrument)
+{
+    if (instrument && instrument.get_deleter().arena_owned)
+    {
+        arena.recycle(instrument.release());
+    }
+    instrument.reset();
+}
+
 void Portfolio::removeInstrument(size_t index)
 {
     validateIndex(index);
+    disposeInstrument(instruments[index].first);
+
+    auto &positions = asset_positions[position_assets[index]];
+    positions.erase(std::find(positions.begin(), positions.end(), index));
+    for (auto &asset : asset_positions)
+    {
+        for (size_t &position : asset)
+        {
+            if (position > index)
+            {
+                --position;
+            }
+        }
+    }
+
     instruments.erase(instruments.begin() + index);
+    position_ids.erase(position_ids.begin() + index);
+    position_assets.erase(position_assets.begin() + index);
+}
+
+void Portfolio::truncate(size_t new_size)
+{
+    if (new_size >= instruments.size())
+    {
+        return;
+    }
+    // Each asset lists its positions in ascending order, so the removed ones
+    // are at the back
+    for (size_t index = instruments.size(); index-- > new_size;)
+    {
+        asset_positions[position_assets[index]].pop_back();
+        disposeInstrument(instruments[index].first);
+    }
+
+    instruments.erase(instruments.begin() + new_size, instruments.end());
+    position_ids.resize(new_size);
+    position_assets.resize(new_size);
 }
 
 void Portfolio::updateQuantity(size_t index, int new_quantity)
@@ -110,6 +348,66 @@ void Portfolio::updateQuantity(size_t index, int new_quantity)
     instruments[index].second = new_quantity;
 }
 
+uint64_t Portfolio::getPositionId(size_t index) const
+{
+    validateIndex(index);
+    return position_ids[index];
+}
+
+size_t Portfolio::getAssetCount() const
+{
+    return asset_names.size();
+}
+
+int Portfolio::findAsset(const std::string &asset_id) const
+{
+    auto it = asset_lookup.find(asset_id);
+    return it == asset_lookup.end() ? -1 : it->second;
+}
+
+const std::string &Portfolio::getAssetName(int asset) const
+{
+    validateAsset(asset);
+    return asset_names[asset];
+}
+
+int Portfolio::getPositionAsset(size_t index) const
+{
+    validateIndex(index);
+    return position_assets[index];
+}
+
+const std::vector<size_t> &Portfolio::getPositionsForAsset(int asset) const
+{
+    validateAsset(asset);
+    return asset_positions[asset];
+}
+
+int Portfolio::internAsset(const std::string &asset_id)
+{
+    auto it = asset_lookup.find(asset_id);
+    if (it != asset_lookup.end())
+    {
+        return it->second;
+    }
+
+    const int asset = static_cast<int>(asset_names.size());
+    asset_names.push_back(asset_id);
+    asset_positions.emplace_back();
+    asset_lookup.emplace(asset_id, asset);
+    return asset;
+}
+
+void Portfolio::validateAsset(int asset) const
+{
+    if (asset < 0 || static_cast<size_t>(asset) >= asset_names.size())
+    {
+        std::ostringstream oss;
+        oss << "Asset " << asset << " out of range. Asset count: " << asset_names.size();
+        throw std::out_of_range(oss.str());
+    }
+}
+
 void Portfolio::validateIndex(size_t index) const
 {
     if (index >= instruments.size())
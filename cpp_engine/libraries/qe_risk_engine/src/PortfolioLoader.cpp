@@ -0,0 +1,972 @@
+#include "PortfolioLoader.h"
+#include "PortfolioSnapshot.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+void PositionBuffer::add(const PositionRecord& record) {
+    // Looked up before inserting, so known assets cost no key copy
+    auto it = asset_lookup_.find(record.asset_id);
+    if (it == asset_lookup_.end()) {
+        it = asset_lookup_.emplace(record.asset_id, static_cast<int32_t>(asset_names_.size())).first;
+        asset_names_.push_back(record.asset_id);
+    }
+
+    is_call_.push_back(record.is_call ? 1 : 0);
+    american_.push_back(record.american ? 1 : 0);
+    model_.push_back(static_cast<uint8_t>(record.model));
+    quantity_.push_back(record.quantity);
+    asset_.push_back(it->second);
+    binomial_steps_.push_back(record.binomial_steps);
+    strike_.push_back(record.strike);
+    expiry_.push_back(record.expiry);
+    jump_intensity_.push_back(record.jump_intensity);
+    jump_mean_.push_back(record.jump_mean);
+    jump_vol_.push_back(record.jump_vol);
+}
+
+void PositionBuffer::reserve(size_t count) {
+    is_call_.reserve(count);
+    american_.reserve(count);
+    model_.reserve(count);
+    quantity_.reserve(count);
+    asset_.reserve(count);
+    binomial_steps_.reserve(count);
+    strike_.reserve(count);
+    expiry_.reserve(count);
+    jump_intensity_.reserve(count);
+    jump_mean_.reserve(count);
+    jump_vol_.reserve(count);
+}
+
+void PositionBuffer::clear() {
+    is_call_.clear();
+    american_.clear();
+    model_.clear();
+    quantity_.clear();
+    asset_.clear();
+    binomial_steps_.clear();
+    strike_.clear();
+    expiry_.clear();
+    jump_intensity_.clear();
+    jump_mean_.clear();
+    jump_vol_.clear();
+}
+
+PositionColumns PositionBuffer::columns() const {
+    PositionColumns columns;
+    columns.count = size();
+    columns.is_call = is_call_.data();
+    columns.strike = strike_.data();
+    columns.expiry = expiry_.data();
+    columns.quantity = quantity_.data();
+    columns.asset = asset_.data();
+    columns.asset_names = asset_names_.data();
+    columns.asset_name_count = asset_names_.size();
+    columns.american = american_.data();
+    columns.model = model_.data();
+    columns.binomial_steps = binomial_steps_.data();
+    columns.jump_intensity = jump_intensity_.data();
+    columns.jump_mean = jump_mean_.data();
+    columns.jump_vol = jump_vol_.data();
+    return columns;
+}
+
+namespace {
+
+// Jump parameters of jumpdiffusion positions that leave them out
+const double kDefaultJumpIntensity = 2.0;
+const double kDefaultJumpMean = -0.05;
+const double kDefaultJumpVol = 0.15;
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+std::string_view trim(std::string_view text) {
+    const size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    const size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+// `lower` must already be lowercase
+bool equalsIgnoreCase(std::string_view text, std::string_view lower) {
+    return text.size() == lower.size() &&
+           std::equal(text.begin(), text.end(), lower.begin(), [](char a, char b) {
+               return std::tolower(static_cast<unsigned char>(a)) == b;
+           });
+}
+
+bool parseOptionType(std::string_view text) {
+    if (equalsIgnoreCase(text, "call")) return true;
+    if (equalsIgnoreCase(text, "put")) return false;
+    throw std::invalid_argument("type must be 'call' or 'put'");
+}
+
+bool parseStyle(std::string_view text) {
+    if (text.empty() || equalsIgnoreCase(text, "european")) return false;
+    if (equalsIgnoreCase(text, "american")) return true;
+    throw std::invalid_argument("style must be 'european' or 'american'");
+}
+
+PricingModel parseModel(std::string_view text) {
+    if (text.empty() || equalsIgnoreCase(text, "blackscholes")) return PricingModel::BlackScholes;
+    if (equalsIgnoreCase(text, "binomial")) return PricingModel::Binomial;
+    if (equalsIgnoreCase(text, "jumpdiffusion")) return PricingModel::MertonJumpDiffusion;
+    throw std::invalid_argument("pricing_model must be 'blackscholes', 'binomial', or 'jumpdiffusion'");
+}
+
+// Plain decimals of up to 15 significant digits, the bulk of any position
+// file. The digits are exact in a double and so is 10^k for k <= 22, so one
+// division is correctly rounded (Clinger's fast path) and matches strtod.
+bool parsePlainDecimal(std::string_view text, double& result) {
+    static const double kPowersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    size_t i = 0;
+    bool negative = false;
+    if (i < text.size() && (text[i] == '-' || text[i] == '+')) {
+        negative = text[i++] == '-';
+    }
+    uint64_t mantissa = 0;
+    int significant_digits = 0;
+    int fraction_digits = 0;
+    bool any_digit = false;
+    bool point = false;
+    for (; i < text.size(); ++i) {
+        const char c = text[i];
+        if (c >= '0' && c <= '9') {
+            if (mantissa != 0 || c != '0') {
+                ++significant_digits;
+            }
+            mantissa = mantissa * 10 + static_cast<uint64_t>(c - '0');
+            fraction_digits += point ? 1 : 0;
+            any_digit = true;
+        } else if (c == '.' && !point) {
+            point = true;
+        } else {
+            return false;
+        }
+    }
+    if (!any_digit || significant_digits > 15 || fraction_digits > 22) {
+        return false;
+    }
+    result = static_cast<double>(mantissa) / kPowersOf10[fraction_digits];
+    if (negative) {
+        result = -result;
+    }
+    return true;
+}
+
+double parseDouble(std::string_view text, const char* field) {
+    const std::string_view value = trim(text);
+    double result;
+    if (parsePlainDecimal(value, result)) {
+        return result;
+    }
+
+    // strtod needs a terminated copy; any sensible number fits on the stack
+    char buffer[64];
+    std::string long_value;
+    const char* begin = buffer;
+    if (value.size() < sizeof(buffer)) {
+        std::memcpy(buffer, value.data(), value.size());
+        buffer[value.size()] = '\0';
+    } else {
+        long_value.assign(value);
+        begin = long_value.c_str();
+    }
+
+    char* end = nullptr;
+    errno = 0;
+    result = std::strtod(begin, &end);
+    if (value.empty() || *end != '\0' || errno == ERANGE) {
+        throw std::invalid_argument(std::string(field) + " must be a number");
+    }
+    return result;
+}
+
+int32_t toInt32(double value, const char* field) {
+    if (!(value >= INT32_MIN && value <= INT32_MAX) || std::floor(value) != value) {
+        throw std::invalid_argument(std::string(field) + " must be an integer");
+    }
+    return static_cast<int32_t>(value);
+}
+
+void applyJumpDefaults(PositionRecord& record, bool has_intensity, bool has_mean, bool has_vol) {
+    if (record.american || record.model != PricingModel::MertonJumpDiffusion) {
+        record.jump_intensity = record.jump_mean = record.jump_vol = 0.0;
+        return;
+    }
+    if (!has_intensity) record.jump_intensity = kDefaultJumpIntensity;
+    if (!has_mean) record.jump_mean = kDefaultJumpMean;
+    if (!has_vol) record.jump_vol = kDefaultJumpVol;
+}
+
+// The checks Portfolio::addPositions makes, so that a bad row is reported
+// where it was read rather than by its index in a batch
+void validateRecord(const PositionRecord& record) {
+    if (!(record.strike > 0.0) || std::isinf(record.strike)) {
+        throw std::invalid_argument("strike must be positive");
+    }
+    if (!(record.expiry >= 0.0) || std::isinf(record.expiry)) {
+        throw std::invalid_argument("expiry must be non-negative");
+    }
+    if ((record.american || record.model == PricingModel::Binomial) &&
+        (record.binomial_steps < 1 || record.binomial_steps > 10000)) {
+        throw std::invalid_argument("binomial_steps must be between 1 and 10000");
+    }
+    if (!(record.jump_intensity >= 0.0) || !(record.jump_vol >= 0.0) ||
+        std::isnan(record.jump_mean)) {
+        throw std::invalid_argument("jump intensity and volatility must be non-negative");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// CSV
+
+// Splits a line into fields in place: the views point into the line, and
+// quoted fields are unescaped by shifting their bytes left within it
+void splitCsvLine(char* line, size_t length, std::vector<std::string_view>& fields) {
+    fields.clear();
+    char* const end = line + length;
+    char* field = line;
+    char* out = line;
+    bool quoted = false;
+    for (char* in = line; in < end; ++in) {
+        const char c = *in;
+        if (quoted) {
+            if (c == '"' && in + 1 < end && in[1] == '"') {
+                *out++ = '"';
+                ++in;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                *out++ = c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.push_back(trim(std::string_view(field, out - field)));
+            field = out = in + 1;
+        } else {
+            *out++ = c;
+        }
+    }
+    fields.push_back(trim(std::string_view(field, out - field)));
+}
+
+// CSV with a header row naming its columns, read in large blocks. Blank
+// lines and lines starting with '#' are skipped, and short rows are padded
+// with empty fields.
+class CsvTable {
+public:
+    CsvTable(std::istream& in, const std::vector<std::string>& required)
+        : in_(in), buffer_(kBlockSize) {
+        char* line;
+        size_t length;
+        if (nextLine(line, length)) {
+            splitCsvLine(line, length, fields_);
+            width_ = fields_.size();
+            for (size_t c = 0; c < fields_.size(); ++c) {
+                columns_.emplace(lowercase(std::string(fields_[c])), c);
+            }
+        }
+        for (const auto& name : required) {
+            if (!columns_.count(name)) {
+                throw std::invalid_argument("CSV header is missing column '" + name + "'");
+            }
+        }
+    }
+
+    // -1 if the header has no such column
+    int column(const std::string& name) const {
+        auto it = columns_.find(name);
+        return it == columns_.end() ? -1 : static_cast<int>(it->second);
+    }
+
+    // Calls on_row with the fields of each row, as views that are valid until
+    // on_row returns
+    template <typename OnRow>
+    void forEachRow(OnRow on_row) {
+        char* line;
+        size_t length;
+        while (nextLine(line, length)) {
+            splitCsvLine(line, length, fields_);
+            if (fields_.size() < width_) {
+                fields_.resize(width_);
+            }
+            try {
+                on_row(fields_);
+            } catch (const std::invalid_argument& e) {
+                throw std::invalid_argument("Line " + std::to_string(line_number_) + ": " + e.what());
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kBlockSize = 1 << 20;
+
+    std::istream& in_;
+    std::vector<char> buffer_;
+    size_t begin_ = 0;   // unread bytes are buffer_[begin_, end_)
+    size_t end_ = 0;
+    bool eof_ = false;
+    std::vector<std::string_view> fields_;
+    std::unordered_map<std::string, size_t> columns_;
+    size_t width_ = 0;
+    size_t line_number_ = 0;
+
+    // Next line that is neither blank nor a comment, trimmed
+    bool nextLine(char*& line, size_t& length) {
+        while (readLine(line, length)) {
+            ++line_number_;
+            const std::string_view content = trim(std::string_view(line, length));
+            if (!content.empty() && content[0] != '#') {
+                line += content.data() - line;
+                length = content.size();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Next raw line of the buffer, refilling it a block at a time; a line
+    // longer than the buffer grows it
+    bool readLine(char*& line, size_t& length) {
+        for (;;) {
+            char* const start = buffer_.data() + begin_;
+            if (const void* newline = std::memchr(start, '\n', end_ - begin_)) {
+                line = start;
+                length = static_cast<const char*>(newline) - start;
+                begin_ += length + 1;
+                return true;
+            }
+            if (eof_) {
+                if (begin_ == end_) {
+                    return false;
+                }
+                line = start;
+                length = end_ - begin_;
+                begin_ = end_;
+                return true;
+            }
+
+            std::memmove(buffer_.data(), start, end_ - begin_);
+            end_ -= begin_;
+            begin_ = 0;
+            if (buffer_.size() - end_ < kBlockSize / 2) {
+                buffer_.resize(buffer_.size() * 2);
+            }
+            in_.read(buffer_.data() + end_, static_cast<std::streamsize>(buffer_.size() - end_));
+            end_ += static_cast<size_t>(in_.gcount());
+            eof_ = !in_;
+        }
+    }
+};
+
+void readPositionsCsv(std::istream& in,
+                      const std::function<void(const PositionRecord&)>& on_position) {
+    CsvTable table(in, {"type", "strike", "expiry", "asset_id", "quantity"});
+    const int type = table.column("type");
+    const int strike = table.column("strike");
+    const int expiry = table.column("expiry");
+    const int asset_id = table.column("asset_id");
+    const int quantity = table.column("quantity");
+    const int style = table.column("style");
+    const int model = table.column("pricing_model");
+    const int steps = table.column("binomial_steps");
+    const int jump_lambda = table.column("jump_lambda");
+    const int jump_mean = table.column("jump_mean");
+    const int jump_vol = table.column("jump_vol");
+
+    PositionRecord record;
+    table.forEachRow([&](const std::vector<std::string_view>& fields) {
+        auto optional = [&](int column) {
+            return column < 0 ? std::string_view() : fields[column];
+        };
+
+        if (fields[asset_id].empty()) {
+            throw std::invalid_argument("asset_id must be a non-empty string");
+        }
+        record.asset_id.assign(fields[asset_id]);
+        record.is_call = parseOptionType(fields[type]);
+        record.strike = parseDouble(fields[strike], "strike");
+        record.expiry = parseDouble(fields[expiry], "expiry");
+        record.quantity = toInt32(parseDouble(fields[quantity], "quantity"), "quantity");
+        record.american = parseStyle(optional(style));
+        record.model = parseModel(optional(model));
+        record.binomial_steps = optional(steps).empty()
+            ? 100 : toInt32(parseDouble(optional(steps), "binomial_steps"), "binomial_steps");
+
+        const bool has_lambda = !optional(jump_lambda).empty();
+        const bool has_mean = !optional(jump_mean).empty();
+        const bool has_vol = !optional(jump_vol).empty();
+        record.jump_intensity = has_lambda ? parseDouble(optional(jump_lambda), "jump_lambda") : 0.0;
+        record.jump_mean = has_mean ? parseDouble(optional(jump_mean), "jump_mean") : 0.0;
+        record.jump_vol = has_vol ? parseDouble(optional(jump_vol), "jump_vol") : 0.0;
+        applyJumpDefaults(record, has_lambda, has_mean, has_vol);
+        validateRecord(record);
+
+        on_position(record);
+    });
+}
+
+std::map<std::string, MarketData> readMarketDataCsv(std::istream& in) {
+    CsvTable table(in, {"asset_id", "spot", "rate", "vol"});
+    const int asset_id = table.column("asset_id");
+    const int spot = table.column("spot");
+    const int rate = table.column("rate");
+    const int vol = table.column("vol");
+    const int dividend = table.column("dividend");
+
+    std::map<std::string, MarketData> market_data;
+    table.forEachRow([&](const std::vector<std::string_view>& fields) {
+        const std::string id(fields[asset_id]);
+        if (id.empty()) {
+            throw std::invalid_argument("asset_id must be a non-empty string");
+        }
+        const double div = dividend < 0 || fields[dividend].empty()
+            ? 0.0 : parseDouble(fields[dividend], "dividend");
+        market_data[id] = MarketData(id, parseDouble(fields[spot], "spot"),
+                                     parseDouble(fields[rate], "rate"),
+                                     parseDouble(fields[vol], "vol"), div);
+    });
+    return market_data;
+}
+
+// ---------------------------------------------------------------------------
+// JSON
+
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue* find(const std::string& key) const {
+        for (const auto& member : object) {
+            if (member.first == key) return &member.second;
+        }
+        return nullptr;
+    }
+};
+
+// Pull parser over a stream: values are read one at a time, so an array of
+// positions is never held in memory as a whole. Characters come straight from
+// the stream buffer, skipping the per-call istream sentry.
+class JsonReader {
+public:
+    explicit JsonReader(std::istream& in) : in_(*in.rdbuf()) {}
+
+    char peek() {
+        skipWhitespace();
+        const int c = in_.sgetc();
+        return c == std::char_traits<char>::eof() ? '\0' : static_cast<char>(c);
+    }
+
+    void expect(char expected) {
+        if (peek() != expected) {
+            fail(std::string("expected '") + expected + "'");
+        }
+        get();
+    }
+
+    // Consumes c if it is next
+    bool consume(char c) {
+        if (peek() != c) return false;
+        get();
+        return true;
+    }
+
+    std::string readString() {
+        expect('"');
+        std::string result;
+        for (;;) {
+            const int c = get();
+            if (c == std::char_traits<char>::eof()) fail("unterminated string");
+            if (c == '"') return result;
+            if (c != '\\') {
+                result += static_cast<char>(c);
+                continue;
+            }
+            const int escape = get();
+            switch (escape) {
+                case '"': result += '"'; break;
+                case '\\': result += '\\'; break;
+                case '/': result += '/'; break;
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'n': result += '\n'; break;
+                case 'r': result += '\r'; break;
+                case 't': result += '\t'; break;
+                case 'u': appendCodePoint(result, readHex4()); break;
+                default: fail("invalid escape in string");
+            }
+        }
+    }
+
+    JsonValue readValue() {
+        JsonValue value;
+        const char c = peek();
+        if (c == '{') {
+            value.type = JsonValue::Type::Object;
+            forEachMember([&](const std::string& key) {
+                value.object.emplace_back(key, readValue());
+            });
+        } else if (c == '[') {
+            value.type = JsonValue::Type::Array;
+            forEachElement([&]() { value.array.push_back(readValue()); });
+        } else if (c == '"') {
+            value.type = JsonValue::Type::String;
+            value.string = readString();
+        } else if (c == 't' || c == 'f' || c == 'n') {
+            const std::string word = readWord();
+            if (word == "true" || word == "false") {
+                value.type = JsonValue::Type::Bool;
+                value.boolean = word == "true";
+            } else if (word != "null") {
+                fail("unexpected '" + word + "'");
+            }
+        } else {
+            value.type = JsonValue::Type::Number;
+            const std::string text = readWord();
+            if (!parsePlainDecimal(text, value.number)) {
+                char* end = nullptr;
+                value.number = std::strtod(text.c_str(), &end);
+                if (text.empty() || *end != '\0') fail("invalid number '" + text + "'");
+            }
+        }
+        return value;
+    }
+
+    // Calls on_member(key) with the reader positioned at each member's value;
+    // on_member must consume it
+    template <typename OnMember>
+    void forEachMember(OnMember on_member) {
+        expect('{');
+        if (consume('}')) return;
+        do {
+            const std::string key = readString();
+            expect(':');
+            on_member(key);
+        } while (consume(','));
+        expect('}');
+    }
+
+    template <typename OnElement>
+    void forEachElement(OnElement on_element) {
+        expect('[');
+        if (consume(']')) return;
+        do {
+            on_element();
+        } while (consume(','));
+        expect(']');
+    }
+
+    void expectEnd() {
+        if (peek() != '\0') fail("unexpected trailing content");
+    }
+
+    [[noreturn]] void fail(const std::string& message) {
+        throw std::invalid_argument("Invalid JSON near offset " + std::to_string(offset_) + ": " +
+                                    message);
+    }
+
+private:
+    std::streambuf& in_;
+    size_t offset_ = 0;
+
+    int get() {
+        const int c = in_.sbumpc();
+        if (c != std::char_traits<char>::eof()) ++offset_;
+        return c;
+    }
+
+    void skipWhitespace() {
+        while (std::isspace(in_.sgetc())) get();
+    }
+
+    std::string readWord() {
+        std::string word;
+        for (;;) {
+            const int c = in_.sgetc();
+            if (c == std::char_traits<char>::eof() || std::isspace(c) || c == ',' || c == ']' ||
+                c == '}' || c == ':') {
+                return word;
+            }
+            word += static_cast<char>(get());
+        }
+    }
+
+    unsigned readHex4() {
+        unsigned value = 0;
+        for (int i = 0; i < 4; ++i) {
+            const int c = get();
+            if (!std::isxdigit(c)) fail("invalid \\u escape");
+            value = value * 16 + static_cast<unsigned>(std::isdigit(c) ? c - '0' : std::tolower(c) - 'a' + 10);
+        }
+        return value;
+    }
+
+    static void appendCodePoint(std::string& out, unsigned code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+};
+
+const std::string& jsonString(const JsonValue& value, const char* field) {
+    if (value.type != JsonValue::Type::String) {
+        throw std::invalid_argument(std::string(field) + " must be a string");
+    }
+    return value.string;
+}
+
+double jsonNumber(const JsonValue& value, const char* field) {
+    if (value.type != JsonValue::Type::Number) {
+        throw std::invalid_argument(std::string(field) + " must be a number");
+    }
+    return value.number;
+}
+
+const JsonValue& requiredMember(const JsonValue& object, const std::string& key) {
+    const JsonValue* member = object.find(key);
+    if (!member) {
+        throw std::invalid_argument("missing required field '" + key + "'");
+    }
+    return *member;
+}
+
+// Reads one position object member by member, so only its scalar values are
+// materialized, never the object itself
+PositionRecord readPositionJson(JsonReader& reader) {
+    if (reader.peek() != '{') {
+        throw std::invalid_argument("must be an object");
+    }
+    static const char* const kRequired[] = {"type", "strike", "expiry", "asset_id", "quantity"};
+    bool seen[5] = {};
+    bool has_lambda = false, has_mean = false, has_vol = false;
+
+    PositionRecord record;
+    reader.forEachMember([&](const std::string& key) {
+        const JsonValue value = reader.readValue();
+        if (key == "type") {
+            record.is_call = parseOptionType(jsonString(value, "type"));
+            seen[0] = true;
+        } else if (key == "strike") {
+            record.strike = jsonNumber(value, "strike");
+            seen[1] = true;
+        } else if (key == "expiry") {
+            record.expiry = jsonNumber(value, "expiry");
+            seen[2] = true;
+        } else if (key == "asset_id") {
+            record.asset_id.assign(trim(jsonString(value, "asset_id")));
+            if (record.asset_id.empty()) {
+                throw std::invalid_argument("asset_id must be a non-empty string");
+            }
+            seen[3] = true;
+        } else if (key == "quantity") {
+            record.quantity = toInt32(jsonNumber(value, "quantity"), "quantity");
+            seen[4] = true;
+        } else if (key == "style") {
+            record.american = parseStyle(jsonString(value, "style"));
+        } else if (key == "pricing_model") {
+            record.model = parseModel(jsonString(value, "pricing_model"));
+        } else if (key == "binomial_steps") {
+            record.binomial_steps = toInt32(jsonNumber(value, "binomial_steps"), "binomial_steps");
+        } else if (key == "jump_parameters") {
+            if (value.type != JsonValue::Type::Object) {
+                throw std::invalid_argument("jump_parameters must be an object");
+            }
+            if (const JsonValue* v = value.find("lambda")) {
+                record.jump_intensity = jsonNumber(*v, "jump_parameters.lambda");
+                has_lambda = true;
+            }
+            if (const JsonValue* v = value.find("mean")) {
+                record.jump_mean = jsonNumber(*v, "jump_parameters.mean");
+                has_mean = true;
+            }
+            if (const JsonValue* v = value.find("vol")) {
+                record.jump_vol = jsonNumber(*v, "jump_parameters.vol");
+                has_vol = true;
+            }
+        }
+    });
+
+    for (size_t f = 0; f < 5; ++f) {
+        if (!seen[f]) {
+            throw std::invalid_argument(std::string("missing required field '") + kRequired[f] + "'");
+        }
+    }
+    applyJumpDefaults(record, has_lambda, has_mean, has_vol);
+    validateRecord(record);
+    return record;
+}
+
+void readPositionsJson(std::istream& in,
+                       const std::function<void(const PositionRecord&)>& on_position) {
+    JsonReader reader(in);
+    size_t index = 0;
+    auto readArray = [&]() {
+        reader.forEachElement([&]() {
+            PositionRecord record;
+            try {
+                record = readPositionJson(reader);
+            } catch (const std::invalid_argument& e) {
+                throw std::invalid_argument("Portfolio item " + std::to_string(index) + ": " + e.what());
+            }
+            on_position(record);
+            ++index;
+        });
+    };
+
+    if (reader.peek() == '[') {
+        readArray();
+    } else {
+        bool found = false;
+        reader.forEachMember([&](const std::string& key) {
+            if (key == "portfolio" && !found) {
+                found = true;
+                readArray();
+            } else {
+                reader.readValue();
+            }
+        });
+        if (!found) {
+            throw std::invalid_argument("JSON positions need a top-level array or a 'portfolio' field");
+        }
+    }
+    reader.expectEnd();
+}
+
+std::map<std::string, MarketData> readMarketDataJson(std::istream& in) {
+    JsonReader reader(in);
+    JsonValue root = reader.readValue();
+    reader.expectEnd();
+    if (root.type != JsonValue::Type::Object) {
+        throw std::invalid_argument("JSON market data must be an object");
+    }
+
+    const JsonValue* table = &root;
+    if (root.find("market_data") || root.find("portfolio")) {
+        table = root.find("market_data");
+    }
+
+    std::map<std::string, MarketData> market_data;
+    if (!table) {
+        return market_data;
+    }
+    if (table->type != JsonValue::Type::Object) {
+        throw std::invalid_argument("market_data must be an object");
+    }
+    for (const auto& [asset_id, md] : table->object) {
+        try {
+            if (md.type != JsonValue::Type::Object) {
+                throw std::invalid_argument("must be an object");
+            }
+            const JsonValue* dividend = md.find("dividend");
+            market_data[asset_id] = MarketData(
+                asset_id, jsonNumber(requiredMember(md, "spot"), "spot"),
+                jsonNumber(requiredMember(md, "rate"), "rate"),
+                jsonNumber(requiredMember(md, "vol"), "vol"),
+                dividend ? jsonNumber(*dividend, "dividend") : 0.0);
+        } catch (const std::invalid_argument& e) {
+            throw std::invalid_argument("Market data for '" + asset_id + "': " + e.what());
+        }
+    }
+    return market_data;
+}
+
+std::ifstream openText(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    return in;
+}
+
+// Unwinds the reader thread of a PositionStream destroyed before the end
+struct StreamStopped {};
+
+} // namespace
+
+namespace PortfolioLoader {
+
+Format formatOf(const std::string& path) {
+    const size_t dot = path.find_last_of('.');
+    const std::string extension = dot == std::string::npos ? "" : lowercase(path.substr(dot + 1));
+    if (extension == "csv") return Format::Csv;
+    if (extension == "json") return Format::Json;
+    if (extension == "qesnap") return Format::Snapshot;
+    throw std::invalid_argument("Unknown file format (expected .csv, .json or .qesnap): " + path);
+}
+
+void readPositions(std::istream& in, Format format,
+                   const std::function<void(const PositionRecord&)>& on_position) {
+    switch (format) {
+        case Format::Csv: readPositionsCsv(in, on_position); return;
+        case Format::Json: readPositionsJson(in, on_position); return;
+        case Format::Snapshot: break;
+    }
+    throw std::invalid_argument("Snapshots are read through PortfolioSnapshot, not a stream");
+}
+
+void loadPositions(const std::string& path, Portfolio& portfolio) {
+    const Format format = formatOf(path);
+    if (format == Format::Snapshot) {
+        PortfolioSnapshot(path).loadInto(portfolio);
+        return;
+    }
+    const size_t initial_size = portfolio.size();
+    try {
+        PositionStream stream(path);
+        while (stream.appendTo(portfolio) > 0) {
+        }
+    } catch (...) {
+        portfolio.truncate(initial_size);
+        throw;
+    }
+}
+
+std::map<std::string, MarketData> readMarketData(std::istream& in, Format format) {
+    switch (format) {
+        case Format::Csv: return readMarketDataCsv(in);
+        case Format::Json: return readMarketDataJson(in);
+        case Format::Snapshot: break;
+    }
+    throw std::invalid_argument("Snapshots are read through PortfolioSnapshot, not a stream");
+}
+
+std::map<std::string, MarketData> loadMarketData(const std::string& path) {
+    const Format format = formatOf(path);
+    if (format == Format::Snapshot) {
+        return PortfolioSnapshot(path).marketData();
+    }
+    std::ifstream in = openText(path);
+    return readMarketData(in, format);
+}
+
+} // namespace PortfolioLoader
+
+PositionStream::PositionStream(const std::string& path, size_t batch_size, size_t max_pending)
+    : batch_size_(batch_size), max_pending_(max_pending) {
+    if (batch_size == 0 || max_pending == 0) {
+        throw std::invalid_argument("Batch size and pending batch limit must be positive");
+    }
+    const PortfolioLoader::Format format = PortfolioLoader::formatOf(path);
+    if (format == PortfolioLoader::Format::Snapshot) {
+        throw std::invalid_argument("Snapshots are read through PortfolioSnapshot, not a stream");
+    }
+    std::ifstream in = openText(path);
+    reader_ = std::thread([this, format, in = std::move(in)]() mutable { readFile(in, format); });
+}
+
+PositionStream::~PositionStream() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    space_ready_.notify_all();
+    reader_.join();
+}
+
+void PositionStream::readFile(std::istream& in, PortfolioLoader::Format format) {
+    try {
+        PositionBuffer batch;
+        batch.reserve(batch_size_);
+        PortfolioLoader::readPositions(in, format, [&](const PositionRecord& record) {
+            batch.add(record);
+            if (batch.size() == batch_size_) {
+                publish(batch);
+            }
+        });
+        if (!batch.empty()) {
+            publish(batch);
+        }
+    } catch (const StreamStopped&) {
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+    }
+    batch_ready_.notify_all();
+}
+
+// Queues a full batch, waiting while max_pending are ahead of the consumer,
+// and refills `batch` with a recycled buffer
+void PositionStream::publish(PositionBuffer& batch) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_ready_.wait(lock, [&] { return pending_.size() < max_pending_ || stopping_; });
+    if (stopping_) {
+        throw StreamStopped();
+    }
+    pending_.push_back(std::move(batch));
+    if (spare_.empty()) {
+        batch = PositionBuffer();
+    } else {
+        batch = std::move(spare_.back());
+        spare_.pop_back();
+    }
+    lock.unlock();
+    batch_ready_.notify_one();
+    batch.reserve(batch_size_);
+}
+
+bool PositionStream::next(PositionBuffer& batch) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    batch_ready_.wait(lock, [&] { return !pending_.empty() || finished_; });
+    if (pending_.empty()) {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        return false;
+    }
+
+    if (spare_.size() < max_pending_) {
+        batch.clear();
+        spare_.push_back(std::move(batch));
+    }
+    batch = std::move(pending_.front());
+    pending_.pop_front();
+    lock.unlock();
+    space_ready_.notify_one();
+    return true;
+}
+
+size_t PositionStream::appendTo(Portfolio& portfolio) {
+    if (!next(batch_)) {
+        return 0;
+    }
+    portfolio.addPositions(batch_.columns());
+    return batch_.size();
+}
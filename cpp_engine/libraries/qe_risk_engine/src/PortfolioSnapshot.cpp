@@ -0,0 +1,268 @@
+#include "PortfolioSnapshot.h"
+#include "Instrument.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+const char kMagic[8] = {'Q', 'E', 'S', 'N', 'A', 'P', '\0', '\0'};
+const uint32_t kVersion = 1;
+const size_t kHeaderSize = 32;
+
+enum Section {
+    IsCall, American, Model, Quantity, Asset, BinomialSteps, Strike, Expiry,
+    JumpIntensity, JumpMean, JumpVol, HasMarketData, MarketStates, kSectionCount
+};
+
+// Element size of each section, and whether it has one entry per asset
+// rather than per position
+const size_t kElementSize[kSectionCount] = {1, 1, 1, 4, 4, 4, 8, 8, 8, 8, 8, 1, sizeof(MarketState)};
+bool perAsset(int section) {
+    return section == HasMarketData || section == MarketStates;
+}
+
+const size_t kSectionsEnd = kHeaderSize + kSectionCount * sizeof(uint64_t);
+
+static_assert(std::is_trivially_copyable<MarketState>::value &&
+              sizeof(MarketState) == 4 * sizeof(double),
+              "MarketState is stored as raw bytes");
+
+size_t alignTo8(size_t offset) {
+    return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+template <typename T>
+T readAt(const char* base, size_t offset) {
+    T value;
+    std::memcpy(&value, base + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+void writeValue(std::ofstream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void writeColumn(std::ofstream& out, const std::vector<T>& column) {
+    const size_t bytes = column.size() * sizeof(T);
+    out.write(reinterpret_cast<const char*>(column.data()), static_cast<std::streamsize>(bytes));
+    const char zeros[8] = {};
+    out.write(zeros, static_cast<std::streamsize>(alignTo8(bytes) - bytes));
+}
+
+} // namespace
+
+PortfolioSnapshot::PortfolioSnapshot(const std::string& path)
+    : mapping_(std::make_unique<MappedFile>(path, "portfolio snapshot")) {
+    const char* base = mapping_->data();
+    const size_t size = mapping_->size();
+    if (size < kSectionsEnd || std::memcmp(base, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a portfolio snapshot: " + path);
+    }
+    if (readAt<uint32_t>(base, 8) != kVersion) {
+        throw std::runtime_error("Unsupported portfolio snapshot version in " + path);
+    }
+
+    const size_t asset_count = readAt<uint32_t>(base, 12);
+    const uint64_t position_count = readAt<uint64_t>(base, 16);
+    const uint64_t directory_offset = readAt<uint64_t>(base, 24);
+    if (directory_offset > size) {
+        throw std::runtime_error("Corrupt portfolio snapshot header in " + path);
+    }
+
+    const char* sections[kSectionCount];
+    for (int s = 0; s < kSectionCount; ++s) {
+        const uint64_t offset = readAt<uint64_t>(base, kHeaderSize + s * sizeof(uint64_t));
+        const uint64_t count = perAsset(s) ? asset_count : position_count;
+        if (offset < kSectionsEnd || offset % 8 != 0 || offset > directory_offset ||
+            count > (directory_offset - offset) / kElementSize[s]) {
+            throw std::runtime_error("Corrupt portfolio snapshot sections in " + path);
+        }
+        sections[s] = base + offset;
+    }
+
+    size_t offset = directory_offset;
+    asset_names_.reserve(asset_count);
+    for (size_t a = 0; a < asset_count; ++a) {
+        if (offset + sizeof(uint32_t) > size) {
+            throw std::runtime_error("Truncated portfolio snapshot directory in " + path);
+        }
+        const uint32_t name_length = readAt<uint32_t>(base, offset);
+        offset += sizeof(uint32_t);
+        if (offset + name_length > size) {
+            throw std::runtime_error("Truncated portfolio snapshot directory in " + path);
+        }
+        asset_names_.emplace_back(base + offset, name_length);
+        offset += name_length;
+    }
+
+    columns_.count = static_cast<size_t>(position_count);
+    columns_.is_call = reinterpret_cast<const uint8_t*>(sections[IsCall]);
+    columns_.american = reinterpret_cast<const uint8_t*>(sections[American]);
+    columns_.model = reinterpret_cast<const uint8_t*>(sections[Model]);
+    columns_.quantity = reinterpret_cast<const int32_t*>(sections[Quantity]);
+    columns_.asset = reinterpret_cast<const int32_t*>(sections[Asset]);
+    columns_.binomial_steps = reinterpret_cast<const int32_t*>(sections[BinomialSteps]);
+    columns_.strike = reinterpret_cast<const double*>(sections[Strike]);
+    columns_.expiry = reinterpret_cast<const double*>(sections[Expiry]);
+    columns_.jump_intensity = reinterpret_cast<const double*>(sections[JumpIntensity]);
+    columns_.jump_mean = reinterpret_cast<const double*>(sections[JumpMean]);
+    columns_.jump_vol = reinterpret_cast<const double*>(sections[JumpVol]);
+    columns_.asset_names = asset_names_.data();
+    columns_.asset_name_count = asset_names_.size();
+    has_market_data_ = reinterpret_cast<const uint8_t*>(sections[HasMarketData]);
+    market_states_ = reinterpret_cast<const MarketState*>(sections[MarketStates]);
+}
+
+PortfolioSnapshot::~PortfolioSnapshot() = default;
+
+bool PortfolioSnapshot::hasMarketData(int asset) const {
+    validateAsset(asset);
+    return has_market_data_[asset] != 0;
+}
+
+const MarketState& PortfolioSnapshot::marketState(int asset) const {
+    validateAsset(asset);
+    return market_states_[asset];
+}
+
+std::map<std::string, MarketData> PortfolioSnapshot::marketData() const {
+    std::map<std::string, MarketData> market_data;
+    for (size_t a = 0; a < asset_names_.size(); ++a) {
+        if (!has_market_data_[a]) {
+            continue;
+        }
+        const MarketState& state = market_states_[a];
+        market_data.emplace(asset_names_[a],
+                            MarketData(asset_names_[a], state.spot_price, state.risk_free_rate,
+                                       state.volatility, state.dividend_yield));
+    }
+    return market_data;
+}
+
+void PortfolioSnapshot::loadInto(Portfolio& portfolio) const {
+    portfolio.addPositions(columns_);
+}
+
+void PortfolioSnapshot::validateAsset(int asset) const {
+    if (asset < 0 || static_cast<size_t>(asset) >= asset_names_.size()) {
+        std::ostringstream oss;
+        oss << "Asset " << asset << " out of range. Asset count: " << asset_names_.size();
+        throw std::out_of_range(oss.str());
+    }
+}
+
+void PortfolioSnapshot::write(const std::string& path,
+                              const Portfolio& portfolio,
+                              const std::map<std::string, MarketData>& market_data) {
+    const auto& instruments = portfolio.getInstruments();
+    const size_t count = instruments.size();
+
+    std::vector<uint8_t> is_call(count), american(count), model(count);
+    std::vector<int32_t> quantity(count), asset(count), binomial_steps(count);
+    std::vector<double> strike(count), expiry(count);
+    std::vector<double> jump_intensity(count, 0.0), jump_mean(count, 0.0), jump_vol(count, 0.0);
+
+    for (size_t i = 0; i < count; ++i) {
+        const Instrument* instrument = instruments[i].first.get();
+        auto reject = [i](const std::string& reason) {
+            throw std::invalid_argument("Position " + std::to_string(i) + ": " + reason);
+        };
+
+        OptionType type = OptionType::Call;
+        if (const auto* option = dynamic_cast<const EuropeanOption*>(instrument)) {
+            if (option->getPricingModel() == PricingModel::Heston) {
+                reject("Heston parameters cannot be stored in a snapshot");
+            }
+            type = option->getOptionType();
+            model[i] = static_cast<uint8_t>(option->getPricingModel());
+            binomial_steps[i] = option->getBinomialSteps();
+            jump_intensity[i] = option->getJumpIntensity();
+            jump_mean[i] = option->getJumpMean();
+            jump_vol[i] = option->getJumpVolatility();
+        } else if (const auto* option = dynamic_cast<const AmericanOption*>(instrument)) {
+            type = option->getOptionType();
+            american[i] = 1;
+            binomial_steps[i] = option->getBinomialSteps();
+        } else {
+            reject(instrument->getInstrumentType() + " cannot be stored in a snapshot");
+        }
+
+        is_call[i] = type == OptionType::Call;
+        strike[i] = instrument->getStrike();
+        expiry[i] = instrument->getTimeToExpiry();
+        quantity[i] = instruments[i].second;
+        asset[i] = portfolio.getPositionAsset(i);
+    }
+
+    // Portfolio assets keep their interned indices; assets with market data
+    // only are appended after them
+    std::vector<std::string> names;
+    for (size_t a = 0; a < portfolio.getAssetCount(); ++a) {
+        names.push_back(portfolio.getAssetName(static_cast<int>(a)));
+    }
+    for (const auto& entry : market_data) {
+        if (portfolio.findAsset(entry.first) < 0) {
+            names.push_back(entry.first);
+        }
+    }
+    std::vector<uint8_t> has_market_data(names.size(), 0);
+    std::vector<MarketState> market_states(names.size());
+    for (size_t a = 0; a < names.size(); ++a) {
+        auto it = market_data.find(names[a]);
+        if (it != market_data.end()) {
+            has_market_data[a] = 1;
+            market_states[a] = MarketState(it->second);
+        }
+    }
+
+    uint64_t offsets[kSectionCount];
+    uint64_t offset = kSectionsEnd;
+    for (int s = 0; s < kSectionCount; ++s) {
+        offsets[s] = offset;
+        offset += alignTo8((perAsset(s) ? names.size() : count) * kElementSize[s]);
+    }
+    const uint64_t directory_offset = offset;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot create portfolio snapshot: " + path);
+    }
+
+    out.write(kMagic, sizeof(kMagic));
+    writeValue<uint32_t>(out, kVersion);
+    writeValue<uint32_t>(out, static_cast<uint32_t>(names.size()));
+    writeValue<uint64_t>(out, count);
+    writeValue<uint64_t>(out, directory_offset);
+    for (uint64_t section_offset : offsets) {
+        writeValue<uint64_t>(out, section_offset);
+    }
+
+    writeColumn(out, is_call);
+    writeColumn(out, american);
+    writeColumn(out, model);
+    writeColumn(out, quantity);
+    writeColumn(out, asset);
+    writeColumn(out, binomial_steps);
+    writeColumn(out, strike);
+    writeColumn(out, expiry);
+    writeColumn(out, jump_intensity);
+    writeColumn(out, jump_mean);
+    writeColumn(out, jump_vol);
+    writeColumn(out, has_market_data);
+    writeColumn(out, market_states);
+
+    for (const auto& name : names) {
+        writeValue<uint32_t>(out, static_cast<uint32_t>(name.size()));
+        out.write(name.data(), static_cast<std::streamsize>(name.size()));
+    }
+
+    if (!out) {
+        throw std::runtime_error("Failed writing portfolio snapshot: " + path);
+    }
+}
@@ -0,0 +1,81 @@
+#include "Profiling.h"
+
+namespace Profiling {
+
+const char* phaseName(Phase phase) {
+    switch (phase) {
+        case Phase::Greeks: return "greeks";
+        case Phase::PathGeneration: return "path_generation";
+        case Phase::Revaluation: return "revaluation";
+        case Phase::TailSort: return "tail_sort";
+        case Phase::Attribution: return "attribution";
+    }
+    return "unknown";
+}
+
+const char* counterName(Counter counter) {
+    switch (counter) {
+        case Counter::Pricings: return "pricings";
+        case Counter::TreeNodes: return "tree_nodes";
+        case Counter::Paths: return "paths";
+    }
+    return "unknown";
+}
+
+void Report::merge(const Report& other) {
+    for (size_t i = 0; i < kPhaseCount; ++i) {
+        phase_seconds[i] += other.phase_seconds[i];
+    }
+    for (size_t i = 0; i < kCounterCount; ++i) {
+        counters[i] += other.counters[i];
+    }
+}
+
+Collector::Collector() : start_(std::chrono::steady_clock::now()) {}
+
+void Collector::merge(const Report& thread_report) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    totals_.merge(thread_report);
+}
+
+Report Collector::report() const {
+    Report report;
+#ifdef QE_ENABLE_PROFILING
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        report = totals_;
+    }
+    report.enabled = true;
+    report.wall_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+#endif
+    return report;
+}
+
+ThreadScope::ThreadScope(Collector* collector) {
+#ifdef QE_ENABLE_PROFILING
+    if (collector && !detail::thread_report) {
+        collector_ = collector;
+        detail::thread_report = &local_;
+        detail::thread_collector = collector;
+    }
+#else
+    (void)collector;
+#endif
+}
+
+ThreadScope::~ThreadScope() {
+    detach();
+}
+
+void ThreadScope::detach() {
+    if (!collector_) {
+        return;
+    }
+    collector_->merge(local_);
+    detail::thread_report = nullptr;
+    detail::thread_collector = nullptr;
+    collector_ = nullptr;
+}
+
+} // namespace Profiling
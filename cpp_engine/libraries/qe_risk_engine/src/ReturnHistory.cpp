@@ -0,0 +1,163 @@
+#include "ReturnHistory.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const char kMagic[8] = {'Q', 'E', 'R', 'H', 'I', 'S', 'T', '\0'};
+const uint32_t kVersion = 1;
+const size_t kHeaderSize = 32;
+
+size_t alignTo8(size_t offset) {
+    return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+template <typename T>
+T readAt(const char* base, size_t offset) {
+    T value;
+    std::memcpy(&value, base + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+void writeValue(std::ofstream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+ReturnHistory::ReturnHistory(const std::string& path)
+    : mapping_(std::make_unique<MappedFile>(path, "return history")) {
+    const char* base = mapping_->data();
+    if (mapping_->size() < kHeaderSize || std::memcmp(base, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a return history file: " + path);
+    }
+    if (readAt<uint32_t>(base, 8) != kVersion) {
+        throw std::runtime_error("Unsupported return history version in " + path);
+    }
+
+    asset_count_ = readAt<uint32_t>(base, 12);
+    day_count_ = readAt<uint32_t>(base, 16);
+    directory_offset_ = readAt<uint64_t>(base, 24);
+
+    const size_t columns_begin = alignTo8(kHeaderSize + day_count_ * sizeof(int32_t));
+    if (directory_offset_ < columns_begin + asset_count_ * day_count_ * sizeof(double) ||
+        directory_offset_ > mapping_->size()) {
+        throw std::runtime_error("Corrupt return history header in " + path);
+    }
+}
+
+ReturnHistory::~ReturnHistory() = default;
+
+const int32_t* ReturnHistory::dates() const {
+    return reinterpret_cast<const int32_t*>(mapping_->data() + kHeaderSize);
+}
+
+void ReturnHistory::loadDirectory() const {
+    const char* base = mapping_->data();
+    const size_t end = mapping_->size();
+    size_t offset = directory_offset_;
+
+    names_.reserve(asset_count_);
+    columns_.reserve(asset_count_);
+    lookup_.reserve(asset_count_);
+
+    for (size_t a = 0; a < asset_count_; ++a) {
+        if (offset + sizeof(uint64_t) + sizeof(uint32_t) > end) {
+            throw std::runtime_error("Truncated return history directory");
+        }
+        const uint64_t column_offset = readAt<uint64_t>(base, offset);
+        const uint32_t name_length = readAt<uint32_t>(base, offset + sizeof(uint64_t));
+        offset += sizeof(uint64_t) + sizeof(uint32_t);
+
+        if (offset + name_length > end ||
+            column_offset % alignof(double) != 0 ||
+            column_offset + day_count_ * sizeof(double) > directory_offset_) {
+            throw std::runtime_error("Corrupt return history directory");
+        }
+
+        names_.emplace_back(base + offset, name_length);
+        columns_.push_back(reinterpret_cast<const double*>(base + column_offset));
+        lookup_.emplace(names_.back(), static_cast<int>(a));
+        offset += name_length;
+    }
+}
+
+int ReturnHistory::findAsset(const std::string& asset_id) const {
+    std::call_once(directory_once_, [this]() { loadDirectory(); });
+    auto it = lookup_.find(asset_id);
+    return it == lookup_.end() ? -1 : it->second;
+}
+
+const std::string& ReturnHistory::assetName(int asset) const {
+    std::call_once(directory_once_, [this]() { loadDirectory(); });
+    validateAsset(asset);
+    return names_[asset];
+}
+
+const double* ReturnHistory::returns(int asset) const {
+    std::call_once(directory_once_, [this]() { loadDirectory(); });
+    validateAsset(asset);
+    return columns_[asset];
+}
+
+void ReturnHistory::validateAsset(int asset) const {
+    if (asset < 0 || static_cast<size_t>(asset) >= asset_count_) {
+        std::ostringstream oss;
+        oss << "Asset " << asset << " out of range. Asset count: " << asset_count_;
+        throw std::out_of_range(oss.str());
+    }
+}
+
+void ReturnHistory::write(const std::string& path,
+                          const std::vector<int32_t>& dates,
+                          const std::vector<std::string>& names,
+                          const std::vector<std::vector<double>>& columns) {
+    if (names.size() != columns.size()) {
+        throw std::invalid_argument("Need one return column per asset");
+    }
+    for (const auto& column : columns) {
+        if (column.size() != dates.size()) {
+            throw std::invalid_argument("Every return column needs one value per date");
+        }
+    }
+
+    const size_t columns_begin = alignTo8(kHeaderSize + dates.size() * sizeof(int32_t));
+    const uint64_t directory_offset = columns_begin + names.size() * dates.size() * sizeof(double);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot create return history: " + path);
+    }
+
+    out.write(kMagic, sizeof(kMagic));
+    writeValue<uint32_t>(out, kVersion);
+    writeValue<uint32_t>(out, static_cast<uint32_t>(names.size()));
+    writeValue<uint32_t>(out, static_cast<uint32_t>(dates.size()));
+    writeValue<uint32_t>(out, 0);
+    writeValue<uint64_t>(out, directory_offset);
+
+    out.write(reinterpret_cast<const char*>(dates.data()),
+              static_cast<std::streamsize>(dates.size() * sizeof(int32_t)));
+    const size_t padding = columns_begin - (kHeaderSize + dates.size() * sizeof(int32_t));
+    const char zeros[8] = {};
+    out.write(zeros, static_cast<std::streamsize>(padding));
+
+    for (const auto& column : columns) {
+        out.write(reinterpret_cast<const char*>(column.data()),
+                  static_cast<std::streamsize>(column.size() * sizeof(double)));
+    }
+
+    for (size_t a = 0; a < names.size(); ++a) {
+        writeValue<uint64_t>(out, columns_begin + a * dates.size() * sizeof(double));
+        writeValue<uint32_t>(out, static_cast<uint32_t>(names[a].size()));
+        out.write(names[a].data(), static_cast<std::streamsize>(names[a].size()));
+    }
+
+    if (!out) {
+        throw std::runtime_error("Failed writing return history: " + path);
+    }
+}
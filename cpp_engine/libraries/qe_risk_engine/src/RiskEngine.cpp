@@ -1,28 +1,246 @@
 #include "RiskEngine.h"
+#include "Parallel.h"
+#include "Profiling.h"
+#include "ReturnHistory.h"
+#include "ScenarioGenerator.h"
 #include <numeric>
 #include <random>
 #include <algorithm>
 #include <vector>
 #include <cmath>
-#include <thread>
+#include <exception>
 #include <sstream>
 #include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace {
+
+// Market data for every asset the portfolio holds, looked up once per asset
+// and addressed by the portfolio's interned asset index
+template <typename Data>
+std::vector<const Data*> joinByAsset(
+    const Portfolio& portfolio,
+    const std::map<std::string, Data>& market_data_map
+) {
+    std::vector<const Data*> joined(portfolio.getAssetCount(), nullptr);
+    
+    for (size_t asset = 0; asset < joined.size(); ++asset) {
+        if (portfolio.getPositionsForAsset(static_cast<int>(asset)).empty()) {
+            continue;
+        }
+        
+        const std::string& asset_id = portfolio.getAssetName(static_cast<int>(asset));
+        auto it = market_data_map.find(asset_id);
+        if (it == market_data_map.end()) {
+            throw std::runtime_error("Missing market data for asset: " + asset_id);
+        }
+        joined[asset] = &it->second;
+    }
+    
+    return joined;
+}
+
+// Every position rolled forward by `years`, built once per run and shared
+// by all scenarios, so revaluation at the horizon sees the right expiry
+std::vector<std::unique_ptr<Instrument>> agedInstruments(const Portfolio& portfolio, double years) {
+    std::vector<std::unique_ptr<Instrument>> aged;
+    aged.reserve(portfolio.size());
+    for (const auto& [instrument, quantity] : portfolio.getInstruments()) {
+        aged.push_back(instrument->aged(years));
+    }
+    return aged;
+}
+
+// The worst scenarios of a P&L distribution, worst first, with the rank
+// windows Euler allocation averages over
+struct TailRanking {
+    std::vector<int> ranked;
+    int index_95 = 0;
+    int index_99 = 0;
+    int lo_95 = 0, hi_95 = 0;
+    int lo_99 = 0, hi_99 = 0;
+    RiskMetrics metrics;
+    double window_loss_95 = 0.0;   // mean portfolio loss over [lo_95, hi_95]
+    double window_loss_99 = 0.0;
+};
+
+TailRanking rankTail(const std::vector<double>& pnl_distribution) {
+    TailRanking tail;
+    const int simulations = static_cast<int>(pnl_distribution.size());
+    if (simulations == 0) {
+        return tail;
+    }
+    
+    tail.index_95 = static_cast<int>((1.0 - 0.95) * simulations);
+    tail.index_99 = static_cast<int>((1.0 - 0.99) * simulations);
+    // A single VaR scenario is too noisy to allocate from; average the
+    // scenarios ranked within +-window of it instead
+    const int window = std::max(1, simulations / 400);
+    const int tail_size = std::min(simulations, tail.index_95 + window + 1);
+    
+    // Only the worst tail_size paths need an order; ties go to the lower
+    // path index so the ranking is deterministic
+    tail.ranked.resize(simulations);
+    std::iota(tail.ranked.begin(), tail.ranked.end(), 0);
+    auto worse = [&](int a, int b) {
+        return pnl_distribution[a] < pnl_distribution[b] ||
+               (pnl_distribution[a] == pnl_distribution[b] && a < b);
+    };
+    std::nth_element(tail.ranked.begin(), tail.ranked.begin() + (tail_size - 1),
+                     tail.ranked.end(), worse);
+    tail.ranked.resize(tail_size);
+    std::sort(tail.ranked.begin(), tail.ranked.end(), worse);
+    
+    auto rankMean = [&](int first, int last) {
+        double sum = 0.0;
+        for (int r = first; r <= last; ++r) {
+            sum += pnl_distribution[tail.ranked[r]];
+        }
+        return sum / (last - first + 1);
+    };
+    
+    tail.lo_95 = std::max(0, tail.index_95 - window);
+    tail.hi_95 = std::min(tail_size - 1, tail.index_95 + window);
+    tail.lo_99 = std::max(0, tail.index_99 - window);
+    tail.hi_99 = std::min(tail_size - 1, tail.index_99 + window);
+    
+    tail.metrics.var_95 = -pnl_distribution[tail.ranked[tail.index_95]];
+    tail.metrics.var_99 = -pnl_distribution[tail.ranked[tail.index_99]];
+    tail.metrics.es_95 = -rankMean(0, tail.index_95);
+    tail.metrics.es_99 = -rankMean(0, tail.index_99);
+    tail.window_loss_95 = -rankMean(tail.lo_95, tail.hi_95);
+    tail.window_loss_99 = -rankMean(tail.lo_99, tail.hi_99);
+    
+    return tail;
+}
+
+// Component VaR/ES of one slice of the portfolio whose P&L on the scenario
+// of a given rank is pnl_at(rank)
+template <typename PnlAt>
+void allocateComponents(const TailRanking& tail, PnlAt pnl_at, RiskContribution& out) {
+    double tail_95 = 0.0, tail_99 = 0.0, near_95 = 0.0, near_99 = 0.0;
+    for (int r = 0; r < static_cast<int>(tail.ranked.size()); ++r) {
+        const double pnl = pnl_at(r);
+        if (r <= tail.index_95) tail_95 += pnl;
+        if (r <= tail.index_99) tail_99 += pnl;
+        if (r >= tail.lo_95 && r <= tail.hi_95) near_95 += pnl;
+        if (r >= tail.lo_99 && r <= tail.hi_99) near_99 += pnl;
+    }
+    
+    out.component_es_95 = -tail_95 / (tail.index_95 + 1);
+    out.component_es_99 = -tail_99 / (tail.index_99 + 1);
+    out.component_var_95 = -near_95 / (tail.hi_95 - tail.lo_95 + 1);
+    out.component_var_99 = -near_99 / (tail.hi_99 - tail.lo_99 + 1);
+    
+    // The window means add up to the window's portfolio loss, not exactly
+    // to VaR; rescale so the components do
+    if (std::abs(tail.window_loss_95) > 1e-12) {
+        out.component_var_95 *= tail.metrics.var_95 / tail.window_loss_95;
+    }
+    if (std::abs(tail.window_loss_99) > 1e-12) {
+        out.component_var_99 *= tail.metrics.var_99 / tail.window_loss_99;
+    }
+}
+
+// Filtered historical simulation (Barone-Adesi et al.): each return is
+// divided by the EWMA volatility prevailing on its day and multiplied by the
+// latest one. The recursion is seeded with the window's mean square return.
+std::vector<double> filterReturns(const double* returns, size_t days, double lambda) {
+    double sum_squares = 0.0;
+    size_t observed = 0;
+    for (size_t d = 0; d < days; ++d) {
+        if (!std::isnan(returns[d])) {
+            sum_squares += returns[d] * returns[d];
+            ++observed;
+        }
+    }
+    
+    double variance = observed > 0 ? sum_squares / observed : 0.0;
+    std::vector<double> day_volatility(days);
+    for (size_t d = 0; d < days; ++d) {
+        day_volatility[d] = std::sqrt(variance);
+        if (!std::isnan(returns[d])) {
+            variance = lambda * variance + (1.0 - lambda) * returns[d] * returns[d];
+        }
+    }
+    const double current_volatility = std::sqrt(variance);
+    
+    std::vector<double> filtered(returns, returns + days);
+    for (size_t d = 0; d < days; ++d) {
+        if (!std::isnan(filtered[d]) && day_volatility[d] > 0.0) {
+            filtered[d] *= current_volatility / day_volatility[d];
+        }
+    }
+    return filtered;
+}
+
+} // namespace
+
+struct RiskEngine::VersionedCache {
+    struct PositionEntry {
+        uint64_t asset_version = 0;
+        double price = 0.0;   // per unit
+        double delta = 0.0;
+        double gamma = 0.0;
+        double vega = 0.0;
+        double theta = 0.0;
+        bool seen = false;
+    };
+    
+    struct AssetEntry {
+        uint64_t version = 0;
+        uint64_t fingerprint = 0;   // positions and quantities on the asset
+        std::vector<double> pnl;    // summed P&L of those positions per path
+        bool seen = false;
+    };
+    
+    std::mutex mutex;
+    uint64_t seed = 0;
+    int simulations = 0;
+    double time_horizon_days = 0.0;
+    std::unordered_map<uint64_t, PositionEntry> positions;
+    std::map<std::string, AssetEntry> assets;
+    RiskCacheStats last_stats;
+    
+    void reset() {
+        positions.clear();
+        assets.clear();
+        simulations = 0;
+    }
+};
 
 RiskEngine::RiskEngine() 
     : var_simulations_(10000),
       time_horizon_days_(1.0),
       random_seed_(0),
-      use_fixed_seed_(false) {
+      use_fixed_seed_(false),
+      cache_(std::make_unique<VersionedCache>()) {
 }
 
 RiskEngine::RiskEngine(int var_simulations)
     : var_simulations_(var_simulations),
       time_horizon_days_(1.0),
       random_seed_(0),
-      use_fixed_seed_(false) {
+      use_fixed_seed_(false),
+      cache_(std::make_unique<VersionedCache>()) {
     validateParameters();
 }
 
+RiskEngine::~RiskEngine() = default;
+
+void RiskEngine::clearCache() {
+    std::lock_guard<std::mutex> lock(cache_->mutex);
+    cache_->reset();
+    cache_->last_stats = RiskCacheStats();
+}
+
+RiskCacheStats RiskEngine::getLastCacheStats() const {
+    std::lock_guard<std::mutex> lock(cache_->mutex);
+    return cache_->last_stats;
+}
+
 void RiskEngine::setVaRSimulations(int simulations) {
     if (simulations <= 0) {
         throw std::invalid_argument("VaR simulations must be positive");
@@ -30,10 +248,12 @@ void RiskEngine::setVaRSimulations(int simulations) {
     if (simulations > 1000000) {
         throw std::invalid_argument("VaR simulations cannot exceed 1,000,000");
     }
+    std::unique_lock<std::shared_mutex> settings_lock(settings_mutex_);
     var_simulations_ = simulations;
 }
 
 int RiskEngine::getVaRSimulations() const {
+    std::shared_lock<std::shared_mutex> settings_lock(settings_mutex_);
     return var_simulations_;
 }
 
@@ -44,19 +264,23 @@ void RiskEngine::setVaRTimeHorizonDays(double days) {
     if (days > 252.0) {
         throw std::invalid_argument("Time horizon cannot exceed 252 trading days");
     }
+    std::unique_lock<std::shared_mutex> settings_lock(settings_mutex_);
     time_horizon_days_ = days;
 }
 
 double RiskEngine::getVaRTimeHorizonDays() const {
+    std::shared_lock<std::shared_mutex> settings_lock(settings_mutex_);
     return time_horizon_days_;
 }
 
 void RiskEngine::setRandomSeed(unsigned int seed) {
+    std::unique_lock<std::shared_mutex> settings_lock(settings_mutex_);
     random_seed_ = seed;
     use_fixed_seed_ = true;
 }
 
 void RiskEngine::setUseFixedSeed(bool use_fixed) {
+    std::unique_lock<std::shared_mutex> settings_lock(settings_mutex_);
     use_fixed_seed_ = use_fixed;
 }
 
@@ -69,54 +293,49 @@ void RiskEngine::validateParameters() const {
     }
 }
 
-void RiskEngine::validateMarketData(
+void RiskEngine::validateAssetMarketData(const std::string& asset_id, const MarketState& md) const {
+    if (md.spot_price <= 0.0) {
+        throw std::invalid_argument("Spot price must be positive for " + asset_id);
+    }
+    if (md.volatility < 0.0) {
+        throw std::invalid_argument("Volatility cannot be negative for " + asset_id);
+    }
+    if (std::isnan(md.spot_price) || std::isinf(md.spot_price)) {
+        throw std::invalid_argument("Invalid spot price for " + asset_id);
+    }
+    if (std::isnan(md.risk_free_rate) || std::isinf(md.risk_free_rate)) {
+        throw std::invalid_argument("Invalid risk-free rate for " + asset_id);
+    }
+    if (std::isnan(md.volatility) || std::isinf(md.volatility)) {
+        throw std::invalid_argument("Invalid volatility for " + asset_id);
+    }
+}
+
+std::vector<AssetId> RiskEngine::joinMarketData(
     const Portfolio& portfolio,
-    const std::map<std::string, MarketData>& market_data_map
+    const MarketDataTable& market_data
 ) const {
-    const auto& instruments = portfolio.getInstruments();
+    std::vector<AssetId> joined(portfolio.getAssetCount(), AssetSymbolTable::npos);
     
-    for (const auto& [instrument, quantity] : instruments) {
-        if (!instrument) {
-            throw std::runtime_error("Portfolio contains null instrument");
-        }
-        
-        std::string asset_id;
-        try {
-            asset_id = instrument->getAssetId();
-        } catch (const std::exception& e) {
-            throw std::runtime_error(std::string("Failed to get asset ID: ") + e.what());
-        }
-        
-        if (asset_id.empty()) {
-            throw std::runtime_error("Instrument has empty asset ID");
+    for (size_t asset = 0; asset < joined.size(); ++asset) {
+        if (portfolio.getPositionsForAsset(static_cast<int>(asset)).empty()) {
+            continue;
         }
         
-        if (market_data_map.find(asset_id) == market_data_map.end()) {
+        const std::string& asset_id = portfolio.getAssetName(static_cast<int>(asset));
+        const AssetId id = market_data.find(asset_id);
+        if (id == AssetSymbolTable::npos) {
             throw std::runtime_error("Missing market data for asset: " + asset_id);
         }
-        
-        const MarketData& md = market_data_map.at(asset_id);
-        
-        if (md.spot_price <= 0.0) {
-            throw std::invalid_argument("Spot price must be positive for " + asset_id);
-        }
-        if (md.volatility < 0.0) {
-            throw std::invalid_argument("Volatility cannot be negative for " + asset_id);
-        }
-        if (std::isnan(md.spot_price) || std::isinf(md.spot_price)) {
-            throw std::invalid_argument("Invalid spot price for " + asset_id);
-        }
-        if (std::isnan(md.risk_free_rate) || std::isinf(md.risk_free_rate)) {
-            throw std::invalid_argument("Invalid risk-free rate for " + asset_id);
-        }
-        if (std::isnan(md.volatility) || std::isinf(md.volatility)) {
-            throw std::invalid_argument("Invalid volatility for " + asset_id);
-        }
+        validateAssetMarketData(asset_id, market_data.getState(id));
+        joined[asset] = id;
     }
+    
+    return joined;
 }
 
 double RiskEngine::calculateSingleInstrumentMetric(
-    const std::unique_ptr<Instrument>& instrument,
+    const InstrumentPtr& instrument,
     int quantity,
     const MarketData& md,
     const std::string& metric_name
@@ -162,37 +381,317 @@ double RiskEngine::calculateSingleInstrumentMetric(
 PortfolioRiskResult RiskEngine::calculatePortfolioRisk(
     const Portfolio& portfolio, 
     const std::map<std::string, MarketData>& market_data_map
-) {
+) const {
+    return calculatePortfolioRisk(portfolio, MarketDataTable(market_data_map));
+}
+
+PortfolioRiskResult RiskEngine::calculatePortfolioRisk(
+    const Portfolio& portfolio, 
+    const MarketDataTable& market_data
+) const {
+    std::shared_lock<std::shared_mutex> settings_lock(settings_mutex_);
     validateParameters();
     
-    PortfolioRiskResult result;
-    result.reset();
+    if (portfolio.empty()) {
+        PortfolioRiskResult result;
+        result.reset();
+        return result;
+    }
+    
+    return calculateRisk(portfolio, resolvePositions(portfolio, market_data));
+}
+
+std::vector<RiskEngine::PositionMarketData> RiskEngine::resolvePositions(
+    const Portfolio& portfolio,
+    const MarketDataTable& market_data
+) const {
+    const std::vector<AssetId> asset_ids = joinMarketData(portfolio, market_data);
+    
+    // One string-carrying MarketData per asset, shared by its positions
+    std::vector<MarketData> asset_market_data(asset_ids.size());
+    for (size_t asset = 0; asset < asset_ids.size(); ++asset) {
+        if (asset_ids[asset] != AssetSymbolTable::npos) {
+            asset_market_data[asset] = market_data.getMarketData(asset_ids[asset]);
+        }
+    }
+    
+    std::vector<PositionMarketData> position_market_data;
+    position_market_data.reserve(portfolio.size());
+    
+    for (size_t p = 0; p < portfolio.size(); ++p) {
+        const int asset = portfolio.getPositionAsset(p);
+        position_market_data.push_back({market_data.getState(asset_ids[asset]),
+                                        asset_market_data[asset]});
+    }
+    
+    return position_market_data;
+}
+
+PortfolioRiskResult RiskEngine::calculatePortfolioRisk(
+    const Portfolio& portfolio, 
+    const std::map<std::string, SurfaceMarketData>& market_data_map
+) const {
+    std::shared_lock<std::shared_mutex> settings_lock(settings_mutex_);
+    validateParameters();
     
     if (portfolio.empty()) {
+        PortfolioRiskResult result;
+        result.reset();
         return result;
     }
     
-    validateMarketData(portfolio, market_data_map);
+    const std::vector<const SurfaceMarketData*> asset_market_data =
+        joinByAsset(portfolio, market_data_map);
+    for (size_t asset = 0; asset < asset_market_data.size(); ++asset) {
+        if (asset_market_data[asset]) {
+            validateAssetMarketData(portfolio.getAssetName(static_cast<int>(asset)),
+                                    MarketState(asset_market_data[asset]->base));
+        }
+    }
+    
+    std::vector<PositionMarketData> position_market_data;
+    position_market_data.reserve(portfolio.size());
     
     const auto& instruments = portfolio.getInstruments();
+    for (size_t p = 0; p < instruments.size(); ++p) {
+        const auto& instrument = instruments[p].first;
+        const int asset = portfolio.getPositionAsset(p);
+        const std::string& asset_id = portfolio.getAssetName(asset);
+        const SurfaceMarketData& smd = *asset_market_data[asset];
+        
+        MarketData pricing;
+        try {
+            pricing = instrument->resolveMarketData(smd);
+        } catch (const std::exception& e) {
+            throw std::runtime_error(
+                "Failed to resolve market data for " + asset_id + ": " + e.what()
+            );
+        }
+        validateAssetMarketData(asset_id, MarketState(pricing));
+        
+        position_market_data.push_back({MarketState(smd.base), pricing});
+    }
     
-    for (const auto& [instrument, quantity] : instruments) {
-        std::string asset_id = instrument->getAssetId();
-        const MarketData& md = market_data_map.at(asset_id);
+    return calculateRisk(portfolio, position_market_data);
+}
+
+PortfolioRiskResult RiskEngine::calculatePortfolioRisk(
+    const Portfolio& portfolio, 
+    const MarketDataManager& market_data
+) const {
+    std::shared_lock<std::shared_mutex> settings_lock(settings_mutex_);
+    validateParameters();
+    
+    if (portfolio.empty()) {
+        PortfolioRiskResult result;
+        result.reset();
+        return result;
+    }
+    
+    const auto& instruments = portfolio.getInstruments();
+    
+    std::lock_guard<std::mutex> lock(cache_->mutex);
+    VersionedCache& cache = *cache_;
+    
+    // The cached P&L vectors are only valid for the scenarios they were built on
+    uint64_t seed = cache.seed;
+    if (use_fixed_seed_) {
+        seed = random_seed_;
+    } else if (cache.simulations == 0) {
+        std::random_device rd;
+        seed = rd();
+    }
+    if (cache.simulations != var_simulations_ || cache.seed != seed ||
+        cache.time_horizon_days != time_horizon_days_) {
+        cache.reset();
+        cache.seed = seed;
+        cache.simulations = var_simulations_;
+        cache.time_horizon_days = time_horizon_days_;
+    }
+    
+    Profiling::Collector collector;
+    Profiling::ThreadScope profile_scope(&collector);
+    
+    RiskCacheStats stats;
+    PortfolioRiskResult result;
+    result.reset();
+    result.position_risk.resize(instruments.size());
+    double initial_portfolio_value = 0.0;
+    std::vector<const VersionedCache::AssetEntry*> asset_entries(portfolio.getAssetCount(), nullptr);
+    std::vector<double> pnl_distribution(var_simulations_, 0.0);
+    const double dt = time_horizon_days_ / 252.0;
+    
+    for (int asset_index = 0; asset_index < static_cast<int>(portfolio.getAssetCount()); ++asset_index) {
+        const std::vector<size_t>& indices = portfolio.getPositionsForAsset(asset_index);
+        if (indices.empty()) {
+            continue;
+        }
+        
+        const std::string& asset_id = portfolio.getAssetName(asset_index);
+        if (!market_data.hasMarketData(asset_id)) {
+            throw std::runtime_error("Missing market data for asset: " + asset_id);
+        }
+        const MarketData& md = market_data.getMarketDataRef(asset_id);
+        validateAssetMarketData(asset_id, MarketState(md));
+        const uint64_t version = market_data.getVersion(asset_id);
+        
+        uint64_t fingerprint = Scenario::assetStream(asset_id);
+        std::vector<const VersionedCache::PositionEntry*> entries;
+        entries.reserve(indices.size());
         
-        result.total_pv += calculateSingleInstrumentMetric(instrument, quantity, md, "price");
-        result.total_delta += calculateSingleInstrumentMetric(instrument, quantity, md, "delta");
-        result.total_gamma += calculateSingleInstrumentMetric(instrument, quantity, md, "gamma");
-        result.total_vega += calculateSingleInstrumentMetric(instrument, quantity, md, "vega");
-        result.total_theta += calculateSingleInstrumentMetric(instrument, quantity, md, "theta");
+        for (size_t p : indices) {
+            const auto& [instrument, quantity] = instruments[p];
+            const uint64_t position_id = portfolio.getPositionId(p);
+            
+            auto found = cache.positions.find(position_id);
+            if (found == cache.positions.end() || found->second.asset_version != version) {
+                QE_PROFILE_PHASE(Profiling::Phase::Greeks);
+                VersionedCache::PositionEntry entry;
+                entry.asset_version = version;
+                entry.price = calculateSingleInstrumentMetric(instrument, 1, md, "price");
+                entry.delta = calculateSingleInstrumentMetric(instrument, 1, md, "delta");
+                entry.gamma = calculateSingleInstrumentMetric(instrument, 1, md, "gamma");
+                entry.vega = calculateSingleInstrumentMetric(instrument, 1, md, "vega");
+                entry.theta = calculateSingleInstrumentMetric(instrument, 1, md, "theta");
+                found = cache.positions.insert_or_assign(position_id, entry).first;
+                ++stats.repriced_positions;
+            }
+            
+            VersionedCache::PositionEntry& entry = found->second;
+            entry.seen = true;
+            entries.push_back(&entry);
+            
+            RiskContribution& position = result.position_risk[p];
+            position.pv = entry.price * quantity;
+            position.delta = entry.delta * quantity;
+            position.gamma = entry.gamma * quantity;
+            position.vega = entry.vega * quantity;
+            position.theta = entry.theta * quantity;
+            
+            result.total_pv += position.pv;
+            result.total_delta += position.delta;
+            result.total_gamma += position.gamma;
+            result.total_vega += position.vega;
+            result.total_theta += position.theta;
+            initial_portfolio_value += position.pv;
+            
+            fingerprint = (fingerprint ^ position_id) * 0x100000001b3ULL;
+            fingerprint = (fingerprint ^ static_cast<uint32_t>(quantity)) * 0x100000001b3ULL;
+        }
+        
+        VersionedCache::AssetEntry& asset = cache.assets[asset_id];
+        asset.seen = true;
+        
+        if (asset.version != version || asset.fingerprint != fingerprint ||
+            asset.pnl.size() != static_cast<size_t>(var_simulations_)) {
+            asset.pnl.assign(var_simulations_, 0.0);
+            const uint64_t stream = Scenario::assetStream(asset_id);
+            
+            std::vector<std::unique_ptr<Instrument>> at_horizon;
+            at_horizon.reserve(indices.size());
+            for (size_t p : indices) {
+                at_horizon.push_back(instruments[p].first->aged(dt));
+            }
+            
+            QE_PROFILE_COUNT(Profiling::Counter::Paths, var_simulations_);
+            runPaths([&](int start, int end) {
+                QE_PROFILE_PHASE(Profiling::Phase::Revaluation);
+                MarketData simulated_md = md;
+                for (int i = start; i < end; ++i) {
+                    const double shock = Scenario::standardNormal(cache.seed, stream, i);
+                    simulated_md.spot_price = Scenario::simulatedSpot(md, dt, shock);
+                    
+                    double path_pnl = 0.0;
+                    for (size_t k = 0; k < indices.size(); ++k) {
+                        const int quantity = instruments[indices[k]].second;
+                        const double simulated_price = at_horizon[k]->price(simulated_md);
+                        if (std::isnan(simulated_price) || std::isinf(simulated_price)) {
+                            throw std::runtime_error("Invalid simulated price in VaR calculation");
+                        }
+                        path_pnl += (simulated_price - entries[k]->price) * quantity;
+                    }
+                    asset.pnl[i] = path_pnl;
+                }
+            });
+            
+            asset.version = version;
+            asset.fingerprint = fingerprint;
+            ++stats.revalued_assets;
+        }
+        
+        for (int i = 0; i < var_simulations_; ++i) {
+            pnl_distribution[i] += asset.pnl[i];
+        }
+        asset_entries[asset_index] = &asset;
+    }
+    
+    // Evict positions and assets that have left the book
+    for (auto it = cache.positions.begin(); it != cache.positions.end();) {
+        if (!it->second.seen) {
+            it = cache.positions.erase(it);
+        } else {
+            it->second.seen = false;
+            ++it;
+        }
+    }
+    for (auto it = cache.assets.begin(); it != cache.assets.end();) {
+        if (!it->second.seen) {
+            it = cache.assets.erase(it);
+        } else {
+            it->second.seen = false;
+            ++it;
+        }
     }
     
+    stats.cached_positions = cache.positions.size();
+    stats.cached_assets = cache.assets.size();
+    cache.last_stats = stats;
+    
     if (!result.isValid()) {
         throw std::runtime_error("Portfolio risk calculation produced invalid results");
     }
     
+    aggregateByAsset(portfolio, result);
+    
+    if (std::abs(initial_portfolio_value) >= 1e-10) {
+        // The cached per-asset P&L vectors give asset components directly;
+        // position components would need the tail repriced, which is what
+        // this path exists to avoid
+        const TailRanking tail = [&] {
+            QE_PROFILE_PHASE(Profiling::Phase::TailSort);
+            return rankTail(pnl_distribution);
+        }();
+        for (size_t asset = 0; asset < asset_entries.size(); ++asset) {
+            if (asset_entries[asset]) {
+                const std::vector<double>& asset_pnl = asset_entries[asset]->pnl;
+                allocateComponents(tail, [&](int rank) { return asset_pnl[tail.ranked[rank]]; },
+                                   result.asset_risk[asset]);
+            }
+        }
+        
+        result.value_at_risk_95 = tail.metrics.var_95;
+        result.value_at_risk_99 = tail.metrics.var_99;
+        result.expected_shortfall_95 = tail.metrics.es_95;
+        result.expected_shortfall_99 = tail.metrics.es_99;
+    }
+    
+    profile_scope.detach();
+    result.profile = collector.report();
+    return result;
+}
+
+PortfolioRiskResult RiskEngine::calculateRisk(
+    const Portfolio& portfolio,
+    const std::vector<PositionMarketData>& position_market_data
+) const {
+    Profiling::Collector collector;
+    Profiling::ThreadScope profile_scope(&collector);
+    
+    PortfolioRiskResult result = valuePositions(portfolio, position_market_data);
+    
     try {
-        RiskMetrics metrics = calculateRiskMetrics(portfolio, market_data_map);
+        RiskMetrics metrics = calculateRiskMetrics(portfolio, position_market_data,
+                                                   result.position_risk);
         result.value_at_risk_95 = metrics.var_95;
         result.value_at_risk_99 = metrics.var_99;
         result.expected_shortfall_95 = metrics.es_95;
@@ -201,26 +700,315 @@ PortfolioRiskResult RiskEngine::calculatePortfolioRisk(
         throw std::runtime_error(std::string("Risk metrics calculation failed: ") + e.what());
     }
     
+    aggregateByAsset(portfolio, result);
+    
+    profile_scope.detach();
+    result.profile = collector.report();
+    return result;
+}
+
+PortfolioRiskResult RiskEngine::valuePositions(
+    const Portfolio& portfolio,
+    const std::vector<PositionMarketData>& position_market_data
+) const {
+    PortfolioRiskResult result;
+    result.reset();
+    
+    const auto& instruments = portfolio.getInstruments();
+    result.position_risk.resize(instruments.size());
+    
+    QE_PROFILE_PHASE(Profiling::Phase::Greeks);
+    for (size_t i = 0; i < instruments.size(); ++i) {
+        const auto& [instrument, quantity] = instruments[i];
+        const MarketData& md = position_market_data[i].pricing;
+        RiskContribution& position = result.position_risk[i];
+        
+        position.pv = calculateSingleInstrumentMetric(instrument, quantity, md, "price");
+        position.delta = calculateSingleInstrumentMetric(instrument, quantity, md, "delta");
+        position.gamma = calculateSingleInstrumentMetric(instrument, quantity, md, "gamma");
+        position.vega = calculateSingleInstrumentMetric(instrument, quantity, md, "vega");
+        position.theta = calculateSingleInstrumentMetric(instrument, quantity, md, "theta");
+        
+        result.total_pv += position.pv;
+        result.total_delta += position.delta;
+        result.total_gamma += position.gamma;
+        result.total_vega += position.vega;
+        result.total_theta += position.theta;
+    }
+    
+    if (!result.isValid()) {
+        throw std::runtime_error("Portfolio risk calculation produced invalid results");
+    }
+    
+    return result;
+}
+
+void RiskEngine::runPaths(const std::function<void(int, int)>& worker) const {
+    // Below ~1k paths per thread the spawn cost dominates. Scenarios depend
+    // only on the path index, so the split does not change the result.
+    Parallel::parallelFor(var_simulations_, 1024, worker);
+}
+
+RiskMetrics riskMetricsFromDistribution(std::vector<double>& pnl_distribution) {
+    RiskMetrics metrics;
+    const int simulations = static_cast<int>(pnl_distribution.size());
+    if (simulations == 0) {
+        return metrics;
+    }
+    
+    const int index_95 = static_cast<int>((1.0 - 0.95) * simulations);
+    if (index_95 < 0 || index_95 >= simulations) {
+        throw std::runtime_error("Invalid VaR 95% index calculation");
+    }
+    const int index_99 = static_cast<int>((1.0 - 0.99) * simulations);
+    if (index_99 < 0 || index_99 >= simulations) {
+        throw std::runtime_error("Invalid VaR 99% index calculation");
+    }
+    
+    // Selection instead of a full sort: after nth_element everything before
+    // the VaR index is a worse (or equal) outcome, which is all ES needs
+    auto begin = pnl_distribution.begin();
+    std::nth_element(begin, begin + index_95, pnl_distribution.end());
+    metrics.var_95 = -pnl_distribution[index_95];
+    
+    // ES is the average of losses beyond VaR, the VaR scenario included
+    metrics.es_95 = -std::accumulate(begin, begin + index_95 + 1, 0.0) / (index_95 + 1);
+    
+    // The 99% tail lies inside the 95% one
+    std::nth_element(begin, begin + index_99, begin + index_95 + 1);
+    metrics.var_99 = -pnl_distribution[index_99];
+    metrics.es_99 = -std::accumulate(begin, begin + index_99 + 1, 0.0) / (index_99 + 1);
+    
+    return metrics;
+}
+
+RiskMetrics riskMetricsFromWeightedDistribution(
+    const std::vector<double>& pnl_distribution,
+    const std::vector<double>& weights
+) {
+    RiskMetrics metrics;
+    if (pnl_distribution.empty()) {
+        return metrics;
+    }
+    if (weights.size() != pnl_distribution.size()) {
+        throw std::invalid_argument("Need one weight per scenario");
+    }
+    
+    double total_weight = 0.0;
+    for (double w : weights) {
+        if (w < 0.0 || std::isnan(w) || std::isinf(w)) {
+            throw std::invalid_argument("Scenario weights must be finite and non-negative");
+        }
+        total_weight += w;
+    }
+    if (total_weight <= 0.0) {
+        throw std::invalid_argument("Scenario weights sum to zero");
+    }
+    
+    std::vector<size_t> order(pnl_distribution.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return pnl_distribution[a] < pnl_distribution[b];
+    });
+    
+    auto tail = [&](double probability, double& var, double& es) {
+        double cumulative = 0.0;
+        double weighted_pnl = 0.0;
+        for (size_t k = 0; k < order.size(); ++k) {
+            const double pnl = pnl_distribution[order[k]];
+            const double w = weights[order[k]] / total_weight;
+            if (cumulative + w >= probability || k + 1 == order.size()) {
+                // Only the part of this scenario's weight inside the tail counts
+                weighted_pnl += (probability - cumulative) * pnl;
+                var = -pnl;
+                es = -weighted_pnl / probability;
+                return;
+            }
+            cumulative += w;
+            weighted_pnl += w * pnl;
+        }
+    };
+    
+    tail(1.0 - 0.95, metrics.var_95, metrics.es_95);
+    tail(1.0 - 0.99, metrics.var_99, metrics.es_99);
+    
+    return metrics;
+}
+
+PortfolioRiskResult RiskEngine::calculateHistoricalRisk(
+    const Portfolio& portfolio,
+    const std::map<std::string, MarketData>& market_data_map,
+    const ReturnHistory& history,
+    const HistoricalSimulationOptions& options
+) const {
+    return calculateHistoricalRisk(portfolio, MarketDataTable(market_data_map), history, options);
+}
+
+PortfolioRiskResult RiskEngine::calculateHistoricalRisk(
+    const Portfolio& portfolio,
+    const MarketDataTable& market_data,
+    const ReturnHistory& history,
+    const HistoricalSimulationOptions& options
+) const {
+    std::shared_lock<std::shared_mutex> settings_lock(settings_mutex_);
+    validateParameters();
+    if (!(options.ewma_lambda > 0.0 && options.ewma_lambda <= 1.0)) {
+        throw std::invalid_argument("EWMA lambda must be in (0, 1]");
+    }
+    if (!(options.volatility_lambda > 0.0 && options.volatility_lambda < 1.0)) {
+        throw std::invalid_argument("Volatility lambda must be in (0, 1)");
+    }
+    
+    if (portfolio.empty()) {
+        PortfolioRiskResult result;
+        result.reset();
+        return result;
+    }
+    
+    Profiling::Collector collector;
+    Profiling::ThreadScope profile_scope(&collector);
+    
+    const std::vector<PositionMarketData> position_market_data =
+        resolvePositions(portfolio, market_data);
+    PortfolioRiskResult result = valuePositions(portfolio, position_market_data);
+    
+    const size_t total_days = history.dayCount();
+    const size_t days = options.window_days == 0 ? total_days
+                                                 : std::min(options.window_days, total_days);
+    if (days == 0) {
+        throw std::runtime_error("Return history has no days");
+    }
+    const size_t first_day = total_days - days;
+    
+    // Columns are read straight from the mapping unless FHS rescales them;
+    // only the assets held are ever touched
+    std::vector<const double*> asset_returns(portfolio.getAssetCount(), nullptr);
+    std::vector<std::vector<double>> filtered_returns(portfolio.getAssetCount());
+    for (size_t asset = 0; asset < asset_returns.size(); ++asset) {
+        if (portfolio.getPositionsForAsset(static_cast<int>(asset)).empty()) {
+            continue;
+        }
+        const std::string& asset_id = portfolio.getAssetName(static_cast<int>(asset));
+        const int column = history.findAsset(asset_id);
+        if (column < 0) {
+            throw std::runtime_error("Missing return history for asset: " + asset_id);
+        }
+        
+        asset_returns[asset] = history.returns(column) + first_day;
+        if (options.filtered) {
+            filtered_returns[asset] = filterReturns(asset_returns[asset], days,
+                                                    options.volatility_lambda);
+            asset_returns[asset] = filtered_returns[asset].data();
+        }
+    }
+    
+    const auto& instruments = portfolio.getInstruments();
+    std::vector<double> base_prices(instruments.size());
+    for (size_t p = 0; p < instruments.size(); ++p) {
+        base_prices[p] = instruments[p].first->price(position_market_data[p].pricing);
+    }
+    
+    const double horizon_scale = std::sqrt(time_horizon_days_);
+    const std::vector<std::unique_ptr<Instrument>> at_horizon =
+        agedInstruments(portfolio, time_horizon_days_ / 252.0);
+    auto simulatedSpot = [&](size_t p, size_t day) {
+        const double spot = position_market_data[p].asset.spot_price;
+        const double r = asset_returns[portfolio.getPositionAsset(p)][day];
+        // A missing observation leaves the price where it is
+        return std::isnan(r) ? spot : spot * std::exp(r * horizon_scale);
+    };
+    
+    std::vector<double> pnl_distribution(days);
+    QE_PROFILE_COUNT(Profiling::Counter::Paths, days);
+    Parallel::parallelFor(static_cast<int>(days), 64, [&](int start, int end) {
+        QE_PROFILE_PHASE(Profiling::Phase::Revaluation);
+        std::vector<MarketData> simulated_md(instruments.size());
+        for (size_t p = 0; p < instruments.size(); ++p) {
+            simulated_md[p] = position_market_data[p].pricing;
+        }
+        
+        for (int d = start; d < end; ++d) {
+            double pnl = 0.0;
+            for (size_t p = 0; p < instruments.size(); ++p) {
+                simulated_md[p].spot_price = simulatedSpot(p, d);
+                
+                const double simulated_price = at_horizon[p]->price(simulated_md[p]);
+                if (std::isnan(simulated_price) || std::isinf(simulated_price)) {
+                    throw std::runtime_error("Invalid simulated price in historical VaR");
+                }
+                pnl += (simulated_price - base_prices[p]) * instruments[p].second;
+            }
+            pnl_distribution[d] = pnl;
+        }
+    });
+    
+    RiskMetrics metrics;
+    if (options.ewma_lambda < 1.0) {
+        QE_PROFILE_PHASE(Profiling::Phase::TailSort);
+        std::vector<double> weights(days);
+        for (size_t d = 0; d < days; ++d) {
+            weights[d] = std::pow(options.ewma_lambda, static_cast<double>(days - 1 - d));
+        }
+        metrics = riskMetricsFromWeightedDistribution(pnl_distribution, weights);
+    } else {
+        const TailRanking tail = [&] {
+            QE_PROFILE_PHASE(Profiling::Phase::TailSort);
+            return rankTail(pnl_distribution);
+        }();
+        metrics = tail.metrics;
+        
+        Parallel::parallelFor(static_cast<int>(instruments.size()), 1, [&](int start, int end) {
+            QE_PROFILE_PHASE(Profiling::Phase::Attribution);
+            MarketData simulated_md;
+            for (int p = start; p < end; ++p) {
+                const int quantity = instruments[p].second;
+                simulated_md = position_market_data[p].pricing;
+                
+                allocateComponents(tail, [&](int rank) {
+                    simulated_md.spot_price = simulatedSpot(p, tail.ranked[rank]);
+                    return (at_horizon[p]->price(simulated_md) - base_prices[p]) * quantity;
+                }, result.position_risk[p]);
+                
+                RiskContribution& position = result.position_risk[p];
+                position.marginal_var_95 = quantity != 0 ? position.component_var_95 / quantity : 0.0;
+                position.marginal_var_99 = quantity != 0 ? position.component_var_99 / quantity : 0.0;
+            }
+        });
+    }
+    
+    result.value_at_risk_95 = metrics.var_95;
+    result.value_at_risk_99 = metrics.var_99;
+    result.expected_shortfall_95 = metrics.es_95;
+    result.expected_shortfall_99 = metrics.es_99;
+    
+    aggregateByAsset(portfolio, result);
+    
+    profile_scope.detach();
+    result.profile = collector.report();
     return result;
 }
 
 RiskMetrics RiskEngine::calculateRiskMetrics(
     const Portfolio& portfolio, 
-    const std::map<std::string, MarketData>& market_data_map
-) {
+    const std::vector<PositionMarketData>& position_market_data,
+    std::vector<RiskContribution>& position_risk
+) const {
     RiskMetrics metrics;
     // Calculate initial portfolio value
     double initial_portfolio_value = 0.0;
     const auto& instruments = portfolio.getInstruments();
+    std::vector<double> base_prices(instruments.size());
     
-    for (const auto& [instrument, quantity] : instruments) {
-        const MarketData& md = market_data_map.at(instrument->getAssetId());
-        double price = instrument->price(md);
+    for (size_t p = 0; p < instruments.size(); ++p) {
+        QE_PROFILE_PHASE(Profiling::Phase::Greeks);
+        const auto& [instrument, quantity] = instruments[p];
+        double price = instrument->price(position_market_data[p].pricing);
         
         if (std::isnan(price) || std::isinf(price)) {
             throw std::runtime_error("Invalid price in risk metrics calculation");
         }
         
+        base_prices[p] = price;
         initial_portfolio_value += price * quantity;
     }
     
@@ -228,110 +1016,342 @@ RiskMetrics RiskEngine::calculateRiskMetrics(
         return metrics;  // Return zeros for empty portfolio
     }
     
+    // Positions on the same asset share one simulated spot per path, so
+    // spots are drawn once per held asset rather than once per position
+    const size_t asset_count = portfolio.getAssetCount();
+    std::vector<uint64_t> asset_streams(asset_count);
+    std::vector<const MarketState*> asset_states(asset_count, nullptr);
+    std::vector<int> held_assets;
+    std::vector<int> position_assets(instruments.size());
+    for (size_t p = 0; p < instruments.size(); ++p) {
+        const int asset = portfolio.getPositionAsset(p);
+        position_assets[p] = asset;
+        if (!asset_states[asset]) {
+            asset_states[asset] = &position_market_data[p].asset;
+            asset_streams[asset] = Scenario::assetStream(portfolio.getAssetName(asset));
+            held_assets.push_back(asset);
+        }
+    }
+    
     std::vector<double> pnl_distribution(var_simulations_);
 
     const double dt = time_horizon_days_ / 252.0;
-    const double sqrt_dt = std::sqrt(dt);
+    const std::vector<std::unique_ptr<Instrument>> at_horizon = agedInstruments(portfolio, dt);
 
-    // unsigned int num_threads = std::thread::hardware_concurrency();
-    // if (num_threads == 0) num_threads = 4;
-    
-    unsigned int num_threads = 500;
-
-    auto worker = [&](int start, int end, unsigned int seed) {
-        std::mt19937 generator(seed);
-        std::normal_distribution<double> distribution(0.0, 1.0);
+    std::random_device rd;
+    const uint64_t seed = use_fixed_seed_ ? random_seed_ : rd();
 
-        for (int i = start; i < end; ++i) {
-            double simulated_portfolio_value = 0.0;
+    // Paths are generated and then revalued a block at a time, which keeps
+    // the spots in cache and times the two phases apart without reading the
+    // clock per pricing
+    constexpr int kPathBlock = 256;
+    
+    auto worker = [&](int start, int end) {
+        // Copied once per worker; paths only overwrite the spot, so the
+        // per-path loop never copies a ticker string
+        std::vector<MarketData> simulated_md(instruments.size());
+        for (size_t p = 0; p < instruments.size(); ++p) {
+            simulated_md[p] = position_market_data[p].pricing;
+        }
+        std::vector<double> spots(asset_count * kPathBlock);
+        
+        for (int block_start = start; block_start < end; block_start += kPathBlock) {
+            const int block_end = std::min(end, block_start + kPathBlock);
             
-            for (const auto& [instrument, quantity] : instruments) {
-                const std::string& asset_id = instrument->getAssetId();
-                const MarketData& md = market_data_map.at(asset_id);
-
-                const double random_shock = distribution(generator);
-                const double drift = (md.risk_free_rate - 0.5 * md.volatility * md.volatility) * dt;
-                const double diffusion = md.volatility * sqrt_dt * random_shock;
-                const double simulated_spot = md.spot_price * std::exp(drift + diffusion);
-                
-                if (std::isnan(simulated_spot) || std::isinf(simulated_spot) || simulated_spot <= 0.0) {
-                    throw std::runtime_error("Invalid simulated spot price in VaR calculation");
+            {
+                QE_PROFILE_PHASE(Profiling::Phase::PathGeneration);
+                for (int asset : held_assets) {
+                    double* asset_spots = &spots[static_cast<size_t>(asset) * kPathBlock];
+                    for (int i = block_start; i < block_end; ++i) {
+                        const double random_shock =
+                            Scenario::standardNormal(seed, asset_streams[asset], i);
+                        const double simulated_spot =
+                            Scenario::simulatedSpot(*asset_states[asset], dt, random_shock);
+                        
+                        if (std::isnan(simulated_spot) || std::isinf(simulated_spot) ||
+                            simulated_spot <= 0.0) {
+                            throw std::runtime_error("Invalid simulated spot price in VaR calculation");
+                        }
+                        asset_spots[i - block_start] = simulated_spot;
+                    }
                 }
+            }
+            
+            QE_PROFILE_PHASE(Profiling::Phase::Revaluation);
+            for (int i = block_start; i < block_end; ++i) {
+                double simulated_portfolio_value = 0.0;
                 
-                MarketData simulated_md = md;
-                simulated_md.spot_price = simulated_spot;
-                
-                double simulated_price = instrument->price(simulated_md);
-                
-                if (std::isnan(simulated_price) || std::isinf(simulated_price)) {
-                    throw std::runtime_error("Invalid simulated price in VaR calculation");
+                for (size_t p = 0; p < instruments.size(); ++p) {
+                    simulated_md[p].spot_price =
+                        spots[static_cast<size_t>(position_assets[p]) * kPathBlock + (i - block_start)];
+                    
+                    double simulated_price = at_horizon[p]->price(simulated_md[p]);
+                    
+                    if (std::isnan(simulated_price) || std::isinf(simulated_price)) {
+                        throw std::runtime_error("Invalid simulated price in VaR calculation");
+                    }
+                    
+                    simulated_portfolio_value += simulated_price * instruments[p].second;
                 }
                 
-                simulated_portfolio_value += simulated_price * quantity;
+                pnl_distribution[i] = simulated_portfolio_value - initial_portfolio_value;
             }
-            
-            pnl_distribution[i] = simulated_portfolio_value - initial_portfolio_value;
         }
     };
     
-    std::vector<std::thread> threads;
-    int chunk = var_simulations_ / num_threads;
-    int remainder = var_simulations_ % num_threads;
+    QE_PROFILE_COUNT(Profiling::Counter::Paths, var_simulations_);
+    runPaths(worker);
+    
+    return allocateTailRisk(portfolio, at_horizon, position_market_data, base_prices, seed,
+                            pnl_distribution, position_risk);
+}
 
-    std::random_device rd;
-    unsigned int base_seed = use_fixed_seed_ ? random_seed_ : rd();
+RiskMetrics RiskEngine::allocateTailRisk(
+    const Portfolio& portfolio,
+    const std::vector<std::unique_ptr<Instrument>>& at_horizon,
+    const std::vector<PositionMarketData>& position_market_data,
+    const std::vector<double>& base_prices,
+    uint64_t seed,
+    const std::vector<double>& pnl_distribution,
+    std::vector<RiskContribution>& position_risk
+) const {
+    if (pnl_distribution.empty()) {
+        return RiskMetrics();
+    }
+    
+    const TailRanking tail = [&] {
+        QE_PROFILE_PHASE(Profiling::Phase::TailSort);
+        return rankTail(pnl_distribution);
+    }();
+    
+    const auto& instruments = portfolio.getInstruments();
+    std::vector<uint64_t> asset_streams(portfolio.getAssetCount());
+    for (size_t asset = 0; asset < asset_streams.size(); ++asset) {
+        asset_streams[asset] = Scenario::assetStream(portfolio.getAssetName(static_cast<int>(asset)));
+    }
+    const double dt = time_horizon_days_ / 252.0;
+    
+    // Positions are independent, so they are split across threads and each
+    // one's sums are accumulated in a fixed order
+    Parallel::parallelFor(static_cast<int>(instruments.size()), 1, [&](int start, int end) {
+        QE_PROFILE_PHASE(Profiling::Phase::Attribution);
+        MarketData simulated_md;
+        for (int p = start; p < end; ++p) {
+            const int quantity = instruments[p].second;
+            const uint64_t stream = asset_streams[portfolio.getPositionAsset(p)];
+            simulated_md = position_market_data[p].pricing;
+            
+            allocateComponents(tail, [&](int rank) {
+                const double shock = Scenario::standardNormal(seed, stream, tail.ranked[rank]);
+                simulated_md.spot_price =
+                    Scenario::simulatedSpot(position_market_data[p].asset, dt, shock);
+                
+                const double simulated_price = at_horizon[p]->price(simulated_md);
+                if (std::isnan(simulated_price) || std::isinf(simulated_price)) {
+                    throw std::runtime_error("Invalid simulated price in VaR attribution");
+                }
+                return (simulated_price - base_prices[p]) * quantity;
+            }, position_risk[p]);
+            
+            RiskContribution& position = position_risk[p];
+            position.marginal_var_95 = quantity != 0 ? position.component_var_95 / quantity : 0.0;
+            position.marginal_var_99 = quantity != 0 ? position.component_var_99 / quantity : 0.0;
+        }
+    });
+    
+    return tail.metrics;
+}
 
-    int start = 0;
-    for (unsigned t = 0; t < num_threads; ++t) {
-        int end = start + chunk + (t < remainder ? 1 : 0);
-        if (start >= end) break;
+std::vector<HorizonRiskResult> RiskEngine::calculateHorizonRisk(
+    const Portfolio& portfolio,
+    const std::map<std::string, MarketData>& market_data_map,
+    const std::vector<double>& horizon_days
+) const {
+    return calculateHorizonRisk(portfolio, MarketDataTable(market_data_map), horizon_days);
+}
 
-        unsigned int seed = base_seed; // deterministic per thread
-        threads.emplace_back(worker, start, end, seed);
-        start = end;
+std::vector<HorizonRiskResult> RiskEngine::calculateHorizonRisk(
+    const Portfolio& portfolio,
+    const MarketDataTable& market_data,
+    const std::vector<double>& horizon_days
+) const {
+    std::shared_lock<std::shared_mutex> settings_lock(settings_mutex_);
+    validateParameters();
+    if (horizon_days.empty()) {
+        throw std::invalid_argument("At least one horizon is required");
+    }
+    for (double days : horizon_days) {
+        if (!(days > 0.0 && days <= 252.0)) {
+            throw std::invalid_argument("Horizons must be in (0, 252] trading days");
+        }
     }
-
-    for (auto& th : threads) th.join();
     
-    // Sort the P&L distribution (ascending order: worst losses first)
-    std::sort(pnl_distribution.begin(), pnl_distribution.end());
+    std::vector<double> horizons = horizon_days;
+    std::sort(horizons.begin(), horizons.end());
+    horizons.erase(std::unique(horizons.begin(), horizons.end()), horizons.end());
     
-    // Calculate VaR at 95% confidence level
-    const int index_95 = static_cast<int>((1.0 - 0.95) * var_simulations_);
-    if (index_95 < 0 || index_95 >= var_simulations_) {
-        throw std::runtime_error("Invalid VaR 95% index calculation");
+    std::vector<HorizonRiskResult> results(horizons.size());
+    for (size_t h = 0; h < horizons.size(); ++h) {
+        results[h].horizon_days = horizons[h];
     }
-    metrics.var_95 = -pnl_distribution[index_95];
     
-    // Calculate VaR at 99% confidence level
-    const int index_99 = static_cast<int>((1.0 - 0.99) * var_simulations_);
-    if (index_99 < 0 || index_99 >= var_simulations_) {
-        throw std::runtime_error("Invalid VaR 99% index calculation");
+    if (portfolio.empty()) {
+        return results;
     }
-    metrics.var_99 = -pnl_distribution[index_99];
     
-    // Calculate Expected Shortfall (CVaR) at 95%
-    // ES is the average of losses beyond VaR
-    double sum_95 = 0.0;
-    int count_95 = 0;
-    for (int i = 0; i <= index_95; ++i) {
-        sum_95 += pnl_distribution[i];
-        count_95++;
+    Profiling::Collector collector;
+    Profiling::ThreadScope profile_scope(&collector);
+    
+    const std::vector<PositionMarketData> position_market_data =
+        resolvePositions(portfolio, market_data);
+    
+    std::vector<std::vector<double>> pnl_distributions;
+    try {
+        simulateHorizons(portfolio, position_market_data, horizons, pnl_distributions);
+    } catch (const std::exception& e) {
+        throw std::runtime_error(std::string("Risk metrics calculation failed: ") + e.what());
     }
-    if (count_95 > 0) {
-        metrics.es_95 = -sum_95 / count_95;
+    
+    // Left empty for a book worth nothing, whose VaR/ES stay zero
+    for (size_t h = 0; h < pnl_distributions.size(); ++h) {
+        QE_PROFILE_PHASE(Profiling::Phase::TailSort);
+        const RiskMetrics metrics = riskMetricsFromDistribution(pnl_distributions[h]);
+        results[h].value_at_risk_95 = metrics.var_95;
+        results[h].value_at_risk_99 = metrics.var_99;
+        results[h].expected_shortfall_95 = metrics.es_95;
+        results[h].expected_shortfall_99 = metrics.es_99;
     }
     
-    // Calculate Expected Shortfall (CVaR) at 99%
-    double sum_99 = 0.0;
-    int count_99 = 0;
-    for (int i = 0; i <= index_99; ++i) {
-        sum_99 += pnl_distribution[i];
-        count_99++;
+    profile_scope.detach();
+    const Profiling::Report profile = collector.report();
+    for (HorizonRiskResult& result : results) {
+        result.profile = profile;
     }
-    if (count_99 > 0) {
-        metrics.es_99 = -sum_99 / count_99;
+    return results;
+}
+
+void RiskEngine::simulateHorizons(
+    const Portfolio& portfolio,
+    const std::vector<PositionMarketData>& position_market_data,
+    const std::vector<double>& horizons,
+    std::vector<std::vector<double>>& pnl_distributions
+) const {
+    const auto& instruments = portfolio.getInstruments();
+    const size_t horizon_count = horizons.size();
+    
+    double initial_portfolio_value = 0.0;
+    for (size_t p = 0; p < instruments.size(); ++p) {
+        QE_PROFILE_PHASE(Profiling::Phase::Greeks);
+        const auto& [instrument, quantity] = instruments[p];
+        const double price = instrument->price(position_market_data[p].pricing);
+        if (std::isnan(price) || std::isinf(price)) {
+            throw std::runtime_error("Invalid price in risk metrics calculation");
+        }
+        initial_portfolio_value += price * quantity;
     }
     
-    return metrics;
+    if (std::abs(initial_portfolio_value) < 1e-10) {
+        pnl_distributions.clear();
+        return;  // No distributions for an empty portfolio
+    }
+    
+    // Aged once per position and horizon, never per path
+    std::vector<std::vector<std::unique_ptr<Instrument>>> at_horizon(horizon_count);
+    for (size_t h = 0; h < horizon_count; ++h) {
+        at_horizon[h] = agedInstruments(portfolio, horizons[h] / 252.0);
+    }
+    
+    std::vector<double> step_dt(horizon_count);
+    for (size_t h = 0; h < horizon_count; ++h) {
+        step_dt[h] = (horizons[h] - (h == 0 ? 0.0 : horizons[h - 1])) / 252.0;
+    }
+    
+    // Each held asset is stepped once per path, whatever its position count
+    const size_t asset_count = portfolio.getAssetCount();
+    std::vector<int> held_assets;
+    std::vector<MarketState> asset_states;
+    std::vector<std::vector<uint64_t>> step_streams;
+    for (size_t asset = 0; asset < asset_count; ++asset) {
+        const std::vector<size_t>& positions = portfolio.getPositionsForAsset(static_cast<int>(asset));
+        if (positions.empty()) continue;
+        
+        const uint64_t stream = Scenario::assetStream(portfolio.getAssetName(static_cast<int>(asset)));
+        std::vector<uint64_t> streams(horizon_count);
+        for (size_t h = 0; h < horizon_count; ++h) {
+            streams[h] = Scenario::checkpointStream(stream, h);
+        }
+        held_assets.push_back(static_cast<int>(asset));
+        asset_states.push_back(position_market_data[positions.front()].asset);
+        step_streams.push_back(std::move(streams));
+    }
+    
+    pnl_distributions.assign(horizon_count, std::vector<double>(var_simulations_));
+    
+    std::random_device rd;
+    const uint64_t seed = use_fixed_seed_ ? random_seed_ : rd();
+    
+    QE_PROFILE_COUNT(Profiling::Counter::Paths, var_simulations_);
+    runPaths([&](int start, int end) {
+        std::vector<MarketData> simulated_md(instruments.size());
+        for (size_t p = 0; p < instruments.size(); ++p) {
+            simulated_md[p] = position_market_data[p].pricing;
+        }
+        // Spot of every asset at every checkpoint, indexed [asset][horizon]
+        std::vector<double> spots(asset_count * horizon_count);
+        
+        for (int i = start; i < end; ++i) {
+            {
+                QE_PROFILE_PHASE(Profiling::Phase::PathGeneration);
+                for (size_t a = 0; a < held_assets.size(); ++a) {
+                    MarketState state = asset_states[a];
+                    for (size_t h = 0; h < horizon_count; ++h) {
+                        const double shock = Scenario::standardNormal(seed, step_streams[a][h], i);
+                        state.spot_price = Scenario::simulatedSpot(state, step_dt[h], shock);
+                        
+                        if (std::isnan(state.spot_price) || std::isinf(state.spot_price) ||
+                            state.spot_price <= 0.0) {
+                            throw std::runtime_error("Invalid simulated spot price in VaR calculation");
+                        }
+                        spots[held_assets[a] * horizon_count + h] = state.spot_price;
+                    }
+                }
+            }
+            
+            QE_PROFILE_PHASE(Profiling::Phase::Revaluation);
+            for (size_t h = 0; h < horizon_count; ++h) {
+                double simulated_portfolio_value = 0.0;
+                for (size_t p = 0; p < instruments.size(); ++p) {
+                    const size_t asset = static_cast<size_t>(portfolio.getPositionAsset(p));
+                    simulated_md[p].spot_price = spots[asset * horizon_count + h];
+                    
+                    const double simulated_price = at_horizon[h][p]->price(simulated_md[p]);
+                    if (std::isnan(simulated_price) || std::isinf(simulated_price)) {
+                        throw std::runtime_error("Invalid simulated price in VaR calculation");
+                    }
+                    simulated_portfolio_value += simulated_price * instruments[p].second;
+                }
+                pnl_distributions[h][i] = simulated_portfolio_value - initial_portfolio_value;
+            }
+        }
+    });
+}
+
+void RiskEngine::aggregateByAsset(const Portfolio& portfolio, PortfolioRiskResult& result) {
+    result.asset_risk.assign(portfolio.getAssetCount(), RiskContribution());
+    
+    for (size_t asset = 0; asset < result.asset_risk.size(); ++asset) {
+        RiskContribution& total = result.asset_risk[asset];
+        for (size_t p : portfolio.getPositionsForAsset(static_cast<int>(asset))) {
+            const RiskContribution& position = result.position_risk[p];
+            total.pv += position.pv;
+            total.delta += position.delta;
+            total.gamma += position.gamma;
+            total.vega += position.vega;
+            total.theta += position.theta;
+            total.component_var_95 += position.component_var_95;
+            total.component_var_99 += position.component_var_99;
+            total.component_es_95 += position.component_es_95;
+            total.component_es_99 += position.component_es_99;
+        }
+    }
 }
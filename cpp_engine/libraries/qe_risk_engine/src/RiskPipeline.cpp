@@ -0,0 +1,452 @@
+#include "RiskPipeline.h"
+#include "Instrument.h"
+#include "Portfolio.h"
+#include "PortfolioLoader.h"
+#include "PortfolioSnapshot.h"
+#include "ScenarioGenerator.h"
+#include "SpscQueue.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Market data and simulated horizon spots of one asset. The build stage
+// makes it the first time a batch holds the asset; it is read-only after.
+struct AssetScenario {
+    size_t index = 0;   // into RiskPipelineResult::asset_names
+    MarketData md;
+    std::vector<double> spots;   // per path
+};
+
+struct Batch {
+    size_t first = 0;        // file index of the batch's first position
+    PositionBuffer buffer;   // backs `columns` for text files
+    PositionColumns columns;
+    Portfolio book;
+    std::vector<const AssetScenario*> assets;   // by the book's asset index
+    std::vector<RiskContribution> position_risk;
+    std::vector<double> pnl;   // the batch's P&L per path
+};
+
+using BatchPtr = std::unique_ptr<Batch>;
+using BatchQueue = SpscQueue<BatchPtr>;
+
+// Thrown to unwind a stage whose queue was cancelled by another's failure
+struct StageCancelled {};
+
+// Keeps the first failure of any stage and cancels every queue, so no
+// stage stays blocked on a neighbour that has stopped
+class FirstFailure {
+public:
+    explicit FirstFailure(std::vector<BatchQueue*> queues) : queues_(std::move(queues)) {}
+
+    void record(std::exception_ptr error) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = error;
+        }
+        for (BatchQueue* queue : queues_) queue->cancel();
+    }
+
+    void rethrowIfAny() const {
+        if (error_) std::rethrow_exception(error_);
+    }
+
+private:
+    std::vector<BatchQueue*> queues_;
+    std::mutex mutex_;
+    std::exception_ptr error_;
+};
+
+// Time a stage spends working; the clock is paused around queue waits
+class BusyClock {
+public:
+    bool pop(BatchQueue& queue, BatchPtr& batch) {
+        busy_ += secondsSince(resumed_);
+        const bool popped = queue.pop(batch);
+        resumed_ = Clock::now();
+        return popped;
+    }
+
+    void push(BatchQueue& queue, BatchPtr batch) {
+        busy_ += secondsSince(resumed_);
+        const bool pushed = queue.push(std::move(batch));
+        resumed_ = Clock::now();
+        if (!pushed) throw StageCancelled();
+    }
+
+    double seconds() const { return busy_ + secondsSince(resumed_); }
+
+private:
+    Clock::time_point resumed_ = Clock::now();
+    double busy_ = 0.0;
+};
+
+PositionColumns sliceColumns(const PositionColumns& columns, size_t first, size_t count) {
+    auto offset = [first](auto* column) { return column ? column + first : column; };
+    PositionColumns slice = columns;
+    slice.count = count;
+    slice.is_call = offset(columns.is_call);
+    slice.strike = offset(columns.strike);
+    slice.expiry = offset(columns.expiry);
+    slice.quantity = offset(columns.quantity);
+    slice.asset = offset(columns.asset);
+    slice.american = offset(columns.american);
+    slice.model = offset(columns.model);
+    slice.binomial_steps = offset(columns.binomial_steps);
+    slice.jump_intensity = offset(columns.jump_intensity);
+    slice.jump_mean = offset(columns.jump_mean);
+    slice.jump_vol = offset(columns.jump_vol);
+    return slice;
+}
+
+std::unique_ptr<AssetScenario> makeScenario(
+    const std::string& asset_id,
+    size_t index,
+    const std::map<std::string, MarketData>& market_data_map,
+    const RiskPipelineOptions& options
+) {
+    auto it = market_data_map.find(asset_id);
+    if (it == market_data_map.end()) {
+        throw std::runtime_error("Missing market data for asset: " + asset_id);
+    }
+    it->second.validate();
+
+    auto scenario = std::make_unique<AssetScenario>();
+    scenario->index = index;
+    scenario->md = it->second;
+    scenario->spots.resize(options.var_simulations);
+
+    const double dt = options.time_horizon_days / 252.0;
+    const uint64_t stream = Scenario::assetStream(asset_id);
+    for (int i = 0; i < options.var_simulations; ++i) {
+        const double shock = Scenario::standardNormal(options.seed, stream, i);
+        const double spot = Scenario::simulatedSpot(scenario->md, dt, shock);
+        if (std::isnan(spot) || std::isinf(spot) || spot <= 0.0) {
+            throw std::runtime_error("Invalid simulated spot price in VaR calculation");
+        }
+        scenario->spots[i] = spot;
+    }
+    return scenario;
+}
+
+double checkedMetric(double value, const char* metric_name, const std::string& asset_id) {
+    if (std::isnan(value) || std::isinf(value)) {
+        throw std::runtime_error(std::string("Invalid ") + metric_name + " value for " + asset_id);
+    }
+    return value;
+}
+
+void priceBatch(Batch& batch, int paths, double dt) {
+    const auto& instruments = batch.book.getInstruments();
+    batch.position_risk.assign(instruments.size(), RiskContribution());
+    batch.pnl.assign(paths, 0.0);
+
+    for (size_t p = 0; p < instruments.size(); ++p) {
+        const auto& [instrument, quantity] = instruments[p];
+        const AssetScenario& asset = *batch.assets[batch.book.getPositionAsset(p)];
+        const MarketData& md = asset.md;
+        RiskContribution& risk = batch.position_risk[p];
+
+        double price = 0.0;
+        try {
+            price = checkedMetric(instrument->price(md), "price", md.asset_id);
+            risk.pv = price * quantity;
+            risk.delta = checkedMetric(instrument->delta(md), "delta", md.asset_id) * quantity;
+            risk.gamma = checkedMetric(instrument->gamma(md), "gamma", md.asset_id) * quantity;
+            risk.vega = checkedMetric(instrument->vega(md), "vega", md.asset_id) * quantity;
+            risk.theta = checkedMetric(instrument->theta(md), "theta", md.asset_id) * quantity;
+        } catch (const std::exception& e) {
+            throw std::runtime_error("Position " + std::to_string(batch.first + p) + ": " + e.what());
+        }
+
+        // Paths are revalued at the horizon with the instrument aged once,
+        // as RiskEngine does
+        const std::unique_ptr<Instrument> at_horizon = instrument->aged(dt);
+        MarketData simulated_md = md;
+        for (int i = 0; i < paths; ++i) {
+            simulated_md.spot_price = asset.spots[i];
+            const double simulated_price = at_horizon->price(simulated_md);
+            if (std::isnan(simulated_price) || std::isinf(simulated_price)) {
+                throw std::runtime_error("Invalid simulated price in VaR calculation");
+            }
+            batch.pnl[i] += (simulated_price - price) * quantity;
+        }
+    }
+}
+
+} // namespace
+
+RiskPipeline::RiskPipeline(const std::map<std::string, MarketData>& market_data_map,
+                           const RiskPipelineOptions& options)
+    : market_data_map_(market_data_map), options_(options) {
+    if (options.batch_size == 0 || options.queue_depth == 0) {
+        throw std::invalid_argument("Batch size and queue depth must be positive");
+    }
+    if (options.var_simulations <= 0 || options.var_simulations > 1000000) {
+        throw std::invalid_argument("Invalid VaR simulations parameter");
+    }
+    if (options.time_horizon_days <= 0.0 || options.time_horizon_days > 252.0) {
+        throw std::invalid_argument("Invalid time horizon parameter");
+    }
+}
+
+RiskPipelineResult RiskPipeline::run(const std::string& positions_path,
+                                     const std::string& output_path) const {
+    const Clock::time_point start = Clock::now();
+
+    const PortfolioLoader::Format format = PortfolioLoader::formatOf(positions_path);
+    std::unique_ptr<PortfolioSnapshot> snapshot;
+    std::ifstream text;
+    if (format == PortfolioLoader::Format::Snapshot) {
+        snapshot = std::make_unique<PortfolioSnapshot>(positions_path);
+    } else {
+        text.open(positions_path);
+        if (!text) {
+            throw std::runtime_error("Cannot open " + positions_path);
+        }
+    }
+    const bool writing = !output_path.empty();
+    std::ofstream out;
+    if (writing) {
+        out.open(output_path);
+        if (!out) {
+            throw std::runtime_error("Cannot create " + output_path);
+        }
+    }
+
+    unsigned int workers = options_.pricing_workers;
+    if (workers == 0) {
+        workers = std::thread::hardware_concurrency();
+        if (workers == 0) workers = 4;
+    }
+
+    BatchQueue loaded(options_.queue_depth);
+    std::vector<std::unique_ptr<BatchQueue>> to_price;
+    std::vector<std::unique_ptr<BatchQueue>> priced;
+    for (unsigned int w = 0; w < workers; ++w) {
+        to_price.push_back(std::make_unique<BatchQueue>(options_.queue_depth));
+        priced.push_back(std::make_unique<BatchQueue>(options_.queue_depth));
+    }
+    BatchQueue to_write(options_.queue_depth);
+
+    std::vector<BatchQueue*> queues = {&loaded, &to_write};
+    for (unsigned int w = 0; w < workers; ++w) {
+        queues.push_back(to_price[w].get());
+        queues.push_back(priced[w].get());
+    }
+    FirstFailure failure(queues);
+
+    RiskPipelineResult result;
+    result.risk.reset();
+    const int paths = options_.var_simulations;
+    const double dt = options_.time_horizon_days / 252.0;
+    const size_t batch_size = options_.batch_size;
+    std::vector<double> pnl_distribution(paths, 0.0);
+    std::vector<double> worker_seconds(workers, 0.0);
+    // Owned here so that they outlive every batch pointing at them
+    std::unordered_map<std::string, std::unique_ptr<AssetScenario>> scenarios;
+
+    auto load = [&]() {
+        BusyClock clock;
+        if (snapshot) {
+            const PositionColumns& columns = snapshot->columns();
+            for (size_t first = 0; first < columns.count; first += batch_size) {
+                auto batch = std::make_unique<Batch>();
+                batch->first = first;
+                batch->columns = sliceColumns(columns, first, std::min(batch_size, columns.count - first));
+                clock.push(loaded, std::move(batch));
+            }
+        } else {
+            size_t next_first = 0;
+            auto batch = std::make_unique<Batch>();
+            batch->buffer.reserve(batch_size);
+            auto publish = [&]() {
+                batch->first = next_first;
+                batch->columns = batch->buffer.columns();
+                next_first += batch->buffer.size();
+                clock.push(loaded, std::move(batch));
+                batch = std::make_unique<Batch>();
+                batch->buffer.reserve(batch_size);
+            };
+            PortfolioLoader::readPositions(text, format, [&](const PositionRecord& record) {
+                batch->buffer.add(record);
+                if (batch->buffer.size() == batch_size) {
+                    publish();
+                }
+            });
+            if (!batch->buffer.empty()) {
+                publish();
+            }
+        }
+        loaded.close();
+        result.load_seconds = clock.seconds();
+    };
+
+    auto build = [&]() {
+        BusyClock clock;
+        BatchPtr batch;
+        for (size_t sequence = 0; clock.pop(loaded, batch); ++sequence) {
+            try {
+                batch->book.addPositions(batch->columns);
+            } catch (const std::invalid_argument& e) {
+                throw std::invalid_argument("Batch from position " + std::to_string(batch->first) +
+                                            ": " + e.what());
+            }
+
+            batch->assets.resize(batch->book.getAssetCount());
+            for (size_t a = 0; a < batch->assets.size(); ++a) {
+                const std::string& asset_id = batch->book.getAssetName(static_cast<int>(a));
+                auto it = scenarios.find(asset_id);
+                if (it == scenarios.end()) {
+                    it = scenarios.emplace(asset_id, makeScenario(asset_id, result.asset_names.size(),
+                                                                  market_data_map_, options_)).first;
+                    result.asset_names.push_back(asset_id);
+                }
+                batch->assets[a] = it->second.get();
+            }
+            clock.push(*to_price[sequence % workers], std::move(batch));
+        }
+        for (auto& queue : to_price) queue->close();
+        result.build_seconds = clock.seconds();
+    };
+
+    auto price = [&](unsigned int worker) {
+        BusyClock clock;
+        BatchPtr batch;
+        while (clock.pop(*to_price[worker], batch)) {
+            priceBatch(*batch, paths, dt);
+            clock.push(*priced[worker], std::move(batch));
+        }
+        priced[worker]->close();
+        worker_seconds[worker] = clock.seconds();
+    };
+
+    auto aggregate = [&]() {
+        BusyClock clock;
+        PortfolioRiskResult& risk = result.risk;
+        BatchPtr batch;
+        // Batches were dealt round-robin, so collecting them the same way
+        // restores file order; the first drained worker marks the end
+        for (size_t sequence = 0; clock.pop(*priced[sequence % workers], batch); ++sequence) {
+            for (size_t p = 0; p < batch->position_risk.size(); ++p) {
+                const RiskContribution& position = batch->position_risk[p];
+                const size_t asset = batch->assets[batch->book.getPositionAsset(p)]->index;
+                if (risk.asset_risk.size() <= asset) {
+                    risk.asset_risk.resize(asset + 1);
+                }
+                RiskContribution& asset_total = risk.asset_risk[asset];
+                asset_total.pv += position.pv;
+                asset_total.delta += position.delta;
+                asset_total.gamma += position.gamma;
+                asset_total.vega += position.vega;
+                asset_total.theta += position.theta;
+
+                risk.total_pv += position.pv;
+                risk.total_delta += position.delta;
+                risk.total_gamma += position.gamma;
+                risk.total_vega += position.vega;
+                risk.total_theta += position.theta;
+            }
+            for (int i = 0; i < paths; ++i) {
+                pnl_distribution[i] += batch->pnl[i];
+            }
+            result.positions += batch->position_risk.size();
+            ++result.batches;
+
+            if (writing) {
+                clock.push(to_write, std::move(batch));
+            } else {
+                batch.reset();
+            }
+        }
+        to_write.close();
+        result.aggregate_seconds = clock.seconds();
+    };
+
+    auto write = [&]() {
+        BusyClock clock;
+        out.precision(12);
+        out << "position,asset_id,instrument,quantity,pv,delta,gamma,vega,theta\n";
+        BatchPtr batch;
+        while (clock.pop(to_write, batch)) {
+            const auto& instruments = batch->book.getInstruments();
+            for (size_t p = 0; p < instruments.size(); ++p) {
+                const RiskContribution& r = batch->position_risk[p];
+                out << batch->first + p << ','
+                    << batch->book.getAssetName(batch->book.getPositionAsset(p)) << ','
+                    << instruments[p].first->getInstrumentType() << ',' << instruments[p].second << ','
+                    << r.pv << ',' << r.delta << ',' << r.gamma << ',' << r.vega << ',' << r.theta
+                    << '\n';
+            }
+            batch.reset();
+        }
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("Failed writing " + output_path);
+        }
+        result.write_seconds = clock.seconds();
+    };
+
+    std::vector<std::thread> threads;
+    auto startStage = [&](std::function<void()> stage) {
+        threads.emplace_back([&failure, stage = std::move(stage)]() {
+            try {
+                stage();
+            } catch (const StageCancelled&) {
+                // Another stage failed and has recorded why
+            } catch (...) {
+                failure.record(std::current_exception());
+            }
+        });
+    };
+    try {
+        startStage(load);
+        startStage(build);
+        for (unsigned int w = 0; w < workers; ++w) {
+            startStage([&price, w]() { price(w); });
+        }
+        startStage(aggregate);
+        if (writing) {
+            startStage(write);
+        }
+    } catch (...) {
+        failure.record(std::current_exception());
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    failure.rethrowIfAny();
+
+    if (result.positions > 0) {
+        const RiskMetrics metrics = riskMetricsFromDistribution(pnl_distribution);
+        result.risk.value_at_risk_95 = metrics.var_95;
+        result.risk.value_at_risk_99 = metrics.var_99;
+        result.risk.expected_shortfall_95 = metrics.es_95;
+        result.risk.expected_shortfall_99 = metrics.es_99;
+    }
+    if (!result.risk.isValid()) {
+        throw std::runtime_error("Portfolio risk calculation produced invalid results");
+    }
+
+    for (double seconds : worker_seconds) {
+        result.pricing_seconds += seconds;
+    }
+    result.wall_seconds = secondsSince(start);
+    return result;
+}
@@ -0,0 +1,309 @@
+#include "RiskSession.h"
+#include "Parallel.h"
+#include "ScenarioGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+
+namespace {
+
+// Below this many paths per thread the hand-off cost dominates
+constexpr int kMinPathsPerThread = 2048;
+
+double checkedMetric(double value, const std::string& metric_name, const std::string& asset_id) {
+    if (std::isnan(value) || std::isinf(value)) {
+        throw std::runtime_error("Invalid " + metric_name + " value for " + asset_id);
+    }
+    return value;
+}
+
+} // namespace
+
+RiskSession::RiskSession(
+    const std::map<std::string, MarketData>& market_data_map,
+    int var_simulations,
+    double time_horizon_days,
+    unsigned int seed
+) : market_data_map_(market_data_map),
+    var_simulations_(var_simulations),
+    time_horizon_days_(time_horizon_days),
+    seed_(seed) {
+    if (var_simulations <= 0 || var_simulations > 1000000) {
+        throw std::invalid_argument("Invalid VaR simulations parameter");
+    }
+    if (time_horizon_days <= 0.0 || time_horizon_days > 252.0) {
+        throw std::invalid_argument("Invalid time horizon parameter");
+    }
+    totals_.reset();
+    pnl_distribution_.assign(var_simulations_, 0.0);
+}
+
+const MarketData& RiskSession::marketDataFor(const std::string& asset_id) const {
+    auto it = market_data_map_.find(asset_id);
+    if (it == market_data_map_.end()) {
+        throw std::runtime_error("Missing market data for asset: " + asset_id);
+    }
+    const MarketData& md = it->second;
+    if (md.spot_price <= 0.0 || std::isnan(md.spot_price) || std::isinf(md.spot_price)) {
+        throw std::invalid_argument("Invalid spot price for " + asset_id);
+    }
+    if (md.volatility < 0.0 || std::isnan(md.volatility) || std::isinf(md.volatility)) {
+        throw std::invalid_argument("Invalid volatility for " + asset_id);
+    }
+    if (std::isnan(md.risk_free_rate) || std::isinf(md.risk_free_rate)) {
+        throw std::invalid_argument("Invalid risk-free rate for " + asset_id);
+    }
+    return md;
+}
+
+RiskSession::PositionCache RiskSession::valuePosition(const Instrument& instrument) const {
+    const std::string asset_id = instrument.getAssetId();
+    const MarketData& md = marketDataFor(asset_id);
+    
+    PositionCache position;
+    try {
+        position.price = checkedMetric(instrument.price(md), "price", asset_id);
+        position.delta = checkedMetric(instrument.delta(md), "delta", asset_id);
+        position.gamma = checkedMetric(instrument.gamma(md), "gamma", asset_id);
+        position.vega = checkedMetric(instrument.vega(md), "vega", asset_id);
+        position.theta = checkedMetric(instrument.theta(md), "theta", asset_id);
+    } catch (const std::exception& e) {
+        throw std::runtime_error("Failed to value position on " + asset_id + ": " + e.what());
+    }
+    return position;
+}
+
+void RiskSession::addPathPnl(const Instrument& instrument, const PositionCache& position,
+                             double quantity, std::vector<double>& pnl) const {
+    const std::string asset_id = instrument.getAssetId();
+    const MarketData& md = marketDataFor(asset_id);
+    
+    const double dt = time_horizon_days_ / 252.0;
+    const uint64_t stream = Scenario::assetStream(asset_id);
+    // Scenarios are revalued at the horizon, with the instrument aged once
+    const std::unique_ptr<Instrument> at_horizon = instrument.aged(dt);
+    
+    Parallel::parallelFor(var_simulations_, kMinPathsPerThread, [&](int start, int end) {
+        MarketData simulated_md = md;
+        for (int i = start; i < end; ++i) {
+            const double shock = Scenario::standardNormal(seed_, stream, i);
+            simulated_md.spot_price = Scenario::simulatedSpot(md, dt, shock);
+            
+            const double simulated_price = at_horizon->price(simulated_md);
+            if (std::isnan(simulated_price) || std::isinf(simulated_price)) {
+                throw std::runtime_error("Invalid simulated price in VaR calculation");
+            }
+            pnl[i] += (simulated_price - position.price) * quantity;
+        }
+    });
+}
+
+void RiskSession::accumulate(const PositionCache& position, double quantity_change) {
+    totals_.total_pv += position.price * quantity_change;
+    totals_.total_delta += position.delta * quantity_change;
+    totals_.total_gamma += position.gamma * quantity_change;
+    totals_.total_vega += position.vega * quantity_change;
+    totals_.total_theta += position.theta * quantity_change;
+}
+
+void RiskSession::applyPathPnl(const std::string& asset_id, const std::vector<double>& pnl_change) {
+    std::vector<double>& asset_pnl = assets_.at(asset_id).pnl;
+    for (int i = 0; i < var_simulations_; ++i) {
+        asset_pnl[i] += pnl_change[i];
+        pnl_distribution_[i] += pnl_change[i];
+    }
+}
+
+size_t RiskSession::addInstrument(std::unique_ptr<Instrument> instrument, int quantity) {
+    if (!instrument) {
+        throw std::invalid_argument("Cannot add null instrument to portfolio");
+    }
+    
+    const std::string asset_id = instrument->getAssetId();
+    const PositionCache position = valuePosition(*instrument);
+    std::vector<double> pnl_change(var_simulations_, 0.0);
+    addPathPnl(*instrument, position, quantity, pnl_change);
+    
+    portfolio_.addInstrument(std::move(instrument), quantity);
+    AssetPnl& asset = assets_[asset_id];
+    if (asset.pnl.empty()) {
+        asset.pnl.assign(var_simulations_, 0.0);
+    }
+    ++asset.positions;
+    accumulate(position, quantity);
+    applyPathPnl(asset_id, pnl_change);
+    positions_.push_back(position);
+    
+    return positions_.size() - 1;
+}
+
+int RiskSession::positionQuantity(size_t index) const {
+    if (index >= positions_.size()) {
+        std::ostringstream oss;
+        oss << "Index " << index << " out of range. Portfolio size: " << positions_.size();
+        throw std::out_of_range(oss.str());
+    }
+    return portfolio_.getInstruments()[index].second;
+}
+
+void RiskSession::removeInstrument(size_t index) {
+    const int quantity = positionQuantity(index);
+    const Instrument& instrument = *portfolio_.getInstruments()[index].first;
+    const std::string asset_id = instrument.getAssetId();
+    
+    // Repricing the one position is what lets the session keep only
+    // per-asset path P&L
+    std::vector<double> pnl_change(var_simulations_, 0.0);
+    addPathPnl(instrument, positions_[index], -static_cast<double>(quantity), pnl_change);
+    
+    accumulate(positions_[index], -static_cast<double>(quantity));
+    applyPathPnl(asset_id, pnl_change);
+    positions_.erase(positions_.begin() + index);
+    portfolio_.removeInstrument(index);
+    
+    auto asset = assets_.find(asset_id);
+    if (--asset->second.positions == 0) {
+        assets_.erase(asset);
+    }
+    
+    // Drop accumulated rounding once the book is empty
+    if (positions_.empty()) {
+        totals_.reset();
+        std::fill(pnl_distribution_.begin(), pnl_distribution_.end(), 0.0);
+    }
+}
+
+void RiskSession::updateQuantity(size_t index, int new_quantity) {
+    const int old_quantity = positionQuantity(index);
+    if (new_quantity == old_quantity) {
+        return;
+    }
+    const Instrument& instrument = *portfolio_.getInstruments()[index].first;
+    const double quantity_change = static_cast<double>(new_quantity) - old_quantity;
+    
+    std::vector<double> pnl_change(var_simulations_, 0.0);
+    addPathPnl(instrument, positions_[index], quantity_change, pnl_change);
+    
+    portfolio_.updateQuantity(index, new_quantity);
+    accumulate(positions_[index], quantity_change);
+    applyPathPnl(instrument.getAssetId(), pnl_change);
+}
+
+size_t RiskSession::updateMarketData(const MarketData& market_data) {
+    market_data.validate();
+    
+    std::vector<size_t> affected;
+    const int asset = portfolio_.findAsset(market_data.asset_id);
+    if (asset >= 0) {
+        affected = portfolio_.getPositionsForAsset(asset);
+    }
+    
+    auto it = market_data_map_.find(market_data.asset_id);
+    if (it == market_data_map_.end()) {
+        market_data_map_.emplace(market_data.asset_id, market_data);
+        return 0;
+    }
+    
+    const MarketData previous = it->second;
+    it->second = market_data;
+    
+    if (affected.empty()) {
+        return 0;
+    }
+    
+    // The asset's path P&L is rebuilt from its revalued positions
+    std::vector<PositionCache> revalued;
+    revalued.reserve(affected.size());
+    std::vector<double> asset_pnl(var_simulations_, 0.0);
+    try {
+        for (size_t index : affected) {
+            const auto& [instrument, quantity] = portfolio_.getInstruments()[index];
+            revalued.push_back(valuePosition(*instrument));
+            addPathPnl(*instrument, revalued.back(), quantity, asset_pnl);
+        }
+    } catch (...) {
+        it->second = previous;
+        throw;
+    }
+    
+    for (size_t i = 0; i < affected.size(); ++i) {
+        const size_t index = affected[i];
+        const double quantity = positionQuantity(index);
+        accumulate(positions_[index], -quantity);
+        accumulate(revalued[i], quantity);
+        positions_[index] = revalued[i];
+    }
+    
+    std::vector<double>& cached = assets_.at(market_data.asset_id).pnl;
+    for (int i = 0; i < var_simulations_; ++i) {
+        pnl_distribution_[i] += asset_pnl[i] - cached[i];
+    }
+    cached = std::move(asset_pnl);
+    return affected.size();
+}
+
+uint64_t RiskSession::getPositionId(size_t index) const {
+    return portfolio_.getPositionId(index);
+}
+
+size_t RiskSession::findPosition(uint64_t position_id) const {
+    // IDs are handed out in increasing order and removal keeps the order
+    size_t low = 0;
+    size_t high = portfolio_.size();
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        if (portfolio_.getPositionId(mid) < position_id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == portfolio_.size() || portfolio_.getPositionId(low) != position_id) {
+        throw std::out_of_range("No position with ID " + std::to_string(position_id));
+    }
+    return low;
+}
+
+PortfolioRiskResult RiskSession::getRisk() const {
+    PortfolioRiskResult result = totals_;
+    
+    if (portfolio_.empty()) {
+        result.reset();
+        return result;
+    }
+    
+    if (std::abs(result.total_pv) >= 1e-10) {
+        std::vector<double> pnl = pnl_distribution_;
+        const RiskMetrics metrics = riskMetricsFromDistribution(pnl);
+        result.value_at_risk_95 = metrics.var_95;
+        result.value_at_risk_99 = metrics.var_99;
+        result.expected_shortfall_95 = metrics.es_95;
+        result.expected_shortfall_99 = metrics.es_99;
+    }
+    
+    if (!result.isValid()) {
+        throw std::runtime_error("Portfolio risk calculation produced invalid results");
+    }
+    return result;
+}
+
+const Portfolio& RiskSession::getPortfolio() const {
+    return portfolio_;
+}
+
+size_t RiskSession::size() const {
+    return portfolio_.size();
+}
+
+bool RiskSession::empty() const {
+    return portfolio_.empty();
+}
+
+int RiskSession::getVaRSimulations() const {
+    return var_simulations_;
+}
+
+double RiskSession::getVaRTimeHorizonDays() const {
+    return time_horizon_days_;
+}
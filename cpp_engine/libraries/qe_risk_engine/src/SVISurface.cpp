@@ -0,0 +1,589 @@
+#include "SVISurface.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace VolatilitySurface {
+
+namespace {
+
+// Log-moneyness grid used by the arbitrage scans
+constexpr double kGridMin = -2.0;
+constexpr double kGridMax = 2.0;
+constexpr int kGridPoints = 201;
+constexpr double kArbitrageTolerance = 1e-9;
+
+// SVI has five parameters; thinner slices get a flat fit
+constexpr size_t kMinSVIQuotes = 5;
+
+struct SliceQuotes {
+    double expiry;
+    std::vector<double> log_moneyness;   // sorted
+    std::vector<double> total_variance;
+};
+
+std::vector<SliceQuotes> groupQuotes(const ImpliedVolSurface& surface,
+                                     double spot, double rate) {
+    if (!surface.hasData()) {
+        throw std::runtime_error("Volatility surface has no data");
+    }
+
+    std::vector<VolPoint> points = surface.getPoints();
+    std::sort(points.begin(), points.end(), [](const VolPoint& a, const VolPoint& b) {
+        return a.expiry < b.expiry || (a.expiry == b.expiry && a.strike < b.strike);
+    });
+
+    std::vector<SliceQuotes> slices;
+    for (const auto& point : points) {
+        if (slices.empty() || slices.back().expiry != point.expiry) {
+            slices.push_back({point.expiry, {}, {}});
+        }
+        SliceQuotes& slice = slices.back();
+        slice.log_moneyness.push_back(std::log(point.strike / spot) - rate * point.expiry);
+        slice.total_variance.push_back(point.implied_vol * point.implied_vol * point.expiry);
+    }
+    return slices;
+}
+
+// Gatheral's density function; the slice is butterfly-free iff g(k) >= 0
+double densityFunction(double k, double w, double dw, double d2w) {
+    const double term = 1.0 - k * dw / (2.0 * w);
+    return term * term - 0.25 * dw * dw * (1.0 / w + 0.25) + 0.5 * d2w;
+}
+
+bool isButterflyFree(const SVIParameters& params) {
+    const double step = (kGridMax - kGridMin) / (kGridPoints - 1);
+    for (int i = 0; i < kGridPoints; ++i) {
+        const double k = kGridMin + i * step;
+        const double w = params.totalVariance(k);
+        if (w <= 0.0) return false;
+        const double g = densityFunction(k, w, params.firstDerivative(k),
+                                         params.secondDerivative(k));
+        if (g < -kArbitrageTolerance) return false;
+    }
+    return true;
+}
+
+bool isCalendarOrdered(const SVIParameters& near, const SVIParameters& far) {
+    const double step = (kGridMax - kGridMin) / (kGridPoints - 1);
+    for (int i = 0; i < kGridPoints; ++i) {
+        const double k = kGridMin + i * step;
+        if (far.totalVariance(k) < near.totalVariance(k) - kArbitrageTolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <size_t N, typename Objective>
+std::array<double, N> nelderMead(Objective&& f, const std::array<double, N>& start,
+                                 const std::array<double, N>& step,
+                                 int max_iterations, double tolerance) {
+    using Point = std::array<double, N>;
+    std::array<Point, N + 1> simplex;
+    std::array<double, N + 1> values;
+
+    simplex[0] = start;
+    for (size_t i = 0; i < N; ++i) {
+        simplex[i + 1] = start;
+        simplex[i + 1][i] += step[i];
+    }
+    for (size_t i = 0; i <= N; ++i) values[i] = f(simplex[i]);
+
+    auto blend = [](const Point& a, const Point& b, double t) {
+        Point p;
+        for (size_t i = 0; i < N; ++i) p[i] = a[i] + t * (b[i] - a[i]);
+        return p;
+    };
+
+    for (int iteration = 0; iteration < max_iterations; ++iteration) {
+        std::array<size_t, N + 1> order;
+        for (size_t i = 0; i <= N; ++i) order[i] = i;
+        std::sort(order.begin(), order.end(),
+                  [&](size_t a, size_t b) { return values[a] < values[b]; });
+        const size_t best = order[0], worst = order[N], second_worst = order[N - 1];
+
+        if (values[worst] - values[best] <= tolerance * (std::abs(values[best]) + 1e-30)) {
+            break;
+        }
+
+        Point centroid{};
+        for (size_t i = 0; i < N; ++i) {
+            const Point& p = simplex[order[i]];
+            for (size_t j = 0; j < N; ++j) centroid[j] += p[j] / N;
+        }
+
+        const Point reflected = blend(centroid, simplex[worst], -1.0);
+        const double f_reflected = f(reflected);
+
+        if (f_reflected < values[best]) {
+            const Point expanded = blend(centroid, simplex[worst], -2.0);
+            const double f_expanded = f(expanded);
+            if (f_expanded < f_reflected) {
+                simplex[worst] = expanded;
+                values[worst] = f_expanded;
+            } else {
+                simplex[worst] = reflected;
+                values[worst] = f_reflected;
+            }
+        } else if (f_reflected < values[second_worst]) {
+            simplex[worst] = reflected;
+            values[worst] = f_reflected;
+        } else {
+            const Point contracted = blend(centroid, simplex[worst], 0.5);
+            const double f_contracted = f(contracted);
+            if (f_contracted < values[worst]) {
+                simplex[worst] = contracted;
+                values[worst] = f_contracted;
+            } else {
+                for (size_t i = 1; i <= N; ++i) {
+                    simplex[order[i]] = blend(simplex[best], simplex[order[i]], 0.5);
+                    values[order[i]] = f(simplex[order[i]]);
+                }
+            }
+        }
+    }
+
+    const size_t best = static_cast<size_t>(
+        std::min_element(values.begin(), values.end()) - values.begin());
+    return simplex[best];
+}
+
+/**
+ * Quasi-explicit SVI fit (Zeliade): for fixed (m, sigma) the slice is linear
+ * in (a, d, c) with w = a + d y + c sqrt(y^2 + 1), y = (k - m) / sigma.
+ * Solves that 3x3 least-squares problem, projects it onto the admissible
+ * domain, and returns the sum of squared total-variance errors.
+ */
+double fitLinearSVI(const SliceQuotes& quotes, double m, double sigma,
+                    SVIParameters& params) {
+    const size_t n = quotes.log_moneyness.size();
+    double A[3][3] = {};
+    double rhs[3] = {};
+    for (size_t i = 0; i < n; ++i) {
+        const double y = (quotes.log_moneyness[i] - m) / sigma;
+        const double basis[3] = {1.0, y, std::sqrt(y * y + 1.0)};
+        for (int r = 0; r < 3; ++r) {
+            rhs[r] += basis[r] * quotes.total_variance[i];
+            for (int c = 0; c < 3; ++c) A[r][c] += basis[r] * basis[c];
+        }
+    }
+
+    const double det = A[0][0] * (A[1][1] * A[2][2] - A[1][2] * A[2][1])
+                     - A[0][1] * (A[1][0] * A[2][2] - A[1][2] * A[2][0])
+                     + A[0][2] * (A[1][0] * A[2][1] - A[1][1] * A[2][0]);
+
+    double a, d, c;
+    if (std::abs(det) > 1e-14 * A[0][0] * A[0][0] * A[0][0]) {
+        auto cramer = [&](int column) {
+            double M[3][3];
+            for (int r = 0; r < 3; ++r) {
+                for (int k = 0; k < 3; ++k) M[r][k] = (k == column) ? rhs[r] : A[r][k];
+            }
+            return (M[0][0] * (M[1][1] * M[2][2] - M[1][2] * M[2][1])
+                  - M[0][1] * (M[1][0] * M[2][2] - M[1][2] * M[2][0])
+                  + M[0][2] * (M[1][0] * M[2][1] - M[1][1] * M[2][0])) / det;
+        };
+        a = cramer(0);
+        d = cramer(1);
+        c = cramer(2);
+    } else {
+        a = rhs[0] / A[0][0];
+        d = 0.0;
+        c = 0.0;
+    }
+
+    // Wing slopes bounded by Lee's moment formula: b (1 + |rho|) <= 4
+    const double c_clamped = std::min(std::max(c, 0.0), 4.0 * sigma);
+    const double d_limit = std::min(c_clamped, 4.0 * sigma - c_clamped);
+    const double d_clamped = std::min(std::max(d, -d_limit), d_limit);
+    if (c_clamped != c || d_clamped != d) {
+        c = c_clamped;
+        d = d_clamped;
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            const double y = (quotes.log_moneyness[i] - m) / sigma;
+            sum += quotes.total_variance[i] - d * y - c * std::sqrt(y * y + 1.0);
+        }
+        a = sum / n;
+    }
+    // Minimum total variance a + sqrt(c^2 - d^2) must stay non-negative
+    a = std::max(a, -std::sqrt(std::max(c * c - d * d, 0.0)));
+
+    params.a = a;
+    params.b = c / sigma;
+    params.rho = c > 0.0 ? d / c : 0.0;
+    params.m = m;
+    params.sigma = sigma;
+
+    double sse = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        const double error = params.totalVariance(quotes.log_moneyness[i]) -
+                             quotes.total_variance[i];
+        sse += error * error;
+    }
+    return sse;
+}
+
+SVISlice fitSlice(const SliceQuotes& quotes) {
+    SVISlice slice;
+    slice.expiry = quotes.expiry;
+    slice.quotes = quotes.log_moneyness.size();
+
+    double sse = 0.0;
+    if (slice.quotes < kMinSVIQuotes) {
+        double mean = 0.0;
+        for (double w : quotes.total_variance) mean += w;
+        mean /= slice.quotes;
+        slice.params.a = mean;
+        for (double w : quotes.total_variance) sse += (w - mean) * (w - mean);
+    } else {
+        const size_t lowest = static_cast<size_t>(
+            std::min_element(quotes.total_variance.begin(), quotes.total_variance.end()) -
+            quotes.total_variance.begin());
+        const double span = quotes.log_moneyness.back() - quotes.log_moneyness.front();
+
+        // Outer search over (m, log sigma); a few starts guard against the
+        // flat valleys of the SVI objective
+        auto objective = [&](const std::array<double, 2>& x) {
+            if (std::abs(x[0]) > 5.0 || x[1] < std::log(1e-4) || x[1] > std::log(10.0)) {
+                return std::numeric_limits<double>::max();
+            }
+            SVIParameters candidate;
+            return fitLinearSVI(quotes, x[0], std::exp(x[1]), candidate);
+        };
+
+        double best = std::numeric_limits<double>::max();
+        std::array<double, 2> best_x{};
+        for (double sigma0 : {0.05, 0.2, 0.5}) {
+            const std::array<double, 2> start = {quotes.log_moneyness[lowest], std::log(sigma0)};
+            const std::array<double, 2> step = {0.1 * std::max(span, 0.1), 0.5};
+            std::array<double, 2> x = nelderMead<2>(objective, start, step, 500, 1e-12);
+            x = nelderMead<2>(objective, x, step, 500, 1e-12);
+            const double value = objective(x);
+            if (value < best) {
+                best = value;
+                best_x = x;
+            }
+        }
+        sse = fitLinearSVI(quotes, best_x[0], std::exp(best_x[1]), slice.params);
+    }
+
+    slice.rmse = std::sqrt(sse / slice.quotes);
+    return slice;
+}
+
+} // namespace
+
+// SVIParameters
+
+double SVIParameters::totalVariance(double k) const {
+    const double x = k - m;
+    return a + b * (rho * x + std::sqrt(x * x + sigma * sigma));
+}
+
+double SVIParameters::firstDerivative(double k) const {
+    const double x = k - m;
+    return b * (rho + x / std::sqrt(x * x + sigma * sigma));
+}
+
+double SVIParameters::secondDerivative(double k) const {
+    const double x = k - m;
+    const double r2 = x * x + sigma * sigma;
+    return b * sigma * sigma / (r2 * std::sqrt(r2));
+}
+
+bool SVIParameters::isValid() const {
+    return b >= 0.0 && std::abs(rho) < 1.0 && sigma > 0.0 &&
+           a + b * sigma * std::sqrt(1.0 - rho * rho) >= 0.0;
+}
+
+// ParametricSurface
+
+ParametricSurface::ParametricSurface(double spot, double rate)
+    : spot_(spot), rate_(rate) {
+    if (spot <= 0.0) {
+        throw std::invalid_argument("Spot must be positive");
+    }
+}
+
+double ParametricSurface::logMoneyness(double strike, double expiry) const {
+    if (strike <= 0.0) {
+        throw std::invalid_argument("Strike must be positive");
+    }
+    return std::log(strike / spot_) - rate_ * expiry;
+}
+
+double ParametricSurface::impliedVol(double strike, double expiry) const {
+    if (expiry <= 0.0) {
+        throw std::invalid_argument("Expiry must be positive");
+    }
+    const double w = totalVariance(logMoneyness(strike, expiry), expiry);
+    return std::sqrt(std::max(w, 0.0) / expiry);
+}
+
+double ParametricSurface::skew(double expiry) const {
+    if (expiry <= 0.0) {
+        throw std::invalid_argument("Expiry must be positive");
+    }
+    double w, dw_dk, dw_dT;
+    derivatives(0.0, expiry, w, dw_dk, dw_dT);
+    if (w <= 0.0) return 0.0;
+
+    // sigma = sqrt(w / T), k = log(K / F): d(sigma)/dK = w' / (2 sigma T K)
+    const double forward = spot_ * std::exp(rate_ * expiry);
+    const double vol = std::sqrt(w / expiry);
+    return dw_dk / (2.0 * vol * expiry * forward);
+}
+
+double ParametricSurface::termStructure(double strike, double expiry) const {
+    if (expiry <= 0.0) {
+        throw std::invalid_argument("Expiry must be positive");
+    }
+    double w, dw_dk, dw_dT;
+    derivatives(logMoneyness(strike, expiry), expiry, w, dw_dk, dw_dT);
+    if (w <= 0.0) return 0.0;
+
+    // At fixed strike the moneyness drifts with the forward: dk/dT = -rate
+    const double total_dw_dT = dw_dT - rate_ * dw_dk;
+    const double vol = std::sqrt(w / expiry);
+    return (total_dw_dT - w / expiry) / (2.0 * vol * expiry);
+}
+
+// SVISurface
+
+SVISurface::SVISurface(double spot, double rate) : ParametricSurface(spot, rate) {}
+
+void SVISurface::fit(const ImpliedVolSurface& surface, unsigned int num_threads) {
+    const std::vector<SliceQuotes> quotes = groupQuotes(surface, spot_, rate_);
+    std::vector<SVISlice> slices(quotes.size());
+
+    Parallel::parallelFor(static_cast<int>(quotes.size()), 1, [&](int start, int end) {
+        for (int s = start; s < end; ++s) {
+            slices[s] = fitSlice(quotes[s]);
+        }
+    }, num_threads);
+
+    slices_ = std::move(slices);
+}
+
+double SVISurface::totalVariance(double k, double expiry) const {
+    double w, dw_dk, dw_dT;
+    derivatives(k, expiry, w, dw_dk, dw_dT);
+    return w;
+}
+
+void SVISurface::derivatives(double k, double expiry,
+                             double& w, double& dw_dk, double& dw_dT) const {
+    if (slices_.empty()) {
+        throw std::runtime_error("SVI surface has not been fitted");
+    }
+    if (expiry <= 0.0) {
+        throw std::invalid_argument("Expiry must be positive");
+    }
+
+    auto upper = std::lower_bound(slices_.begin(), slices_.end(), expiry,
+        [](const SVISlice& slice, double T) { return slice.expiry < T; });
+
+    // Flat vol at constant moneyness outside the fitted expiries
+    if (upper == slices_.begin() || upper == slices_.end()) {
+        const SVISlice& slice = (upper == slices_.begin()) ? slices_.front() : slices_.back();
+        const double scale = expiry / slice.expiry;
+        const double w_slice = slice.params.totalVariance(k);
+        w = w_slice * scale;
+        dw_dk = slice.params.firstDerivative(k) * scale;
+        dw_dT = w_slice / slice.expiry;
+        return;
+    }
+
+    const SVISlice& far = *upper;
+    const SVISlice& near = *(upper - 1);
+    const double span = far.expiry - near.expiry;
+    const double weight = (expiry - near.expiry) / span;
+    const double w_near = near.params.totalVariance(k);
+    const double w_far = far.params.totalVariance(k);
+
+    w = (1.0 - weight) * w_near + weight * w_far;
+    dw_dk = (1.0 - weight) * near.params.firstDerivative(k) +
+            weight * far.params.firstDerivative(k);
+    dw_dT = (w_far - w_near) / span;
+}
+
+ArbitrageReport SVISurface::checkArbitrage() const {
+    if (slices_.empty()) {
+        throw std::runtime_error("SVI surface has not been fitted");
+    }
+
+    ArbitrageReport report;
+    for (size_t i = 0; i < slices_.size(); ++i) {
+        if (!isButterflyFree(slices_[i].params)) {
+            report.butterfly_violations.push_back(slices_[i].expiry);
+        }
+        if (i > 0 && !isCalendarOrdered(slices_[i - 1].params, slices_[i].params)) {
+            report.calendar_violations.emplace_back(slices_[i - 1].expiry, slices_[i].expiry);
+        }
+    }
+    return report;
+}
+
+// SSVISurface
+
+SSVISurface::SSVISurface(double spot, double rate) : ParametricSurface(spot, rate) {}
+
+double SSVISurface::phi(double theta) const {
+    return eta_ / (std::pow(theta, gamma_) * std::pow(1.0 + theta, 1.0 - gamma_));
+}
+
+void SSVISurface::atmVariance(double expiry, double& theta, double& dtheta_dT) const {
+    if (expiries_.empty()) {
+        throw std::runtime_error("SSVI surface has not been fitted");
+    }
+    if (expiry <= 0.0) {
+        throw std::invalid_argument("Expiry must be positive");
+    }
+
+    auto upper = std::lower_bound(expiries_.begin(), expiries_.end(), expiry);
+    if (upper == expiries_.begin() || upper == expiries_.end()) {
+        const size_t i = (upper == expiries_.begin()) ? 0 : expiries_.size() - 1;
+        dtheta_dT = atm_variance_[i] / expiries_[i];
+        theta = dtheta_dT * expiry;
+        return;
+    }
+
+    const size_t i = static_cast<size_t>(upper - expiries_.begin());
+    dtheta_dT = (atm_variance_[i] - atm_variance_[i - 1]) / (expiries_[i] - expiries_[i - 1]);
+    theta = atm_variance_[i - 1] + dtheta_dT * (expiry - expiries_[i - 1]);
+}
+
+double SSVISurface::atmTotalVariance(double expiry) const {
+    double theta, dtheta_dT;
+    atmVariance(expiry, theta, dtheta_dT);
+    return theta;
+}
+
+void SSVISurface::fit(const ImpliedVolSurface& surface) {
+    const std::vector<SliceQuotes> quotes = groupQuotes(surface, spot_, rate_);
+
+    // ATM total variance per expiry, linear in log-moneyness between quotes,
+    // then forced non-decreasing so the surface is calendar-free
+    std::vector<double> expiries, atm;
+    expiries.reserve(quotes.size());
+    atm.reserve(quotes.size());
+    for (const auto& slice : quotes) {
+        const auto& k = slice.log_moneyness;
+        const auto& w = slice.total_variance;
+        auto upper = std::lower_bound(k.begin(), k.end(), 0.0);
+        double theta;
+        if (upper == k.begin()) {
+            theta = w.front();
+        } else if (upper == k.end()) {
+            theta = w.back();
+        } else {
+            const size_t i = static_cast<size_t>(upper - k.begin());
+            const double weight = (0.0 - k[i - 1]) / (k[i] - k[i - 1]);
+            theta = (1.0 - weight) * w[i - 1] + weight * w[i];
+        }
+        if (!atm.empty()) theta = std::max(theta, atm.back());
+        expiries.push_back(slice.expiry);
+        atm.push_back(std::max(theta, 1e-12));
+    }
+    expiries_ = std::move(expiries);
+    atm_variance_ = std::move(atm);
+
+    // Unconstrained coordinates: rho = 0.999 tanh(x0),
+    // eta = 2 / (1 + |rho|) * logistic(x1), gamma = 0.01 + 0.49 * logistic(x2)
+    auto logistic = [](double x) { return 1.0 / (1.0 + std::exp(-x)); };
+    auto apply = [&](const std::array<double, 3>& x) {
+        rho_ = 0.999 * std::tanh(x[0]);
+        eta_ = 2.0 / (1.0 + std::abs(rho_)) * logistic(x[1]);
+        gamma_ = 0.01 + 0.49 * logistic(x[2]);
+    };
+
+    size_t count = 0;
+    for (const auto& slice : quotes) count += slice.log_moneyness.size();
+
+    auto objective = [&](const std::array<double, 3>& x) {
+        apply(x);
+        double sse = 0.0;
+        for (size_t s = 0; s < quotes.size(); ++s) {
+            const double theta = atm_variance_[s];
+            const double p = phi(theta);
+            for (size_t i = 0; i < quotes[s].log_moneyness.size(); ++i) {
+                const double pk = p * quotes[s].log_moneyness[i];
+                const double w = 0.5 * theta *
+                    (1.0 + rho_ * pk + std::sqrt((pk + rho_) * (pk + rho_) + 1.0 - rho_ * rho_));
+                const double error = w - quotes[s].total_variance[i];
+                sse += error * error;
+            }
+        }
+        return sse;
+    };
+
+    const std::array<double, 3> step = {0.5, 0.5, 0.5};
+    std::array<double, 3> x = {std::atanh(-0.3 / 0.999), 0.0, 0.0};
+    x = nelderMead<3>(objective, x, step, 1000, 1e-12);
+    x = nelderMead<3>(objective, x, step, 1000, 1e-12);
+
+    rmse_ = std::sqrt(objective(x) / count);
+    apply(x);
+}
+
+double SSVISurface::totalVariance(double k, double expiry) const {
+    double w, dw_dk, dw_dT;
+    derivatives(k, expiry, w, dw_dk, dw_dT);
+    return w;
+}
+
+void SSVISurface::derivatives(double k, double expiry,
+                              double& w, double& dw_dk, double& dw_dT) const {
+    double theta, dtheta_dT;
+    atmVariance(expiry, theta, dtheta_dT);
+
+    const double p = phi(theta);
+    const double dp_dtheta = p * (-gamma_ / theta + (gamma_ - 1.0) / (1.0 + theta));
+    const double shifted = p * k + rho_;
+    const double root = std::sqrt(shifted * shifted + 1.0 - rho_ * rho_);
+
+    w = 0.5 * theta * (1.0 + rho_ * p * k + root);
+    dw_dk = 0.5 * theta * p * (rho_ + shifted / root);
+
+    const double dw_dphi = 0.5 * theta * k * (rho_ + shifted / root);
+    dw_dT = (w / theta + dw_dphi * dp_dtheta) * dtheta_dT;
+}
+
+ArbitrageReport SSVISurface::checkArbitrage() const {
+    if (expiries_.empty()) {
+        throw std::runtime_error("SSVI surface has not been fitted");
+    }
+
+    // Each SSVI slice is a raw SVI slice with
+    // a = theta (1 - rho^2) / 2, b = theta phi / 2, m = -rho / phi,
+    // sigma = sqrt(1 - rho^2) / phi
+    auto asSVI = [&](double theta) {
+        const double p = phi(theta);
+        SVIParameters params;
+        params.a = 0.5 * theta * (1.0 - rho_ * rho_);
+        params.b = 0.5 * theta * p;
+        params.rho = rho_;
+        params.m = -rho_ / p;
+        params.sigma = std::sqrt(1.0 - rho_ * rho_) / p;
+        return params;
+    };
+
+    ArbitrageReport report;
+    for (size_t i = 0; i < expiries_.size(); ++i) {
+        const SVIParameters slice = asSVI(atm_variance_[i]);
+        if (!isButterflyFree(slice)) {
+            report.butterfly_violations.push_back(expiries_[i]);
+        }
+        if (i > 0 && !isCalendarOrdered(asSVI(atm_variance_[i - 1]), slice)) {
+            report.calendar_violations.emplace_back(expiries_[i - 1], expiries_[i]);
+        }
+    }
+    return report;
+}
+
+} // namespace VolatilitySurface
@@ -0,0 +1,62 @@
+#include "ScenarioGenerator.h"
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace Scenario {
+
+namespace {
+
+// SplitMix64 finaliser
+uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Uniform on (0, 1) from the top 53 bits
+double toUniform(uint64_t x) {
+    return (static_cast<double>(x >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+} // namespace
+
+uint64_t assetStream(const std::string& asset_id) {
+    // FNV-1a, then mixed so similar tickers land far apart
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : asset_id) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return mix(hash);
+}
+
+double standardNormal(uint64_t seed, uint64_t stream, uint64_t path) {
+    const uint64_t key = mix(mix(seed ^ stream) ^ path);
+    const double u1 = toUniform(key);
+    const double u2 = toUniform(mix(key));
+    // Box-Muller, cosine branch
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * u2);
+}
+
+uint64_t checkpointStream(uint64_t asset_stream, size_t checkpoint) {
+    if (checkpoint == 0) {
+        return asset_stream;
+    }
+    return mix(asset_stream ^ (0xd1b54a32d192ed03ULL * checkpoint));
+}
+
+double simulatedSpot(const MarketData& md, double dt, double shock) {
+    return simulatedSpot(MarketState(md), dt, shock);
+}
+
+double simulatedSpot(const MarketState& state, double dt, double shock) {
+    const double drift = (state.risk_free_rate - 0.5 * state.volatility * state.volatility) * dt;
+    const double diffusion = state.volatility * std::sqrt(dt) * shock;
+    return state.spot_price * std::exp(drift + diffusion);
+}
+
+} // namespace Scenario
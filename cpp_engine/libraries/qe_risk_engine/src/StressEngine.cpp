@@ -0,0 +1,178 @@
+#include "StressEngine.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Below this many scenarios per thread the hand-off cost dominates
+constexpr int kMinScenariosPerThread = 8;
+
+std::string shiftLabel(double shift, double scale, const char* unit) {
+    std::ostringstream oss;
+    oss << (shift >= 0.0 ? "+" : "") << shift * scale << unit;
+    return oss.str();
+}
+
+} // namespace
+
+StressResult StressEngine::run(
+    const Portfolio& portfolio,
+    const std::map<std::string, MarketData>& market_data_map,
+    const std::vector<StressScenario>& scenarios
+) const {
+    return run(portfolio, MarketDataTable(market_data_map), scenarios);
+}
+
+StressResult StressEngine::run(
+    const Portfolio& portfolio,
+    const MarketDataTable& market_data,
+    const std::vector<StressScenario>& scenarios
+) const {
+    const auto& instruments = portfolio.getInstruments();
+    const size_t position_count = instruments.size();
+    const size_t asset_count = portfolio.getAssetCount();
+    const size_t scenario_count = scenarios.size();
+
+    StressResult result;
+    result.position_count = position_count;
+    result.scenario_names.reserve(scenario_count);
+    for (const StressScenario& scenario : scenarios) {
+        result.scenario_names.push_back(scenario.name);
+    }
+    result.position_pnl.assign(scenario_count * position_count, 0.0);
+    result.total_pnl.assign(scenario_count, 0.0);
+
+    // Base market data per held asset
+    std::vector<MarketData> asset_market_data(asset_count);
+    for (size_t asset = 0; asset < asset_count; ++asset) {
+        if (portfolio.getPositionsForAsset(static_cast<int>(asset)).empty()) {
+            continue;
+        }
+        const std::string& asset_id = portfolio.getAssetName(static_cast<int>(asset));
+        const AssetId id = market_data.find(asset_id);
+        if (id == AssetSymbolTable::npos) {
+            throw std::runtime_error("Missing market data for asset: " + asset_id);
+        }
+        asset_market_data[asset] = market_data.getMarketData(id);
+        const MarketData& md = asset_market_data[asset];
+        if (!(md.spot_price > 0.0) || std::isinf(md.spot_price) ||
+            !(md.volatility >= 0.0) || std::isinf(md.volatility) ||
+            std::isnan(md.risk_free_rate) || std::isinf(md.risk_free_rate)) {
+            throw std::invalid_argument("Invalid market data for " + asset_id);
+        }
+    }
+
+    // Position columns
+    std::vector<int> position_assets(position_count);
+    std::vector<double> quantities(position_count);
+    std::vector<double> base_prices(position_count);
+    for (size_t p = 0; p < position_count; ++p) {
+        position_assets[p] = portfolio.getPositionAsset(p);
+        quantities[p] = instruments[p].second;
+        base_prices[p] = instruments[p].first->price(asset_market_data[position_assets[p]]);
+        if (std::isnan(base_prices[p]) || std::isinf(base_prices[p])) {
+            throw std::runtime_error("Invalid base price in stress test");
+        }
+        result.base_value += base_prices[p] * quantities[p];
+    }
+
+    // Shocked market state columns, indexed [scenario][asset]
+    std::vector<double> spots(scenario_count * asset_count);
+    std::vector<double> vols(scenario_count * asset_count);
+    std::vector<double> rates(scenario_count * asset_count);
+    for (size_t s = 0; s < scenario_count; ++s) {
+        double* spot = &spots[s * asset_count];
+        double* vol = &vols[s * asset_count];
+        double* rate = &rates[s * asset_count];
+        for (size_t asset = 0; asset < asset_count; ++asset) {
+            spot[asset] = asset_market_data[asset].spot_price;
+            vol[asset] = asset_market_data[asset].volatility;
+            rate[asset] = asset_market_data[asset].risk_free_rate;
+        }
+
+        for (const StressShock& shock : scenarios[s].shocks) {
+            if (!(shock.spot_shift > -1.0) || std::isnan(shock.vol_shift) ||
+                std::isnan(shock.rate_shift)) {
+                throw std::invalid_argument("Invalid shock in scenario: " + scenarios[s].name);
+            }
+
+            size_t first = 0, last = asset_count;
+            if (!shock.asset_id.empty()) {
+                const int asset = portfolio.findAsset(shock.asset_id);
+                if (asset < 0) continue;   // not held, nothing to move
+                first = static_cast<size_t>(asset);
+                last = first + 1;
+            }
+            for (size_t asset = first; asset < last; ++asset) {
+                spot[asset] *= 1.0 + shock.spot_shift;
+                vol[asset] += shock.vol_shift;
+                rate[asset] += shock.rate_shift;
+            }
+        }
+
+        for (size_t asset = 0; asset < asset_count; ++asset) {
+            vol[asset] = std::max(0.0, vol[asset]);
+        }
+    }
+
+    Parallel::parallelFor(static_cast<int>(scenario_count), kMinScenariosPerThread, [&](int start, int end) {
+        // Copied once per worker; scenarios only overwrite the shocked fields
+        std::vector<MarketData> stressed_md(position_count);
+        for (size_t p = 0; p < position_count; ++p) {
+            stressed_md[p] = asset_market_data[position_assets[p]];
+        }
+
+        for (int s = start; s < end; ++s) {
+            const size_t row = static_cast<size_t>(s) * asset_count;
+            double* pnl = &result.position_pnl[static_cast<size_t>(s) * position_count];
+            double total = 0.0;
+
+            for (size_t p = 0; p < position_count; ++p) {
+                const size_t column = row + position_assets[p];
+                stressed_md[p].spot_price = spots[column];
+                stressed_md[p].volatility = vols[column];
+                stressed_md[p].risk_free_rate = rates[column];
+
+                const double stressed_price = instruments[p].first->price(stressed_md[p]);
+                if (std::isnan(stressed_price) || std::isinf(stressed_price)) {
+                    throw std::runtime_error("Invalid stressed price in scenario: " +
+                                             scenarios[s].name);
+                }
+                pnl[p] = (stressed_price - base_prices[p]) * quantities[p];
+                total += pnl[p];
+            }
+            result.total_pnl[s] = total;
+        }
+    });
+
+    return result;
+}
+
+std::vector<StressScenario> StressEngine::ladder(
+    const std::vector<double>& spot_shifts,
+    const std::vector<double>& vol_shifts,
+    const std::string& asset_id
+) {
+    std::vector<StressScenario> scenarios;
+    scenarios.reserve(spot_shifts.size() * vol_shifts.size());
+
+    for (double spot_shift : spot_shifts) {
+        for (double vol_shift : vol_shifts) {
+            StressScenario scenario;
+            scenario.name = (asset_id.empty() ? "" : asset_id + " ") + "spot " +
+                            shiftLabel(spot_shift, 100.0, "%") + " vol " +
+                            shiftLabel(vol_shift, 100.0, "pt");
+            StressShock shock;
+            shock.asset_id = asset_id;
+            shock.spot_shift = spot_shift;
+            shock.vol_shift = vol_shift;
+            scenario.shocks.push_back(shock);
+            scenarios.push_back(std::move(scenario));
+        }
+    }
+
+    return scenarios;
+}
@@ -1,6 +1,10 @@
 #include "BlackScholes.h"
 #include "simple_test.h"
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 
 void test_cumulative_normal(TestSuite &suite) {
@@ -171,6 +175,193 @@ void test_theta(TestSuite &suite) {
   });
 }
 
+void test_implied_volatility(TestSuite &suite) {
+  suite.run_test("Batch IV round-trips calls and puts across the chain", [&]() {
+    const double S = 100.0, r = 0.03;
+    std::vector<BlackScholes::ImpliedVolQuote> quotes;
+    std::vector<double> truth;
+    for (double T : {0.02, 0.25, 1.0, 5.0}) {
+      for (double K : {40.0, 70.0, 95.0, 100.0, 105.0, 140.0, 250.0}) {
+        for (double vol : {0.05, 0.2, 0.8}) {
+          for (bool is_call : {true, false}) {
+            const double price = is_call ? BlackScholes::callPrice(S, K, r, T, vol)
+                                         : BlackScholes::putPrice(S, K, r, T, vol);
+            // Skip quotes whose time value is lost to rounding
+            const double forward = S * std::exp(r * T);
+            const double intrinsic = is_call ? std::max(S - K * std::exp(-r * T), 0.0)
+                                             : std::max(K * std::exp(-r * T) - S, 0.0);
+            if (price - intrinsic < 1e-12 * std::max(forward, K)) continue;
+            quotes.push_back({price, K, T, is_call});
+            truth.push_back(vol);
+          }
+        }
+      }
+    }
+
+    std::vector<double> vols = BlackScholes::impliedVolatility(quotes, S, r);
+    for (size_t i = 0; i < quotes.size(); ++i) {
+      if (std::isnan(vols[i])) throw std::runtime_error("Unsolved quote");
+      suite.assert_equal(truth[i], vols[i], 1e-6,
+                         "K=" + std::to_string(quotes[i].strike) +
+                             " T=" + std::to_string(quotes[i].expiry));
+    }
+  });
+
+  suite.run_test("Batch IV agrees with the scalar solver", [&]() {
+    const double S = 100.0, r = 0.05;
+    std::vector<BlackScholes::ImpliedVolQuote> quotes = {
+        {10.45, 100.0, 1.0, true}, {5.57, 100.0, 1.0, false}, {2.0, 120.0, 0.5, true}};
+    std::vector<double> vols = BlackScholes::impliedVolatility(quotes, S, r);
+    for (size_t i = 0; i < quotes.size(); ++i) {
+      const double scalar = BlackScholes::impliedVolatility(
+          quotes[i].market_price, S, quotes[i].strike, r, quotes[i].expiry,
+          quotes[i].is_call, 0.3, 1e-10);
+      if (std::isnan(vols[i])) throw std::runtime_error("Unsolved quote");
+      suite.assert_equal(scalar, vols[i], 1e-8);
+    }
+  });
+
+  suite.run_test("Batch IV flags quotes outside arbitrage bounds", [&]() {
+    std::vector<BlackScholes::ImpliedVolQuote> quotes = {
+        {101.0, 100.0, 1.0, true},  // above spot
+        {1.0, 50.0, 1.0, true},     // below intrinsic
+        {-1.0, 100.0, 1.0, false},  // negative
+        {5.0, 100.0, 0.0, true},    // expired
+        {0.0, 150.0, 1.0, true}};   // at intrinsic
+    std::vector<double> vols = BlackScholes::impliedVolatility(quotes, 100.0, 0.0);
+    for (size_t i = 0; i < 4; ++i) {
+      if (!std::isnan(vols[i])) {
+        throw std::runtime_error("Expected NaN for quote " + std::to_string(i));
+      }
+    }
+    suite.assert_equal(0.0, vols[4], 0.0, "Zero time value");
+  });
+
+  suite.run_test("Batch IV solves a 20k quote chain", [&]() {
+    const double S = 100.0, r = 0.02;
+    std::vector<BlackScholes::ImpliedVolQuote> quotes;
+    std::vector<double> truth;
+    for (int e = 0; e < 40; ++e) {
+      const double T = 0.05 + 0.1 * e;
+      for (int k = 0; k < 500; ++k) {
+        const double K = 50.0 + 0.2 * k;
+        const double vol = 0.15 + 0.1 * std::abs(std::log(K / S));
+        const bool is_call = K >= S;
+        const double price = is_call ? BlackScholes::callPrice(S, K, r, T, vol)
+                                     : BlackScholes::putPrice(S, K, r, T, vol);
+        if (price < 1e-10) continue;
+        quotes.push_back({price, K, T, is_call});
+        truth.push_back(vol);
+      }
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<double> vols = BlackScholes::impliedVolatility(quotes, S, r);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    std::cout << "(" << elapsed.count() << " ms) ";
+
+    for (size_t i = 0; i < quotes.size(); ++i) {
+      if (std::isnan(vols[i])) throw std::runtime_error("Unsolved quote");
+      suite.assert_equal(truth[i], vols[i], 1e-6);
+    }
+  });
+}
+
+void test_batch_pricing(TestSuite &suite) {
+  struct Columns {
+    std::vector<double> spot, strike, rate, expiry, vol;
+    std::vector<uint8_t> is_call;
+    BlackScholes::BatchInputs inputs() const {
+      return {spot.data(), strike.data(), rate.data(), expiry.data(), vol.data(),
+              is_call.data(), spot.size()};
+    }
+    void add(double S, double K, double r, double T, double sigma, bool call) {
+      spot.push_back(S);
+      strike.push_back(K);
+      rate.push_back(r);
+      expiry.push_back(T);
+      vol.push_back(sigma);
+      is_call.push_back(call ? 1 : 0);
+    }
+  };
+
+  auto checkAgainstScalar = [&](const Columns &c) {
+    const size_t n = c.spot.size();
+    std::vector<double> price(n), delta(n), gamma(n), vega(n), theta(n), rho(n);
+    BlackScholes::priceBatch(c.inputs(), {price.data(), delta.data(), gamma.data(),
+                                          vega.data(), theta.data(), rho.data()});
+    for (size_t i = 0; i < n; ++i) {
+      const double S = c.spot[i], K = c.strike[i], r = c.rate[i], T = c.expiry[i],
+                   sigma = c.vol[i];
+      const bool call = c.is_call[i] != 0;
+      suite.assert_equal(call ? BlackScholes::callPrice(S, K, r, T, sigma)
+                              : BlackScholes::putPrice(S, K, r, T, sigma),
+                         price[i], 1e-10, "Price");
+      suite.assert_equal(call ? BlackScholes::callDelta(S, K, r, T, sigma)
+                              : BlackScholes::putDelta(S, K, r, T, sigma),
+                         delta[i], 1e-12, "Delta");
+      suite.assert_equal(BlackScholes::gamma(S, K, r, T, sigma), gamma[i], 1e-12, "Gamma");
+      suite.assert_equal(BlackScholes::vega(S, K, r, T, sigma), vega[i], 1e-10, "Vega");
+      suite.assert_equal(call ? BlackScholes::callTheta(S, K, r, T, sigma)
+                              : BlackScholes::putTheta(S, K, r, T, sigma),
+                         theta[i], 1e-12, "Theta");
+      suite.assert_equal(call ? BlackScholes::callRho(S, K, r, T, sigma)
+                              : BlackScholes::putRho(S, K, r, T, sigma),
+                         rho[i], 1e-12, "Rho");
+    }
+  };
+
+  suite.run_test("Batch pricing matches the scalar functions", [&]() {
+    Columns c;
+    for (double K : {60.0, 95.0, 100.0, 105.0, 160.0}) {
+      for (double T : {0.0, 0.02, 1.0, 5.0}) {
+        c.add(100.0, K, 0.03, T, 0.25, true);
+        c.add(100.0, K, 0.03, T, 0.25, false);
+      }
+    }
+    c.add(100.0, 90.0, 0.03, 1.0, 0.0, true);  // zero vol settles at intrinsic
+    checkAgainstScalar(c);
+  });
+
+  suite.run_test("Batch pricing gives NaN for invalid rows", [&]() {
+    Columns c;
+    c.add(-1.0, 100.0, 0.05, 1.0, 0.2, true);
+    c.add(100.0, 0.0, 0.05, 1.0, 0.2, true);
+    c.add(100.0, 100.0, 0.05, -1.0, 0.2, false);
+    c.add(100.0, 100.0, std::nan(""), 1.0, 0.2, false);
+    c.add(100.0, 100.0, 0.05, 1.0, 0.2, true);
+    std::vector<double> price(5), gamma(5);
+    BlackScholes::BatchOutputs out;
+    out.price = price.data();
+    out.gamma = gamma.data();
+    BlackScholes::priceBatch(c.inputs(), out);
+    for (size_t i = 0; i < 4; ++i) {
+      if (!std::isnan(price[i]) || !std::isnan(gamma[i])) {
+        throw std::runtime_error("Expected NaN for row " + std::to_string(i));
+      }
+    }
+    suite.assert_equal(BlackScholes::callPrice(100.0, 100.0, 0.05, 1.0, 0.2), price[4], 1e-10);
+  });
+
+  suite.run_test("Batch pricing splits a 50k chain across threads", [&]() {
+    Columns c;
+    for (int i = 0; i < 50000; ++i) {
+      c.add(100.0, 50.0 + 0.002 * i, 0.01 + 0.0000005 * i, 0.05 + (i % 40) * 0.05,
+            0.1 + (i % 17) * 0.02, i % 3 != 0);
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<double> price(c.spot.size());
+    BlackScholes::BatchOutputs out;
+    out.price = price.data();
+    BlackScholes::priceBatch(c.inputs(), out);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    std::cout << "(" << elapsed.count() << " ms) ";
+    checkAgainstScalar(c);
+  });
+}
+
 int main() {
   TestSuite suite;
 
@@ -186,6 +377,8 @@ int main() {
   test_gamma(suite);
   test_vega(suite);
   test_theta(suite);
+  test_implied_volatility(suite);
+  test_batch_pricing(suite);
 
   suite.print_summary();
 
@@ -0,0 +1,269 @@
+#include "BlackScholes.h"
+#include "Heston.h"
+#include "ImpliedVolatilitySurface.h"
+#include "Instrument.h"
+#include "simple_test.h"
+#include <chrono>
+#include <cmath>
+#include <complex>
+
+// Reference price from the "little Heston trap" formulation (Albrecher et
+// al.) integrated with a fine trapezoid rule, independent of the library.
+double referenceCallPrice(double S, double K, double r, double T,
+                          const Heston::Parameters &p) {
+  using C = std::complex<double>;
+  const C i(0.0, 1.0);
+
+  auto cf = [&](C u) {
+    const double kappa = p.mean_reversion, theta = p.long_run_variance;
+    const double sigma = p.vol_of_vol, rho = p.correlation;
+    const C beta = kappa - rho * sigma * i * u;
+    const C d = std::sqrt(beta * beta + sigma * sigma * (i * u + u * u));
+    const C g = (beta - d) / (beta + d);
+    const C e = std::exp(-d * T);
+    const C A = kappa * theta / (sigma * sigma) *
+                ((beta - d) * T - 2.0 * std::log((1.0 - g * e) / (1.0 - g)));
+    const C B = (beta - d) / (sigma * sigma) * (1.0 - e) / (1.0 - g * e);
+    return std::exp(i * u * (std::log(S) + r * T) + A + B * p.initial_variance);
+  };
+
+  const double forward = S * std::exp(r * T);
+  double p1 = 0.0, p2 = 0.0;
+  const double du = 0.005;
+  for (double u = du / 2; u < 300.0; u += du) {
+    const C k = std::exp(-i * u * std::log(K)) / (i * u);
+    p1 += std::real(k * cf(C(u, -1.0)) / forward) * du;
+    p2 += std::real(k * cf(C(u, 0.0))) * du;
+  }
+  p1 = 0.5 + p1 / M_PI;
+  p2 = 0.5 + p2 / M_PI;
+  return S * p1 - K * std::exp(-r * T) * p2;
+}
+
+Heston::Parameters sampleParameters() {
+  Heston::Parameters p;
+  p.initial_variance = 0.05;
+  p.mean_reversion = 2.0;
+  p.long_run_variance = 0.06;
+  p.vol_of_vol = 0.6;
+  p.correlation = -0.65;
+  return p;
+}
+
+void test_heston_pricing(TestSuite &suite) {
+  suite.run_test("Heston call matches reference integration", [&]() {
+    const Heston::Parameters p = sampleParameters();
+    for (double K : {80.0, 100.0, 125.0}) {
+      for (double T : {0.25, 1.0, 3.0}) {
+        const double price = Heston::callPrice(100.0, K, 0.03, T, p);
+        const double reference = referenceCallPrice(100.0, K, 0.03, T, p);
+        suite.assert_equal(reference, price, 1e-4,
+                           "K=" + std::to_string(K) + " T=" + std::to_string(T));
+      }
+    }
+  });
+
+  suite.run_test("Heston put-call parity", [&]() {
+    const Heston::Parameters p = sampleParameters();
+    const double S = 100.0, K = 95.0, r = 0.04, T = 0.75;
+    const double call = Heston::callPrice(S, K, r, T, p);
+    const double put = Heston::putPrice(S, K, r, T, p);
+    suite.assert_equal(S - K * std::exp(-r * T), call - put, 1e-8);
+  });
+
+  suite.run_test("Heston collapses to Black-Scholes for tiny vol of vol", [&]() {
+    Heston::Parameters p;
+    p.initial_variance = 0.04;
+    p.long_run_variance = 0.04;
+    p.mean_reversion = 1.0;
+    p.vol_of_vol = 1e-3;
+    p.correlation = 0.0;
+    const double heston = Heston::callPrice(100.0, 105.0, 0.05, 1.0, p);
+    const double bs = BlackScholes::callPrice(100.0, 105.0, 0.05, 1.0, 0.2);
+    suite.assert_equal(bs, heston, 1e-4);
+  });
+
+  suite.run_test("Heston tracks Black-Scholes at short and long expiries", [&]() {
+    Heston::Parameters p;
+    p.initial_variance = 0.04;
+    p.long_run_variance = 0.04;
+    p.mean_reversion = 1.0;
+    p.vol_of_vol = 1e-3;
+    p.correlation = 0.0;
+    // One day out the integrand is still alive far past u = 200, and ten
+    // years out the strike phase turns quickly against its decay
+    for (double T : {1.0 / 252.0, 10.0}) {
+      for (double K : {60.0, 97.0, 100.0, 104.0, 180.0}) {
+        const double heston = Heston::callPrice(100.0, K, 0.02, T, p);
+        const double bs = BlackScholes::callPrice(100.0, K, 0.02, T, 0.2);
+        suite.assert_equal(bs, heston, 1e-5,
+                           "K=" + std::to_string(K) + " T=" + std::to_string(T));
+      }
+    }
+  });
+
+  suite.run_test("Heston returns intrinsic at expiry", [&]() {
+    const Heston::Parameters p = sampleParameters();
+    suite.assert_equal(10.0, Heston::callPrice(110.0, 100.0, 0.05, 0.0, p), 1e-12);
+    suite.assert_equal(5.0, Heston::putPrice(95.0, 100.0, 0.05, 0.0, p), 1e-12);
+  });
+
+  suite.run_test("Invalid Heston parameters rejected", [&]() {
+    Heston::Parameters p = sampleParameters();
+    p.correlation = 1.5;
+    try {
+      Heston::callPrice(100.0, 100.0, 0.05, 1.0, p);
+    } catch (const std::invalid_argument &) {
+      return;
+    }
+    throw std::runtime_error("Expected invalid_argument for |rho| >= 1");
+  });
+}
+
+void test_heston_gradient(TestSuite &suite) {
+  suite.run_test("Analytic gradient matches finite differences", [&]() {
+    const Heston::Parameters p = sampleParameters();
+    Heston::Gradient gradient;
+    Heston::callPriceWithGradient(100.0, 110.0, 0.02, 1.5, p, gradient);
+
+    double Heston::Parameters::*fields[5] = {
+        &Heston::Parameters::initial_variance, &Heston::Parameters::mean_reversion,
+        &Heston::Parameters::long_run_variance, &Heston::Parameters::vol_of_vol,
+        &Heston::Parameters::correlation};
+
+    for (int k = 0; k < 5; ++k) {
+      const double h = 1e-5;
+      Heston::Parameters up = p, down = p;
+      up.*fields[k] += h;
+      down.*fields[k] -= h;
+      const double fd = (Heston::callPrice(100.0, 110.0, 0.02, 1.5, up) -
+                         Heston::callPrice(100.0, 110.0, 0.02, 1.5, down)) /
+                        (2.0 * h);
+      suite.assert_equal(fd, gradient[k], 1e-4,
+                         "Gradient component " + std::to_string(k));
+    }
+  });
+}
+
+void test_heston_instrument(TestSuite &suite) {
+  suite.run_test("EuropeanOption prices with Heston model", [&]() {
+    EuropeanOption option(OptionType::Put, 100.0, 1.0, "AAPL",
+                          PricingModel::Heston);
+    const Heston::Parameters p = sampleParameters();
+    option.setHestonParameters(p.initial_variance, p.mean_reversion,
+                               p.long_run_variance, p.vol_of_vol,
+                               p.correlation);
+
+    MarketData md("AAPL", 100.0, 0.05, 0.2);
+    suite.assert_equal(Heston::putPrice(100.0, 100.0, 0.05, 1.0, p),
+                       option.price(md), 1e-10);
+
+    const double delta = option.delta(md);
+    if (delta >= 0.0 || delta <= -1.0) {
+      throw std::runtime_error("Put delta should be in (-1, 0)");
+    }
+  });
+
+  suite.run_test("Heston vega bumps the initial volatility", [&]() {
+    EuropeanOption option(OptionType::Call, 100.0, 1.0, "AAPL",
+                          PricingModel::Heston);
+    const Heston::Parameters p = sampleParameters();
+    option.setHestonParameters(p.initial_variance, p.mean_reversion,
+                               p.long_run_variance, p.vol_of_vol,
+                               p.correlation);
+
+    MarketData md("AAPL", 100.0, 0.05, 0.2);
+    const double vega = option.vega(md);
+    if (vega <= 0.0) {
+      throw std::runtime_error("Heston vega should be positive");
+    }
+
+    // Finite difference in sqrt(v0) through the gradient w.r.t. v0
+    Heston::Gradient gradient;
+    Heston::callPriceWithGradient(100.0, 100.0, 0.05, 1.0, p, gradient);
+    const double expected = gradient[0] * 2.0 * std::sqrt(p.initial_variance);
+    suite.assert_equal(expected, vega, 1e-3 * expected, "dC/dsqrt(v0)");
+
+    // The market data volatility plays no part in the Heston price
+    MarketData other_vol = md;
+    other_vol.volatility = 0.5;
+    suite.assert_equal(vega, option.vega(other_vol), 1e-12);
+  });
+
+  suite.run_test("Aged Heston option rolls down and settles at intrinsic", [&]() {
+    EuropeanOption option(OptionType::Put, 100.0, 1.0, "AAPL",
+                          PricingModel::Heston);
+    const Heston::Parameters p = sampleParameters();
+    option.setHestonParameters(p.initial_variance, p.mean_reversion,
+                               p.long_run_variance, p.vol_of_vol,
+                               p.correlation);
+
+    MarketData md("AAPL", 90.0, 0.05, 0.2);
+    suite.assert_equal(Heston::putPrice(90.0, 100.0, 0.05, 0.75, p),
+                       option.aged(0.25)->price(md), 1e-10, "Rolled down");
+    suite.assert_equal(10.0, option.aged(1.5)->price(md), 1e-12, "Expired");
+
+    const double bump = 1.0 / 365.0;
+    suite.assert_equal((option.aged(bump)->price(md) - option.price(md)) / bump,
+                       option.theta(md), 1e-10, "Theta");
+  });
+}
+
+void test_heston_calibration(TestSuite &suite) {
+  suite.run_test("Calibration recovers parameters from 200 quotes", [&]() {
+    const double S = 100.0, r = 0.03;
+    const Heston::Parameters truth = sampleParameters();
+
+    VolatilitySurface::ImpliedVolSurface surface;
+    const double expiries[] = {0.1,  0.25, 0.5, 0.75, 1.0,
+                               1.5,  2.0,  3.0, 4.0,  5.0};
+    for (double T : expiries) {
+      for (int k = 0; k < 20; ++k) {
+        const double K = 70.0 + 3.0 * k;
+        const double price = Heston::callPrice(S, K, r, T, truth);
+        const double vol = BlackScholes::impliedVolatility(price, S, K, r, T,
+                                                           true, 0.25, 1e-10);
+        surface.addPoint(K, T, vol);
+      }
+    }
+
+    Heston::Parameters guess;
+    guess.initial_variance = 0.03;
+    guess.mean_reversion = 1.0;
+    guess.long_run_variance = 0.03;
+    guess.vol_of_vol = 0.3;
+    guess.correlation = -0.3;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    Heston::CalibrationResult result = Heston::calibrate(surface, S, r, guess);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+
+    std::cout << "(" << elapsed.count() << " ms, " << result.iterations
+              << " iterations) ";
+
+    suite.assert_equal(0.0, result.rmse, 1e-4, "RMSE");
+    suite.assert_equal(truth.initial_variance, result.parameters.initial_variance, 1e-3, "v0");
+    suite.assert_equal(truth.mean_reversion, result.parameters.mean_reversion, 0.05, "kappa");
+    suite.assert_equal(truth.long_run_variance, result.parameters.long_run_variance, 1e-3, "theta");
+    suite.assert_equal(truth.vol_of_vol, result.parameters.vol_of_vol, 0.02, "sigma");
+    suite.assert_equal(truth.correlation, result.parameters.correlation, 0.01, "rho");
+  });
+}
+
+int main() {
+  TestSuite suite;
+
+  std::cout << "\n" << std::string(60, '=') << std::endl;
+  std::cout << "  Heston Model Test Suite" << std::endl;
+  std::cout << std::string(60, '=') << "\n" << std::endl;
+
+  test_heston_pricing(suite);
+  test_heston_gradient(suite);
+  test_heston_instrument(suite);
+  test_heston_calibration(suite);
+
+  suite.print_summary();
+
+  return suite.all_passed() ? 0 : 1;
+}
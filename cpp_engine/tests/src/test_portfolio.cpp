@@ -1,8 +1,21 @@
 #include "Instrument.h"
 #include "MarketData.h"
 #include "Portfolio.h"
+#include "PortfolioLoader.h"
+#include "PortfolioSnapshot.h"
 #include "simple_test.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
 #include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
 
 
 void test_empty_portfolio(TestSuite &suite) {
@@ -296,6 +309,737 @@ void test_portfolio_ordering(TestSuite &suite) {
   });
 }
 
+void test_asset_index(TestSuite &suite) {
+  suite.run_test("Assets are interned in first-seen order", [&]() {
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 100.0, 1.0, "AAPL"), 1);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Put, 90.0, 1.0, "MSFT"), 2);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Put, 95.0, 1.0, "AAPL"), 3);
+
+    suite.assert_equal(2, static_cast<double>(portfolio.getAssetCount()), 0.0);
+    suite.assert_equal(0, portfolio.findAsset("AAPL"), 0.0);
+    suite.assert_equal(1, portfolio.findAsset("MSFT"), 0.0);
+    suite.assert_equal(-1, portfolio.findAsset("GOOG"), 0.0);
+    if (portfolio.getAssetName(1) != "MSFT") {
+      throw std::runtime_error("Asset name lookup wrong");
+    }
+    suite.assert_equal(0, portfolio.getPositionAsset(2), 0.0);
+
+    const auto &aapl = portfolio.getPositionsForAsset(0);
+    if (aapl.size() != 2 || aapl[0] != 0 || aapl[1] != 2) {
+      throw std::runtime_error("AAPL positions should be {0, 2}");
+    }
+    suite.assert_equal(4, portfolio.getTotalQuantityForAsset("AAPL"), 0.0);
+  });
+
+  suite.run_test("Removal keeps the asset index consistent", [&]() {
+    Portfolio portfolio;
+    const char *assets[] = {"AAPL", "MSFT", "AAPL", "GOOG", "MSFT"};
+    for (int i = 0; i < 5; ++i) {
+      portfolio.addInstrument(std::make_unique<EuropeanOption>(
+                                  OptionType::Call, 100.0, 1.0, assets[i]),
+                              i + 1);
+    }
+
+    portfolio.removeInstrument(1);
+
+    for (size_t p = 0; p < portfolio.size(); ++p) {
+      const int asset = portfolio.getPositionAsset(p);
+      if (portfolio.getAssetName(asset) !=
+          portfolio.getInstruments()[p].first->getAssetId()) {
+        throw std::runtime_error("Position asset out of sync after removal");
+      }
+    }
+
+    const auto &msft = portfolio.getPositionsForAsset(portfolio.findAsset("MSFT"));
+    if (msft.size() != 1 || msft[0] != 3) {
+      throw std::runtime_error("MSFT positions should be {3}");
+    }
+    suite.assert_equal(5, portfolio.getTotalQuantityForAsset("MSFT"), 0.0);
+    suite.assert_equal(4, portfolio.getTotalQuantityForAsset("AAPL"), 0.0);
+    suite.assert_equal(0, portfolio.getTotalQuantityForAsset("TSLA"), 0.0);
+
+    portfolio.clear();
+    suite.assert_equal(0, static_cast<double>(portfolio.getAssetCount()), 0.0);
+  });
+}
+
+void test_instrument_arena(TestSuite &suite) {
+  suite.run_test("Emplaced instruments share contiguous arena blocks", [&]() {
+    Portfolio portfolio;
+    portfolio.reserveInstruments<EuropeanOption>(1000);
+    for (int i = 0; i < 1000; ++i) {
+      portfolio.emplaceInstrument<EuropeanOption>(
+          1, OptionType::Call, 100.0 + i, 1.0, i % 2 ? "AAPL" : "MSFT");
+    }
+    portfolio.emplaceInstrument<AmericanOption>(2, OptionType::Put, 95.0, 0.5, "AAPL");
+
+    suite.assert_equal(1001, static_cast<double>(portfolio.size()), 0.0);
+    suite.assert_equal(2, static_cast<double>(portfolio.getArena().blockCount()), 0.0,
+                       "One block per type");
+
+    const auto &instruments = portfolio.getInstruments();
+    const char *first = reinterpret_cast<const char *>(instruments[0].first.get());
+    const char *last = reinterpret_cast<const char *>(instruments[999].first.get());
+    suite.assert_equal(999.0 * sizeof(EuropeanOption), static_cast<double>(last - first), 0.0,
+                       "Same-type instruments are adjacent");
+    suite.assert_equal(1099.0, instruments[999].first->getStrike(), 0.0);
+    suite.assert_equal(500, portfolio.getTotalQuantityForAsset("MSFT"), 0.0);
+  });
+
+  suite.run_test("Arena and heap instruments mix, remove and clear", [&]() {
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 100.0, 1.0, "AAPL"), 1);
+    EuropeanOption &emplaced = portfolio.emplaceInstrument<EuropeanOption>(
+        2, OptionType::Put, 90.0, 1.0, "AAPL");
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 110.0, 1.0, "MSFT"), 3);
+
+    if (&emplaced != portfolio.getInstruments()[1].first.get()) {
+      throw std::runtime_error("Returned reference should be the stored instrument");
+    }
+
+    portfolio.removeInstrument(1);
+    portfolio.removeInstrument(0);
+    suite.assert_equal(3, portfolio.getTotalQuantityForAsset("MSFT"), 0.0);
+
+    portfolio.clear();
+    suite.assert_equal(0, static_cast<double>(portfolio.getArena().blockCount()), 0.0);
+  });
+
+  suite.run_test("Removed arena slots are reused", [&]() {
+    Portfolio portfolio;
+    for (int i = 0; i < 100; ++i) {
+      portfolio.emplaceInstrument<EuropeanOption>(1, OptionType::Call, 100.0 + i, 1.0, "AAPL");
+    }
+    const size_t bytes = portfolio.getArena().bytesUsed();
+
+    // A long-lived book churning positions should not grow the arena
+    for (int round = 0; round < 50; ++round) {
+      portfolio.removeInstrument(round % 100);
+      portfolio.truncate(portfolio.size() - 1);
+      portfolio.emplaceInstrument<EuropeanOption>(2, OptionType::Put, 80.0, 1.0, "MSFT");
+      portfolio.emplaceInstrument<EuropeanOption>(3, OptionType::Call, 120.0, 1.0, "MSFT");
+    }
+    suite.assert_equal(static_cast<double>(bytes),
+                       static_cast<double>(portfolio.getArena().bytesUsed()), 0.0);
+    suite.assert_equal(100, static_cast<double>(portfolio.size()), 0.0);
+    suite.assert_equal(120.0, portfolio.getInstruments()[99].first->getStrike(), 0.0);
+
+    portfolio.emplaceInstrument<AmericanOption>(1, OptionType::Put, 95.0, 0.5, "AAPL");
+    portfolio.removeInstrument(100);
+    portfolio.emplaceInstrument<EuropeanOption>(1, OptionType::Call, 90.0, 1.0, "AAPL");
+    suite.assert_equal(1, static_cast<double>(portfolio.getArena().freeSlotCount()), 0.0,
+                       "Slots are only reused by their own type");
+    portfolio.emplaceInstrument<AmericanOption>(1, OptionType::Put, 90.0, 0.5, "AAPL");
+    suite.assert_equal(0, static_cast<double>(portfolio.getArena().freeSlotCount()), 0.0);
+  });
+
+  suite.run_test("Move-assigned portfolio keeps its instruments valid", [&]() {
+    Portfolio source;
+    source.emplaceInstrument<EuropeanOption>(5, OptionType::Call, 100.0, 1.0, "AAPL");
+    Portfolio target;
+    target.emplaceInstrument<EuropeanOption>(7, OptionType::Put, 80.0, 1.0, "MSFT");
+
+    target = std::move(source);
+    suite.assert_equal(1, static_cast<double>(target.size()), 0.0);
+    suite.assert_equal(100.0, target.getInstruments()[0].first->getStrike(), 0.0);
+
+    MarketData md("AAPL", 100.0, 0.05, 0.2);
+    suite.assert_equal(10.4506, target.getInstruments()[0].first->price(md), 0.01);
+  });
+}
+
+void test_columnar_positions(TestSuite &suite) {
+  suite.run_test("Columns build the same book as individual adds", [&]() {
+    const std::vector<std::string> names = {"AAPL", "MSFT"};
+    const std::vector<uint8_t> is_call = {1, 0, 1, 0};
+    const std::vector<double> strike = {100.0, 95.0, 300.0, 110.0};
+    const std::vector<double> expiry = {1.0, 0.5, 0.25, 2.0};
+    const std::vector<int32_t> quantity = {10, -5, 3, 7};
+    const std::vector<int32_t> asset = {0, 0, 1, 0};
+    const std::vector<uint8_t> american = {0, 1, 0, 0};
+    const std::vector<uint8_t> model = {static_cast<uint8_t>(PricingModel::BlackScholes), 0,
+                                        static_cast<uint8_t>(PricingModel::MertonJumpDiffusion),
+                                        static_cast<uint8_t>(PricingModel::Binomial)};
+    const std::vector<int32_t> steps = {100, 50, 100, 200};
+    const std::vector<double> jump_intensity = {0.0, 0.0, 2.0, 0.0};
+    const std::vector<double> jump_mean = {0.0, 0.0, -0.05, 0.0};
+    const std::vector<double> jump_vol = {0.0, 0.0, 0.15, 0.0};
+
+    PositionColumns columns;
+    columns.count = 4;
+    columns.is_call = is_call.data();
+    columns.strike = strike.data();
+    columns.expiry = expiry.data();
+    columns.quantity = quantity.data();
+    columns.asset = asset.data();
+    columns.asset_names = names.data();
+    columns.asset_name_count = names.size();
+    columns.american = american.data();
+    columns.model = model.data();
+    columns.binomial_steps = steps.data();
+    columns.jump_intensity = jump_intensity.data();
+    columns.jump_mean = jump_mean.data();
+    columns.jump_vol = jump_vol.data();
+
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 120.0, 1.0, "MSFT"), 1);
+    portfolio.addPositions(columns);
+
+    Portfolio expected;
+    expected.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 120.0, 1.0, "MSFT"), 1);
+    expected.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 100.0, 1.0, "AAPL"), 10);
+    expected.addInstrument(
+        std::make_unique<AmericanOption>(OptionType::Put, 95.0, 0.5, "AAPL", 50), -5);
+    auto jump = std::make_unique<EuropeanOption>(OptionType::Call, 300.0, 0.25, "MSFT",
+                                                 PricingModel::MertonJumpDiffusion);
+    jump->setJumpParameters(2.0, -0.05, 0.15);
+    expected.addInstrument(std::move(jump), 3);
+    auto binomial = std::make_unique<EuropeanOption>(OptionType::Put, 110.0, 2.0, "AAPL",
+                                                     PricingModel::Binomial);
+    binomial->setBinomialSteps(200);
+    expected.addInstrument(std::move(binomial), 7);
+
+    suite.assert_equal(5, static_cast<double>(portfolio.size()), 0.0);
+    suite.assert_equal(2, static_cast<double>(portfolio.getAssetCount()), 0.0);
+    suite.assert_equal(0, portfolio.findAsset("MSFT"), 0.0, "Existing asset reused");
+    const std::map<std::string, MarketData> market_data = {
+        {"AAPL", MarketData("AAPL", 105.0, 0.05, 0.25)},
+        {"MSFT", MarketData("MSFT", 290.0, 0.05, 0.2)}};
+    for (size_t i = 0; i < portfolio.size(); ++i) {
+      const auto &[instrument, qty] = portfolio.getInstruments()[i];
+      const auto &[reference, reference_qty] = expected.getInstruments()[i];
+      const MarketData &md = market_data.at(reference->getAssetId());
+      suite.assert_equal(reference->price(md), instrument->price(md), 1e-12, "Price");
+      suite.assert_equal(reference_qty, qty, 0.0, "Quantity");
+      suite.assert_equal(expected.getPositionAsset(i), portfolio.getPositionAsset(i), 0.0);
+      if (i > 0 && portfolio.getPositionId(i) <= portfolio.getPositionId(i - 1)) {
+        throw std::runtime_error("Position IDs should increase in column order");
+      }
+    }
+    suite.assert_equal(expected.getTotalQuantityForAsset("AAPL"),
+                       portfolio.getTotalQuantityForAsset("AAPL"), 0.0);
+  });
+
+  suite.run_test("A bad row rejects the whole batch", [&]() {
+    const std::vector<std::string> names = {"AAPL"};
+    const std::vector<uint8_t> is_call = {1, 1, 1};
+    const std::vector<double> strike = {100.0, 0.0, 100.0};
+    const std::vector<double> expiry = {1.0, 1.0, 1.0};
+    const std::vector<int32_t> quantity = {1, 1, 1};
+    const std::vector<int32_t> asset = {0, 0, 0};
+    PositionColumns columns;
+    columns.count = 3;
+    columns.is_call = is_call.data();
+    columns.strike = strike.data();
+    columns.expiry = expiry.data();
+    columns.quantity = quantity.data();
+    columns.asset = asset.data();
+    columns.asset_names = names.data();
+    columns.asset_name_count = names.size();
+
+    Portfolio portfolio;
+    try {
+      portfolio.addPositions(columns);
+    } catch (const std::invalid_argument &e) {
+      if (std::string(e.what()).find("Position 1") == std::string::npos) {
+        throw std::runtime_error(std::string("Error should name the row: ") + e.what());
+      }
+      suite.assert_equal(0, static_cast<double>(portfolio.size()), 0.0);
+      return;
+    }
+    throw std::runtime_error("Expected invalid_argument");
+  });
+
+  suite.run_test("Heston rows are rejected", [&]() {
+    const std::vector<std::string> names = {"AAPL"};
+    const std::vector<uint8_t> is_call = {1, 0};
+    const std::vector<double> strike = {100.0, 100.0};
+    const std::vector<double> expiry = {1.0, 1.0};
+    const std::vector<int32_t> quantity = {1, 1};
+    const std::vector<int32_t> asset = {0, 0};
+    const std::vector<uint8_t> model = {static_cast<uint8_t>(PricingModel::BlackScholes),
+                                        static_cast<uint8_t>(PricingModel::Heston)};
+    PositionColumns columns;
+    columns.count = 2;
+    columns.is_call = is_call.data();
+    columns.strike = strike.data();
+    columns.expiry = expiry.data();
+    columns.quantity = quantity.data();
+    columns.asset = asset.data();
+    columns.asset_names = names.data();
+    columns.asset_name_count = names.size();
+    columns.model = model.data();
+
+    Portfolio portfolio;
+    try {
+      portfolio.addPositions(columns);
+    } catch (const std::invalid_argument &e) {
+      if (std::string(e.what()).find("Position 1: Heston") == std::string::npos) {
+        throw std::runtime_error(std::string("Error should name the Heston row: ") + e.what());
+      }
+      suite.assert_equal(0, static_cast<double>(portfolio.size()), 0.0);
+      return;
+    }
+    throw std::runtime_error("Expected invalid_argument");
+  });
+
+  suite.run_test("Step counts are only checked on lattice rows", [&]() {
+    const std::vector<std::string> names = {"AAPL"};
+    const std::vector<uint8_t> is_call = {1, 1, 0};
+    const std::vector<double> strike = {100.0, 100.0, 100.0};
+    const std::vector<double> expiry = {1.0, 1.0, 1.0};
+    const std::vector<int32_t> quantity = {1, 1, 1};
+    const std::vector<int32_t> asset = {0, 0, 0};
+    const std::vector<uint8_t> american = {0, 0, 1};
+    const std::vector<uint8_t> model = {static_cast<uint8_t>(PricingModel::BlackScholes),
+                                        static_cast<uint8_t>(PricingModel::Binomial),
+                                        static_cast<uint8_t>(PricingModel::BlackScholes)};
+    std::vector<int32_t> steps = {0, 250, 300};
+    PositionColumns columns;
+    columns.count = 3;
+    columns.is_call = is_call.data();
+    columns.strike = strike.data();
+    columns.expiry = expiry.data();
+    columns.quantity = quantity.data();
+    columns.asset = asset.data();
+    columns.asset_names = names.data();
+    columns.asset_name_count = names.size();
+    columns.american = american.data();
+    columns.model = model.data();
+    columns.binomial_steps = steps.data();
+
+    Portfolio portfolio;
+    portfolio.addPositions(columns);
+    const auto &instruments = portfolio.getInstruments();
+    const auto &binomial = static_cast<const EuropeanOption &>(*instruments[1].first);
+    const auto &american_put = static_cast<const AmericanOption &>(*instruments[2].first);
+    suite.assert_equal(250, binomial.getBinomialSteps(), 0.0);
+    suite.assert_equal(300, american_put.getBinomialSteps(), 0.0);
+
+    steps[1] = 0;
+    try {
+      portfolio.addPositions(columns);
+    } catch (const std::invalid_argument &e) {
+      if (std::string(e.what()).find("Position 1: binomial") == std::string::npos) {
+        throw std::runtime_error(std::string("Error should name the binomial row: ") + e.what());
+      }
+      suite.assert_equal(3, static_cast<double>(portfolio.size()), 0.0);
+      return;
+    }
+    throw std::runtime_error("Expected invalid_argument");
+  });
+
+  suite.run_test("100k columnar positions load in one pass", [&]() {
+    const size_t count = 100000;
+    std::vector<std::string> names;
+    for (int a = 0; a < 50; ++a) names.push_back("ASSET" + std::to_string(a));
+    std::vector<uint8_t> is_call(count);
+    std::vector<double> strike(count), expiry(count);
+    std::vector<int32_t> quantity(count), asset(count);
+    for (size_t i = 0; i < count; ++i) {
+      is_call[i] = i % 2;
+      strike[i] = 80.0 + static_cast<double>(i % 40);
+      expiry[i] = 0.25 + 0.25 * static_cast<double>(i % 8);
+      quantity[i] = static_cast<int32_t>(i % 7) - 3;
+      asset[i] = static_cast<int32_t>(i % names.size());
+    }
+    PositionColumns columns;
+    columns.count = count;
+    columns.is_call = is_call.data();
+    columns.strike = strike.data();
+    columns.expiry = expiry.data();
+    columns.quantity = quantity.data();
+    columns.asset = asset.data();
+    columns.asset_names = names.data();
+    columns.asset_name_count = names.size();
+
+    Portfolio portfolio;
+    auto start = std::chrono::high_resolution_clock::now();
+    portfolio.addPositions(columns);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    std::cout << "(" << elapsed.count() << " ms) ";
+
+    suite.assert_equal(static_cast<double>(count), static_cast<double>(portfolio.size()), 0.0);
+    suite.assert_equal(2000, static_cast<double>(portfolio.getPositionsForAsset(7).size()), 0.0);
+  });
+}
+
+std::string snapshotPath(const std::string &name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+void test_snapshots(TestSuite &suite) {
+  suite.run_test("Snapshot round-trips positions and market data", [&]() {
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 100.0, 1.0, "AAPL"), 10);
+    portfolio.addInstrument(
+        std::make_unique<AmericanOption>(OptionType::Put, 95.0, 0.5, "AAPL", 50), -5);
+    auto jump = std::make_unique<EuropeanOption>(OptionType::Call, 300.0, 0.25, "MSFT",
+                                                 PricingModel::MertonJumpDiffusion);
+    jump->setJumpParameters(2.0, -0.05, 0.15);
+    portfolio.addInstrument(std::move(jump), 3);
+    auto binomial = std::make_unique<EuropeanOption>(OptionType::Put, 110.0, 2.0, "AAPL",
+                                                     PricingModel::Binomial);
+    binomial->setBinomialSteps(200);
+    portfolio.addInstrument(std::move(binomial), 7);
+
+    const std::map<std::string, MarketData> market_data = {
+        {"AAPL", MarketData("AAPL", 105.0, 0.05, 0.25, 0.01)},
+        {"MSFT", MarketData("MSFT", 290.0, 0.04, 0.2)},
+        {"GOOG", MarketData("GOOG", 140.0, 0.05, 0.3)}};
+
+    const std::string path = snapshotPath("qe_test_snapshot.bin");
+    PortfolioSnapshot::write(path, portfolio, market_data);
+    {
+      PortfolioSnapshot snapshot(path);
+      suite.assert_equal(4, static_cast<double>(snapshot.positionCount()), 0.0);
+      suite.assert_equal(3, static_cast<double>(snapshot.assetCount()), 0.0,
+                         "Market-data-only assets are stored too");
+      suite.assert_equal(-5, snapshot.columns().quantity[1], 0.0, "Columns read in place");
+
+      const std::map<std::string, MarketData> loaded_md = snapshot.marketData();
+      suite.assert_equal(3, static_cast<double>(loaded_md.size()), 0.0);
+      suite.assert_equal(0.01, loaded_md.at("AAPL").dividend_yield, 0.0);
+      suite.assert_equal(140.0, loaded_md.at("GOOG").spot_price, 0.0);
+
+      Portfolio loaded;
+      snapshot.loadInto(loaded);
+      suite.assert_equal(4, static_cast<double>(loaded.size()), 0.0);
+      for (size_t i = 0; i < loaded.size(); ++i) {
+        const auto &[instrument, qty] = loaded.getInstruments()[i];
+        const auto &[reference, reference_qty] = portfolio.getInstruments()[i];
+        const MarketData &md = loaded_md.at(reference->getAssetId());
+        suite.assert_equal(reference->price(md), instrument->price(md), 1e-12, "Price");
+        suite.assert_equal(reference_qty, qty, 0.0, "Quantity");
+        if (instrument->getInstrumentType() != reference->getInstrumentType()) {
+          throw std::runtime_error("Instrument type changed in the round trip");
+        }
+      }
+    }
+    std::remove(path.c_str());
+  });
+
+  suite.run_test("Snapshot rejects unsupported instruments and bad files", [&]() {
+    Portfolio portfolio;
+    portfolio.addInstrument(std::make_unique<EuropeanOption>(OptionType::Call, 100.0, 1.0,
+                                                             "AAPL", PricingModel::Heston),
+                            1);
+    const std::string path = snapshotPath("qe_test_snapshot_bad.bin");
+    bool threw = false;
+    try {
+      PortfolioSnapshot::write(path, portfolio, {});
+    } catch (const std::invalid_argument &) {
+      threw = true;
+    }
+    if (!threw) throw std::runtime_error("Expected Heston position to be rejected");
+
+    {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      out << "not a snapshot, just some bytes padding it past the header size........"
+             "................................................................";
+    }
+    threw = false;
+    try {
+      PortfolioSnapshot snapshot(path);
+    } catch (const std::runtime_error &) {
+      threw = true;
+    }
+    std::remove(path.c_str());
+    if (!threw) throw std::runtime_error("Expected a corrupt file to be rejected");
+  });
+
+  suite.run_test("1M-position snapshot opens without parsing", [&]() {
+    const size_t count = 1000000;
+    std::vector<std::string> names;
+    for (int a = 0; a < 100; ++a) names.push_back("ASSET" + std::to_string(a));
+    std::vector<uint8_t> is_call(count);
+    std::vector<double> strike(count), expiry(count);
+    std::vector<int32_t> quantity(count), asset(count);
+    for (size_t i = 0; i < count; ++i) {
+      is_call[i] = i % 2;
+      strike[i] = 80.0 + static_cast<double>(i % 40);
+      expiry[i] = 0.25 + 0.25 * static_cast<double>(i % 8);
+      quantity[i] = static_cast<int32_t>(i % 7) - 3;
+      asset[i] = static_cast<int32_t>(i % names.size());
+    }
+    PositionColumns columns;
+    columns.count = count;
+    columns.is_call = is_call.data();
+    columns.strike = strike.data();
+    columns.expiry = expiry.data();
+    columns.quantity = quantity.data();
+    columns.asset = asset.data();
+    columns.asset_names = names.data();
+    columns.asset_name_count = names.size();
+    Portfolio portfolio;
+    portfolio.addPositions(columns);
+
+    const std::string path = snapshotPath("qe_test_snapshot_large.bin");
+    PortfolioSnapshot::write(path, portfolio, {});
+    {
+      auto start = std::chrono::high_resolution_clock::now();
+      PortfolioSnapshot snapshot(path);
+      auto opened = std::chrono::high_resolution_clock::now();
+      Portfolio loaded;
+      snapshot.loadInto(loaded);
+      auto end = std::chrono::high_resolution_clock::now();
+      std::chrono::duration<double, std::milli> open_ms = opened - start;
+      std::chrono::duration<double, std::milli> load_ms = end - opened;
+      std::cout << "(open " << open_ms.count() << " ms, load " << load_ms.count() << " ms) ";
+
+      suite.assert_equal(static_cast<double>(count), static_cast<double>(loaded.size()), 0.0);
+      suite.assert_equal(portfolio.getTotalQuantityForAsset("ASSET42"),
+                         loaded.getTotalQuantityForAsset("ASSET42"), 0.0);
+    }
+    std::remove(path.c_str());
+  });
+}
+
+Portfolio loadBook(const std::string &text, PortfolioLoader::Format format) {
+  std::istringstream in(text);
+  PositionBuffer buffer;
+  PortfolioLoader::readPositions(in, format,
+                                 [&](const PositionRecord &record) { buffer.add(record); });
+  Portfolio portfolio;
+  portfolio.addPositions(buffer.columns());
+  return portfolio;
+}
+
+void expectRejected(const std::string &text, PortfolioLoader::Format format,
+                    const std::string &where) {
+  std::istringstream in(text);
+  try {
+    PortfolioLoader::readPositions(in, format, [](const PositionRecord &) {});
+  } catch (const std::invalid_argument &e) {
+    if (std::string(e.what()).find(where) == std::string::npos) {
+      throw std::runtime_error("Error does not name " + where + ": " + e.what());
+    }
+    return;
+  }
+  throw std::runtime_error("Expected rejection at " + where);
+}
+
+void test_portfolio_loader(TestSuite &suite) {
+  suite.run_test("CSV and JSON files build the same book", [&]() {
+    const std::string csv =
+        "asset_id,type,strike,expiry,quantity,style,pricing_model,binomial_steps,jump_lambda\n"
+        "AAPL,call,100,1.0,10,european,blackscholes,,\n"
+        "AAPL,PUT,95,0.5,-5,american,,50,\n"
+        "\"MSFT\",call,300,0.25,3,,jumpdiffusion,,1.5\n";
+    const std::string json =
+        "{\"portfolio\": ["
+        "{\"type\": \"call\", \"strike\": 100, \"expiry\": 1.0, \"asset_id\": \"AAPL\","
+        " \"quantity\": 10},"
+        "{\"type\": \"put\", \"strike\": 95, \"expiry\": 0.5, \"asset_id\": \"AAPL\","
+        " \"quantity\": -5, \"style\": \"american\", \"binomial_steps\": 50},"
+        "{\"type\": \"call\", \"strike\": 300, \"expiry\": 0.25, \"asset_id\": \"MSFT\","
+        " \"quantity\": 3, \"pricing_model\": \"jumpdiffusion\","
+        " \"jump_parameters\": {\"lambda\": 1.5}}]}";
+
+    Portfolio reference;
+    reference.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 100.0, 1.0, "AAPL"), 10);
+    reference.addInstrument(
+        std::make_unique<AmericanOption>(OptionType::Put, 95.0, 0.5, "AAPL", 50), -5);
+    auto jump = std::make_unique<EuropeanOption>(OptionType::Call, 300.0, 0.25, "MSFT",
+                                                 PricingModel::MertonJumpDiffusion);
+    jump->setJumpParameters(1.5, -0.05, 0.15);
+    reference.addInstrument(std::move(jump), 3);
+
+    const MarketData aapl("AAPL", 105.0, 0.05, 0.25);
+    const MarketData msft("MSFT", 290.0, 0.04, 0.2);
+    for (auto format : {PortfolioLoader::Format::Csv, PortfolioLoader::Format::Json}) {
+      const Portfolio loaded =
+          loadBook(format == PortfolioLoader::Format::Csv ? csv : json, format);
+      suite.assert_equal(3, static_cast<double>(loaded.size()), 0.0);
+      suite.assert_equal(2, static_cast<double>(loaded.getAssetCount()), 0.0);
+      for (size_t i = 0; i < loaded.size(); ++i) {
+        const auto &[instrument, qty] = loaded.getInstruments()[i];
+        const auto &[expected, expected_qty] = reference.getInstruments()[i];
+        const MarketData &md = expected->getAssetId() == "AAPL" ? aapl : msft;
+        suite.assert_equal(expected->price(md), instrument->price(md), 1e-12, "Price");
+        suite.assert_equal(expected_qty, qty, 0.0, "Quantity");
+        if (instrument->getInstrumentType() != expected->getInstrumentType()) {
+          throw std::runtime_error("Loaded instrument has the wrong type");
+        }
+      }
+    }
+  });
+
+  suite.run_test("Bad rows are reported by line or index", [&]() {
+    expectRejected("type,strike,expiry,asset_id,quantity\n"
+                   "call,100,1.0,AAPL,10\n"
+                   "call,abc,1.0,AAPL,10\n",
+                   PortfolioLoader::Format::Csv, "Line 3");
+    expectRejected("type,strike,expiry,quantity\ncall,100,1.0,10\n",
+                   PortfolioLoader::Format::Csv, "asset_id");
+    expectRejected("[{\"type\": \"call\", \"strike\": 100, \"expiry\": 1, "
+                   "\"asset_id\": \"AAPL\", \"quantity\": 1},"
+                   " {\"type\": \"straddle\", \"strike\": 100, \"expiry\": 1, "
+                   "\"asset_id\": \"AAPL\", \"quantity\": 1}]",
+                   PortfolioLoader::Format::Json, "Portfolio item 1");
+    expectRejected("[{\"type\": \"call\"", PortfolioLoader::Format::Json, "Invalid JSON");
+  });
+
+  suite.run_test("Market data reads from CSV and request-body JSON", [&]() {
+    std::istringstream csv("asset_id,spot,rate,vol,dividend\n"
+                           "AAPL,105,0.05,0.25,0.01\n"
+                           "MSFT,290,0.04,0.2,\n");
+    const auto from_csv = PortfolioLoader::readMarketData(csv, PortfolioLoader::Format::Csv);
+    suite.assert_equal(2, static_cast<double>(from_csv.size()), 0.0);
+    suite.assert_equal(0.01, from_csv.at("AAPL").dividend_yield, 0.0);
+    suite.assert_equal(0.0, from_csv.at("MSFT").dividend_yield, 0.0, "Dividend defaults to 0");
+
+    std::istringstream json("{\"portfolio\": [], \"market_data\": {"
+                            "\"AAPL\": {\"spot\": 105, \"rate\": 0.05, \"vol\": 0.25,"
+                            " \"dividend\": 0.01},"
+                            "\"MSFT\": {\"spot\": 290, \"rate\": 0.04, \"vol\": 0.2}}}");
+    const auto from_json = PortfolioLoader::readMarketData(json, PortfolioLoader::Format::Json);
+    suite.assert_equal(2, static_cast<double>(from_json.size()), 0.0);
+    suite.assert_equal(290.0, from_json.at("MSFT").spot_price, 0.0);
+    suite.assert_equal(from_csv.at("AAPL").volatility, from_json.at("AAPL").volatility, 0.0);
+  });
+}
+
+std::string writePositionsCsv(const std::string &name, size_t rows, size_t bad_row) {
+  const std::string path = snapshotPath(name);
+  std::ofstream out(path, std::ios::trunc);
+  out << "type,strike,expiry,asset_id,quantity,style\n";
+  for (size_t i = 0; i < rows; ++i) {
+    out << (i % 2 ? "put" : "call") << ',' << (i == bad_row ? "-1" : "100") << ','
+        << 0.25 + 0.25 * (i % 4) << ",ASSET" << i % 7 << ',' << i % 5 + 1 << ','
+        << (i % 3 ? "european" : "american") << '\n';
+  }
+  return path;
+}
+
+void test_position_stream(TestSuite &suite) {
+  suite.run_test("Batches stream in file order and match a full load", [&]() {
+    const std::string path = writePositionsCsv("qe_test_stream.csv", 10000, SIZE_MAX);
+    Portfolio streamed;
+    size_t batches = 0;
+    {
+      PositionStream stream(path, 1000, 2);
+      PositionBuffer batch;
+      while (stream.next(batch)) {
+        suite.assert_equal(1000, static_cast<double>(batch.size()), 0.0, "Batch size");
+        streamed.addPositions(batch.columns());
+        ++batches;
+      }
+      suite.assert_equal(0, stream.next(batch) ? 1.0 : 0.0, 0.0, "Stream stays exhausted");
+    }
+    suite.assert_equal(10, static_cast<double>(batches), 0.0);
+
+    Portfolio loaded;
+    PortfolioLoader::loadPositions(path, loaded);
+    suite.assert_equal(10000, static_cast<double>(loaded.size()), 0.0);
+    suite.assert_equal(7, static_cast<double>(loaded.getAssetCount()), 0.0);
+    for (size_t i = 0; i < loaded.size(); i += 997) {
+      const auto &[instrument, qty] = loaded.getInstruments()[i];
+      const auto &[expected, expected_qty] = streamed.getInstruments()[i];
+      suite.assert_equal(expected_qty, qty, 0.0, "Quantity");
+      suite.assert_equal(expected->getTimeToExpiry(), instrument->getTimeToExpiry(), 0.0);
+      if (instrument->getInstrumentType() != expected->getInstrumentType()) {
+        throw std::runtime_error("Streamed instrument has the wrong type");
+      }
+    }
+
+    {
+      // Destroyed with the reader blocked on a full queue
+      PositionStream abandoned(path, 100, 1);
+      PositionBuffer batch;
+      abandoned.next(batch);
+    }
+    std::remove(path.c_str());
+  });
+
+  suite.run_test("A bad row surfaces after earlier batches and rolls back a load", [&]() {
+    const std::string path = writePositionsCsv("qe_test_stream_bad.csv", 5000, 2500);
+    {
+      PositionStream stream(path, 1000, 4);
+      PositionBuffer batch;
+      size_t delivered = 0;
+      bool threw = false;
+      try {
+        while (stream.next(batch)) delivered += batch.size();
+      } catch (const std::invalid_argument &e) {
+        threw = std::string(e.what()).find("Line 2502") != std::string::npos;
+      }
+      suite.assert_equal(2000, static_cast<double>(delivered), 0.0,
+                         "Full batches before the bad row are delivered");
+      if (!threw) throw std::runtime_error("Expected the bad row to be reported by line");
+    }
+
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 100.0, 1.0, "AAPL"), 1);
+    bool threw = false;
+    try {
+      PortfolioLoader::loadPositions(path, portfolio);
+    } catch (const std::invalid_argument &) {
+      threw = true;
+    }
+    std::remove(path.c_str());
+    if (!threw) throw std::runtime_error("Expected loadPositions to throw");
+    suite.assert_equal(1, static_cast<double>(portfolio.size()), 0.0, "Load rolled back");
+    suite.assert_equal(1, static_cast<double>(portfolio.getPositionsForAsset(0).size()), 0.0);
+  });
+
+  suite.run_test("Quoted fields and CRLF lines split in place", [&]() {
+    std::istringstream in("\"type\",strike,expiry,asset_id,quantity\r\n"
+                          "# comment\r\n"
+                          "call, 100 ,1.0,\"BRK \"\"B\"\", A\",2\r\n"
+                          "\r\n"
+                          "put,90,0.5,\"X,Y\",-3");
+    std::vector<PositionRecord> records;
+    PortfolioLoader::readPositions(in, PortfolioLoader::Format::Csv,
+                                   [&](const PositionRecord &r) { records.push_back(r); });
+    suite.assert_equal(2, static_cast<double>(records.size()), 0.0);
+    if (records[0].asset_id != "BRK \"B\", A" || records[1].asset_id != "X,Y") {
+      throw std::runtime_error("Quoted asset ids mangled: " + records[0].asset_id);
+    }
+    suite.assert_equal(100.0, records[0].strike, 0.0);
+    suite.assert_equal(-3, records[1].quantity, 0.0);
+  });
+
+  suite.run_test("Numbers parse exactly as strtod does", [&]() {
+    std::vector<std::string> texts = {"0", "0.5", "+12.25", ".5", "7.", "1e3", "123456789012345",
+                                      "1234567890123456789", "0.1000000000000000055511",
+                                      "0.000000000000000000000000001", "99.99999999999999"};
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> dist(0.0, 500.0);
+    char text[32];
+    for (int i = 0; i < 2000; ++i) {
+      std::snprintf(text, sizeof(text), "%.*f", i % 12, dist(rng));
+      texts.push_back(text);
+    }
+
+    std::string rows = "type,strike,expiry,asset_id,quantity\n";
+    for (const auto &t : texts) rows += "call,1," + t + ",A,1\n";
+    std::istringstream in(rows);
+    size_t i = 0;
+    PortfolioLoader::readPositions(in, PortfolioLoader::Format::Csv, [&](const PositionRecord &r) {
+      const double expected = std::strtod(texts[i].c_str(), nullptr);
+      if (r.expiry != expected) {
+        throw std::runtime_error("Parsed " + texts[i] + " inexactly");
+      }
+      ++i;
+    });
+    suite.assert_equal(static_cast<double>(texts.size()), static_cast<double>(i), 0.0);
+  });
+}
+
 int main() {
   TestSuite suite;
 
@@ -313,6 +1057,12 @@ int main() {
   test_large_portfolio(suite);
   test_instrument_pricing_in_portfolio(suite);
   test_portfolio_ordering(suite);
+  test_asset_index(suite);
+  test_instrument_arena(suite);
+  test_columnar_positions(suite);
+  test_snapshots(suite);
+  test_portfolio_loader(suite);
+  test_position_stream(suite);
 
   suite.print_summary();
 
@@ -1,13 +1,21 @@
+#include "BlackScholes.h"
+#include "ImpliedVolatilitySurface.h"
 #include "Instrument.h"
 #include "MarketData.h"
+#include "Parallel.h"
 #include "Portfolio.h"
+#include "ReturnHistory.h"
 #include "RiskEngine.h"
 #include "simple_test.h"
 #include <cmath>
+#include <cstdio>
+#include <filesystem>
 #include <map>
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
+#include <thread>
 
 
 // Helper function to create market data
@@ -484,6 +492,806 @@ void test_theta_time_decay(TestSuite &suite) {
   });
 }
 
+void test_surface_market_data(TestSuite &suite) {
+  suite.run_test("Instruments price off the implied vol surface", [&]() {
+    auto surface = std::make_shared<VolatilitySurface::ImpliedVolSurface>();
+    surface->addPoint(90.0, 1.0, 0.25);
+    surface->addPoint(100.0, 1.0, 0.20);
+    surface->addPoint(110.0, 1.0, 0.18);
+
+    SurfaceMarketData smd(createMarketData("AAPL", 100.0, 0.05, 0.2));
+    smd.vol_surface = surface;
+    smd.rate_curve = std::make_shared<RateCurve>(0.03);
+
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Put, 90.0, 1.0, "AAPL"), 1);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 110.0, 1.0, "AAPL"), 1);
+
+    std::map<std::string, SurfaceMarketData> surface_map;
+    surface_map["AAPL"] = smd;
+
+    RiskEngine engine;
+    engine.setRandomSeed(42);
+    PortfolioRiskResult result =
+        engine.calculatePortfolioRisk(portfolio, surface_map);
+
+    const double expected_pv =
+        BlackScholes::putPrice(100.0, 90.0, 0.03, 1.0, 0.25) +
+        BlackScholes::callPrice(100.0, 110.0, 0.03, 1.0, 0.18);
+    suite.assert_equal(expected_pv, result.total_pv, 1e-10, "Smile PV");
+
+    if (result.value_at_risk_95 <= 0.0) {
+      throw std::runtime_error("VaR should be positive for long options");
+    }
+  });
+
+  suite.run_test("Flat surface matches flat market data", [&]() {
+    auto surface = std::make_shared<VolatilitySurface::ImpliedVolSurface>();
+    surface->addPoint(100.0, 1.0, 0.2);
+
+    std::map<std::string, MarketData> flat_map;
+    flat_map["AAPL"] = createMarketData("AAPL", 100.0, 0.05, 0.2);
+    std::map<std::string, SurfaceMarketData> surface_map;
+    surface_map["AAPL"] = SurfaceMarketData(flat_map["AAPL"]);
+    surface_map["AAPL"].vol_surface = surface;
+
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 95.0, 1.0, "AAPL"), 3);
+
+    RiskEngine engine;
+    engine.setRandomSeed(7);
+    PortfolioRiskResult flat = engine.calculatePortfolioRisk(portfolio, flat_map);
+    PortfolioRiskResult smile = engine.calculatePortfolioRisk(portfolio, surface_map);
+
+    suite.assert_equal(flat.total_pv, smile.total_pv, 1e-10, "PV");
+    suite.assert_equal(flat.total_vega, smile.total_vega, 1e-10, "Vega");
+    suite.assert_equal(flat.value_at_risk_99, smile.value_at_risk_99, 1e-10, "VaR 99");
+  });
+}
+
+void test_versioned_market_data(TestSuite &suite) {
+  auto buildPortfolio = [](Portfolio &portfolio) {
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 1.0, "AAPL"), 100);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Put, 140.0, 0.5, "AAPL"), -50);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 300.0, 1.0, "MSFT"), 20);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Put, 2800.0, 0.25, "GOOGL"), 5);
+  };
+
+  auto buildManager = [](MarketDataManager &manager) {
+    manager.addMarketData("AAPL", createMarketData("AAPL", 150.0, 0.05, 0.25));
+    manager.addMarketData("MSFT", createMarketData("MSFT", 300.0, 0.05, 0.20));
+    manager.addMarketData("GOOGL", createMarketData("GOOGL", 2800.0, 0.05, 0.30));
+  };
+
+  auto assertSameRisk = [&](const PortfolioRiskResult &expected,
+                            const PortfolioRiskResult &actual) {
+    suite.assert_equal(expected.total_pv, actual.total_pv, 1e-8, "PV");
+    suite.assert_equal(expected.total_delta, actual.total_delta, 1e-8, "Delta");
+    suite.assert_equal(expected.total_vega, actual.total_vega, 1e-8, "Vega");
+    suite.assert_equal(expected.value_at_risk_95, actual.value_at_risk_95, 1e-6, "VaR 95");
+    suite.assert_equal(expected.expected_shortfall_99, actual.expected_shortfall_99, 1e-6, "ES 99");
+  };
+
+  suite.run_test("Version stamps advance only on changes", [&]() {
+    MarketDataManager manager;
+    buildManager(manager);
+    const uint64_t aapl = manager.getVersion("AAPL");
+    const uint64_t latest = manager.getLatestVersion();
+
+    manager.updateMarketData("AAPL", createMarketData("AAPL", 150.0, 0.05, 0.25));
+    suite.assert_equal(static_cast<double>(aapl),
+                       static_cast<double>(manager.getVersion("AAPL")), 0.0, "Same tick");
+
+    manager.updateMarketData("AAPL", createMarketData("AAPL", 151.0, 0.05, 0.25));
+    suite.assert_equal(1, manager.getVersion("AAPL") > latest ? 1.0 : 0.0, 0.0, "New tick");
+    suite.assert_equal(static_cast<double>(manager.getVersion("AAPL")),
+                       static_cast<double>(manager.getLatestVersion()), 0.0, "Latest");
+  });
+
+  suite.run_test("Versioned run matches a full run", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    MarketDataManager manager;
+    buildManager(manager);
+
+    RiskEngine engine(4000);
+    engine.setRandomSeed(21);
+    PortfolioRiskResult versioned = engine.calculatePortfolioRisk(portfolio, manager);
+    PortfolioRiskResult full =
+        engine.calculatePortfolioRisk(portfolio, manager.getAllMarketData());
+    assertSameRisk(full, versioned);
+
+    RiskCacheStats stats = engine.getLastCacheStats();
+    suite.assert_equal(4, static_cast<double>(stats.repriced_positions), 0.0);
+    suite.assert_equal(3, static_cast<double>(stats.revalued_assets), 0.0);
+  });
+
+  suite.run_test("Only positions on the ticked asset are repriced", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    MarketDataManager manager;
+    buildManager(manager);
+
+    RiskEngine engine(4000);
+    engine.setRandomSeed(21);
+    engine.calculatePortfolioRisk(portfolio, manager);
+
+    engine.calculatePortfolioRisk(portfolio, manager);
+    suite.assert_equal(0, static_cast<double>(engine.getLastCacheStats().repriced_positions),
+                       0.0, "Nothing ticked");
+
+    manager.updateMarketData("AAPL", createMarketData("AAPL", 152.5, 0.05, 0.27));
+    PortfolioRiskResult versioned = engine.calculatePortfolioRisk(portfolio, manager);
+    RiskCacheStats stats = engine.getLastCacheStats();
+    suite.assert_equal(2, static_cast<double>(stats.repriced_positions), 0.0, "Repriced");
+    suite.assert_equal(1, static_cast<double>(stats.revalued_assets), 0.0, "Revalued");
+
+    assertSameRisk(engine.calculatePortfolioRisk(portfolio, manager.getAllMarketData()),
+                   versioned);
+  });
+
+  suite.run_test("Switching managers reprices the book", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    MarketDataManager first;
+    buildManager(first);
+    MarketDataManager second;
+    second.addMarketData("AAPL", createMarketData("AAPL", 180.0, 0.05, 0.25));
+    second.addMarketData("MSFT", createMarketData("MSFT", 300.0, 0.05, 0.20));
+    second.addMarketData("GOOGL", createMarketData("GOOGL", 2800.0, 0.05, 0.30));
+
+    RiskEngine engine(4000);
+    engine.setRandomSeed(21);
+    engine.calculatePortfolioRisk(portfolio, first);
+    PortfolioRiskResult switched = engine.calculatePortfolioRisk(portfolio, second);
+    suite.assert_equal(4, static_cast<double>(engine.getLastCacheStats().repriced_positions),
+                       0.0, "Repriced");
+
+    RiskEngine fresh(4000);
+    fresh.setRandomSeed(21);
+    assertSameRisk(fresh.calculatePortfolioRisk(portfolio, second), switched);
+  });
+
+  suite.run_test("Position changes revalue only their asset", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    MarketDataManager manager;
+    buildManager(manager);
+
+    RiskEngine engine(4000);
+    engine.setRandomSeed(21);
+    engine.calculatePortfolioRisk(portfolio, manager);
+
+    portfolio.updateQuantity(2, 35);
+    portfolio.removeInstrument(1);
+    PortfolioRiskResult versioned = engine.calculatePortfolioRisk(portfolio, manager);
+    RiskCacheStats stats = engine.getLastCacheStats();
+    suite.assert_equal(0, static_cast<double>(stats.repriced_positions), 0.0, "Repriced");
+    suite.assert_equal(2, static_cast<double>(stats.revalued_assets), 0.0, "Revalued");
+    suite.assert_equal(3, static_cast<double>(stats.cached_positions), 0.0, "Evicted");
+
+    assertSameRisk(engine.calculatePortfolioRisk(portfolio, manager.getAllMarketData()),
+                   versioned);
+  });
+}
+
+void test_market_data_table(TestSuite &suite) {
+  suite.run_test("Symbol table interns tickers densely", [&]() {
+    AssetSymbolTable symbols;
+    suite.assert_equal(0, symbols.intern("AAPL"), 0.0);
+    suite.assert_equal(1, symbols.intern("MSFT"), 0.0);
+    suite.assert_equal(0, symbols.intern("AAPL"), 0.0);
+    suite.assert_equal(1, symbols.find("MSFT"), 0.0);
+    if (symbols.find("GOOGL") != AssetSymbolTable::npos) {
+      throw std::runtime_error("Unknown ticker should not be found");
+    }
+    if (symbols.name(1) != "MSFT") {
+      throw std::runtime_error("Name lookup wrong");
+    }
+  });
+
+  suite.run_test("Table overload matches the map adapter", [&]() {
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 1.0, "AAPL"), 100);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Put, 290.0, 0.5, "MSFT"), -40);
+
+    std::map<std::string, MarketData> market_data;
+    market_data["AAPL"] = createMarketData("AAPL", 150.0, 0.05, 0.25);
+    market_data["MSFT"] = createMarketData("MSFT", 300.0, 0.05, 0.20);
+    market_data["TSLA"] = createMarketData("TSLA", 200.0, 0.05, 0.60);
+
+    MarketDataTable table(market_data);
+    suite.assert_equal(3, static_cast<double>(table.size()), 0.0);
+    suite.assert_equal(300.0, table.getState(table.find("MSFT")).spot_price, 0.0);
+
+    RiskEngine engine(5000);
+    engine.setRandomSeed(9);
+    PortfolioRiskResult from_table = engine.calculatePortfolioRisk(portfolio, table);
+    PortfolioRiskResult from_map = engine.calculatePortfolioRisk(portfolio, market_data);
+    suite.assert_equal(from_map.total_pv, from_table.total_pv, 0.0, "PV");
+    suite.assert_equal(from_map.value_at_risk_99, from_table.value_at_risk_99, 0.0, "VaR 99");
+
+    table.set(table.find("AAPL"), MarketState(createMarketData("AAPL", 160.0, 0.05, 0.25)));
+    if (engine.calculatePortfolioRisk(portfolio, table).total_pv <= from_table.total_pv) {
+      throw std::runtime_error("Higher spot should raise the call-heavy PV");
+    }
+  });
+
+  suite.run_test("Table missing a held asset throws", [&]() {
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 1.0, "AAPL"), 1);
+    MarketDataTable table;
+    table.set("MSFT", createMarketData("MSFT", 300.0, 0.05, 0.20));
+    RiskEngine engine(1000);
+    try {
+      engine.calculatePortfolioRisk(portfolio, table);
+    } catch (const std::runtime_error &) {
+      return;
+    }
+    throw std::runtime_error("Expected runtime_error for missing asset");
+  });
+}
+
+void test_risk_decomposition(TestSuite &suite) {
+  auto buildPortfolio = [](Portfolio &portfolio) {
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 1.0, "AAPL"), 100);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Put, 140.0, 0.5, "AAPL"), -50);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 300.0, 1.0, "MSFT"), 20);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Put, 290.0, 0.25, "MSFT"), 40);
+  };
+
+  std::map<std::string, MarketData> market_data;
+  market_data["AAPL"] = createMarketData("AAPL", 150.0, 0.05, 0.25);
+  market_data["MSFT"] = createMarketData("MSFT", 300.0, 0.05, 0.20);
+
+  suite.run_test("Position and asset Greeks add up to the totals", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    RiskEngine engine(5000);
+    engine.setRandomSeed(3);
+    PortfolioRiskResult result = engine.calculatePortfolioRisk(portfolio, market_data);
+
+    suite.assert_equal(4, static_cast<double>(result.position_risk.size()), 0.0);
+    suite.assert_equal(2, static_cast<double>(result.asset_risk.size()), 0.0);
+
+    double delta = 0.0, vega = 0.0;
+    for (const RiskContribution &asset : result.asset_risk) {
+      delta += asset.delta;
+      vega += asset.vega;
+    }
+    suite.assert_equal(result.total_delta, delta, 1e-9, "Delta");
+    suite.assert_equal(result.total_vega, vega, 1e-9, "Vega");
+
+    const RiskContribution &aapl = result.asset_risk[portfolio.findAsset("AAPL")];
+    suite.assert_equal(result.position_risk[0].pv + result.position_risk[1].pv, aapl.pv, 1e-9);
+  });
+
+  suite.run_test("Component VaR and ES sum to the portfolio figures", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    RiskEngine engine(20000);
+    engine.setRandomSeed(3);
+    PortfolioRiskResult result = engine.calculatePortfolioRisk(portfolio, market_data);
+
+    double var_95 = 0.0, var_99 = 0.0, es_95 = 0.0, es_99 = 0.0;
+    for (const RiskContribution &position : result.position_risk) {
+      var_95 += position.component_var_95;
+      var_99 += position.component_var_99;
+      es_95 += position.component_es_95;
+      es_99 += position.component_es_99;
+    }
+    suite.assert_equal(result.value_at_risk_95, var_95, 1e-8, "VaR 95");
+    suite.assert_equal(result.value_at_risk_99, var_99, 1e-8, "VaR 99");
+    suite.assert_equal(result.expected_shortfall_95, es_95, 1e-8, "ES 95");
+    suite.assert_equal(result.expected_shortfall_99, es_99, 1e-8, "ES 99");
+
+    const RiskContribution &call = result.position_risk[0];
+    suite.assert_equal(call.component_var_95 / 100.0, call.marginal_var_95, 1e-12, "Marginal");
+
+    // Long delta dominates the AAPL book, so it carries most of the loss
+    const RiskContribution &aapl = result.asset_risk[portfolio.findAsset("AAPL")];
+    if (aapl.component_es_95 <= 0.0) {
+      throw std::runtime_error("AAPL should contribute positive ES");
+    }
+  });
+
+  suite.run_test("Versioned run attributes the same asset components", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    MarketDataManager manager;
+    for (const auto &[asset_id, md] : market_data) {
+      manager.addMarketData(asset_id, md);
+    }
+
+    RiskEngine engine(8000);
+    engine.setRandomSeed(11);
+    PortfolioRiskResult full = engine.calculatePortfolioRisk(portfolio, market_data);
+    PortfolioRiskResult versioned = engine.calculatePortfolioRisk(portfolio, manager);
+
+    for (size_t asset = 0; asset < full.asset_risk.size(); ++asset) {
+      suite.assert_equal(full.asset_risk[asset].component_es_95,
+                         versioned.asset_risk[asset].component_es_95, 1e-6, "ES 95");
+      suite.assert_equal(full.asset_risk[asset].component_var_99,
+                         versioned.asset_risk[asset].component_var_99, 1e-6, "VaR 99");
+      suite.assert_equal(full.asset_risk[asset].delta,
+                         versioned.asset_risk[asset].delta, 1e-9, "Delta");
+    }
+  });
+}
+
+// 500 days of returns: AAPL turbulent early and calm late, MSFT the reverse
+std::string writeSampleHistory() {
+  std::vector<int32_t> dates;
+  std::vector<std::vector<double>> columns(2);
+  for (int d = 0; d < 500; ++d) {
+    dates.push_back(20200101 + d);
+    const double wave = std::sin(0.7 * d) + 0.5 * std::cos(1.9 * d);
+    columns[0].push_back((d < 250 ? 0.03 : 0.005) * wave);
+    columns[1].push_back((d < 250 ? 0.005 : 0.03) * wave);
+  }
+  columns[1][10] = std::nan("");
+
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "qe_test_history.bin").string();
+  ReturnHistory::write(path, dates, {"AAPL", "MSFT"}, columns);
+  return path;
+}
+
+void test_historical_simulation(TestSuite &suite) {
+  const std::string path = writeSampleHistory();
+  std::map<std::string, MarketData> market_data;
+  market_data["AAPL"] = createMarketData("AAPL", 150.0, 0.05, 0.25);
+  market_data["MSFT"] = createMarketData("MSFT", 300.0, 0.05, 0.20);
+
+  suite.run_test("Return history round-trips through the mapped file", [&]() {
+    ReturnHistory history(path);
+    suite.assert_equal(2, static_cast<double>(history.assetCount()), 0.0);
+    suite.assert_equal(500, static_cast<double>(history.dayCount()), 0.0);
+    suite.assert_equal(20200101, history.dates()[0], 0.0);
+    suite.assert_equal(1, history.findAsset("MSFT"), 0.0);
+    suite.assert_equal(-1, history.findAsset("GOOGL"), 0.0);
+    suite.assert_equal(0.03 * (std::sin(0.7) + 0.5 * std::cos(1.9)),
+                       history.returns(0)[1], 1e-15);
+    if (!std::isnan(history.returns(1)[10])) {
+      throw std::runtime_error("Missing observation should stay NaN");
+    }
+  });
+
+  suite.run_test("Historical VaR matches a direct revaluation", [&]() {
+    ReturnHistory history(path);
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 1.0, "AAPL"), 100);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Put, 300.0, 1.0, "MSFT"), 50);
+
+    RiskEngine engine;
+    PortfolioRiskResult result =
+        engine.calculateHistoricalRisk(portfolio, market_data, history);
+
+    std::vector<double> pnl;
+    for (size_t d = 0; d < history.dayCount(); ++d) {
+      double day_pnl = 0.0;
+      for (int p = 0; p < 2; ++p) {
+        const auto &[instrument, quantity] = portfolio.getInstruments()[p];
+        MarketData md = market_data[instrument->getAssetId()];
+        const double base = instrument->price(md);
+        const double r = history.returns(p)[d];
+        if (!std::isnan(r)) md.spot_price *= std::exp(r);
+        // Revalued one trading day closer to expiry
+        day_pnl += (instrument->aged(1.0 / 252.0)->price(md) - base) * quantity;
+      }
+      pnl.push_back(day_pnl);
+    }
+    RiskMetrics expected = riskMetricsFromDistribution(pnl);
+    suite.assert_equal(expected.var_95, result.value_at_risk_95, 1e-9, "VaR 95");
+    suite.assert_equal(expected.es_99, result.expected_shortfall_99, 1e-9, "ES 99");
+
+    double component_es = 0.0;
+    for (const RiskContribution &asset : result.asset_risk) {
+      component_es += asset.component_es_95;
+    }
+    suite.assert_equal(result.expected_shortfall_95, component_es, 1e-8, "Component ES");
+  });
+
+  suite.run_test("EWMA weights and FHS react to the recent regime", [&]() {
+    ReturnHistory history(path);
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 1.0, "AAPL"), 100);
+
+    RiskEngine engine;
+    const double plain =
+        engine.calculateHistoricalRisk(portfolio, market_data, history).value_at_risk_99;
+
+    HistoricalSimulationOptions weighted;
+    weighted.ewma_lambda = 0.98;
+    const double recent =
+        engine.calculateHistoricalRisk(portfolio, market_data, history, weighted)
+            .value_at_risk_99;
+
+    HistoricalSimulationOptions filtered;
+    filtered.filtered = true;
+    const double rescaled =
+        engine.calculateHistoricalRisk(portfolio, market_data, history, filtered)
+            .value_at_risk_99;
+
+    // AAPL has been calm lately, so both should cut the VaR well below plain HS
+    if (!(recent < 0.5 * plain) || !(rescaled < 0.5 * plain)) {
+      throw std::runtime_error("Weighted or filtered VaR should fall with recent volatility");
+    }
+
+    HistoricalSimulationOptions window;
+    window.window_days = 250;
+    suite.assert_equal(engine.calculateHistoricalRisk(portfolio, market_data, history, window)
+                           .value_at_risk_99,
+                       recent, 0.5 * recent, "Recent window");
+  });
+
+  suite.run_test("Weighted metrics reduce to the unweighted ones", [&]() {
+    std::vector<double> pnl;
+    for (int i = 0; i < 1000; ++i) pnl.push_back(std::sin(1.3 * i) * 100.0);
+    std::vector<double> weights(pnl.size(), 2.0);
+    RiskMetrics weighted = riskMetricsFromWeightedDistribution(pnl, weights);
+    std::vector<double> copy = pnl;
+    RiskMetrics plain = riskMetricsFromDistribution(copy);
+    // The weighted tail holds exactly 5% of the mass, the plain one 5% + 1 path
+    suite.assert_equal(plain.es_95, weighted.es_95, 0.5, "ES 95");
+    suite.assert_equal(plain.var_99, weighted.var_99, 0.5, "VaR 99");
+  });
+
+  suite.run_test("Asset missing from the history throws", [&]() {
+    ReturnHistory history(path);
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 100.0, 1.0, "GOOGL"), 1);
+    std::map<std::string, MarketData> googl;
+    googl["GOOGL"] = createMarketData("GOOGL", 100.0, 0.05, 0.3);
+    RiskEngine engine;
+    try {
+      engine.calculateHistoricalRisk(portfolio, googl, history);
+    } catch (const std::runtime_error &) {
+      return;
+    }
+    throw std::runtime_error("Expected runtime_error for missing history");
+  });
+
+  std::remove(path.c_str());
+}
+
+void test_horizon_risk(TestSuite &suite) {
+  std::map<std::string, MarketData> market_data;
+  market_data["AAPL"] = createMarketData("AAPL", 150.0, 0.05, 0.25);
+  market_data["MSFT"] = createMarketData("MSFT", 300.0, 0.05, 0.20);
+
+  auto buildPortfolio = [](Portfolio &portfolio) {
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 5.0, "AAPL"), 100);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Put, 290.0, 5.0, "MSFT"), -40);
+  };
+
+  suite.run_test("First horizon matches a single-horizon run", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    RiskEngine engine(5000);
+    engine.setRandomSeed(11);
+    engine.setVaRTimeHorizonDays(5.0);
+    PortfolioRiskResult single = engine.calculatePortfolioRisk(portfolio, market_data);
+    std::vector<HorizonRiskResult> horizons =
+        engine.calculateHorizonRisk(portfolio, market_data, {5.0, 20.0});
+
+    suite.assert_equal(single.value_at_risk_95, horizons[0].value_at_risk_95,
+                       1e-9, "VaR 95");
+    suite.assert_equal(single.expected_shortfall_99, horizons[0].expected_shortfall_99,
+                       1e-9, "ES 99");
+  });
+
+  suite.run_test("Horizons are sorted and share the simulated path", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    RiskEngine engine(5000);
+    engine.setRandomSeed(11);
+    std::vector<HorizonRiskResult> all =
+        engine.calculateHorizonRisk(portfolio, market_data, {20.0, 1.0, 10.0, 10.0});
+    suite.assert_equal(3, static_cast<double>(all.size()), 0.0);
+    suite.assert_equal(1.0, all[0].horizon_days, 0.0);
+    suite.assert_equal(20.0, all[2].horizon_days, 0.0);
+    if (!(all[0].value_at_risk_99 < all[1].value_at_risk_99 &&
+          all[1].value_at_risk_99 < all[2].value_at_risk_99)) {
+      throw std::runtime_error("VaR should grow with the horizon");
+    }
+
+    // Dropping a later checkpoint leaves the earlier ones untouched
+    std::vector<HorizonRiskResult> prefix =
+        engine.calculateHorizonRisk(portfolio, market_data, {1.0, 10.0});
+    suite.assert_equal(all[1].value_at_risk_95, prefix[1].value_at_risk_95, 1e-9);
+    suite.assert_equal(all[1].expected_shortfall_99, prefix[1].expected_shortfall_99, 1e-9);
+  });
+
+  suite.run_test("Loss on an option expiring inside the horizon is capped", [&]() {
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 155.0, 5.0 / 252.0, "AAPL"), 100);
+    const double premium =
+        100 * portfolio.getInstruments()[0].first->price(market_data["AAPL"]);
+    RiskEngine engine(5000);
+    engine.setRandomSeed(11);
+    std::vector<HorizonRiskResult> horizons =
+        engine.calculateHorizonRisk(portfolio, market_data, {10.0});
+    if (horizons[0].expected_shortfall_99 > premium + 1e-9 ||
+        horizons[0].expected_shortfall_99 < 0.9 * premium) {
+      throw std::runtime_error("Expired call should lose at most its premium");
+    }
+  });
+
+  suite.run_test("A book worth nothing has zero horizon VaR", [&]() {
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 1.0, "AAPL"), 100);
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 1.0, "AAPL"), -100);
+    RiskEngine engine(2000);
+    engine.setRandomSeed(11);
+    PortfolioRiskResult single = engine.calculatePortfolioRisk(portfolio, market_data);
+    std::vector<HorizonRiskResult> horizons =
+        engine.calculateHorizonRisk(portfolio, market_data, {1.0, 10.0});
+    for (const HorizonRiskResult &horizon : horizons) {
+      suite.assert_equal(single.value_at_risk_99, horizon.value_at_risk_99, 0.0, "VaR 99");
+      suite.assert_equal(0.0, horizon.expected_shortfall_99, 0.0, "ES 99");
+    }
+  });
+
+  suite.run_test("Horizon runs report a profile", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    RiskEngine engine(2000);
+    engine.setRandomSeed(11);
+    std::vector<HorizonRiskResult> horizons =
+        engine.calculateHorizonRisk(portfolio, market_data, {1.0, 10.0});
+    const Profiling::Report &profile = horizons[0].profile;
+
+#ifdef QE_ENABLE_PROFILING
+    if (!profile.enabled) {
+      throw std::runtime_error("Profile should be enabled");
+    }
+    suite.assert_equal(2000, static_cast<double>(profile.count(Profiling::Counter::Paths)),
+                       0.0, "Paths");
+    suite.assert_equal(static_cast<double>(profile.count(Profiling::Counter::Pricings)),
+                       static_cast<double>(horizons[1].profile.count(Profiling::Counter::Pricings)),
+                       0.0, "Shared by every horizon");
+    const Profiling::Phase phases[] = {Profiling::Phase::Greeks, Profiling::Phase::PathGeneration,
+                                       Profiling::Phase::Revaluation, Profiling::Phase::TailSort};
+    for (Profiling::Phase phase : phases) {
+      if (!(profile.seconds(phase) > 0.0)) {
+        throw std::runtime_error(std::string("No time in phase ") + Profiling::phaseName(phase));
+      }
+    }
+#else
+    if (profile.enabled) {
+      throw std::runtime_error("Profile should be empty when compiled out");
+    }
+#endif
+  });
+
+  suite.run_test("Single-horizon runs revalue at the aged expiry", [&]() {
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 155.0, 5.0 / 252.0, "AAPL"), 100);
+    const double premium =
+        100 * portfolio.getInstruments()[0].first->price(market_data["AAPL"]);
+    RiskEngine engine(5000);
+    engine.setRandomSeed(11);
+    engine.setVaRTimeHorizonDays(10.0);
+    PortfolioRiskResult result = engine.calculatePortfolioRisk(portfolio, market_data);
+    // Expired inside the horizon, so the worst case is the whole premium
+    suite.assert_equal(premium, result.expected_shortfall_99, 1e-9, "ES 99");
+    suite.assert_equal(premium, result.position_risk[0].component_es_99, 1e-9,
+                       "Component ES 99");
+  });
+
+  suite.run_test("Expired Asians settle on their own average type", [&]() {
+    MarketData md = market_data["AAPL"];
+    md.spot_price = 120.0;
+    // Two of four fixings taken, at 80 and 180
+    AsianOption arithmetic(OptionType::Call, 100.0, 0.0, "AAPL",
+                           AsianOption::AverageType::Arithmetic, 4, 80.0 + 180.0, 2);
+    AsianOption geometric(OptionType::Call, 100.0, 0.0, "AAPL",
+                          AsianOption::AverageType::Geometric, 4, 80.0 * 180.0, 2);
+    suite.assert_equal((80.0 + 180.0 + 2 * 120.0) / 4.0 - 100.0, arithmetic.price(md), 1e-12);
+    suite.assert_equal(std::pow(80.0 * 180.0 * 120.0 * 120.0, 0.25) - 100.0,
+                       geometric.price(md), 1e-10);
+
+    AsianOption fresh(OptionType::Put, 130.0, 0.0, "AAPL",
+                      AsianOption::AverageType::Geometric, 4);
+    suite.assert_equal(10.0, fresh.price(md), 1e-10, "No fixings taken yet");
+  });
+
+  suite.run_test("Invalid horizons throw", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    RiskEngine engine(1000);
+    for (const std::vector<double> &bad :
+         {std::vector<double>{}, std::vector<double>{0.0}, std::vector<double>{1.0, 300.0}}) {
+      try {
+        engine.calculateHorizonRisk(portfolio, market_data, bad);
+      } catch (const std::invalid_argument &) {
+        continue;
+      }
+      throw std::runtime_error("Expected invalid_argument");
+    }
+  });
+}
+
+void test_profiling(TestSuite &suite) {
+  std::map<std::string, MarketData> market_data;
+  market_data["AAPL"] = createMarketData("AAPL", 150.0, 0.05, 0.25);
+  market_data["MSFT"] = createMarketData("MSFT", 300.0, 0.05, 0.20);
+
+  auto buildPortfolio = [](Portfolio &portfolio) {
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 1.0, "AAPL"), 100);
+    portfolio.addInstrument(
+        std::make_unique<AmericanOption>(OptionType::Put, 290.0, 0.5, "MSFT"), -40);
+  };
+
+  suite.run_test("Profile reports phases and counters", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    RiskEngine engine(2000);
+    engine.setRandomSeed(42);
+    PortfolioRiskResult result = engine.calculatePortfolioRisk(portfolio, market_data);
+    const Profiling::Report &profile = result.profile;
+
+#ifdef QE_ENABLE_PROFILING
+    if (!profile.enabled) {
+      throw std::runtime_error("Profile should be enabled");
+    }
+    suite.assert_equal(2000, static_cast<double>(profile.count(Profiling::Counter::Paths)),
+                       0.0, "Paths");
+    // Every path reprices both positions; Greeks and attribution add more
+    if (profile.count(Profiling::Counter::Pricings) <= 2 * 2000) {
+      throw std::runtime_error("Too few pricings counted");
+    }
+    if (profile.count(Profiling::Counter::TreeNodes) == 0) {
+      throw std::runtime_error("American revaluation should count tree nodes");
+    }
+    for (size_t phase = 0; phase < Profiling::kPhaseCount; ++phase) {
+      if (!(profile.phase_seconds[phase] > 0.0)) {
+        throw std::runtime_error(std::string("No time in phase ") +
+                                 Profiling::phaseName(static_cast<Profiling::Phase>(phase)));
+      }
+    }
+    if (!(profile.wall_seconds > 0.0)) {
+      throw std::runtime_error("Wall time should be positive");
+    }
+#else
+    if (profile.enabled || profile.count(Profiling::Counter::Pricings) != 0) {
+      throw std::runtime_error("Profile should be empty when compiled out");
+    }
+#endif
+  });
+
+  suite.run_test("Cached versioned runs report no new paths", [&]() {
+    Portfolio portfolio;
+    buildPortfolio(portfolio);
+    MarketDataManager manager;
+    manager.addMarketData("AAPL", market_data["AAPL"]);
+    manager.addMarketData("MSFT", market_data["MSFT"]);
+    RiskEngine engine(2000);
+    engine.setRandomSeed(42);
+
+    PortfolioRiskResult first = engine.calculatePortfolioRisk(portfolio, manager);
+    manager.updateMarketData("AAPL", createMarketData("AAPL", 151.0, 0.05, 0.25));
+    PortfolioRiskResult second = engine.calculatePortfolioRisk(portfolio, manager);
+
+#ifdef QE_ENABLE_PROFILING
+    suite.assert_equal(2 * 2000, static_cast<double>(first.profile.count(Profiling::Counter::Paths)),
+                       0.0, "Both assets simulated");
+    suite.assert_equal(2000, static_cast<double>(second.profile.count(Profiling::Counter::Paths)),
+                       0.0, "Only the ticked asset simulated");
+    if (second.profile.count(Profiling::Counter::TreeNodes) != 0) {
+      throw std::runtime_error("The American put should not have been repriced");
+    }
+#else
+    if (first.profile.enabled || second.profile.enabled) {
+      throw std::runtime_error("Profile should be empty when compiled out");
+    }
+#endif
+  });
+}
+
+void test_concurrent_calls(TestSuite &suite) {
+  suite.run_test("Concurrent runs on one engine match a serial run", [&]() {
+    Portfolio portfolio;
+    portfolio.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 1.0, "AAPL"), 100);
+    portfolio.addInstrument(
+        std::make_unique<AmericanOption>(OptionType::Put, 290.0, 0.5, "MSFT"), -40);
+    std::map<std::string, MarketData> market_data_map;
+    market_data_map["AAPL"] = createMarketData("AAPL", 150.0, 0.05, 0.25);
+    market_data_map["MSFT"] = createMarketData("MSFT", 300.0, 0.05, 0.20);
+    const MarketDataTable market_data(market_data_map);
+    MarketDataManager manager;
+    manager.addMarketData("AAPL", market_data_map["AAPL"]);
+    manager.addMarketData("MSFT", market_data_map["MSFT"]);
+
+    RiskEngine engine(5000);
+    engine.setRandomSeed(42);
+    const PortfolioRiskResult expected = engine.calculatePortfolioRisk(portfolio, market_data);
+
+    const int runs = 8;
+    std::vector<PortfolioRiskResult> results(runs);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < runs; ++t) {
+      threads.emplace_back([&, t]() {
+        // Odd runs share the version cache, even ones only the settings
+        results[t] = t % 2 == 0 ? engine.calculatePortfolioRisk(portfolio, market_data)
+                                : engine.calculatePortfolioRisk(portfolio, manager);
+      });
+    }
+    for (auto &thread : threads) thread.join();
+
+    for (const PortfolioRiskResult &result : results) {
+      suite.assert_equal(expected.total_pv, result.total_pv, 1e-9, "PV");
+      suite.assert_equal(expected.value_at_risk_95, result.value_at_risk_95, 1e-9, "VaR 95");
+      suite.assert_equal(expected.expected_shortfall_99, result.expected_shortfall_99, 1e-9,
+                         "ES 99");
+    }
+  });
+}
+
+void test_parallel_for(TestSuite &suite) {
+  suite.run_test("parallelFor covers every index once, nested or concurrent", [&]() {
+    const int count = 10000;
+    std::vector<int> hits(count, 0);
+    // Outer chunks start inner loops, and several callers share the pool
+    std::vector<std::thread> callers;
+    for (int c = 0; c < 3; ++c) {
+      callers.emplace_back([&, c]() {
+        Parallel::parallelFor(count / 3 + (c < count % 3 ? 1 : 0), 1, [&](int start, int end) {
+          Parallel::parallelFor(end - start, 16, [&](int inner_start, int inner_end) {
+            for (int i = start + inner_start; i < start + inner_end; ++i) ++hits[3 * i + c];
+          });
+        });
+      });
+    }
+    for (auto &caller : callers) caller.join();
+
+    int wrong = 0;
+    for (int hit : hits) wrong += hit != 1;
+    suite.assert_equal(0, wrong, 0.0, "Indices not visited exactly once");
+  });
+
+  suite.run_test("parallelFor rethrows a worker exception", [&]() {
+    std::string message;
+    try {
+      Parallel::parallelFor(1000, 1, [](int start, int end) {
+        if (start <= 500 && 500 < end) throw std::runtime_error("chunk failed");
+      });
+    } catch (const std::runtime_error &e) {
+      message = e.what();
+    }
+    if (message != "chunk failed") {
+      throw std::runtime_error("Expected the worker's exception, got: " + message);
+    }
+  });
+}
+
 void test_parallel_improvement(TestSuite &suite) {
   suite.run_test("Parallel computation improves performance", [&]() {
     Portfolio portfolio;
@@ -533,6 +1341,15 @@ int main() {
   test_expected_shortfall_properties(suite);
   test_expected_shortfall_scaling(suite);
   test_theta_time_decay(suite);
+  test_surface_market_data(suite);
+  test_versioned_market_data(suite);
+  test_market_data_table(suite);
+  test_risk_decomposition(suite);
+  test_historical_simulation(suite);
+  test_horizon_risk(suite);
+  test_profiling(suite);
+  test_concurrent_calls(suite);
+  test_parallel_for(suite);
   test_parallel_improvement(suite);
   suite.print_summary();
 
@@ -0,0 +1,236 @@
+#include "MarketData.h"
+#include "Portfolio.h"
+#include "PortfolioLoader.h"
+#include "PortfolioSnapshot.h"
+#include "RiskEngine.h"
+#include "RiskPipeline.h"
+#include "SpscQueue.h"
+#include "simple_test.h"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+std::string pipelinePath(const std::string &name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+std::map<std::string, MarketData> pipelineMarketData() {
+  std::map<std::string, MarketData> market_data_map;
+  for (int a = 0; a < 5; ++a) {
+    const std::string asset_id = "ASSET" + std::to_string(a);
+    market_data_map[asset_id] = MarketData(asset_id, 80.0 + 10.0 * a, 0.03, 0.15 + 0.05 * a);
+  }
+  return market_data_map;
+}
+
+// European options over five assets; row bad_row gets a negative strike
+std::string writePipelineCsv(const std::string &name, size_t rows, size_t bad_row) {
+  const std::string path = pipelinePath(name);
+  std::ofstream out(path, std::ios::trunc);
+  out << "type,strike,expiry,asset_id,quantity\n";
+  for (size_t i = 0; i < rows; ++i) {
+    const double strike = i == bad_row ? -1.0 : 80.0 + static_cast<double>(i % 9) * 5.0;
+    out << (i % 2 ? "put" : "call") << ',' << strike << ',' << 0.25 + 0.25 * (i % 4)
+        << ",ASSET" << i % 5 << ',' << (i % 3 ? 1 : -2) * static_cast<int>(i % 7 + 1) << '\n';
+  }
+  return path;
+}
+
+size_t countLines(const std::string &path) {
+  std::ifstream in(path);
+  std::string line;
+  size_t lines = 0;
+  while (std::getline(in, line)) ++lines;
+  return lines;
+}
+
+void assertMatchesEngine(TestSuite &suite, const PortfolioRiskResult &expected,
+                         const RiskPipelineResult &actual, const Portfolio &portfolio) {
+  const PortfolioRiskResult &risk = actual.risk;
+  suite.assert_equal(expected.total_pv, risk.total_pv, 1e-8 * std::abs(expected.total_pv), "PV");
+  suite.assert_equal(expected.total_delta, risk.total_delta, 1e-8, "Delta");
+  suite.assert_equal(expected.total_gamma, risk.total_gamma, 1e-8, "Gamma");
+  suite.assert_equal(expected.total_vega, risk.total_vega, 1e-8, "Vega");
+  suite.assert_equal(expected.total_theta, risk.total_theta, 1e-8, "Theta");
+  // P&L is summed per batch rather than per position, so only rounding differs
+  const double var_tolerance = 1e-9 * std::abs(expected.value_at_risk_99);
+  suite.assert_equal(expected.value_at_risk_95, risk.value_at_risk_95, var_tolerance, "VaR 95");
+  suite.assert_equal(expected.value_at_risk_99, risk.value_at_risk_99, var_tolerance, "VaR 99");
+  suite.assert_equal(expected.expected_shortfall_95, risk.expected_shortfall_95, var_tolerance,
+                     "ES 95");
+  suite.assert_equal(expected.expected_shortfall_99, risk.expected_shortfall_99, var_tolerance,
+                     "ES 99");
+
+  suite.assert_equal(static_cast<double>(portfolio.getAssetCount()),
+                     static_cast<double>(actual.asset_names.size()), 0.0, "Assets");
+  for (size_t a = 0; a < actual.asset_names.size(); ++a) {
+    const std::string &asset_id = portfolio.getAssetName(static_cast<int>(a));
+    if (actual.asset_names[a] != asset_id) {
+      throw std::runtime_error("Assets are not in first-seen order");
+    }
+    suite.assert_equal(expected.asset_risk[a].pv, risk.asset_risk[a].pv, 1e-8, asset_id + " PV");
+    suite.assert_equal(expected.asset_risk[a].delta, risk.asset_risk[a].delta, 1e-8,
+                       asset_id + " delta");
+  }
+}
+
+void test_spsc_queue(TestSuite &suite) {
+  suite.run_test("Queue keeps FIFO order across threads", [&]() {
+    SpscQueue<int> queue(3);
+    suite.assert_equal(3, static_cast<double>(queue.capacity()), 0.0);
+    const int count = 100000;
+    std::thread producer([&]() {
+      for (int i = 0; i < count; ++i) queue.push(i);
+      queue.close();
+    });
+    int expected = 0;
+    int value = 0;
+    bool ordered = true;
+    while (queue.pop(value)) {
+      ordered = ordered && value == expected;
+      ++expected;
+    }
+    producer.join();
+    suite.assert_equal(1, ordered ? 1.0 : 0.0, 0.0, "Order");
+    suite.assert_equal(count, expected, 0.0, "Items");
+  });
+
+  suite.run_test("Closing drains and cancelling unblocks", [&]() {
+    SpscQueue<int> drained(4);
+    int value = 1;
+    suite.assert_equal(1, drained.tryPush(value) ? 1.0 : 0.0, 0.0);
+    drained.close();
+    suite.assert_equal(1, drained.pop(value) ? 1.0 : 0.0, 0.0, "Drains after close");
+    suite.assert_equal(0, drained.pop(value) ? 1.0 : 0.0, 0.0, "Ends when drained");
+
+    SpscQueue<int> full(1);
+    full.push(1);
+    std::thread blocked([&]() { full.push(2); });
+    full.cancel();
+    blocked.join();
+    suite.assert_equal(0, full.pop(value) ? 1.0 : 0.0, 0.0, "Cancelled");
+  });
+}
+
+void test_pipeline_results(TestSuite &suite) {
+  suite.run_test("Pipeline matches the engine on the same book", [&]() {
+    const std::string path = writePipelineCsv("qe_test_pipeline.csv", 2500, SIZE_MAX);
+    const std::string output = pipelinePath("qe_test_pipeline_out.csv");
+
+    RiskPipelineOptions options;
+    options.batch_size = 300;
+    options.queue_depth = 2;
+    options.pricing_workers = 3;
+    options.var_simulations = 2000;
+    options.seed = 17;
+    RiskPipeline pipeline(pipelineMarketData(), options);
+    const RiskPipelineResult result = pipeline.run(path, output);
+
+    Portfolio portfolio;
+    PortfolioLoader::loadPositions(path, portfolio);
+    RiskEngine engine(options.var_simulations);
+    engine.setRandomSeed(options.seed);
+    const PortfolioRiskResult expected =
+        engine.calculatePortfolioRisk(portfolio, pipelineMarketData());
+
+    suite.assert_equal(2500, static_cast<double>(result.positions), 0.0, "Positions");
+    suite.assert_equal(9, static_cast<double>(result.batches), 0.0, "Batches");
+    suite.assert_equal(0, static_cast<double>(result.risk.position_risk.size()), 0.0);
+    assertMatchesEngine(suite, expected, result, portfolio);
+    suite.assert_equal(2501, static_cast<double>(countLines(output)), 0.0, "Output rows");
+
+    std::remove(path.c_str());
+    std::remove(output.c_str());
+  });
+
+  suite.run_test("Snapshots give the same result", [&]() {
+    const std::string csv = writePipelineCsv("qe_test_pipeline_src.csv", 1000, SIZE_MAX);
+    Portfolio portfolio;
+    PortfolioLoader::loadPositions(csv, portfolio);
+    const std::string path = pipelinePath("qe_test_pipeline.qesnap");
+    PortfolioSnapshot::write(path, portfolio, pipelineMarketData());
+
+    RiskPipelineOptions options;
+    options.batch_size = 128;
+    options.var_simulations = 1000;
+    options.seed = 5;
+    const RiskPipelineResult from_csv = RiskPipeline(pipelineMarketData(), options).run(csv);
+    const RiskPipelineResult from_snapshot = RiskPipeline(pipelineMarketData(), options).run(path);
+
+    suite.assert_equal(8, static_cast<double>(from_snapshot.batches), 0.0, "Batches");
+    suite.assert_equal(from_csv.risk.total_pv, from_snapshot.risk.total_pv, 1e-8, "PV");
+    suite.assert_equal(from_csv.risk.value_at_risk_99, from_snapshot.risk.value_at_risk_99, 1e-8,
+                       "VaR 99");
+
+    std::remove(csv.c_str());
+    std::remove(path.c_str());
+  });
+}
+
+void test_pipeline_errors(TestSuite &suite) {
+  suite.run_test("Invalid options are rejected", [&]() {
+    RiskPipelineOptions options;
+    options.batch_size = 0;
+    bool threw = false;
+    try {
+      RiskPipeline pipeline(pipelineMarketData(), options);
+    } catch (const std::invalid_argument &) {
+      threw = true;
+    }
+    if (!threw) throw std::runtime_error("Expected invalid_argument for batch size");
+  });
+
+  suite.run_test("A failing stage stops the pipeline", [&]() {
+    const std::string path = writePipelineCsv("qe_test_pipeline_err.csv", 3000, SIZE_MAX);
+    RiskPipelineOptions options;
+    options.batch_size = 100;
+    options.queue_depth = 1;
+    options.var_simulations = 200;
+
+    std::map<std::string, MarketData> partial = pipelineMarketData();
+    partial.erase("ASSET3");
+    std::string message;
+    try {
+      RiskPipeline(partial, options).run(path);
+    } catch (const std::runtime_error &e) {
+      message = e.what();
+    }
+    if (message.find("Missing market data for asset: ASSET3") == std::string::npos) {
+      throw std::runtime_error("Expected missing market data, got: " + message);
+    }
+    std::remove(path.c_str());
+
+    const std::string bad = writePipelineCsv("qe_test_pipeline_bad.csv", 3000, 2200);
+    message.clear();
+    try {
+      RiskPipeline(pipelineMarketData(), options).run(bad);
+    } catch (const std::invalid_argument &e) {
+      message = e.what();
+    }
+    if (message.find("Line") == std::string::npos) {
+      throw std::runtime_error("Expected the bad line to be named, got: " + message);
+    }
+    std::remove(bad.c_str());
+  });
+}
+
+int main() {
+  TestSuite suite;
+
+  std::cout << "\n" << std::string(60, '=') << std::endl;
+  std::cout << "  Risk Pipeline Test Suite" << std::endl;
+  std::cout << std::string(60, '=') << "\n" << std::endl;
+
+  test_spsc_queue(suite);
+  test_pipeline_results(suite);
+  test_pipeline_errors(suite);
+
+  suite.print_summary();
+
+  return suite.all_passed() ? 0 : 1;
+}
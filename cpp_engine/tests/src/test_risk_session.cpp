@@ -0,0 +1,259 @@
+#include "Instrument.h"
+#include "MarketData.h"
+#include "Portfolio.h"
+#include "RiskEngine.h"
+#include "RiskSession.h"
+#include "simple_test.h"
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <memory>
+
+std::map<std::string, MarketData> sessionMarketData() {
+  std::map<std::string, MarketData> market_data_map;
+  market_data_map["AAPL"] = MarketData("AAPL", 150.0, 0.05, 0.25);
+  market_data_map["MSFT"] = MarketData("MSFT", 300.0, 0.05, 0.20);
+  return market_data_map;
+}
+
+std::unique_ptr<Instrument> aaplCall() {
+  return std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 1.0, "AAPL");
+}
+
+std::unique_ptr<Instrument> aaplPut() {
+  return std::make_unique<EuropeanOption>(OptionType::Put, 140.0, 0.5, "AAPL");
+}
+
+std::unique_ptr<Instrument> msftCall() {
+  return std::make_unique<EuropeanOption>(OptionType::Call, 310.0, 0.75, "MSFT");
+}
+
+PortfolioRiskResult engineRisk(Portfolio &portfolio, int simulations,
+                               unsigned int seed) {
+  RiskEngine engine(simulations);
+  engine.setRandomSeed(seed);
+  return engine.calculatePortfolioRisk(portfolio, sessionMarketData());
+}
+
+void assertSameRisk(TestSuite &suite, const PortfolioRiskResult &expected,
+                    const PortfolioRiskResult &actual) {
+  suite.assert_equal(expected.total_pv, actual.total_pv, 1e-8, "PV");
+  suite.assert_equal(expected.total_delta, actual.total_delta, 1e-8, "Delta");
+  suite.assert_equal(expected.total_gamma, actual.total_gamma, 1e-8, "Gamma");
+  suite.assert_equal(expected.total_vega, actual.total_vega, 1e-8, "Vega");
+  suite.assert_equal(expected.total_theta, actual.total_theta, 1e-8, "Theta");
+  suite.assert_equal(expected.value_at_risk_95, actual.value_at_risk_95, 1e-6, "VaR 95");
+  suite.assert_equal(expected.value_at_risk_99, actual.value_at_risk_99, 1e-6, "VaR 99");
+  suite.assert_equal(expected.expected_shortfall_95, actual.expected_shortfall_95, 1e-6, "ES 95");
+  suite.assert_equal(expected.expected_shortfall_99, actual.expected_shortfall_99, 1e-6, "ES 99");
+}
+
+void test_session_matches_engine(TestSuite &suite) {
+  suite.run_test("Session matches a full engine run", [&]() {
+    RiskSession session(sessionMarketData(), 5000, 1.0, 11);
+    session.addInstrument(aaplCall(), 100);
+    session.addInstrument(aaplPut(), -40);
+    session.addInstrument(msftCall(), 25);
+
+    Portfolio portfolio;
+    portfolio.addInstrument(aaplCall(), 100);
+    portfolio.addInstrument(aaplPut(), -40);
+    portfolio.addInstrument(msftCall(), 25);
+
+    assertSameRisk(suite, engineRisk(portfolio, 5000, 11), session.getRisk());
+  });
+
+  suite.run_test("Offsetting positions on one asset cancel", [&]() {
+    RiskSession session(sessionMarketData(), 2000, 1.0, 3);
+    session.addInstrument(aaplCall(), 10);
+    session.addInstrument(aaplCall(), -10);
+    session.addInstrument(msftCall(), 1);
+
+    RiskSession reference(sessionMarketData(), 2000, 1.0, 3);
+    reference.addInstrument(msftCall(), 1);
+
+    assertSameRisk(suite, reference.getRisk(), session.getRisk());
+  });
+}
+
+void test_session_updates(TestSuite &suite) {
+  suite.run_test("Quantity update matches a fresh revaluation", [&]() {
+    RiskSession session(sessionMarketData(), 5000, 1.0, 5);
+    session.addInstrument(aaplCall(), 100);
+    session.addInstrument(msftCall(), 25);
+    session.updateQuantity(0, -60);
+
+    Portfolio portfolio;
+    portfolio.addInstrument(aaplCall(), -60);
+    portfolio.addInstrument(msftCall(), 25);
+
+    assertSameRisk(suite, engineRisk(portfolio, 5000, 5), session.getRisk());
+    suite.assert_equal(-60, session.getPortfolio().getInstruments()[0].second, 0.0);
+  });
+
+  suite.run_test("Removal matches a fresh revaluation", [&]() {
+    RiskSession session(sessionMarketData(), 5000, 1.0, 9);
+    session.addInstrument(aaplCall(), 100);
+    session.addInstrument(aaplPut(), 30);
+    session.addInstrument(msftCall(), 25);
+    session.removeInstrument(1);
+
+    Portfolio portfolio;
+    portfolio.addInstrument(aaplCall(), 100);
+    portfolio.addInstrument(msftCall(), 25);
+
+    assertSameRisk(suite, engineRisk(portfolio, 5000, 9), session.getRisk());
+    suite.assert_equal(2, static_cast<double>(session.size()), 0.0);
+  });
+
+  suite.run_test("Removing every position returns zero risk", [&]() {
+    RiskSession session(sessionMarketData(), 1000);
+    session.addInstrument(aaplCall(), 10);
+    session.removeInstrument(0);
+    PortfolioRiskResult result = session.getRisk();
+    suite.assert_equal(0.0, result.total_pv, 0.0);
+    suite.assert_equal(0.0, result.value_at_risk_95, 0.0);
+  });
+
+  suite.run_test("Invalid index and missing market data are rejected", [&]() {
+    RiskSession session(sessionMarketData(), 1000);
+    session.addInstrument(aaplCall(), 10);
+    bool threw = false;
+    try {
+      session.updateQuantity(3, 1);
+    } catch (const std::out_of_range &) {
+      threw = true;
+    }
+    if (!threw) throw std::runtime_error("Expected out_of_range");
+
+    threw = false;
+    try {
+      session.addInstrument(
+          std::make_unique<EuropeanOption>(OptionType::Call, 100.0, 1.0, "GOOG"), 1);
+    } catch (const std::runtime_error &) {
+      threw = true;
+    }
+    if (!threw) throw std::runtime_error("Expected missing market data error");
+    suite.assert_equal(1, static_cast<double>(session.size()), 0.0,
+                       "Failed add leaves the session unchanged");
+  });
+
+  suite.run_test("Quantity updates reprice only the changed position", [&]() {
+    RiskSession session(sessionMarketData(), 100000, 1.0, 1);
+    for (int i = 0; i < 20; ++i) {
+      session.addInstrument(i % 2 ? aaplCall() : msftCall(), 10 + i);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 100; ++i) {
+      session.updateQuantity(i % 20, i);
+      session.getRisk();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    std::cout << "(" << elapsed.count() / 100.0 << " ms per update) ";
+  });
+}
+
+void test_session_market_data(TestSuite &suite) {
+  suite.run_test("Market data update matches a fresh session", [&]() {
+    RiskSession session(sessionMarketData(), 5000, 1.0, 13);
+    session.addInstrument(aaplCall(), 100);
+    session.addInstrument(msftCall(), 25);
+    session.addInstrument(aaplPut(), -40);
+
+    const MarketData tick("AAPL", 156.0, 0.05, 0.27);
+    suite.assert_equal(2, static_cast<double>(session.updateMarketData(tick)), 0.0,
+                       "Only the AAPL positions are revalued");
+
+    std::map<std::string, MarketData> moved = sessionMarketData();
+    moved["AAPL"] = tick;
+    RiskSession reference(moved, 5000, 1.0, 13);
+    reference.addInstrument(aaplCall(), 100);
+    reference.addInstrument(msftCall(), 25);
+    reference.addInstrument(aaplPut(), -40);
+
+    assertSameRisk(suite, reference.getRisk(), session.getRisk());
+  });
+
+  suite.run_test("Edits after a market data update match a fresh session", [&]() {
+    RiskSession session(sessionMarketData(), 5000, 1.0, 17);
+    session.addInstrument(aaplCall(), 100);
+    session.addInstrument(msftCall(), 25);
+    session.addInstrument(aaplPut(), -40);
+
+    const MarketData tick("AAPL", 146.0, 0.05, 0.22);
+    session.updateMarketData(tick);
+    session.updateQuantity(0, 70);
+    session.removeInstrument(2);
+
+    std::map<std::string, MarketData> moved = sessionMarketData();
+    moved["AAPL"] = tick;
+    RiskSession reference(moved, 5000, 1.0, 17);
+    reference.addInstrument(aaplCall(), 70);
+    reference.addInstrument(msftCall(), 25);
+
+    assertSameRisk(suite, reference.getRisk(), session.getRisk());
+  });
+
+  suite.run_test("Market data for a new asset enables positions on it", [&]() {
+    RiskSession session(sessionMarketData(), 1000);
+    suite.assert_equal(0, static_cast<double>(
+                              session.updateMarketData(MarketData("GOOG", 120.0, 0.05, 0.3))),
+                       0.0);
+    session.addInstrument(
+        std::make_unique<EuropeanOption>(OptionType::Call, 125.0, 1.0, "GOOG"), 5);
+    suite.assert_equal(1, static_cast<double>(session.size()), 0.0);
+  });
+
+  suite.run_test("Failed market data update leaves the session unchanged", [&]() {
+    RiskSession session(sessionMarketData(), 2000, 1.0, 4);
+    session.addInstrument(aaplCall(), 10);
+    const PortfolioRiskResult before = session.getRisk();
+
+    MarketData bad("AAPL", 150.0, 0.05, 0.25);
+    bad.spot_price = -1.0;
+    bool threw = false;
+    try {
+      session.updateMarketData(bad);
+    } catch (const std::invalid_argument &) {
+      threw = true;
+    }
+    if (!threw) throw std::runtime_error("Expected invalid_argument");
+    assertSameRisk(suite, before, session.getRisk());
+  });
+
+  suite.run_test("Position IDs survive removals", [&]() {
+    RiskSession session(sessionMarketData(), 1000);
+    session.addInstrument(aaplCall(), 1);
+    const uint64_t put_id = session.getPositionId(session.addInstrument(aaplPut(), 2));
+    const uint64_t msft_id = session.getPositionId(session.addInstrument(msftCall(), 3));
+    session.removeInstrument(0);
+
+    suite.assert_equal(0, static_cast<double>(session.findPosition(put_id)), 0.0);
+    suite.assert_equal(1, static_cast<double>(session.findPosition(msft_id)), 0.0);
+    bool threw = false;
+    try {
+      session.findPosition(msft_id + 1);
+    } catch (const std::out_of_range &) {
+      threw = true;
+    }
+    if (!threw) throw std::runtime_error("Expected out_of_range");
+  });
+}
+
+int main() {
+  TestSuite suite;
+
+  std::cout << "\n" << std::string(60, '=') << std::endl;
+  std::cout << "  Risk Session Test Suite" << std::endl;
+  std::cout << std::string(60, '=') << "\n" << std::endl;
+
+  test_session_matches_engine(suite);
+  test_session_updates(suite);
+  test_session_market_data(suite);
+
+  suite.print_summary();
+
+  return suite.all_passed() ? 0 : 1;
+}
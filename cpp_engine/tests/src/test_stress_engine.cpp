@@ -0,0 +1,147 @@
+#include "Instrument.h"
+#include "MarketData.h"
+#include "Portfolio.h"
+#include "StressEngine.h"
+#include "simple_test.h"
+#include <cmath>
+#include <map>
+#include <memory>
+
+std::map<std::string, MarketData> stressMarketData() {
+  std::map<std::string, MarketData> market_data_map;
+  market_data_map["AAPL"] = MarketData("AAPL", 150.0, 0.05, 0.25);
+  market_data_map["MSFT"] = MarketData("MSFT", 300.0, 0.05, 0.20);
+  return market_data_map;
+}
+
+void buildStressPortfolio(Portfolio &portfolio) {
+  portfolio.addInstrument(
+      std::make_unique<EuropeanOption>(OptionType::Call, 150.0, 1.0, "AAPL"), 100);
+  portfolio.addInstrument(
+      std::make_unique<EuropeanOption>(OptionType::Put, 140.0, 0.5, "AAPL"), -50);
+  portfolio.addInstrument(
+      std::make_unique<AmericanOption>(OptionType::Put, 300.0, 0.75, "MSFT"), 20);
+}
+
+void test_stress_scenarios(TestSuite &suite) {
+  suite.run_test("Scenario P&L matches a direct revaluation", [&]() {
+    Portfolio portfolio;
+    buildStressPortfolio(portfolio);
+
+    StressScenario crash;
+    crash.name = "crash";
+    crash.shocks.push_back({"", -0.10, 0.05, 0.0});
+    crash.shocks.push_back({"AAPL", -0.05, 0.02, -0.01});
+
+    StressEngine engine;
+    StressResult result = engine.run(portfolio, stressMarketData(), {crash});
+    suite.assert_equal(1, static_cast<double>(result.scenarioCount()), 0.0);
+    suite.assert_equal(3, static_cast<double>(result.position_count), 0.0);
+
+    std::map<std::string, MarketData> stressed = stressMarketData();
+    stressed["AAPL"].spot_price = 150.0 * 0.90 * 0.95;
+    stressed["AAPL"].volatility = 0.25 + 0.05 + 0.02;
+    stressed["AAPL"].risk_free_rate = 0.04;
+    stressed["MSFT"].spot_price = 300.0 * 0.90;
+    stressed["MSFT"].volatility = 0.20 + 0.05;
+
+    const std::map<std::string, MarketData> base = stressMarketData();
+    double total = 0.0;
+    for (size_t p = 0; p < portfolio.size(); ++p) {
+      const auto &[instrument, quantity] = portfolio.getInstruments()[p];
+      const std::string asset = instrument->getAssetId();
+      const double expected = (instrument->price(stressed[asset]) -
+                               instrument->price(base.at(asset))) * quantity;
+      suite.assert_equal(expected, result.pnl(0, p), 1e-9);
+      total += expected;
+    }
+    suite.assert_equal(total, result.total_pnl[0], 1e-9, "Total");
+  });
+
+  suite.run_test("Shocks on assets not held are ignored", [&]() {
+    Portfolio portfolio;
+    buildStressPortfolio(portfolio);
+    StressScenario other;
+    other.name = "other";
+    other.shocks.push_back({"GOOG", -0.5, 0.5, 0.1});
+    StressResult result = StressEngine().run(portfolio, stressMarketData(), {other});
+    suite.assert_equal(0.0, result.total_pnl[0], 0.0);
+  });
+
+  suite.run_test("Missing market data and invalid shocks throw", [&]() {
+    Portfolio portfolio;
+    buildStressPortfolio(portfolio);
+    std::map<std::string, MarketData> partial = stressMarketData();
+    partial.erase("MSFT");
+    bool threw = false;
+    try {
+      StressEngine().run(portfolio, partial, StressEngine::ladder({0.0}, {0.0}));
+    } catch (const std::runtime_error &) {
+      threw = true;
+    }
+    if (!threw) throw std::runtime_error("Expected runtime_error for missing asset");
+
+    try {
+      StressEngine().run(portfolio, stressMarketData(), StressEngine::ladder({-1.0}, {0.0}));
+    } catch (const std::invalid_argument &) {
+      return;
+    }
+    throw std::runtime_error("Expected invalid_argument for a -100% spot shock");
+  });
+}
+
+void test_stress_ladder(TestSuite &suite) {
+  suite.run_test("Ladder is spot-major and unshocked cell is flat", [&]() {
+    Portfolio portfolio;
+    buildStressPortfolio(portfolio);
+    const std::vector<double> spot_shifts = {-0.2, -0.1, 0.0, 0.1, 0.2};
+    const std::vector<double> vol_shifts = {-0.05, 0.0, 0.05};
+    std::vector<StressScenario> grid = StressEngine::ladder(spot_shifts, vol_shifts);
+    suite.assert_equal(15, static_cast<double>(grid.size()), 0.0);
+
+    StressResult result = StressEngine().run(portfolio, stressMarketData(), grid);
+    suite.assert_equal(0.0, result.total_pnl[2 * vol_shifts.size() + 1], 1e-9, "Flat");
+
+    // The long AAPL call dominates: P&L rises with spot at every vol
+    for (size_t j = 0; j < vol_shifts.size(); ++j) {
+      for (size_t i = 1; i < spot_shifts.size(); ++i) {
+        if (result.pnl(i * vol_shifts.size() + j, 0) <=
+            result.pnl((i - 1) * vol_shifts.size() + j, 0)) {
+          throw std::runtime_error("Call P&L should rise with spot");
+        }
+      }
+    }
+  });
+
+  suite.run_test("Large batch rows add up to the totals", [&]() {
+    Portfolio portfolio;
+    buildStressPortfolio(portfolio);
+    std::vector<double> spot_shifts, vol_shifts;
+    for (int i = -20; i <= 20; ++i) spot_shifts.push_back(0.01 * i);
+    for (int j = -24; j <= 24; ++j) vol_shifts.push_back(0.002 * j);
+
+    StressResult result =
+        StressEngine().run(portfolio, stressMarketData(), StressEngine::ladder(spot_shifts, vol_shifts));
+    suite.assert_equal(41 * 49, static_cast<double>(result.scenarioCount()), 0.0);
+    for (size_t s = 0; s < result.scenarioCount(); ++s) {
+      double total = 0.0;
+      for (size_t p = 0; p < result.position_count; ++p) total += result.pnl(s, p);
+      suite.assert_equal(total, result.total_pnl[s], 1e-9);
+    }
+  });
+}
+
+int main() {
+  TestSuite suite;
+
+  std::cout << "\n" << std::string(60, '=') << std::endl;
+  std::cout << "  Stress Engine Test Suite" << std::endl;
+  std::cout << std::string(60, '=') << "\n" << std::endl;
+
+  test_stress_scenarios(suite);
+  test_stress_ladder(suite);
+
+  suite.print_summary();
+
+  return suite.all_passed() ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+#include "ImpliedVolatilitySurface.h"
+#include "SVISurface.h"
+#include "simple_test.h"
+#include <cmath>
+#include <vector>
+
+using VolatilitySurface::ImpliedVolSurface;
+using VolatilitySurface::SSVISurface;
+using VolatilitySurface::SVIParameters;
+using VolatilitySurface::SVISurface;
+
+ImpliedVolSurface buildSampleSurface() {
+  ImpliedVolSurface surface;
+  // Two expiries with a simple downward skew
+  surface.addPoint(120.0, 0.5, 0.18);
+  surface.addPoint(80.0, 0.5, 0.30);
+  surface.addPoint(100.0, 0.5, 0.22);
+  surface.addPoint(100.0, 1.0, 0.20);
+  surface.addPoint(80.0, 1.0, 0.26);
+  surface.addPoint(120.0, 1.0, 0.17);
+  return surface;
+}
+
+void test_surface_grid(TestSuite &suite) {
+  suite.run_test("Quotes are reproduced exactly on the grid", [&]() {
+    ImpliedVolSurface surface = buildSampleSurface();
+    suite.assert_equal(0.30, surface.interpolate(80.0, 0.5), 1e-12);
+    suite.assert_equal(0.22, surface.interpolate(100.0, 0.5), 1e-12);
+    suite.assert_equal(0.17, surface.interpolate(120.0, 1.0), 1e-12);
+    suite.assert_equal(2, static_cast<double>(surface.expiryCount()), 0.0);
+    suite.assert_equal(6, static_cast<double>(surface.size()), 0.0);
+  });
+
+  suite.run_test("Strike interpolation is linear in log-moneyness variance",
+                 [&]() {
+    ImpliedVolSurface surface = buildSampleSurface();
+    const double K = 90.0, T = 0.5;
+    const double weight = (std::log(K) - std::log(80.0)) /
+                          (std::log(100.0) - std::log(80.0));
+    const double w = (1 - weight) * 0.30 * 0.30 * T + weight * 0.22 * 0.22 * T;
+    suite.assert_equal(std::sqrt(w / T), surface.interpolate(K, T), 1e-12);
+  });
+
+  suite.run_test("Expiry interpolation is linear in total variance", [&]() {
+    ImpliedVolSurface surface = buildSampleSurface();
+    const double T = 0.75;
+    const double w = 0.5 * (0.22 * 0.22 * 0.5) + 0.5 * (0.20 * 0.20 * 1.0);
+    suite.assert_equal(std::sqrt(w / T), surface.interpolate(100.0, T), 1e-12);
+  });
+
+  suite.run_test("Flat vol extrapolation outside the grid", [&]() {
+    ImpliedVolSurface surface = buildSampleSurface();
+    suite.assert_equal(0.30, surface.interpolate(50.0, 0.5), 1e-12, "Low strike");
+    suite.assert_equal(0.17, surface.interpolate(200.0, 1.0), 1e-12, "High strike");
+    suite.assert_equal(0.22, surface.interpolate(100.0, 0.1), 1e-12, "Short expiry");
+    suite.assert_equal(0.20, surface.interpolate(100.0, 3.0), 1e-12, "Long expiry");
+  });
+
+  suite.run_test("Re-quoted strike replaces the grid value and the quote", [&]() {
+    ImpliedVolSurface surface = buildSampleSurface();
+    const size_t quotes = surface.size();
+    surface.addPoint(100.0, 0.5, 0.25);
+    suite.assert_equal(0.25, surface.interpolate(100.0, 0.5), 1e-12);
+
+    suite.assert_equal(static_cast<double>(quotes), static_cast<double>(surface.size()), 0.0,
+                       "No duplicate quote");
+    int matches = 0;
+    for (const VolatilitySurface::VolPoint &point : surface.getPoints()) {
+      if (point.strike == 100.0 && point.expiry == 0.5) {
+        suite.assert_equal(0.25, point.implied_vol, 0.0, "Latest quote kept");
+        ++matches;
+      }
+    }
+    suite.assert_equal(1, matches, 0.0);
+  });
+
+  suite.run_test("Forward rate shifts moneyness between expiries", [&]() {
+    ImpliedVolSurface surface = buildSampleSurface();
+    surface.setForwardRate(0.05);
+    // At T = 0.75 the slices are sampled at log-strikes shifted by +-0.0125
+    const double T = 0.75;
+    const double sticky = buildSampleSurface().interpolate(100.0, T);
+    const double moneyness = surface.interpolate(100.0, T);
+    if (std::abs(sticky - moneyness) < 1e-6) {
+      throw std::runtime_error("Forward rate should change the lookup");
+    }
+  });
+
+  suite.run_test("Batch lookup matches scalar lookups", [&]() {
+    ImpliedVolSurface surface = buildSampleSurface();
+    std::vector<double> strikes = {70.0, 85.0, 100.0, 110.0, 130.0};
+    std::vector<double> expiries = {0.25, 0.5, 0.6, 0.9, 2.0};
+    std::vector<double> vols = surface.interpolate(strikes, expiries);
+    for (size_t i = 0; i < strikes.size(); ++i) {
+      suite.assert_equal(surface.interpolate(strikes[i], expiries[i]), vols[i],
+                         1e-15);
+    }
+  });
+
+  suite.run_test("Empty surface throws", [&]() {
+    ImpliedVolSurface surface;
+    try {
+      surface.interpolate(100.0, 1.0);
+    } catch (const std::runtime_error &) {
+      return;
+    }
+    throw std::runtime_error("Expected runtime_error on empty surface");
+  });
+}
+
+// Quotes generated from known SVI slices, strikes 60..150
+ImpliedVolSurface buildSVISurface(double spot, double rate,
+                                  const std::vector<double> &expiries,
+                                  const std::vector<SVIParameters> &slices) {
+  ImpliedVolSurface surface;
+  for (size_t s = 0; s < expiries.size(); ++s) {
+    const double T = expiries[s];
+    for (double K = 60.0; K <= 150.0; K += 5.0) {
+      const double k = std::log(K / spot) - rate * T;
+      surface.addPoint(K, T, std::sqrt(slices[s].totalVariance(k) / T));
+    }
+  }
+  return surface;
+}
+
+SVIParameters sviSlice(double a, double b, double rho, double m, double sigma) {
+  SVIParameters p;
+  p.a = a;
+  p.b = b;
+  p.rho = rho;
+  p.m = m;
+  p.sigma = sigma;
+  return p;
+}
+
+void test_svi_surface(TestSuite &suite) {
+  const double S = 100.0, r = 0.03;
+  const std::vector<double> expiries = {0.25, 0.5, 1.0, 2.0};
+  const std::vector<SVIParameters> truth = {
+      sviSlice(0.005, 0.08, -0.40, 0.02, 0.15),
+      sviSlice(0.010, 0.10, -0.35, 0.03, 0.20),
+      sviSlice(0.020, 0.12, -0.30, 0.05, 0.25),
+      sviSlice(0.045, 0.14, -0.25, 0.08, 0.30)};
+
+  suite.run_test("SVI fit reproduces the generating slices", [&]() {
+    SVISurface svi(S, r);
+    svi.fit(buildSVISurface(S, r, expiries, truth), 2);
+    suite.assert_equal(4, static_cast<double>(svi.getSlices().size()), 0.0);
+    for (size_t s = 0; s < expiries.size(); ++s) {
+      suite.assert_equal(0.0, svi.getSlices()[s].rmse, 1e-7, "Slice RMSE");
+      for (double k : {-0.4, -0.1, 0.0, 0.2, 0.4}) {
+        suite.assert_equal(truth[s].totalVariance(k),
+                           svi.totalVariance(k, expiries[s]), 1e-6);
+      }
+    }
+    if (!svi.checkArbitrage().isArbitrageFree()) {
+      throw std::runtime_error("Generated surface should be arbitrage-free");
+    }
+  });
+
+  suite.run_test("Analytic skew and term structure match finite differences",
+                 [&]() {
+    SVISurface svi(S, r);
+    svi.fit(buildSVISurface(S, r, expiries, truth));
+    const double h = 1e-4;
+    for (double T : {0.35, 0.75, 1.5}) {
+      const double F = S * std::exp(r * T);
+      const double fd_skew =
+          (svi.impliedVol(F + h, T) - svi.impliedVol(F - h, T)) / (2 * h);
+      suite.assert_equal(fd_skew, svi.skew(T), 1e-6, "Skew");
+      const double fd_term =
+          (svi.impliedVol(95.0, T + h) - svi.impliedVol(95.0, T - h)) / (2 * h);
+      suite.assert_equal(fd_term, svi.termStructure(95.0, T), 1e-5, "Term");
+    }
+    if (svi.skew(1.0) >= 0.0) {
+      throw std::runtime_error("Negative rho should give a downward skew");
+    }
+  });
+
+  suite.run_test("Crossing total variance flags calendar arbitrage", [&]() {
+    std::vector<SVIParameters> crossing = truth;
+    crossing[2] = sviSlice(0.002, 0.05, -0.30, 0.05, 0.25);
+    SVISurface svi(S, r);
+    svi.fit(buildSVISurface(S, r, expiries, crossing));
+    VolatilitySurface::ArbitrageReport report = svi.checkArbitrage();
+    if (report.isCalendarFree()) {
+      throw std::runtime_error("Expected a calendar violation");
+    }
+    suite.assert_equal(0.5, report.calendar_violations.front().first, 0.0);
+  });
+
+  suite.run_test("SSVI fit recovers global parameters", [&]() {
+    // Generate quotes from a known SSVI surface
+    const double rho = -0.4, eta = 1.2, gamma = 0.3;
+    const std::vector<double> theta = {0.01, 0.02, 0.045, 0.09};
+    ImpliedVolSurface surface;
+    for (size_t s = 0; s < expiries.size(); ++s) {
+      const double T = expiries[s];
+      const double phi = eta / (std::pow(theta[s], gamma) *
+                                std::pow(1.0 + theta[s], 1.0 - gamma));
+      for (double K = 60.0; K <= 150.0; K += 5.0) {
+        const double k = std::log(K / S) - r * T;
+        const double w = 0.5 * theta[s] *
+                         (1.0 + rho * phi * k +
+                          std::sqrt((phi * k + rho) * (phi * k + rho) + 1.0 - rho * rho));
+        surface.addPoint(K, T, std::sqrt(w / T));
+      }
+    }
+
+    SSVISurface ssvi(S, r);
+    ssvi.fit(surface);
+    suite.assert_equal(rho, ssvi.getRho(), 0.02, "rho");
+    suite.assert_equal(eta, ssvi.getEta(), 0.05, "eta");
+    suite.assert_equal(gamma, ssvi.getGamma(), 0.05, "gamma");
+    suite.assert_equal(0.0, ssvi.getRmse(), 1e-4, "RMSE");
+    if (!ssvi.checkArbitrage().isArbitrageFree()) {
+      throw std::runtime_error("SSVI fit should be arbitrage-free");
+    }
+  });
+
+  suite.run_test("Unfitted parametric surface throws", [&]() {
+    SVISurface svi(S, r);
+    try {
+      svi.impliedVol(100.0, 1.0);
+    } catch (const std::runtime_error &) {
+      return;
+    }
+    throw std::runtime_error("Expected runtime_error before fit");
+  });
+}
+
+int main() {
+  TestSuite suite;
+
+  std::cout << "\n" << std::string(60, '=') << std::endl;
+  std::cout << "  Volatility Surface Test Suite" << std::endl;
+  std::cout << std::string(60, '=') << "\n" << std::endl;
+
+  test_surface_grid(suite);
+  test_svi_surface(suite);
+
+  suite.print_summary();
+
+  return suite.all_passed() ? 0 : 1;
+}
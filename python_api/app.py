@@ -1,12 +1,15 @@
 from pathlib import Path
 from flask import Flask, render_template, request, jsonify, send_from_directory
 from flask_cors import CORS
+import numpy as np
 import quant_risk_engine
 import traceback
 from typing import Dict, Any, Optional, List
 from datetime import datetime
 from market_data_fetcher import get_market_data_fetcher, MarketDataCache
+from risk_sessions import RiskSessionStore, SessionEntry
 import os
+import secrets
 
 app = Flask(__name__)
 CORS(app)
@@ -198,6 +201,52 @@ def create_option(item: Dict[str, Any]) -> Any:
     
     return option
 
+PRICING_MODEL_CODES = {
+    'blackscholes': int(quant_risk_engine.PricingModel.BlackScholes),
+    'binomial': int(quant_risk_engine.PricingModel.Binomial),
+    'jumpdiffusion': int(quant_risk_engine.PricingModel.MertonJumpDiffusion),
+}
+
+def build_portfolio(portfolio_data: List[Dict[str, Any]]) -> Any:
+    """Builds the C++ portfolio in one columnar call instead of one option per item."""
+    count = len(portfolio_data)
+    is_call = np.zeros(count, dtype=np.uint8)
+    american = np.zeros(count, dtype=np.uint8)
+    model = np.zeros(count, dtype=np.uint8)
+    strike = np.empty(count)
+    expiry = np.empty(count)
+    quantity = np.empty(count, dtype=np.int32)
+    binomial_steps = np.full(count, 100, dtype=np.int32)
+    jump_intensity = np.zeros(count)
+    jump_mean = np.zeros(count)
+    jump_vol = np.zeros(count)
+    asset_ids = []
+
+    for i, item in enumerate(portfolio_data):
+        is_call[i] = item['type'].lower() == 'call'
+        american[i] = item.get('style', 'european').lower() == 'american'
+        strike[i] = float(item['strike'])
+        expiry[i] = float(item['expiry'])
+        quantity[i] = item['quantity']
+        asset_ids.append(item['asset_id'].strip())
+
+        pricing_model_str = item.get('pricing_model', 'blackscholes').lower()
+        model[i] = PRICING_MODEL_CODES.get(pricing_model_str, PRICING_MODEL_CODES['blackscholes'])
+        # As in create_option, only lattice-priced rows take a step count
+        if american[i] or pricing_model_str == 'binomial':
+            binomial_steps[i] = item.get('binomial_steps', 100)
+        if pricing_model_str == 'jumpdiffusion' and not american[i]:
+            jump_params = item.get('jump_parameters', {})
+            jump_intensity[i] = jump_params.get('lambda', 2.0)
+            jump_mean[i] = jump_params.get('mean', -0.05)
+            jump_vol[i] = jump_params.get('vol', 0.15)
+
+    return quant_risk_engine.Portfolio.from_arrays(
+        is_call, strike, expiry, asset_ids, quantity,
+        american=american, model=model, binomial_steps=binomial_steps,
+        jump_intensity=jump_intensity, jump_mean=jump_mean, jump_vol=jump_vol
+    )
+
 BASE_DIR = Path(__file__).resolve().parent
 DASHBOARD_DIR = BASE_DIR.parent / "react_dashboard" / "dist"
 
@@ -407,12 +456,7 @@ def calculate_risk():
         var_config = validate_var_parameters(var_params)
 
         # Build portfolio
-        portfolio = quant_risk_engine.Portfolio()
-        portfolio.reserve(len(portfolio_data))
-        
-        for item in portfolio_data:
-            option = create_option(item)
-            portfolio.add_instrument(option, item['quantity'])
+        portfolio = build_portfolio(portfolio_data)
 
         # Convert market data to C++ format
         market_data_map_cpp = {}
@@ -460,6 +504,13 @@ def calculate_risk():
                 'market_data_used': complete_market_data
             }
         }
+        profile = result_cpp.profile
+        if profile.enabled:
+            result_py['profile'] = {
+                'wall_seconds': profile.wall_seconds,
+                'phase_seconds': profile.phase_seconds,
+                'counters': profile.counters
+            }
         return jsonify(result_py), 200
 
     except ValueError as e:
@@ -579,11 +630,7 @@ def get_net_position(asset_id):
         for idx, item in enumerate(portfolio_data):
             validate_portfolio_item(item, idx)
         
-        portfolio = quant_risk_engine.Portfolio()
-        
-        for item in portfolio_data:
-            option = create_option(item)
-            portfolio.add_instrument(option, item['quantity'])
+        portfolio = build_portfolio(portfolio_data)
         
         net_quantity = portfolio.get_total_quantity(asset_id)
         
@@ -617,11 +664,7 @@ def portfolio_summary():
         for idx, item in enumerate(portfolio_data):
             validate_portfolio_item(item, idx)
         
-        portfolio = quant_risk_engine.Portfolio()
-        
-        for item in portfolio_data:
-            option = create_option(item)
-            portfolio.add_instrument(option, item['quantity'])
+        portfolio = build_portfolio(portfolio_data)
         
         assets = set(item['asset_id'] for item in portfolio_data)
         net_positions = {}
@@ -650,6 +693,241 @@ def portfolio_summary():
         app.logger.error(f"Unexpected error: {traceback.format_exc()}")
         return jsonify({'error': f'Internal server error: {str(e)}'}), 500
 
+# Sessions keep the C++ portfolio and per-position valuations alive between
+# requests, so dashboard refreshes, position deltas and market ticks only
+# revalue what changed instead of rebuilding the book and the engine.
+risk_sessions = RiskSessionStore(
+    max_sessions=int(os.environ.get('RISK_SESSION_LIMIT', 100)),
+    ttl_seconds=float(os.environ.get('RISK_SESSION_TTL_SECONDS', 3600))
+)
+
+def market_data_to_cpp(asset_id: str, md_py: Dict[str, Any]) -> Any:
+    return quant_risk_engine.MarketData(
+        asset_id,
+        float(md_py['spot']),
+        float(md_py['rate']),
+        float(md_py['vol']),
+        float(md_py.get('dividend', 0.0))
+    )
+
+def session_risk_response(session_id: str, entry: SessionEntry) -> Dict[str, Any]:
+    result_cpp = entry.session.get_risk()
+    if not result_cpp.is_valid():
+        raise RuntimeError('Risk calculation produced invalid results')
+    return {
+        'session_id': session_id,
+        'total_pv': result_cpp.total_pv,
+        'total_delta': result_cpp.total_delta,
+        'total_gamma': result_cpp.total_gamma,
+        'total_vega': result_cpp.total_vega,
+        'total_theta': result_cpp.total_theta,
+        'value_at_risk_95': result_cpp.value_at_risk_95,
+        'value_at_risk_99': result_cpp.value_at_risk_99,
+        'expected_shortfall_95': result_cpp.expected_shortfall_95,
+        'expected_shortfall_99': result_cpp.expected_shortfall_99,
+        'portfolio_size': len(entry.session),
+        'var_parameters': {
+            'simulations': entry.var_config['simulations'],
+            'confidence_level': entry.var_config['confidence'],
+            'time_horizon_days': entry.var_config['time_horizon']
+        }
+    }
+
+def add_session_positions(entry: SessionEntry, portfolio_data: List[Dict[str, Any]],
+                          market_data_py: Dict[str, Any]) -> List[int]:
+    """Adds positions to a session, fetching market data for assets it has not seen"""
+    for idx, item in enumerate(portfolio_data):
+        validate_portfolio_item(item, idx)
+    
+    new_assets = set(item['asset_id'].strip() for item in portfolio_data) - entry.assets
+    if new_assets:
+        fetched = auto_fetch_missing_market_data(new_assets, market_data_py)
+        for asset_id in new_assets:
+            validate_market_data(asset_id, fetched[asset_id])
+        for asset_id in new_assets:
+            entry.session.update_market_data(market_data_to_cpp(asset_id, fetched[asset_id]))
+            entry.market_data[asset_id] = fetched[asset_id]
+    
+    position_ids = []
+    try:
+        for item in portfolio_data:
+            index = entry.session.add_instrument(create_option(item), item['quantity'])
+            position_ids.append(entry.session.get_position_id(index))
+    except Exception:
+        # Keep the delta all-or-nothing
+        for position_id in position_ids:
+            entry.session.remove_instrument(entry.session.find_position(position_id))
+        raise
+    return position_ids
+
+def session_not_found(session_id: str):
+    return jsonify({'error': f"Risk session '{session_id}' not found or expired"}), 404
+
+@app.route('/sessions', methods=['POST'])
+def create_session():
+    """
+    Create a risk session from a portfolio; returns its ID, the position IDs
+    and the current risk. Market data is auto-fetched as in /calculate_risk.
+    """
+    try:
+        data = request.get_json()
+        
+        if not data:
+            return jsonify({'error': 'Request body must be valid JSON'}), 400
+        
+        portfolio_data = data.get('portfolio', [])
+        market_data_py = data.get('market_data', {})
+        
+        if not isinstance(portfolio_data, list):
+            return jsonify({'error': "Field 'portfolio' must be an array"}), 400
+        
+        if not isinstance(market_data_py, dict):
+            return jsonify({'error': "Field 'market_data' must be an object"}), 400
+        
+        var_config = validate_var_parameters(data.get('var_parameters'))
+        seed = var_config['seed'] if var_config['seed'] is not None else secrets.randbelow(2**32)
+        
+        session = quant_risk_engine.RiskSession(
+            {}, var_config['simulations'], var_config['time_horizon'], seed
+        )
+        entry = SessionEntry(session, {}, var_config)
+        position_ids = add_session_positions(entry, portfolio_data, market_data_py)
+        
+        session_id = risk_sessions.add(entry)
+        response = session_risk_response(session_id, entry)
+        response['position_ids'] = position_ids
+        return jsonify(response), 201
+        
+    except ValueError as e:
+        return jsonify({'error': f'Validation error: {str(e)}'}), 400
+    except RuntimeError as e:
+        return jsonify({'error': f'Runtime error: {str(e)}'}), 500
+    except Exception as e:
+        app.logger.error(f"Unexpected error: {traceback.format_exc()}")
+        return jsonify({'error': f'Internal server error: {str(e)}'}), 500
+
+@app.route('/sessions/<session_id>', methods=['DELETE'])
+def delete_session(session_id):
+    if not risk_sessions.remove(session_id):
+        return session_not_found(session_id)
+    return jsonify({'session_id': session_id, 'deleted': True}), 200
+
+@app.route('/sessions/<session_id>/risk', methods=['GET'])
+def get_session_risk(session_id):
+    """Current risk of a session, read from its cached valuations"""
+    entry = risk_sessions.get(session_id)
+    if entry is None:
+        return session_not_found(session_id)
+    try:
+        with entry.lock:
+            return jsonify(session_risk_response(session_id, entry)), 200
+    except RuntimeError as e:
+        return jsonify({'error': f'Runtime error: {str(e)}'}), 500
+
+@app.route('/sessions/<session_id>/positions', methods=['POST'])
+def add_positions_to_session(session_id):
+    entry = risk_sessions.get(session_id)
+    if entry is None:
+        return session_not_found(session_id)
+    try:
+        data = request.get_json()
+        
+        if not data or not isinstance(data.get('positions'), list):
+            return jsonify({'error': "Field 'positions' must be an array"}), 400
+        
+        market_data_py = data.get('market_data', {})
+        if not isinstance(market_data_py, dict):
+            return jsonify({'error': "Field 'market_data' must be an object"}), 400
+        
+        with entry.lock:
+            position_ids = add_session_positions(entry, data['positions'], market_data_py)
+            response = session_risk_response(session_id, entry)
+        response['position_ids'] = position_ids
+        return jsonify(response), 200
+        
+    except ValueError as e:
+        return jsonify({'error': f'Validation error: {str(e)}'}), 400
+    except RuntimeError as e:
+        return jsonify({'error': f'Runtime error: {str(e)}'}), 500
+    except Exception as e:
+        app.logger.error(f"Unexpected error: {traceback.format_exc()}")
+        return jsonify({'error': f'Internal server error: {str(e)}'}), 500
+
+@app.route('/sessions/<session_id>/positions/<int:position_id>', methods=['PATCH', 'DELETE'])
+def modify_session_position(session_id, position_id):
+    """PATCH sets a position's quantity; DELETE removes it"""
+    entry = risk_sessions.get(session_id)
+    if entry is None:
+        return session_not_found(session_id)
+    try:
+        quantity = None
+        if request.method == 'PATCH':
+            data = request.get_json()
+            if not data or not isinstance(data.get('quantity'), int):
+                return jsonify({'error': "Field 'quantity' must be an integer"}), 400
+            quantity = data['quantity']
+        
+        with entry.lock:
+            index = entry.session.find_position(position_id)
+            if quantity is None:
+                entry.session.remove_instrument(index)
+            else:
+                entry.session.update_quantity(index, quantity)
+            return jsonify(session_risk_response(session_id, entry)), 200
+        
+    except IndexError:
+        return jsonify({'error': f'Position {position_id} not found in session'}), 404
+    except ValueError as e:
+        return jsonify({'error': f'Validation error: {str(e)}'}), 400
+    except RuntimeError as e:
+        return jsonify({'error': f'Runtime error: {str(e)}'}), 500
+    except Exception as e:
+        app.logger.error(f"Unexpected error: {traceback.format_exc()}")
+        return jsonify({'error': f'Internal server error: {str(e)}'}), 500
+
+@app.route('/sessions/<session_id>/market_data', methods=['POST'])
+def tick_session_market_data(session_id):
+    """
+    Apply market-data ticks: {"market_data": {"AAPL": {"spot": 151.2}}}.
+    Omitted fields keep their current values; only positions on the ticked
+    assets are revalued.
+    """
+    entry = risk_sessions.get(session_id)
+    if entry is None:
+        return session_not_found(session_id)
+    try:
+        data = request.get_json()
+        
+        if not data or not isinstance(data.get('market_data'), dict) or not data['market_data']:
+            return jsonify({'error': "Field 'market_data' must be a non-empty object"}), 400
+        
+        with entry.lock:
+            updates = {}
+            for asset_id, tick in data['market_data'].items():
+                if not isinstance(tick, dict):
+                    return jsonify({'error': f"Market data for '{asset_id}' must be an object"}), 400
+                md = dict(entry.market_data.get(asset_id, {}))
+                md.update(tick)
+                validate_market_data(asset_id, md)
+                updates[asset_id] = md
+            
+            revalued = 0
+            for asset_id, md in updates.items():
+                revalued += entry.session.update_market_data(market_data_to_cpp(asset_id, md))
+                entry.market_data[asset_id] = md
+            
+            response = session_risk_response(session_id, entry)
+        response['revalued_positions'] = revalued
+        return jsonify(response), 200
+        
+    except ValueError as e:
+        return jsonify({'error': f'Validation error: {str(e)}'}), 400
+    except RuntimeError as e:
+        return jsonify({'error': f'Runtime error: {str(e)}'}), 500
+    except Exception as e:
+        app.logger.error(f"Unexpected error: {traceback.format_exc()}")
+        return jsonify({'error': f'Internal server error: {str(e)}'}), 500
+
 @app.errorhandler(404)
 def not_found(error):
     return jsonify({'error': 'Endpoint not found'}), 404
@@ -684,4 +962,5 @@ if __name__ == '__main__':
         print(f"Dashboard files: {list(DASHBOARD_DIR.glob('*'))[:5]}")
     print("=" * 60)
     
-    app.run(host=host, port=port, debug=debug)
\ No newline at end of file
+    # Risk runs release the GIL, so concurrent requests are computed in parallel
+    app.run(host=host, port=port, debug=debug, threaded=True)
\ No newline at end of file
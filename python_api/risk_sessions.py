@@ -0,0 +1,76 @@
+import threading
+import time
+import uuid
+from collections import OrderedDict
+from typing import Any, Dict, Optional, Set
+import logging
+
+logger = logging.getLogger(__name__)
+
+
+class SessionEntry:
+    """A live C++ RiskSession plus the bookkeeping the API needs around it"""
+
+    def __init__(self, session: Any, market_data: Dict[str, Dict[str, Any]], var_config: Dict[str, Any]):
+        self.session = session
+        self.market_data = market_data
+        self.var_config = var_config
+        self.lock = threading.Lock()
+        self.last_used = time.monotonic()
+
+    @property
+    def assets(self) -> Set[str]:
+        return set(self.market_data)
+
+
+class RiskSessionStore:
+    """
+    In-process registry of risk sessions keyed by an opaque ID
+
+    Each session keeps its C++ portfolio and per-position valuations alive
+    between requests. Requests on one session are serialised by its lock;
+    different sessions run concurrently. Idle sessions expire after ttl_seconds,
+    and the least recently used one is dropped once max_sessions is reached.
+    """
+
+    def __init__(self, max_sessions: int = 100, ttl_seconds: float = 3600.0):
+        self.max_sessions = max_sessions
+        self.ttl_seconds = ttl_seconds
+        self._sessions: "OrderedDict[str, SessionEntry]" = OrderedDict()
+        self._lock = threading.Lock()
+
+    def add(self, entry: SessionEntry) -> str:
+        session_id = uuid.uuid4().hex
+        with self._lock:
+            self._expire()
+            while len(self._sessions) >= self.max_sessions:
+                evicted, _ = self._sessions.popitem(last=False)
+                logger.info(f"Evicted risk session {evicted}")
+            self._sessions[session_id] = entry
+        return session_id
+
+    def get(self, session_id: str) -> Optional[SessionEntry]:
+        with self._lock:
+            self._expire()
+            entry = self._sessions.get(session_id)
+            if entry is not None:
+                entry.last_used = time.monotonic()
+                self._sessions.move_to_end(session_id)
+            return entry
+
+    def remove(self, session_id: str) -> bool:
+        with self._lock:
+            return self._sessions.pop(session_id, None) is not None
+
+    def __len__(self) -> int:
+        with self._lock:
+            return len(self._sessions)
+
+    def _expire(self) -> None:
+        cutoff = time.monotonic() - self.ttl_seconds
+        while self._sessions:
+            session_id, entry = next(iter(self._sessions.items()))
+            if entry.last_used >= cutoff:
+                break
+            del self._sessions[session_id]
+            logger.info(f"Expired risk session {session_id}")
@@ -7,15 +7,27 @@ ext_modules = [
     Extension(
         'quant_risk_engine',
         sources=[
-            '../cpp_engine/apps/main.cpp',
             '../cpp_engine/libraries/python_interface/src/pybind_wrapper.cpp',
             '../cpp_engine/libraries/qe_risk_engine/src/Portfolio.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/PortfolioLoader.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/PortfolioSnapshot.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/MappedFile.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/Profiling.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/Parallel.cpp',
             '../cpp_engine/libraries/qe_risk_engine/src/RiskEngine.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/RiskPipeline.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/ReturnHistory.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/RiskSession.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/ScenarioGenerator.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/StressEngine.cpp',
             '../cpp_engine/libraries/qe_risk_engine/src/BlackScholes.cpp',
             '../cpp_engine/libraries/qe_risk_engine/src/BinomialTree.cpp',
             '../cpp_engine/libraries/qe_risk_engine/src/JumpDiffusion.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/Heston.cpp',
             '../cpp_engine/libraries/qe_risk_engine/src/ImpliedVolatilitySurface.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/SVISurface.cpp',
             '../cpp_engine/libraries/qe_risk_engine/src/MarketData.cpp',
+            '../cpp_engine/libraries/qe_risk_engine/src/InstrumentArena.cpp',
             "../cpp_engine/libraries/qe_risk_engine/src/Instrument.cpp"
         ],
         include_dirs=[
@@ -27,6 +39,7 @@ ext_modules = [
             '../cpp_engine/libraries/qe_risk_engine/includes'
         ],
         language='c++',
+        define_macros=[('QE_ENABLE_PROFILING', None)],
         extra_compile_args=cpp_args,
     ),
 ]
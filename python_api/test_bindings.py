@@ -0,0 +1,237 @@
+"""
+Smoke tests for the quant_risk_engine bindings
+Covers batch Black-Scholes pricing, GIL-released risk calls and columnar
+portfolio construction
+"""
+
+import threading
+
+import pytest
+
+np = pytest.importorskip("numpy")
+qre = pytest.importorskip("quant_risk_engine")
+
+
+GREEKS = ("price", "delta", "gamma", "vega", "theta", "rho")
+
+
+def scalar_chain():
+    """Small call/put chain priced one option at a time"""
+    strikes = np.array([80.0, 90.0, 100.0, 110.0, 120.0])
+    is_call = np.array([True, False, True, False, True])
+    md = qre.MarketData("AAPL", 100.0, 0.05, 0.25)
+    prices = []
+    for strike, call in zip(strikes, is_call):
+        option_type = qre.OptionType.Call if call else qre.OptionType.Put
+        prices.append(qre.EuropeanOption(option_type, strike, 0.5, "AAPL").price(md))
+    return strikes, is_call, np.array(prices)
+
+
+def batch_inputs(strikes):
+    count = len(strikes)
+    return (np.full(count, 100.0), strikes, np.full(count, 0.05),
+            np.full(count, 0.5), np.full(count, 0.25))
+
+
+class TestBlackScholesBatch:
+    """Test vectorised Black-Scholes pricing"""
+
+    def test_allocates_all_outputs(self):
+        """Test that every column is allocated when no outputs are given"""
+        strikes, is_call, expected = scalar_chain()
+        result = qre.black_scholes_batch(*batch_inputs(strikes), is_call)
+
+        assert set(result.keys()) == set(GREEKS)
+        for name in GREEKS:
+            assert result[name].dtype == np.float64
+            assert result[name].shape == strikes.shape
+        np.testing.assert_allclose(result["price"], expected, rtol=1e-10)
+        assert np.all(result["gamma"] > 0)
+        assert np.all(result["vega"] > 0)
+
+    def test_writes_preallocated_outputs_in_place(self):
+        """Test that given outputs are filled in place and the rest skipped"""
+        strikes, is_call, expected = scalar_chain()
+        price = np.zeros(len(strikes))
+        delta = np.zeros(len(strikes))
+        result = qre.black_scholes_batch(*batch_inputs(strikes), is_call,
+                                         price=price, delta=delta)
+
+        assert set(result.keys()) == {"price", "delta"}
+        assert np.shares_memory(result["price"], price)
+        np.testing.assert_allclose(price, expected, rtol=1e-10)
+        assert np.all(delta[is_call] > 0)
+        assert np.all(delta[~is_call] < 0)
+
+    def test_matches_allocated_outputs(self):
+        """Test that both paths give the same numbers, threaded or not"""
+        # Long enough for the kernel to split the chain across threads
+        strikes = np.linspace(50.0, 150.0, 10000)
+        is_call = np.arange(len(strikes)) % 2 == 0
+        allocated = qre.black_scholes_batch(*batch_inputs(strikes), is_call, num_threads=1)
+        outputs = {name: np.empty(len(strikes)) for name in GREEKS}
+        qre.black_scholes_batch(*batch_inputs(strikes), is_call.astype(np.uint8),
+                                num_threads=4, **outputs)
+
+        for name in GREEKS:
+            np.testing.assert_array_equal(outputs[name], allocated[name])
+
+    def test_converts_lists_and_integer_flags(self):
+        """Test that sequences and int flags are accepted"""
+        strikes, is_call, expected = scalar_chain()
+        spot, _, rate, expiry, vol = batch_inputs(strikes)
+        result = qre.black_scholes_batch(list(spot), list(strikes), rate, expiry, vol,
+                                         [int(c) for c in is_call])
+        np.testing.assert_allclose(result["price"], expected, rtol=1e-10)
+
+    def test_rejects_bad_outputs(self):
+        """Test output dtype, contiguity and length checks"""
+        strikes, is_call, _ = scalar_chain()
+        inputs = batch_inputs(strikes)
+        with pytest.raises(TypeError):
+            qre.black_scholes_batch(*inputs, is_call, price=np.zeros(len(strikes), np.float32))
+        with pytest.raises(TypeError):
+            qre.black_scholes_batch(*inputs, is_call, price=np.zeros(2 * len(strikes))[::2])
+        with pytest.raises(ValueError):
+            qre.black_scholes_batch(*inputs, is_call, price=np.zeros(len(strikes) + 1))
+        with pytest.raises(ValueError):
+            qre.black_scholes_batch(*inputs, is_call[:-1])
+
+
+def sample_market_data():
+    return {
+        "AAPL": qre.MarketData("AAPL", 175.0, 0.05, 0.28),
+        "MSFT": qre.MarketData("MSFT", 410.0, 0.05, 0.24),
+    }
+
+
+def sample_columns():
+    return {
+        "is_call": np.array([True, False, True, True]),
+        "strike": np.array([170.0, 180.0, 400.0, 420.0]),
+        "expiry": np.array([0.5, 0.25, 1.0, 0.75]),
+        "asset_id": ["AAPL", "AAPL", "MSFT", "MSFT"],
+        "quantity": np.array([10, -5, 3, 7], dtype=np.int32),
+        "american": np.array([False, True, False, False]),
+    }
+
+
+def sample_portfolio():
+    """Same book as sample_columns, one instrument at a time"""
+    columns = sample_columns()
+    portfolio = qre.Portfolio()
+    for i in range(len(columns["strike"])):
+        option_type = qre.OptionType.Call if columns["is_call"][i] else qre.OptionType.Put
+        cls = qre.AmericanOption if columns["american"][i] else qre.EuropeanOption
+        portfolio.add_instrument(cls(option_type, float(columns["strike"][i]),
+                                     float(columns["expiry"][i]), columns["asset_id"][i]),
+                                 int(columns["quantity"][i]))
+    return portfolio
+
+
+class TestPortfolioFromArrays:
+    """Test columnar portfolio construction"""
+
+    def test_matches_instrument_by_instrument(self):
+        """Test that from_arrays builds the same book as add_instrument"""
+        portfolio = qre.Portfolio.from_arrays(**sample_columns())
+        assert portfolio.size() == 4
+        assert portfolio.get_asset_count() == 2
+
+        engine = qre.RiskEngine(1000)
+        engine.set_random_seed(7)
+        engine.set_use_fixed_seed(True)
+        actual = engine.calculate_portfolio_risk(portfolio, sample_market_data())
+        expected = engine.calculate_portfolio_risk(sample_portfolio(), sample_market_data())
+        assert actual.total_pv == pytest.approx(expected.total_pv, rel=1e-12)
+        assert actual.total_delta == pytest.approx(expected.total_delta, rel=1e-12)
+        assert actual.value_at_risk_99 == pytest.approx(expected.value_at_risk_99, rel=1e-12)
+
+    def test_add_positions_appends(self):
+        """Test that add_positions extends an existing book"""
+        portfolio = sample_portfolio()
+        portfolio.add_positions(**sample_columns())
+        assert portfolio.size() == 8
+        assert portfolio.get_asset_count() == 2
+
+    def test_rejects_bad_columns(self):
+        """Test length mismatches and Heston rows"""
+        columns = sample_columns()
+        columns["strike"] = columns["strike"][:-1]
+        with pytest.raises(ValueError):
+            qre.Portfolio.from_arrays(**columns)
+
+        columns = sample_columns()
+        columns["model"] = np.array([0, int(qre.PricingModel.Heston), 0, 0], dtype=np.uint8)
+        with pytest.raises(ValueError, match="Heston"):
+            qre.Portfolio.from_arrays(**columns)
+
+
+class TestConcurrentRisk:
+    """Test risk calls from several Python threads"""
+
+    def test_threads_match_serial_results(self):
+        """Test that GIL-released calls give the serial answer"""
+        portfolio = sample_portfolio()
+        market_data = sample_market_data()
+        engine = qre.RiskEngine(2000)
+        engine.set_random_seed(11)
+        engine.set_use_fixed_seed(True)
+        expected = engine.calculate_portfolio_risk(portfolio, market_data)
+
+        results = [None] * 4
+        errors = []
+
+        def worker(index):
+            try:
+                results[index] = engine.calculate_portfolio_risk(portfolio, market_data)
+            except Exception as error:
+                errors.append(error)
+
+        threads = [threading.Thread(target=worker, args=(i,)) for i in range(len(results))]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        assert not errors
+        for result in results:
+            assert result.total_pv == pytest.approx(expected.total_pv, rel=1e-12)
+            assert result.value_at_risk_99 == pytest.approx(expected.value_at_risk_99, rel=1e-12)
+
+    def test_mutation_waits_for_running_calculations(self):
+        """Test that editing a portfolio mid-calculation never tears the book"""
+        portfolio = sample_portfolio()
+        market_data = sample_market_data()
+        engine = qre.RiskEngine(20000)
+        engine.set_random_seed(11)
+        engine.set_use_fixed_seed(True)
+        # The first position flips between these, so every result must be
+        # one of the two books
+        quantities = (10, -10)
+        expected_pv = []
+        for quantity in quantities:
+            portfolio.update_quantity(0, quantity)
+            expected_pv.append(engine.calculate_portfolio_risk(portfolio, market_data).total_pv)
+
+        results = []
+        errors = []
+
+        def worker():
+            try:
+                for _ in range(5):
+                    results.append(engine.calculate_portfolio_risk(portfolio, market_data))
+            except Exception as error:
+                errors.append(error)
+
+        thread = threading.Thread(target=worker)
+        thread.start()
+        flips = 0
+        while thread.is_alive():
+            flips += 1
+            portfolio.update_quantity(0, quantities[flips % 2])
+        thread.join()
+
+        assert not errors
+        for result in results:
+            assert any(result.total_pv == pytest.approx(pv, rel=1e-12) for pv in expected_pv)